@@ -31,6 +31,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <opencv2/highgui/highgui.hpp>
 #include "rtabmap/core/SensorData.h"
+#include "rtabmap/core/FramePool.h"
 #include <set>
 #include <stack>
 #include <list>
@@ -79,6 +80,8 @@ protected:
 
 	virtual cv::Mat captureImage() = 0;
 
+	FramePool & framePool() {return _framePool;} // buffers of the captured images
+
 private:
 	float _imageRate;
 	unsigned int _imageWidth;
@@ -87,6 +90,7 @@ private:
 	UTimer * _frameRateTimer;
 	cv::Mat _k; // camera_matrix
 	cv::Mat _d; // distorsion_coefficients
+	FramePool _framePool;
 };
 
 
@@ -38,6 +38,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stack>
 #include <list>
 #include <vector>
+#include "rtabmap/core/FramePool.h"
 
 #include <pcl/io/openni_camera/openni_depth_image.h>
 #include <pcl/io/openni_camera/openni_image.h>
@@ -118,12 +119,15 @@ protected:
 	 */
 	virtual void captureImage(cv::Mat & rgb, cv::Mat & depth, float & fx, float & fy, float & cx, float & cy) = 0;
 
+	FramePool & framePool() {return _framePool;} // buffers of the captured images
+
 private:
 	float _imageRate;
 	Transform _localTransform;
 	bool _mirroring;
 	bool _colorOnly;
 	UTimer * _frameRateTimer;
+	FramePool _framePool;
 };
 
 /////////////////////////
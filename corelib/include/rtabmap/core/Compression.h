@@ -37,6 +37,7 @@ namespace rtabmap {
 
 /**
  * Compress image or data
+ * (see DecompressionService to decode many images or nodes concurrently)
  *
  * Example compression:
  *   cv::Mat image;// an image
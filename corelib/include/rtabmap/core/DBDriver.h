@@ -48,7 +48,9 @@ class Signature;
 class VWDictionary;
 class VisualWord;
 
-// Todo This class needs a refactoring, the _dbSafeAccessMutex problem when the trash is emptying (transaction)
+// The trash is saved by a persistent thread (see emptyTrashes()). Signatures and words being
+// saved stay in the trash until they are committed, so that they can still be read. If the driver
+// has a connection for writing (hasWriterConnectionQuery()), the other queries are not blocked while saving.
 // "Of course, it has always been the case and probably always will be
 //that you cannot use the same sqlite3 connection in two or more
 //threads at the same time.  You can use different sqlite3 connections
@@ -71,7 +73,9 @@ public:
 	void asyncSave(Signature * s); //ownership transferred
 	void asyncSave(VisualWord * vw); //ownership transferred
 	void emptyTrashes(bool async = false);
-	double getEmptyTrashesTime() const {return _emptyTrashesTime;}
+	double getEmptyTrashesTime() const {return _emptyTrashesTime;} // time saving since the last async request
+	double getEmptyTrashesLatency() const {return _emptyTrashesLatency;} // from the last async request to the end of saving
+	int getTrashQueueSize() const {return _trashQueueSize;} // signatures and words in the trash on the last async request
 	void setTimestampUpdateEnabled(bool enabled) {_timestampUpdate = enabled;} // used on Update Signature and Word queries
 
 public:
@@ -91,6 +95,7 @@ public:
 	void load(VWDictionary * dictionary) const;
 	void loadLastNodes(std::list<Signature *> & signatures) const;
 	void loadSignatures(const std::list<int> & ids, std::list<Signature *> & signatures, std::set<int> * loadedFromTrash = 0);
+	void loadSignaturesNotInTrash(const std::list<int> & ids, std::list<Signature *> & signatures) const; // the trash is not modified
 	void loadWords(const std::set<int> & wordIds, std::list<VisualWord *> & vws);
 
 	// Specific queries...
@@ -117,6 +122,9 @@ private:
 	virtual long getMemoryUsedQuery() const = 0; // In bytes
 
 	virtual void executeNoResultQuery(const std::string & sql) const = 0;
+	virtual bool hasWriterConnectionQuery() const = 0; // save/update queries can be done while other queries are executed
+	virtual void beginTransactionQuery() const = 0; // on the writer connection
+	virtual void commitQuery() const = 0; // on the writer connection
 
 	virtual void getWeightQuery(int signatureId, int & weight) const = 0;
 
@@ -150,15 +158,23 @@ private:
 
 	//thread stuff
 	virtual void mainLoop();
+	virtual void mainLoopKill();
 
 private:
 	UMutex _transactionMutex;
 	std::map<int, Signature *> _trashSignatures;//<id, Signature*>
 	std::map<int, VisualWord *> _trashVisualWords; //<id, VisualWord*>
+	std::set<int> _savingSignatures; // in the trash, being saved
+	std::set<int> _savingVisualWords; // in the trash, being saved
 	UMutex _trashesMutex;
 	UMutex _dbSafeAccessMutex;
+	UMutex _savingMutex; // locked while the trash is saved
 	USemaphore _addSem;
 	double _emptyTrashesTime;
+	double _emptyTrashesLatency;
+	double _emptyTrashesRequestStamp;
+	int _trashQueueSize;
+	unsigned int _trashMaxSize;
 	std::string _url;
 	bool _timestampUpdate;
 };
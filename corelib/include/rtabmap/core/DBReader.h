@@ -35,10 +35,12 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UEventsSender.h>
 #include <rtabmap/core/Transform.h>
 #include <rtabmap/core/SensorData.h>
+#include <rtabmap/core/DecompressionService.h>
 
 #include <opencv2/core/core.hpp>
 
 #include <set>
+#include <list>
 
 namespace rtabmap {
 
@@ -60,6 +62,24 @@ protected:
 	virtual void mainLoopBegin();
 	virtual void mainLoop();
 
+private:
+	void prefetch();
+
+private:
+	// node read in advance, decoded by the DecompressionService
+	struct Prefetched
+	{
+		int id;
+		DecompressionFuture data;
+		float fx, fy, cx, cy;
+		Transform localTransform;
+		Transform pose;
+		float rotVariance;
+		float transVariance;
+		double stamp;
+		std::vector<unsigned char> userData;
+	};
+
 private:
 	std::string _path;
 	float _frameRate;
@@ -69,7 +89,8 @@ private:
 	DBDriver * _dbDriver;
 	UTimer _timer;
 	std::set<int> _ids;
-	std::set<int>::iterator _currentId;
+	std::set<int>::iterator _currentId; // next node to read
+	std::list<Prefetched> _prefetched;
 };
 
 } /* namespace rtabmap */
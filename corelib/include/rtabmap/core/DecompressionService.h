@@ -0,0 +1,138 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DECOMPRESSIONSERVICE_H_
+#define DECOMPRESSIONSERVICE_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <rtabmap/utilite/UMutex.h>
+#include <rtabmap/utilite/USemaphore.h>
+#include <rtabmap/utilite/UDestroyer.h>
+#include <opencv2/core/core.hpp>
+#include <list>
+#include <vector>
+
+class UThread;
+
+namespace rtabmap {
+
+class Signature;
+class DecompressionService;
+class DecompressionState;
+
+/**
+ * Result of a decompression requested to the DecompressionService. The
+ * accessors wait until all parts are decoded. While waiting, the calling
+ * thread decodes pending parts of the service instead of blocking.
+ * Copies share the same result.
+ */
+class RTABMAP_EXP DecompressionFuture
+{
+public:
+	DecompressionFuture(); // not valid
+	DecompressionFuture(const DecompressionFuture & future);
+	DecompressionFuture & operator=(const DecompressionFuture & future);
+	~DecompressionFuture();
+
+	bool isValid() const {return _state != 0;}
+	bool isReady() const;
+	void wait() const;
+
+	int id() const;
+	const cv::Mat & image() const;
+	const cv::Mat & depth() const; // or right image
+	const cv::Mat & laserScan() const;
+
+private:
+	friend class DecompressionService;
+	DecompressionFuture(DecompressionState * state);
+
+private:
+	DecompressionState * _state;
+};
+
+/**
+ * Pool of threads decoding the compressed image, depth and laser scan of
+ * nodes. The parts of a node are decoded concurrently, and many nodes
+ * can be requested at once, so all threads are used when a batch of
+ * nodes is decoded.
+ *
+ * Example:
+ *   std::vector<DecompressionFuture> futures = DecompressionService::instance().decompress(signatures);
+ *   for each future: future.image(), future.depth() // waits
+ */
+class RTABMAP_EXP DecompressionService
+{
+public:
+	// shared service (4 threads), used by Signature::uncompressData()
+	static DecompressionService & instance();
+
+public:
+	DecompressionService(int threads = 4);
+	~DecompressionService(); // pending parts are decoded before the threads are stopped
+
+	int threads() const {return (int)_workers.size();}
+
+	/**
+	 * Decode the parts not empty (image, depth or right image: uncompressImage(),
+	 * laser scan: uncompressData()).
+	 */
+	DecompressionFuture decompress(
+			const cv::Mat & imageCompressed,
+			const cv::Mat & depthCompressed = cv::Mat(),
+			const cv::Mat & laserScanCompressed = cv::Mat(),
+			int id = 0);
+
+	// Parts of the signature not already uncompressed
+	DecompressionFuture decompress(const Signature & signature);
+	std::vector<DecompressionFuture> decompress(const std::list<Signature *> & signatures);
+
+	// Decode the signatures and set their raw data (blocking)
+	void uncompressData(const std::list<Signature *> & signatures);
+
+private:
+	DecompressionService(const DecompressionService &);
+	DecompressionService & operator=(const DecompressionService &);
+
+	friend class DecompressionFuture;
+	friend class DecompressionWorker;
+	bool runTask(); // decode a pending part, false if there is none
+
+private:
+	std::vector<UThread *> _workers;
+	std::list<std::pair<DecompressionState *, int> > _tasks; // <node, part>
+	UMutex _tasksMutex;
+	USemaphore _tasksAdded;
+
+	static DecompressionService * instance_;
+	static UDestroyer<DecompressionService> destroyer_;
+	static UMutex instanceMutex_;
+};
+
+} /* namespace rtabmap */
+#endif /* DECOMPRESSIONSERVICE_H_ */
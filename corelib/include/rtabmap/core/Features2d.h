@@ -104,11 +104,24 @@ protected:
 	Feature2D(const ParametersMap & parameters = ParametersMap());
 
 private:
+	friend class KeypointsTilesThread;
+	friend class DescriptorsThread;
+
+	std::vector<cv::KeyPoint> generateKeypointsTiled(const cv::Mat & image, const cv::Rect & roi) const;
+
 	virtual std::vector<cv::KeyPoint> generateKeypointsImpl(const cv::Mat & image, const cv::Rect & roi) const = 0;
 	virtual cv::Mat generateDescriptorsImpl(const cv::Mat & image, std::vector<cv::KeyPoint> & keypoints) const = 0;
 
+	// If the Impl methods can be called by many threads at the same time
+	virtual bool isKeypointsThreadSafe() const {return true;}
+	virtual bool isDescriptorsThreadSafe() const {return true;}
+
 private:
 	int maxFeatures_;
+	int gridRows_;
+	int gridCols_;
+	int gridOverlap_;
+	int extractionThreads_;
 };
 
 //SURF
@@ -124,6 +137,8 @@ public:
 private:
 	virtual std::vector<cv::KeyPoint> generateKeypointsImpl(const cv::Mat & image, const cv::Rect & roi) const;
 	virtual cv::Mat generateDescriptorsImpl(const cv::Mat & image, std::vector<cv::KeyPoint> & keypoints) const;
+	virtual bool isKeypointsThreadSafe() const {return _gpuSurf == 0;}
+	virtual bool isDescriptorsThreadSafe() const {return _gpuSurf == 0;}
 
 private:
 	double hessianThreshold_;
@@ -175,6 +190,8 @@ public:
 private:
 	virtual std::vector<cv::KeyPoint> generateKeypointsImpl(const cv::Mat & image, const cv::Rect & roi) const;
 	virtual cv::Mat generateDescriptorsImpl(const cv::Mat & image, std::vector<cv::KeyPoint> & keypoints) const;
+	virtual bool isKeypointsThreadSafe() const {return _gpuOrb == 0;}
+	virtual bool isDescriptorsThreadSafe() const {return _gpuOrb == 0;}
 
 private:
 	int nFeatures_;
@@ -205,6 +222,7 @@ public:
 
 private:
 	virtual std::vector<cv::KeyPoint> generateKeypointsImpl(const cv::Mat & image, const cv::Rect & roi) const;
+	virtual bool isKeypointsThreadSafe() const {return _gpuFast == 0;}
 
 private:
 	int threshold_;
@@ -247,6 +265,7 @@ public:
 
 private:
 	virtual cv::Mat generateDescriptorsImpl(const cv::Mat & image, std::vector<cv::KeyPoint> & keypoints) const;
+	virtual bool isDescriptorsThreadSafe() const {return false;} // cv::FREAK builds its pattern on compute()
 
 private:
 	bool orientationNormalized_;
@@ -311,6 +330,7 @@ public:
 
 private:
 	virtual cv::Mat generateDescriptorsImpl(const cv::Mat & image, std::vector<cv::KeyPoint> & keypoints) const;
+	virtual bool isDescriptorsThreadSafe() const {return false;} // cv::FREAK builds its pattern on compute()
 
 private:
 	bool orientationNormalized_;
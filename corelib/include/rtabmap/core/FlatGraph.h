@@ -0,0 +1,118 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef FLATGRAPH_H_
+#define FLATGRAPH_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <rtabmap/core/Transform.h>
+#include <rtabmap/core/Link.h>
+#include <map>
+#include <vector>
+
+namespace rtabmap {
+
+/**
+ * Poses and links of a graph in flat arrays: the node ids sorted in one
+ * vector with their poses in a parallel vector, and the links grouped by
+ * their "from" node (compressed sparse rows). A node is found by binary
+ * search on its id, then referred by its index, so traversing the graph
+ * doesn't allocate anything.
+ *
+ * Nodes and links are added in any order, then finalize() sorts them:
+ *   FlatGraph graph;
+ *   graph.addNode(id, pose); ...
+ *   graph.addLink(link); ...
+ *   graph.finalize();
+ *   for(int i=0; i<graph.size(); ++i)
+ *      for(int k=graph.linksBegin(i); k<graph.linksEnd(i); ++k)
+ *         graph.link(k), graph.linkTo(k) (index of the "to" node, -1 if not in the graph)
+ *
+ * Links keep their order of insertion for the same "from" node, like in a
+ * std::multimap<int, Link>. Links whose "from" node is not in the graph are
+ * ignored.
+ */
+class RTABMAP_EXP FlatGraph
+{
+public:
+	FlatGraph();
+	FlatGraph(const std::map<int, Transform> & poses, const std::multimap<int, Link> & links);
+
+	void clear();
+	void reserve(int nodes, int links);
+
+	void addNode(int id, const Transform & pose); // ids must be unique
+	void addLink(const Link & link);
+	void finalize(); // can be called again after adding nodes or links
+
+	bool isFinalized() const {return _finalized;}
+	bool empty() const {return _ids.empty();}
+	int size() const {return (int)_ids.size();}
+	int linksSize() const {return (int)_links.size();}
+
+	// Nodes
+	int index(int id) const; // -1 if not found
+	bool contains(int id) const {return index(id) >= 0;}
+	int id(int index) const {return _ids[index];}
+	const Transform & pose(int index) const {return _poses[index];}
+	void setPose(int index, const Transform & pose) {_poses[index] = pose;}
+	const std::vector<int> & ids() const {return _ids;}
+	const std::vector<Transform> & poses() const {return _poses;}
+	void setPoses(const std::vector<Transform> & poses); // same size than the graph
+	int removeNullPoses(); // with their links, return the number of nodes removed
+
+	// Links of the node "index" are in [linksBegin(index), linksEnd(index))
+	int linksBegin(int index) const {return _offsets[index];}
+	int linksEnd(int index) const {return _offsets[index+1];}
+	const Link & link(int k) const {return _links[k];}
+	int linkTo(int k) const {return _linksTo[k];}
+	const std::vector<Link> & links() const {return _links;} // in order of insertion if not finalized
+	int findLink(int from, int to) const; // by id, in both directions, -1 if not found
+
+	// Adapters, appended to the maps
+	void toMaps(std::map<int, Transform> & poses, std::multimap<int, Link> & links) const;
+	void toMaps(std::map<int, Transform> & poses) const;
+	std::map<int, Transform> posesMap() const;
+	std::multimap<int, Link> linksMap() const;
+
+	long memoryUsed() const; // in bytes
+
+private:
+	void appendLinks(std::multimap<int, Link> & links) const;
+
+private:
+	std::vector<int> _ids; // sorted when finalized
+	std::vector<Transform> _poses;
+	std::vector<int> _offsets; // size()+1 when finalized
+	std::vector<Link> _links; // grouped by "from" node when finalized
+	std::vector<int> _linksTo;
+	bool _finalized;
+};
+
+} /* namespace rtabmap */
+#endif /* FLATGRAPH_H_ */
@@ -0,0 +1,296 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef FLATWORDS_H_
+#define FLATWORDS_H_
+
+#include <rtabmap/utilite/ULogger.h>
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <vector>
+
+namespace rtabmap {
+
+/**
+ * Words of a signature in flat arrays: the word ids sorted in one vector
+ * and their values (keypoints or 3D points) in a parallel vector. Words
+ * with the same id keep their order of insertion, like in a
+ * std::multimap<int, T>. It is read like a multimap (iter->first is the
+ * word id, iter->second the value); toMultimap() makes a copy for the
+ * functions still taking a multimap.
+ *
+ * Walking the ids of two signatures together (see pairs()) is a linear
+ * merge, without the tree lookups of the multimaps.
+ */
+template<typename T>
+class FlatWords
+{
+public:
+	struct Word
+	{
+		Word(int id, const T & value) : first(id), second(value) {}
+		const int first;
+		const T & second;
+	};
+
+	class const_iterator
+	{
+	public:
+		typedef std::bidirectional_iterator_tag iterator_category;
+		typedef Word value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const Word * pointer;
+		typedef Word reference;
+
+		struct Proxy
+		{
+			Proxy(const Word & w) : word(w) {}
+			const Word * operator->() const {return &word;}
+			Word word;
+		};
+
+		const_iterator() : _words(0), _index(0) {}
+		Word operator*() const {return Word(_words->_ids[_index], _words->_values[_index]);}
+		Proxy operator->() const {return Proxy(**this);}
+		const_iterator & operator++() {++_index; return *this;}
+		const_iterator operator++(int) {const_iterator tmp(*this); ++_index; return tmp;}
+		const_iterator & operator--() {--_index; return *this;}
+		const_iterator operator--(int) {const_iterator tmp(*this); --_index; return tmp;}
+		bool operator==(const const_iterator & other) const {return _index == other._index && _words == other._words;}
+		bool operator!=(const const_iterator & other) const {return !(*this == other);}
+		int index() const {return _index;}
+
+	private:
+		friend class FlatWords;
+		const_iterator(const FlatWords * words, int index) : _words(words), _index(index) {}
+		const FlatWords * _words;
+		int _index;
+	};
+	typedef const_iterator iterator;
+	friend class const_iterator;
+
+public:
+	FlatWords() {}
+	FlatWords(const std::multimap<int, T> & words) {*this = words;}
+
+	FlatWords & operator=(const std::multimap<int, T> & words)
+	{
+		_ids.resize(words.size());
+		_values.resize(words.size());
+		int i = 0;
+		for(typename std::multimap<int, T>::const_iterator iter=words.begin(); iter!=words.end(); ++iter, ++i)
+		{
+			_ids[i] = iter->first;
+			_values[i] = iter->second;
+		}
+		return *this;
+	}
+
+	/**
+	 * The vectors are swapped in (they are empty after the call),
+	 * then sorted by id if they are not.
+	 */
+	void assign(std::vector<int> & ids, std::vector<T> & values)
+	{
+		UASSERT(ids.size() == values.size());
+		_ids.swap(ids);
+		_values.swap(values);
+		ids.clear();
+		values.clear();
+		bool sorted = true;
+		for(unsigned int i=1; i<_ids.size() && sorted; ++i)
+		{
+			sorted = _ids[i-1] <= _ids[i];
+		}
+		if(!sorted)
+		{
+			std::vector<std::pair<int, int> > order(_ids.size()); // <id, index>, stable
+			for(unsigned int i=0; i<_ids.size(); ++i)
+			{
+				order[i] = std::make_pair(_ids[i], i);
+			}
+			std::sort(order.begin(), order.end());
+			this->reorder(order);
+		}
+	}
+
+	// Explicit copy, util3d and EpipolarGeometry have overloads for FlatWords
+	std::multimap<int, T> toMultimap() const
+	{
+		std::multimap<int, T> words;
+		for(unsigned int i=0; i<_ids.size(); ++i)
+		{
+			words.insert(words.end(), std::make_pair(_ids[i], _values[i]));
+		}
+		return words;
+	}
+
+	void clear() {_ids.clear(); _values.clear();}
+	bool empty() const {return _ids.empty();}
+	size_t size() const {return _ids.size();}
+
+	const_iterator begin() const {return const_iterator(this, 0);}
+	const_iterator end() const {return const_iterator(this, (int)_ids.size());}
+	const_iterator lower_bound(int id) const {return const_iterator(this, int(std::lower_bound(_ids.begin(), _ids.end(), id) - _ids.begin()));}
+	const_iterator upper_bound(int id) const {return const_iterator(this, int(std::upper_bound(_ids.begin(), _ids.end(), id) - _ids.begin()));}
+	std::pair<const_iterator, const_iterator> equal_range(int id) const {return std::make_pair(lower_bound(id), upper_bound(id));}
+	const_iterator find(int id) const
+	{
+		const_iterator iter = lower_bound(id);
+		return iter.index() < (int)_ids.size() && _ids[iter.index()] == id?iter:end();
+	}
+	size_t count(int id) const
+	{
+		std::pair<std::vector<int>::const_iterator, std::vector<int>::const_iterator> range = std::equal_range(_ids.begin(), _ids.end(), id);
+		return range.second - range.first;
+	}
+
+	const std::vector<int> & ids() const {return _ids;} // sorted, with duplicates
+	const std::vector<T> & values() const {return _values;}
+	int id(int index) const {return _ids[index];}
+	const T & value(int index) const {return _values[index];}
+	std::vector<int> uniqueIds() const
+	{
+		std::vector<int> ids;
+		ids.reserve(_ids.size());
+		for(unsigned int i=0; i<_ids.size(); ++i)
+		{
+			if(i==0 || _ids[i] != _ids[i-1])
+			{
+				ids.push_back(_ids[i]);
+			}
+		}
+		return ids;
+	}
+
+	// return the number of words removed
+	int erase(int id)
+	{
+		std::vector<int>::iterator first = std::lower_bound(_ids.begin(), _ids.end(), id);
+		std::vector<int>::iterator last = std::upper_bound(first, _ids.end(), id);
+		int n = int(last - first);
+		if(n)
+		{
+			_values.erase(_values.begin() + (first - _ids.begin()), _values.begin() + (last - _ids.begin()));
+			_ids.erase(first, last);
+		}
+		return n;
+	}
+
+	/**
+	 * Change the ids of the words <old id, new id>, with only one sort.
+	 * Like in a multimap, the words changed are after the words already
+	 * having the new id. Return the number of words changed.
+	 */
+	int changeIds(const std::map<int, int> & ids)
+	{
+		std::vector<std::pair<std::pair<int, int>, int> > order(_ids.size()); // <<id, changed>, index>
+		int changed = 0;
+		std::map<int, int>::const_iterator jter = ids.end();
+		for(unsigned int i=0; i<_ids.size(); ++i)
+		{
+			if(i==0 || _ids[i] != _ids[i-1])
+			{
+				jter = ids.find(_ids[i]);
+			}
+			if(jter != ids.end())
+			{
+				order[i] = std::make_pair(std::make_pair(jter->second, 1), i);
+				++changed;
+			}
+			else
+			{
+				order[i] = std::make_pair(std::make_pair(_ids[i], 0), i);
+			}
+		}
+		if(changed)
+		{
+			std::sort(order.begin(), order.end());
+			std::vector<std::pair<int, int> > sorted(order.size());
+			for(unsigned int i=0; i<order.size(); ++i)
+			{
+				sorted[i] = std::make_pair(order[i].first.first, order[i].second);
+			}
+			this->reorder(sorted);
+		}
+		return changed;
+	}
+
+	/**
+	 * Number of pairs of words with the same id (for an id found n times
+	 * in one and m times in the other, min(n,m) pairs), by a linear merge.
+	 */
+	template<typename U>
+	int pairs(const FlatWords<U> & words) const
+	{
+		const std::vector<int> & idsB = words.ids();
+		unsigned int a = 0;
+		unsigned int b = 0;
+		int count = 0;
+		while(a < _ids.size() && b < idsB.size())
+		{
+			if(_ids[a] < idsB[b])
+			{
+				++a;
+			}
+			else if(idsB[b] < _ids[a])
+			{
+				++b;
+			}
+			else
+			{
+				++count;
+				++a;
+				++b;
+			}
+		}
+		return count;
+	}
+
+	long memoryUsed() const {return long(_ids.capacity()*sizeof(int) + _values.capacity()*sizeof(T));}
+
+private:
+	// <new id, old index>, sorted
+	void reorder(const std::vector<std::pair<int, int> > & order)
+	{
+		std::vector<T> values(order.size());
+		for(unsigned int i=0; i<order.size(); ++i)
+		{
+			_ids[i] = order[i].first;
+			values[i] = _values[order[i].second];
+		}
+		_values.swap(values);
+	}
+
+private:
+	std::vector<int> _ids;
+	std::vector<T> _values;
+};
+
+} /* namespace rtabmap */
+#endif /* FLATWORDS_H_ */
@@ -0,0 +1,77 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef FRAMEPOOL_H_
+#define FRAMEPOOL_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <rtabmap/utilite/UMutex.h>
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+namespace rtabmap
+{
+
+/**
+ * Pool of image buffers for the cameras. A buffer returned by acquire()
+ * is reused once all the cv::Mat referencing it are released, so a
+ * camera capturing images of the same size doesn't allocate memory
+ * after the first frames, even if the images are still referenced by
+ * the odometry or the memory for some time.
+ *
+ * Thread-safe.
+ */
+class RTABMAP_EXP FramePool
+{
+public:
+	FramePool(int maxBuffers = 16);
+
+	/**
+	 * Return a buffer not referenced outside the pool, allocated if none
+	 * is free. The content is not initialized.
+	 */
+	cv::Mat acquire(int rows, int cols, int type);
+	cv::Mat copy(const cv::Mat & image); // copy of the image in a buffer of the pool
+	void clear(); // buffers still referenced are not freed until released
+
+	int buffers() const; // buffers in the pool
+	int allocations() const {return _allocations;} // buffers allocated since the creation
+
+private:
+	static bool isReferenced(const cv::Mat & buffer);
+
+private:
+	std::vector<cv::Mat> _buffers;
+	int _maxBuffers;
+	int _allocations;
+	mutable UMutex _mutex;
+};
+
+} // namespace rtabmap
+
+#endif /* FRAMEPOOL_H_ */
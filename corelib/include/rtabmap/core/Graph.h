@@ -32,7 +32,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <map>
 #include <list>
+#include <vector>
 #include <rtabmap/core/Link.h>
+#include <rtabmap/core/FlatGraph.h>
 #include <rtabmap/core/Parameters.h>
 
 namespace rtabmap {
@@ -48,7 +50,8 @@ public:
 	enum Type {
 		kTypeUndef = -1,
 		kTypeTORO = 0,
-		kTypeG2O = 1
+		kTypeG2O = 1,
+		kTypeIncremental = 2
 	};
 	static Optimizer * create(const ParametersMap & parameters);
 	static Optimizer * create(Optimizer::Type & type, const ParametersMap & parameters = ParametersMap());
@@ -77,6 +80,16 @@ public:
 			const std::multimap<int, Link> & constraints,
 			std::list<std::map<int, Transform> > * intermediateGraphes = 0) = 0;
 
+	/**
+	 * Same as above on a finalized graph, return the optimized poses in the
+	 * order of graph.ids() (null for the poses not optimized), empty if the
+	 * optimization failed. The default converts the graph to maps.
+	 */
+	virtual std::vector<Transform> optimize(
+			int rootId,
+			const FlatGraph & graph,
+			std::list<std::map<int, Transform> > * intermediateGraphes = 0);
+
 	virtual void parseParameters(const ParametersMap & parameters);
 
 protected:
@@ -110,6 +123,8 @@ public:
 
 	virtual Type type() const {return kTypeTORO;}
 
+	using Optimizer::optimize;
+
 	virtual std::map<int, Transform> optimize(
 			int rootId,
 			const std::map<int, Transform> & poses,
@@ -131,11 +146,135 @@ public:
 
 	virtual Type type() const {return kTypeG2O;}
 
+	using Optimizer::optimize;
+
+	virtual std::map<int, Transform> optimize(
+			int rootId,
+			const std::map<int, Transform> & poses,
+			const std::multimap<int, Link> & edgeConstraints,
+			std::list<std::map<int, Transform> > * intermediateGraphes = 0);
+};
+
+class IncrementalGraph;
+
+/**
+ * Gauss-Newton optimizer keeping its solution between calls. Poses and links
+ * are compared to the previous call: only the new, removed or modified ones are
+ * updated. The poses are ordered by their insertion in the graph and the sparse
+ * block Cholesky factor of the system is kept, so only its rows from the oldest
+ * pose touched by a change are computed again (a new loop closure only updates
+ * the rows of the poses in the loop). Like iSAM2, a pose is linearized again only
+ * if its update is over RGBD/OptimizeRelinearizeThreshold. New poses are
+ * initialized from the already optimized poses they are linked to.
+ */
+class RTABMAP_EXP IncrementalOptimizer : public Optimizer
+{
+public:
+	IncrementalOptimizer(int iterations = 100, bool slam2d = false, bool covarianceIgnored = false, float relinearizeThreshold = 0.01f);
+	IncrementalOptimizer(const ParametersMap & parameters);
+	virtual ~IncrementalOptimizer();
+
+	virtual Type type() const {return kTypeIncremental;}
+
 	virtual std::map<int, Transform> optimize(
 			int rootId,
 			const std::map<int, Transform> & poses,
 			const std::multimap<int, Link> & edgeConstraints,
 			std::list<std::map<int, Transform> > * intermediateGraphes = 0);
+	virtual std::vector<Transform> optimize(
+			int rootId,
+			const FlatGraph & graph,
+			std::list<std::map<int, Transform> > * intermediateGraphes = 0);
+
+	virtual void parseParameters(const ParametersMap & parameters);
+
+	void reset(); // forget the previous solution
+
+	float relinearizeThreshold() const {return relinearizeThreshold_;}
+
+	// Statistics of the last optimization
+	int lastIterations() const {return lastIterations_;}
+	int lastUpdatedRows() const {return lastUpdatedRows_;} // rows of the Cholesky factor computed again, summed over iterations
+
+private:
+	IncrementalOptimizer(const IncrementalOptimizer &);
+	IncrementalOptimizer & operator=(const IncrementalOptimizer &);
+
+private:
+	float relinearizeThreshold_;
+	IncrementalGraph * graph_;
+	int lastIterations_;
+	int lastUpdatedRows_;
+};
+
+////////////////////////////////////////////
+// Spatial index
+////////////////////////////////////////////
+/**
+ * Poses indexed by their position in a uniform grid of cubic cells,
+ * updated in place when poses are added, moved or removed. Radius
+ * searches only look in the cells overlapping the search sphere, so the
+ * poses don't have to be indexed again (like with a kd-tree) for
+ * each search. A cell size near the usual search radius is best.
+ */
+class RTABMAP_EXP PosesIndex
+{
+public:
+	PosesIndex(float cellSize = 1.0f);
+
+	void setCellSize(float cellSize); // poses are indexed again if the size changes
+	float cellSize() const {return _cellSize;}
+
+	void update(int id, const Transform & pose); // add or move the pose
+	void update(const std::map<int, Transform> & poses); // after this, the index has the same poses than the map
+	void remove(int id);
+	void clear();
+
+	const std::map<int, Transform> & poses() const {return _poses;}
+	bool contains(int id) const {return _poses.find(id) != _poses.end();}
+	int size() const {return (int)_poses.size();}
+
+	/**
+	 * Get the poses in the radius, sorted by distance.
+	 * @param maxNeighbors keep only the nearest poses (0 means all)
+	 * @return the number of poses found
+	 */
+	int radiusSearch(
+			const Transform & pose,
+			float radius,
+			std::vector<int> & ids,
+			std::vector<float> & sqrDistances,
+			int maxNeighbors = 0) const;
+
+private:
+	struct Cell
+	{
+		Cell(int cx = 0, int cy = 0, int cz = 0) : x(cx), y(cy), z(cz) {}
+		bool operator<(const Cell & c) const {return x<c.x || (x==c.x && (y<c.y || (y==c.y && z<c.z)));}
+		bool operator==(const Cell & c) const {return x==c.x && y==c.y && z==c.z;}
+		int x;
+		int y;
+		int z;
+	};
+	struct Entry
+	{
+		Entry(int entryId, const Transform & pose) : id(entryId), x(pose.x()), y(pose.y()), z(pose.z()) {}
+		int id;
+		float x;
+		float y;
+		float z;
+	};
+	Cell cell(float x, float y, float z) const;
+	Cell cell(const Transform & pose) const {return cell(pose.x(), pose.y(), pose.z());}
+	void move(std::map<int, Transform>::iterator iter, const Transform & pose);
+	void addToCell(int id, const Transform & pose);
+	void removeFromCell(int id, const Transform & pose);
+	void search(const Entry & query, const std::vector<Entry> & entries, float sqrRadius, std::vector<std::pair<float, int> > & found) const;
+
+private:
+	float _cellSize;
+	std::map<int, Transform> _poses;
+	std::map<Cell, std::vector<Entry> > _cells; // empty cells are removed
 };
 
 ////////////////////////////////////////////
@@ -163,6 +302,12 @@ std::map<int, Transform> RTABMAP_EXP radiusPosesFiltering(
 		float radius,
 		float angle,
 		bool keepLatest = true);
+// Same as above with all poses of the index
+std::map<int, Transform> RTABMAP_EXP radiusPosesFiltering(
+		const PosesIndex & index,
+		float radius,
+		float angle,
+		bool keepLatest = true);
 
 /**
  * Get all neighbor nodes in a fixed radius around each pose.
@@ -175,6 +320,11 @@ std::multimap<int, int> RTABMAP_EXP radiusPosesClustering(
 		const std::map<int, Transform> & poses,
 		float radius,
 		float angle);
+// Same as above with all poses of the index
+std::multimap<int, int> RTABMAP_EXP radiusPosesClustering(
+		const PosesIndex & index,
+		float radius,
+		float angle);
 
 /**
  * Perform A* path planning in the graph.
@@ -191,6 +341,12 @@ std::list<std::pair<int, Transform> > RTABMAP_EXP computePath(
 			int from,
 			int to,
 			bool updateNewCosts = false);
+// Same as above on a finalized graph, following its links from "from" to "to"
+std::list<std::pair<int, Transform> > RTABMAP_EXP computePath(
+			const FlatGraph & graph,
+			int from,
+			int to,
+			bool updateNewCosts = false);
 
 int RTABMAP_EXP findNearestNode(
 		const std::map<int, rtabmap::Transform> & nodes,
@@ -209,6 +365,12 @@ std::map<int, float> RTABMAP_EXP getNodesInRadius(
 		const std::map<int, Transform> & nodes,
 		int maxNearestNeighbors,
 		float radius);
+// Same as above with the nodes of the index
+std::map<int, float> RTABMAP_EXP getNodesInRadius(
+		int nodeId,
+		const PosesIndex & nodes,
+		int maxNearestNeighbors,
+		float radius);
 
 float RTABMAP_EXP computePathLength(
 		const std::vector<std::pair<int, Transform> > & path,
@@ -0,0 +1,155 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MAPASSEMBLER_H_
+#define MAPASSEMBLER_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <rtabmap/core/Transform.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <map>
+
+namespace rtabmap {
+
+class Signature;
+
+namespace util3d {
+class VoxelAccumulator;
+}
+
+/**
+ * Assemble the clouds of the nodes of a map in one cloud.
+ *
+ * The clouds of the nodes are created by worker threads (decompression,
+ * projection, max depth, voxel filter, transform in place) and merged by
+ * the calling thread in order of node id, so the result doesn't depend on
+ * the number of threads. The workers are at most a few nodes ahead of the
+ * merge, so only these node clouds are in memory at the same time. With
+ * an assembled voxel size, points are merged in a voxel grid (average of
+ * the points and colors of each voxel, see util3d::VoxelAccumulator) as
+ * the nodes come, otherwise the node clouds are copied in one allocated
+ * cloud.
+ *
+ * Example:
+ *   MapAssembler assembler(4); // threads
+ *   assembler.setNodeFilters(4, 0.01f, 4.0f); // decimation, voxel, max depth
+ *   assembler.setAssembledVoxelSize(0.01f);
+ *   pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = assembler.assemble(poses, signatures);
+ */
+class RTABMAP_EXP MapAssembler
+{
+public:
+	MapAssembler(int threads = 4);
+	virtual ~MapAssembler() {}
+
+	void setThreads(int threads);
+	/**
+	 * Filters applied on the cloud of each node.
+	 * @param decimation of the depth image
+	 * @param voxelSize m (0=no voxel filter)
+	 * @param maxDepth m (0=no maximum)
+	 */
+	void setNodeFilters(int decimation, float voxelSize, float maxDepth);
+	void setAssembledVoxelSize(float voxelSize); // m (0=clouds concatenated)
+
+	int getThreads() const {return _threads;}
+	int getDecimation() const {return _decimation;}
+	float getVoxelSize() const {return _voxelSize;}
+	float getMaxDepth() const {return _maxDepth;}
+	float getAssembledVoxelSize() const {return _assembledVoxelSize;}
+
+	/**
+	 * Create the clouds of the nodes (see createCloud()) and merge them in
+	 * the map frame. Nodes without pose or signature are ignored.
+	 */
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr assemble(
+			const std::map<int, Transform> & poses,
+			const std::map<int, const Signature *> & signatures);
+
+	/**
+	 * Same as above, but the node clouds are integrated in "accumulator"
+	 * (the assembled voxel size is ignored). With a maximum memory of the
+	 * accumulator, large maps can be assembled and saved with
+	 * VoxelAccumulator::savePLY() without having the whole cloud in memory.
+	 */
+	void assemble(
+			const std::map<int, Transform> & poses,
+			const std::map<int, const Signature *> & signatures,
+			util3d::VoxelAccumulator & accumulator);
+
+	/**
+	 * Merge clouds already created (in the frame of their node) in the map frame.
+	 * The node filters are not applied.
+	 */
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr assemble(
+			const std::map<int, Transform> & poses,
+			const std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr> & clouds);
+
+	/**
+	 * Create the clouds of the nodes, in the map frame if "transformed" is
+	 * true, otherwise in the frame of their node. Empty clouds are not returned.
+	 */
+	std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr> createClouds(
+			const std::map<int, Transform> & poses,
+			const std::map<int, const Signature *> & signatures,
+			bool transformed = true);
+
+	/**
+	 * Cloud of a node in the frame "pose": from the image and the depth (or
+	 * right image) of the signature, or from its 3D words (white) if it
+	 * has no depth.
+	 */
+	static pcl::PointCloud<pcl::PointXYZRGB>::Ptr createCloud(
+			const Signature & signature,
+			const Transform & pose,
+			int decimation = 1,
+			float voxelSize = 0.0f,
+			float maxDepth = 0.0f);
+
+protected:
+	/**
+	 * Called by the thread calling assemble() or createClouds() for each
+	 * node, in order of id, when its cloud is merged. The cloud is empty
+	 * if the node has been ignored.
+	 */
+	virtual void nodeProcessed(int id, const pcl::PointCloud<pcl::PointXYZRGB> & cloud, int index, int total) {}
+
+private:
+	friend class MapAssemblerJobs; // creates and merges the node clouds, see MapAssembler.cpp
+
+private:
+	int _threads;
+	int _decimation;
+	float _voxelSize;
+	float _maxDepth;
+	float _assembledVoxelSize;
+};
+
+} /* namespace rtabmap */
+#endif /* MAPASSEMBLER_H_ */
@@ -34,6 +34,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/Parameters.h"
 #include "rtabmap/core/SensorData.h"
 #include "rtabmap/core/Link.h"
+#include "rtabmap/core/FlatGraph.h"
 #include "rtabmap/core/Features2d.h"
 #include <typeinfo>
 #include <list>
@@ -52,6 +53,7 @@ class VWDictionary;
 class VisualWord;
 class Feature2D;
 class Statistics;
+class PrefetchThread;
 
 class RTABMAP_EXP Memory
 {
@@ -66,6 +68,10 @@ public:
 
 	virtual void parseParameters(const ParametersMap & parameters);
 	bool update(const SensorData & data, Statistics * stats = 0);
+	// Detect keypoints and extract descriptors like update() would do, then set them
+	// to the data. Only the feature parameters are used, so it can be called from
+	// another thread than update(), but not while parameters are parsed.
+	void extractFeatures(SensorData & data, Statistics * stats = 0) const;
 	bool init(const std::string & dbUrl,
 			bool dbOverwritten = false,
 			const ParametersMap & parameters = ParametersMap(),
@@ -77,6 +83,7 @@ public:
 
 	std::list<int> forget(const std::set<int> & ignoredIds = std::set<int>());
 	std::set<int> reactivateSignatures(const std::list<int> & ids, unsigned int maxLoaded, double & timeDbAccess);
+	void prefetchSignatures(const std::list<int> & ids);
 
 	std::list<int> cleanup(const std::list<int> & ignoredIds = std::list<int>());
 	void emptyTrash();
@@ -97,6 +104,11 @@ public:
 	const std::map<int, double> & getWorkingMem() const {return _workingMem;}
 	const std::set<int> & getStMem() const {return _stMem;}
 	int getMaxStMemSize() const {return _maxStMemSize;}
+	// prefetch stats of the last reactivateSignatures()
+	int getPrefetchHits() const {return _prefetchHits;}
+	int getPrefetchMisses() const {return _prefetchMisses;}
+	int getPrefetchStaged() const {return _prefetchStaged;}
+	long getPrefetchStagedMemory() const {return _prefetchStagedMemory;} // in bytes
 	std::map<int, Link> getNeighborLinks(int signatureId,
 			bool lookInDatabase = false) const;
 	std::map<int, Link> getLoopClosureLinks(int signatureId,
@@ -113,6 +125,8 @@ public:
 	bool setUserData(int id, const std::vector<unsigned char> & data);
 	int getDatabaseMemoryUsed() const; // in bytes
 	double getDbSavingTime() const;
+	double getDbSavingLatency() const;
+	int getDbTrashQueueSize() const;
 	Transform getOdomPose(int signatureId, bool lookInDatabase = false) const;
 	bool getNodeInfo(int signatureId,
 			Transform & odomPose,
@@ -127,6 +141,13 @@ public:
 	Signature getSignatureDataConst(int locationId) const;
 	std::set<int> getAllSignatureIds() const;
 	bool memoryChanged() const {return _memoryChanged;}
+	// Revision of the map, incremented when a node is added or when the data (label,
+	// user data) or the links of a node change. Revisions older than
+	// getRevisionReset() are from before the last reset of the memory.
+	int getRevision() const {return _revision;}
+	int getRevisionReset() const {return _revisionReset;}
+	int newRevision() {return ++_revision;} // for changes made outside the memory (e.g., optimized poses)
+	void getChangedNodes(int revision, std::set<int> & dataChanged, std::set<int> & linksChanged) const; // changed after "revision"
 	bool isIncremental() const {return _incrementalMemory;}
 	const Signature * getSignature(int id) const;
 	bool isInSTM(int signatureId) const {return _stMem.find(signatureId) != _stMem.end();}
@@ -158,6 +179,10 @@ public:
 			std::map<int, Transform> & poses,
 			std::multimap<int, Link> & links,
 			bool lookInDatabase = false);
+	void getMetricConstraints(
+			const std::vector<int> & ids,
+			FlatGraph & graph, // finalized, the previous content is cleared
+			bool lookInDatabase = false);
 	float getBowInlierDistance() const {return _bowInlierDistance;}
 	int getBowIterations() const {return _bowIterations;}
 	int getBowMinInliers() const {return _bowMinInliers;}
@@ -182,6 +207,8 @@ private:
 	void moveToTrash(Signature * s, bool keepLinkedToGraph = true, std::list<int> * deletedWords = 0);
 
 	void addSignatureToWm(Signature * signature);
+	void setDataRevision(int id) {_dataRevisions[id] = ++_revision;}
+	void setLinksRevision(int id) {_linksRevisions[id] = ++_revision;}
 	Signature * _getSignature(int id) const;
 	std::list<Signature *> getRemovableSignatures(int count,
 			const std::set<int> & ignoredIds = std::set<int>());
@@ -203,6 +230,10 @@ private:
 	void cleanUnusedWords();
 	int getNi(int signatureId) const;
 
+	//prefetch stuff
+	void joinPrefetchThread();
+	void clearPrefetched();
+
 protected:
 	DBDriver * _dbDriver;
 
@@ -222,6 +253,7 @@ private:
 	int _imageDecimation;
 	float _laserScanVoxelSize;
 	bool _localSpaceLinksKeptInWM;
+	int _prefetchMaxSize;
 	float _rehearsalMaxDistance;
 	float _rehearsalMaxAngle;
 
@@ -233,6 +265,17 @@ private:
 	bool _linksChanged; // False by default, become true when links are modified.
 	int _signaturesAdded;
 	bool _postInitClosingEvents;
+	int _revision;
+	int _revisionReset;
+	std::map<int, int> _dataRevisions; // <id, revision of the last change of the data>
+	std::map<int, int> _linksRevisions; // <id, revision of the last change of the links>
+
+	PrefetchThread * _prefetchThread;
+	std::map<int, Signature *> _prefetched; // loaded in background, not yet in WM
+	int _prefetchHits;
+	int _prefetchMisses;
+	int _prefetchStaged;
+	long _prefetchStagedMemory;
 
 	std::map<int, Signature *> _signatures; // TODO : check if a signature is already added? although it is not supposed to occur...
 	std::set<int> _stMem; // id
@@ -244,6 +287,7 @@ private:
 	Feature2D::Type _featureType;
 	float _badSignRatio;;
 	bool _tfIdfLikelihoodUsed;
+	int _tfIdfLikelihoodThreads;
 	bool _parallelized;
 	float _wordsMaxDepth; // 0=inf
 	std::vector<float> _roiRatios; // size 4
@@ -0,0 +1,130 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef OCCUPANCYGRID_H_
+#define OCCUPANCYGRID_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <rtabmap/core/Transform.h>
+#include <opencv2/core/core.hpp>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace rtabmap {
+
+/**
+ * 2D occupancy grid (CV_8S: -1=unknown, 0=empty space, 100=obstacle) built from
+ * the occupancy local maps of the nodes, kept between updates.
+ *
+ * The grid is made of fixed size tiles allocated on demand. The cells of
+ * each node are kept, so only the nodes added, removed or moved more than
+ * the update thresholds are projected again, and only the tiles they touch
+ * are drawn again. Like util3d::create2DMapFromOccupancyLocalMaps(), nodes
+ * are drawn by increasing id (empty space, then obstacles).
+ *
+ * Example:
+ *   OccupancyGrid grid(0.05f);
+ *   grid.update(poses, localMaps); // after each graph update
+ *   float xMin, yMin;
+ *   cv::Mat map8S = grid.getMap(xMin, yMin);
+ */
+class RTABMAP_EXP OccupancyGrid
+{
+public:
+	/**
+	 * @param cellSize m
+	 * @param linearUpdate nodes moving less than this distance (m) are not projected again
+	 * @param angularUpdate nodes rotating less than this angle (rad) are not projected again
+	 */
+	OccupancyGrid(float cellSize = 0.05f, float linearUpdate = 0.01f, float angularUpdate = 0.01f);
+
+	float getCellSize() const {return _cellSize;}
+	void setCellSize(float cellSize); // the grid is cleared if the size changes
+	void setUpdateThresholds(float linearUpdate, float angularUpdate);
+
+	/**
+	 * Set the nodes of the grid: the poses having a local map. Local maps
+	 * <empty, occupied> (CV_32FC2, in the node frame) of nodes already in the
+	 * grid are not read again, call clear() if they have changed.
+	 */
+	void update(
+			const std::map<int, Transform> & poses,
+			const std::map<int, std::pair<cv::Mat, cv::Mat> > & occupancy);
+	void clear();
+
+	/**
+	 * Get the map with the same filtering than
+	 * util3d::create2DMapFromOccupancyLocalMaps(): holes filled, empty
+	 * cells on obstacle borders removed, obstacles optionally eroded.
+	 * @param xMin position (m) of the center of the first column
+	 * @param yMin position (m) of the center of the first row
+	 * @param minMapSize minimum width (m)
+	 */
+	cv::Mat getMap(float & xMin, float & yMin, float minMapSize = 0.0f, bool erode = false) const;
+
+	int nodes() const {return (int)_nodes.size();}
+	int tiles() const {return (int)_tiles.size();}
+	int lastUpdatedNodes() const {return _lastUpdatedNodes;} // nodes projected on the last update
+	int lastUpdatedTiles() const {return _lastUpdatedTiles;} // tiles drawn on the last update
+
+private:
+	typedef std::pair<int, int> TileKey; // <row, col>
+	struct Cells
+	{
+		std::vector<cv::Point2i> empty; // in tile
+		std::vector<cv::Point2i> occupied; // in tile
+	};
+	struct Node
+	{
+		Transform pose; // pose used to project the local map
+		cv::Point2i cell; // cell of the pose
+		std::map<TileKey, Cells> cells;
+	};
+	struct Tile
+	{
+		cv::Mat map; // CV_8S
+		std::set<int> nodes; // nodes having cells in the tile
+		cv::Rect bounds; // cells set, in tile
+	};
+
+	void project(const Transform & pose, const std::pair<cv::Mat, cv::Mat> & occupancy, Node & node) const;
+	void draw(const TileKey & key, Tile & tile) const;
+
+private:
+	float _cellSize;
+	float _linearUpdate;
+	float _angularUpdate;
+	std::map<int, Node> _nodes;
+	std::map<TileKey, Tile> _tiles; // tiles without nodes are removed
+	int _lastUpdatedNodes;
+	int _lastUpdatedTiles;
+};
+
+} /* namespace rtabmap */
+#endif /* OCCUPANCYGRID_H_ */
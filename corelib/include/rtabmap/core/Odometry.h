@@ -109,6 +109,67 @@ private:
 	std::multimap<int, pcl::PointXYZ> localMap_;
 };
 
+// Frame-to-map odometry: the local map is kept as arrays of 3D points with their
+// descriptors, which are matched directly (without visual words dictionary) with the
+// features of the new frame around their projection.
+class RTABMAP_EXP OdometryF2M : public Odometry
+{
+public:
+	OdometryF2M(const rtabmap::ParametersMap & parameters = rtabmap::ParametersMap());
+	virtual ~OdometryF2M();
+
+	virtual void reset(const Transform & initialPose = Transform::getIdentity());
+	const pcl::PointCloud<pcl::PointXYZ>::Ptr & getLocalMap() const {return mapPoints_;}
+	const cv::Mat & getLocalMapDescriptors() const {return mapDescriptors_;}
+
+private:
+	virtual Transform computeTransform(const SensorData & image, OdometryInfo * info = 0);
+	void extractFeatures(
+			const SensorData & data,
+			std::vector<cv::KeyPoint> & keypoints,
+			cv::Mat & descriptors,
+			pcl::PointCloud<pcl::PointXYZ>::Ptr & points) const;
+	int matchFeatures(
+			const SensorData & data,
+			const std::vector<cv::KeyPoint> & keypoints,
+			const cv::Mat & descriptors,
+			const Transform & guess,
+			std::vector<int> & matches) const;
+	void updateLocalMap(
+			const Transform & pose,
+			const cv::Mat & descriptors,
+			const pcl::PointCloud<pcl::PointXYZ>::Ptr & points,
+			const std::vector<int> & matches,
+			std::vector<int> & ids);
+
+private:
+	//Parameters:
+	int maxSize_;
+	float nndr_;
+	float searchRadius_;
+
+	int stereoWinSize_;
+	int stereoIterations_;
+	double stereoEps_;
+	int stereoMaxLevel_;
+	float stereoMaxSlope_;
+
+	int subPixWinSize_;
+	int subPixIterations_;
+	double subPixEps_;
+
+	Feature2D * feature2D_;
+
+	// local map, in odometry frame
+	pcl::PointCloud<pcl::PointXYZ>::Ptr mapPoints_;
+	cv::Mat mapDescriptors_; // one row per point
+	std::vector<int> mapIds_;
+	std::vector<int> mapLastSeen_; // frame count
+	int nextId_;
+	int frames_;
+	Transform motion_; // last incremental transform, used as guess
+};
+
 class RTABMAP_EXP OdometryOpticalFlow : public Odometry
 {
 public:
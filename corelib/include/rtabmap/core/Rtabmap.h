@@ -34,6 +34,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/SensorData.h"
 #include "rtabmap/core/Statistics.h"
 #include "rtabmap/core/Link.h"
+#include "rtabmap/core/FlatGraph.h"
 
 #include <opencv2/core/core.hpp>
 #include <list>
@@ -49,6 +50,7 @@ class BayesFilter;
 class Signature;
 namespace graph {
 class Optimizer;
+class PosesIndex;
 }
 
 class RTABMAP_EXP Rtabmap
@@ -121,6 +123,29 @@ public:
 			std::map<int, std::vector<unsigned char> > & userDatas,
 			bool optimized,
 			bool global) const;
+	/**
+	 * Changes of the map since "revision" (a revision returned by a previous call).
+	 * Only new nodes or nodes with modified data are in signatures and in the node
+	 * info maps, only moved nodes are in poses and constraints contains all links
+	 * of the nodes in linkedIds (new nodes or nodes with modified links). Nodes
+	 * that left the map are in removedIds. If the delta cannot be computed
+	 * from "revision" (0, unknown or from before a reset), the whole map is
+	 * returned like get3DMap() and snapshot is true.
+	 * @return the revision of the returned map
+	 */
+	int get3DMapDelta(int revision,
+			std::map<int, Signature> & signatures,
+			std::map<int, Transform> & poses,
+			std::multimap<int, Link> & constraints,
+			std::map<int, int> & mapIds,
+			std::map<int, double> & stamps,
+			std::map<int, std::string> & labels,
+			std::map<int, std::vector<unsigned char> > & userDatas,
+			std::set<int> & linkedIds,
+			std::set<int> & removedIds,
+			bool & snapshot,
+			bool optimized,
+			bool global);
 	void getGraph(std::map<int, Transform> & poses,
 			std::multimap<int, Link> & constraints,
 			std::map<int, int> & mapIds,
@@ -129,6 +154,8 @@ public:
 			std::map<int, std::vector<unsigned char> > & userDatas,
 			bool optimized,
 			bool global);
+	// Same as above without the node info, nodes not optimized are removed
+	void getGraph(FlatGraph & graph, bool optimized, bool global) const;
 	void clearPath();
 	bool computePath(int targetNode, bool global);
 	bool computePath(const Transform & targetPose, bool global);
@@ -145,12 +172,27 @@ public:
 											const std::map<int, float> & likelihood) const;
 
 private:
+	// Poses and links of the current map
+	void getMapGraph(std::map<int, Transform> & poses,
+			std::multimap<int, Link> & constraints,
+			bool optimized,
+			bool global) const;
+	void getMapData(std::map<int, Signature> & signatures, bool global) const; // signatures in STM+WM (+LTM if global)
+	void getNodesInfo(const std::set<int> & ids,
+			std::map<int, int> & mapIds,
+			std::map<int, double> & stamps,
+			std::map<int, std::string> & labels,
+			std::map<int, std::vector<unsigned char> > & userDatas) const;
 	void optimizeCurrentMap(int id,
 			bool lookInDatabase,
 			std::map<int, Transform> & optimizedPoses,
 			std::multimap<int, Link> * constraints = 0) const;
+	// Return the optimized poses in the order of graph.ids() (empty if the optimization failed)
+	std::vector<Transform> optimizeCurrentMap(int id,
+			bool lookInDatabase,
+			FlatGraph & graph) const;
 	void updateGoalIndex();
-	bool computePath(int targetNode, const std::map<int, Transform> & nodes, const std::multimap<int, rtabmap::Link> & constraints);
+	bool computePath(int targetNode, const FlatGraph & graph);
 
 	void setupLogFiles(bool overwrite = false);
 	void flushStatisticLogs();
@@ -203,6 +245,7 @@ private:
 	EpipolarGeometry * _epipolarGeometry;
 	BayesFilter * _bayesFilter;
 	graph::Optimizer * _graphOptimizer;
+	graph::Optimizer * _globalGraphOptimizer; // global maps, when _graphOptimizer is incremental (null otherwise)
 	ParametersMap _modifiedParameters;
 
 	Memory * _memory;
@@ -217,10 +260,23 @@ private:
 	std::string _wDir;
 
 	std::map<int, Transform> _optimizedPoses;
+	graph::PosesIndex * _optimizedPosesIndex; // same poses than _optimizedPoses, for radius searches
 	std::multimap<int, Link> _constraints;
 	Transform _mapCorrection;
 	Transform _mapTransform; // for localization mode
 
+	// Last map published with get3DMapDelta(), for each [optimized*2+global]
+	struct MapDeltaCache
+	{
+		MapDeltaCache() : revision(0), created(0) {}
+		std::map<int, std::pair<Transform, int> > poses; // <id, <pose, revision of the last move>>
+		std::map<int, int> added; // <id, revision at which the node entered the map>
+		std::map<int, int> removed; // <id, revision at which the node left the map>
+		int revision; // memory revision of the last update
+		int created; // deltas from older revisions are not known (raised when removed is pruned)
+	};
+	MapDeltaCache _mapDeltaCaches[4];
+
 	// Planning stuff
 	std::vector<std::pair<int,Transform> > _path;
 	unsigned int _pathCurrentIndex;
@@ -33,6 +33,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UEvent.h>
 #include "rtabmap/core/Statistics.h"
 #include "rtabmap/core/Parameters.h"
+#include <set>
 
 namespace rtabmap
 {
@@ -72,6 +73,7 @@ public:
 			kCmdPublish3DMapGlobal, // params: optimized
 			kCmdPublishTOROGraphGlobal, // params: optimized
 			kCmdPublishTOROGraphLocal, // params: optimized
+			kCmdPublish3DMapDelta, // params: revision, parameters "optimized" and "global"
 			kCmdTriggerNewMap,
 			kCmdPause,
 			kCmdGoal}; // params: label or location ID
@@ -160,7 +162,36 @@ public:
 		_mapIds(mapIds),
 		_stamps(stamps),
 		_labels(labels),
-		_userDatas(userDatas)
+		_userDatas(userDatas),
+		_revision(0),
+		_baseRevision(0)
+	{}
+	// Changes of the map from "baseRevision" to "revision" (see Rtabmap::get3DMapDelta()),
+	// baseRevision is 0 if the whole map is sent.
+	RtabmapEvent3DMap(
+			const std::map<int, Signature> & signatures,
+			const std::map<int, Transform> & poses,
+			const std::multimap<int, Link> & constraints,
+			const std::map<int, int> & mapIds,
+			const std::map<int, double> & stamps,
+			const std::map<int, std::string> & labels,
+			const std::map<int, std::vector<unsigned char> > & userDatas,
+			int revision,
+			int baseRevision,
+			const std::set<int> & linkedIds,
+			const std::set<int> & removedIds) :
+		UEvent(0),
+		_signatures(signatures),
+		_poses(poses),
+		_constraints(constraints),
+		_mapIds(mapIds),
+		_stamps(stamps),
+		_labels(labels),
+		_userDatas(userDatas),
+		_revision(revision),
+		_baseRevision(baseRevision),
+		_linkedIds(linkedIds),
+		_removedIds(removedIds)
 	{}
 
 	virtual ~RtabmapEvent3DMap() {}
@@ -172,6 +203,11 @@ public:
 	const std::map<int, double> & getStamps() const {return _stamps;}
 	const std::map<int, std::string> & getLabels() const {return _labels;}
 	const std::map<int, std::vector<unsigned char> > & getUserDatas() const {return _userDatas;}
+	int getRevision() const {return _revision;}
+	int getBaseRevision() const {return _baseRevision;}
+	bool isDelta() const {return _baseRevision > 0;}
+	const std::set<int> & getLinkedIds() const {return _linkedIds;} // nodes for which all links are in getConstraints()
+	const std::set<int> & getRemovedIds() const {return _removedIds;}
 
 	virtual std::string getClassName() const {return std::string("RtabmapEvent3DMap");}
 
@@ -183,6 +219,10 @@ private:
 	std::map<int, double> _stamps;
 	std::map<int, std::string> _labels;
 	std::map<int, std::vector<unsigned char> > _userDatas;
+	int _revision;
+	int _baseRevision;
+	std::set<int> _linkedIds;
+	std::set<int> _removedIds;
 };
 
 class RtabmapGlobalPathEvent : public UEvent
@@ -38,6 +38,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/RtabmapEvent.h"
 #include "rtabmap/core/SensorData.h"
 #include "rtabmap/core/Parameters.h"
+#include "rtabmap/core/Statistics.h"
 
 #include <stack>
 
@@ -46,6 +47,7 @@ class UTimer;
 namespace rtabmap {
 
 class Rtabmap;
+class FeatureExtractionStage;
 
 class RTABMAP_EXP RtabmapThread :
 	public UThreadNode,
@@ -69,6 +71,7 @@ public:
 		kStatePublishingMapGlobal,
 		kStatePublishingTOROGraphLocal,
 		kStatePublishingTOROGraphGlobal,
+		kStatePublishingMapDelta,
 		kStateTriggeringMap,
 		kStateAddingUserData,
 		kStateSettingGoal
@@ -82,30 +85,58 @@ public:
 	void clearBufferedData();
 	void setDetectorRate(float rate);
 	void setBufferSize(int bufferSize);
+	void setPipelineDepth(int depth); // see Parameters::kRtabmapPipelineDepth()
 
 protected:
 	virtual void handleEvent(UEvent * anEvent);
 
 private:
+	// Data waiting in the input buffer, then in the ready buffer with the features
+	// extracted by the extraction stage (see Parameters::kRtabmapPipelineDepth()).
+	struct StagedData
+	{
+		StagedData() : addedStamp(0.0), readyStamp(0.0), takenStamp(0.0), extracted(false), extractionTime(0.0f) {}
+		SensorData data;
+		double addedStamp; // added to the input buffer
+		double readyStamp; // added to the ready buffer
+		double takenStamp; // taken for the map update
+		bool extracted; // features set by the extraction stage
+		float extractionTime; // ms
+		Statistics stats; // extraction timings
+	};
+
+private:
+	friend class FeatureExtractionStage;
 	virtual void mainLoop();
 	virtual void mainLoopKill();
 	void process();
 	void addData(const SensorData & data);
-	void getData(SensorData & data);
+	void getData(StagedData & data);
+	void extractData(const FeatureExtractionStage * stage);
+	void startExtractionStage();
+	void stopExtractionStage();
+	void resetExtractedData();
 	void pushNewState(State newState, const ParametersMap & parameters = ParametersMap());
 	void setDataBufferSize(int size);
 	void publishMap(bool optimized, bool full) const;
 	void publishTOROGraph(bool optimized, bool full) const;
+	void publishMapDelta(bool optimized, bool full, int revision) const;
 
 private:
 	UMutex _stateMutex;
 	std::stack<State> _state;
 	std::stack<ParametersMap> _stateParam;
 
-	std::list<SensorData> _dataBuffer;
+	std::list<StagedData> _dataBuffer;
+	std::list<StagedData> _readyBuffer;
 	UMutex _dataMutex;
 	USemaphore _dataAdded;
 	int _dataBufferMaxSize;
+	int _pipelineDepth;
+	FeatureExtractionStage * _extractionStage;
+	USemaphore _inputAdded; // extraction stage
+	USemaphore _readyTaken; // extraction stage
+	UMutex _extractionMutex; // held while extracting, Memory's parameters should not change
 	float _rate;
 	UTimer * _frameRateTimer;
 
@@ -38,6 +38,11 @@ namespace rtabmap
 
 /**
  * An id is automatically generated if id=0.
+ *
+ * Copies are cheap: the images share their buffers (cv::Mat) and the
+ * keypoints, user data and camera ID are shared between the copies
+ * until one of them is modified (copy-on-write), so the data can be
+ * passed by value from the camera to the memory without deep copies.
  */
 class RTABMAP_EXP SensorData
 {
@@ -76,7 +81,9 @@ public:
 		  double stamp,
 		  const std::vector<unsigned char> & userData = std::vector<unsigned char>());
 
-	virtual ~SensorData() {}
+	SensorData(const SensorData & data);
+	SensorData & operator=(const SensorData & data);
+	virtual ~SensorData();
 
 	bool isValid() const {return !_image.empty();}
 
@@ -106,19 +113,32 @@ public:
 	float poseRotVariance() const {return _poseRotVariance;}
 	float poseTransVariance() const {return _poseTransVariance;}
 
-	void setFeatures(const std::vector<cv::KeyPoint> & keypoints, const cv::Mat & descriptors)
-	{
-		_keypoints = keypoints;
-		_descriptors = descriptors;
-	}
-	const std::vector<cv::KeyPoint> & keypoints() const {return _keypoints;}
+	// Features set are final, even if empty: the memory won't extract them again
+	void setFeatures(const std::vector<cv::KeyPoint> & keypoints, const cv::Mat & descriptors);
+	void clearFeatures();
+	bool featuresExtracted() const;
+	const std::vector<cv::KeyPoint> & keypoints() const;
 	const cv::Mat & descriptors() const {return _descriptors;}
 
-	void setUserData(const std::vector<unsigned char> & data) {_userData = data;}
-	const std::vector<unsigned char> & userData() const {return _userData;}
+	void setUserData(const std::vector<unsigned char> & data);
+	const std::vector<unsigned char> & userData() const;
+
+	void setCameraID(std::string cameraID);
+	std::string  getCameraID() const;
 
-	void setCameraID(std::string cameraID){_cameraID = cameraID;}
-	std::string  getCameraID() const {return _cameraID;}
+private:
+	// Data shared between the copies
+	struct Metadata
+	{
+		Metadata() : refs(1), featuresExtracted(false) {}
+		int refs;
+		bool featuresExtracted;
+		std::vector<cv::KeyPoint> keypoints;
+		std::vector<unsigned char> userData;
+		std::string cameraID;
+	};
+	Metadata * metadata(); // not shared anymore, for modification
+	void releaseMetadata();
 
 private:
 	cv::Mat _image;
@@ -138,15 +158,10 @@ private:
 	float _poseTransVariance;
 
 	// features
-	std::vector<cv::KeyPoint> _keypoints;
 	cv::Mat _descriptors;
 
-	// user data
-	std::vector<unsigned char> _userData;
-
-
-	// CameraID
-	std::string _cameraID;
+	// keypoints, user data and CameraID (null if all empty)
+	Metadata * _metadata;
 };
 
 }
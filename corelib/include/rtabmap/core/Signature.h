@@ -41,6 +41,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/core/Transform.h>
 #include <rtabmap/core/SensorData.h>
 #include <rtabmap/core/Link.h>
+#include <rtabmap/core/FlatWords.h>
 
 namespace rtabmap
 {
@@ -57,8 +58,8 @@ public:
 			int weight,
 			double stamp,
 			const std::string & label,
-			const std::multimap<int, cv::KeyPoint> & words,
-			const std::multimap<int, pcl::PointXYZ> & words3,
+			const FlatWords<cv::KeyPoint> & words,
+			const FlatWords<pcl::PointXYZ> & words3,
 			const Transform & pose = Transform(),
 			const std::vector<unsigned char> & userData = std::vector<unsigned char>(),
 			const cv::Mat & laserScan = cv::Mat(),
@@ -115,10 +116,12 @@ public:
 	void removeAllWords();
 	void removeWord(int wordId);
 	void changeWordsRef(int oldWordId, int activeWordId);
-	void setWords(const std::multimap<int, cv::KeyPoint> & words) {_enabled = false;_words = words;}
+	void changeWordsRef(const std::map<int, int> & refsToChange); // <old id, active id>, for many words at once
+	void setWords(const FlatWords<cv::KeyPoint> & words) {_enabled = false;_words = words;}
 	bool isEnabled() const {return _enabled;}
 	void setEnabled(bool enabled) {_enabled = enabled;}
-	const std::multimap<int, cv::KeyPoint> & getWords() const {return _words;}
+	const FlatWords<cv::KeyPoint> & getWords() const {return _words;}
+	std::multimap<int, cv::KeyPoint> getWordsMap() const {return _words.toMultimap();} // copy, prefer getWords()
 	const std::map<int, int> & getWordsChanged() const {return _wordsChanged;}
 	void setImageCompressed(const cv::Mat & bytes) {_imageCompressed = bytes;}
 	const cv::Mat & getImageCompressed() const {return _imageCompressed;}
@@ -126,12 +129,13 @@ public:
 	const cv::Mat & getImageRaw() const {return _imageRaw;}
 
 	//metric stuff
-	void setWords3(const std::multimap<int, pcl::PointXYZ> & words3) {_words3 = words3;}
+	void setWords3(const FlatWords<pcl::PointXYZ> & words3) {_words3 = words3;}
 	void setDepthCompressed(const cv::Mat & bytes, float fx, float fy, float cx, float cy);
 	void setLaserScanCompressed(const cv::Mat & bytes) {_laserScanCompressed = bytes;}
 	void setLocalTransform(const Transform & t) {_localTransform = t;}
 	void setPose(const Transform & pose) {_pose = pose;}
-	const std::multimap<int, pcl::PointXYZ> & getWords3() const {return _words3;}
+	const FlatWords<pcl::PointXYZ> & getWords3() const {return _words3;}
+	std::multimap<int, pcl::PointXYZ> getWords3Map() const {return _words3.toMultimap();} // copy, prefer getWords3()
 	const cv::Mat & getDepthCompressed() const {return _depthCompressed;}
 	const cv::Mat & getLaserScanCompressed() const {return _laserScanCompressed;}
 	RTABMAP_DEPRECATED(float getDepthFx() const, "Use getFx() instead.");
@@ -169,7 +173,7 @@ private:
 	// Contains all words (Some can be duplicates -> if a word appears 2
 	// times in the signature, it will be 2 times in this list)
 	// Words match with the CvSeq keypoints and descriptors
-	std::multimap<int, cv::KeyPoint> _words; // word <id, keypoint>
+	FlatWords<cv::KeyPoint> _words; // word <id, keypoint>
 	std::map<int, int> _wordsChanged; // <oldId, newId>
 	bool _enabled;
 	cv::Mat _imageCompressed; // compressed image
@@ -182,7 +186,7 @@ private:
 	float _cy;
 	Transform _pose;
 	Transform _localTransform; // camera_link -> base_link
-	std::multimap<int, pcl::PointXYZ> _words3; // word <id, keypoint>
+	FlatWords<pcl::PointXYZ> _words3; // word <id, 3D point>, empty or same ids than _words
 
 	cv::Mat _imageRaw; // CV_8UC1 or CV_8UC3
 	cv::Mat _depthRaw; // depth CV_16UC1 or CV_32FC1, right image CV_8UC1
@@ -74,6 +74,11 @@ class RTABMAP_EXP Statistics
 	RTABMAP_STATS(Memory, Short_time_memory_size,);
 	RTABMAP_STATS(Memory, Signatures_removed,);
 	RTABMAP_STATS(Memory, Signatures_retrieved,);
+	RTABMAP_STATS(Memory, Prefetch_hits,);
+	RTABMAP_STATS(Memory, Prefetch_misses,);
+	RTABMAP_STATS(Memory, Prefetch_staged,);
+	RTABMAP_STATS(Memory, Prefetch_staged_memory, KB);
+	RTABMAP_STATS(Memory, Trash_queue_size,);
 	RTABMAP_STATS(Memory, Images_buffered,);
 	RTABMAP_STATS(Memory, Rehearsal_sim,);
 	RTABMAP_STATS(Memory, Rehearsal_merged,);
@@ -96,6 +101,7 @@ class RTABMAP_EXP Statistics
 	RTABMAP_STATS(Timing, Forgetting, ms);
 	RTABMAP_STATS(Timing, Joining_trash, ms);
 	RTABMAP_STATS(Timing, Emptying_trash, ms);
+	RTABMAP_STATS(Timing, Emptying_trash_latency, ms);
 
 	RTABMAP_STATS(TimingMem, Pre_update, ms);
 	RTABMAP_STATS(TimingMem, Signature_creation, ms);
@@ -109,6 +115,13 @@ class RTABMAP_EXP Statistics
 	RTABMAP_STATS(TimingMem, Add_new_words, ms);
 	RTABMAP_STATS(TimingMem, Compressing_data, ms);
 
+	RTABMAP_STATS(Pipeline, Input_latency, ms);
+	RTABMAP_STATS(Pipeline, Extraction, ms);
+	RTABMAP_STATS(Pipeline, Ready_latency, ms);
+	RTABMAP_STATS(Pipeline, Map_update, ms);
+	RTABMAP_STATS(Pipeline, Input_buffered,);
+	RTABMAP_STATS(Pipeline, Ready_buffered,);
+
 	RTABMAP_STATS(Keypoint, Dictionary_size, words);
 	RTABMAP_STATS(Keypoint, Response_threshold,);
 
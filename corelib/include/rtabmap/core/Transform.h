@@ -36,6 +36,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace rtabmap {
 
+/**
+ * Rigid (or affine) transform stored as a 3x4 row-major matrix [R|t]. The
+ * storage is inline: copying a Transform doesn't allocate.
+ */
 class RTABMAP_EXP Transform
 {
 public:
@@ -72,9 +76,9 @@ public:
 	void setNull();
 	void setIdentity();
 
-	const float * data() const {return data_.data();}
-	float * data() {return data_.data();}
-	int size() const {return (int)data_.size();}
+	const float * data() const {return data_;}
+	float * data() {return data_;}
+	int size() const {return 12;}
 
 	float & x() {return data_[3];}
 	float & y() {return data_[7];}
@@ -85,6 +89,16 @@ public:
 
 	float theta() const;
 
+	// point = R*point + t
+	void transformPoint(float & px, float & py, float & pz) const
+	{
+		float tx = data_[0]*px + data_[1]*py + data_[2]*pz + data_[3];
+		float ty = data_[4]*px + data_[5]*py + data_[6]*pz + data_[7];
+		pz = data_[8]*px + data_[9]*py + data_[10]*pz + data_[11];
+		px = tx;
+		py = ty;
+	}
+
 	Transform inverse() const;
 	Transform rotation() const;
 	Transform translation() const;
@@ -121,7 +135,7 @@ public:
 	static Transform fromEigen3d(const Eigen::Isometry3d & matrix);
 
 private:
-	std::vector<float> data_;
+	float data_[12];
 };
 
 RTABMAP_EXP std::ostream& operator<<(std::ostream& os, const Transform& s);
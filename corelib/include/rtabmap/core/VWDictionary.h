@@ -41,11 +41,15 @@ namespace rtabmap
 
 class DBDriver;
 class VisualWord;
+class VWIndexSegment;
+class HammingMatcher;
+class DescriptorSlab;
+class InvertedIndex;
 
 class RTABMAP_EXP VWDictionary
 {
 public:
-	enum NNStrategy{kNNFlannNaive, kNNFlannKdTree, kNNFlannLSH, kNNBruteForce, kNNBruteForceGPU, kNNUndef};
+	enum NNStrategy{kNNFlannNaive, kNNFlannKdTree, kNNFlannLSH, kNNBruteForce, kNNBruteForceGPU, kNNBruteForceHamming, kNNUndef};
 	static const int ID_START;
 	static const int ID_INVALID;
 
@@ -65,7 +69,8 @@ public:
 	virtual std::vector<int> findNN(const std::list<VisualWord *> & vws) const;
 
 	void addWordRef(int wordId, int signatureId);
-	void removeAllWordRef(int wordId, int signatureId);
+	void addWordsRef(const std::vector<int> & wordIds, int signatureId); // a word can be more than once in wordIds
+	void removeAllWordsRef(int signatureId);
 	const VisualWord * getWord(int id) const;
 	VisualWord * getUnusedWord(int id) const;
 	void setLastWordId(int id) {_lastWordId = id;}
@@ -73,8 +78,12 @@ public:
 	float getNndrRatio() const {return _nndrRatio;}
 	unsigned int getNotIndexedWordsCount() const {return (int)_notIndexedWords.size();}
 	int getLastIndexedWordId() const;
-	int getTotalActiveReferences() const {return _totalActiveReferences;}
+	int getTotalActiveReferences() const;
+	const InvertedIndex & getInvertedIndex() const {return *_invertedIndex;}
 	void setNNStrategy(NNStrategy strategy);
+	void setIncrementalFlann(bool enabled);
+	bool isIncrementalFlann() const {return _incrementalFlann;}
+	unsigned int getIndexSegmentsCount() const {return (int)_segments.size();}
 	bool isIncremental() const {return _incrementalDictionary;}
 	void setIncrementalDictionary();
 	void setFixedDictionary(const std::string & dictionaryPath);
@@ -91,9 +100,13 @@ public:
 protected:
 	int getNextId();
 
+private:
+	void releaseIndex();
+	void updateSegments();
+	void searchSegments(const cv::Mat & query, unsigned int k, std::vector<std::multimap<float, int> > & results) const;
+
 protected:
 	std::map<int, VisualWord *> _visualWords; //<id,VisualWord*>
-	int _totalActiveReferences; // keep track of all references for updating the common signature
 
 private:
 	bool _incrementalDictionary;
@@ -102,12 +115,20 @@ private:
 	bool _newWordsComparedTogether;
 	int _lastWordId;
 	cv::flann::Index * _flannIndex;
-	cv::Mat _dataTree;
+	HammingMatcher * _hammingMatcher; // owns _dataTree's data with kNNBruteForceHamming
+	DescriptorSlab * _slab; // descriptors of the words
+	InvertedIndex * _invertedIndex; // signatures referencing the words
+	cv::Mat _dataTree; // not copied from _slab if the slab is dense
 	NNStrategy _strategy;
 	std::map<int ,int> _mapIndexId;
 	std::map<int, VisualWord*> _unusedWords; //<id,VisualWord*>, note that these words stay in _visualWords
 	std::set<int> _notIndexedWords; // Words that are not indexed in the dictionary
 	std::set<int> _removedIndexedWords; // Words not anymore in the dictionary but still indexed in the dictionary
+
+	// Incremental index (Kp/IncrementalFlann): append-only segments, newest at the back
+	bool _incrementalFlann;
+	float _flannRebalancingFactor;
+	std::vector<VWIndexSegment *> _segments;
 };
 
 } // namespace rtabmap
@@ -0,0 +1,146 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef VOXELACCUMULATOR_H_
+#define VOXELACCUMULATOR_H_
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <rtabmap/core/Transform.h>
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace rtabmap {
+namespace util3d {
+
+/**
+ * Voxel grid filled one cloud at a time: each voxel keeps the average of
+ * its points and colors, and the number of points. The voxels are hashed
+ * by blocks of 16x16x16 voxels. With a maximum memory, the blocks not
+ * updated for the longest time are written to a spill file when the
+ * limit is reached after integrate(). A spilled block receiving new
+ * points is created again and the parts are merged when the voxels are
+ * read back, so the voxels are the same with or without spilling.
+ *
+ * savePLY() streams the voxels block by block, so the assembled cloud
+ * is never in memory.
+ *
+ * Example:
+ *   util3d::VoxelAccumulator accumulator(0.01f, 512*1024*1024); // 1 cm, 512 MB
+ *   for each node: accumulator.integrate(*cloud, pose);
+ *   accumulator.savePLY("map.ply");
+ */
+class RTABMAP_EXP VoxelAccumulator
+{
+public:
+	/**
+	 * @param voxelSize m
+	 * @param maxMemory bytes of the resident blocks (0=no limit)
+	 * @param spillPath file used for spilled blocks, removed when the accumulator
+	 *        is cleared or destroyed (empty=temporary file of the system)
+	 */
+	VoxelAccumulator(float voxelSize, long maxMemory = 0, const std::string & spillPath = "");
+	~VoxelAccumulator();
+
+	/**
+	 * Add the points of the cloud, transformed by "transform" if not null.
+	 * Points with NaN are ignored.
+	 */
+	void integrate(const pcl::PointCloud<pcl::PointXYZRGB> & cloud, const Transform & transform = Transform());
+
+	/**
+	 * The voxels (average of the points and colors), with the number of points
+	 * of each voxel in "counts" if set. Spilled blocks are read back.
+	 */
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud(std::vector<int> * counts = 0) const;
+
+	/**
+	 * Write the voxels in a PLY file (with a "count" property of the
+	 * number of points of each voxel if withCounts is true).
+	 * @return the number of voxels written, -1 on error
+	 */
+	int savePLY(const std::string & path, bool binary = true, bool withCounts = false) const;
+
+	void clear();
+
+	float voxelSize() const {return _voxelSize;}
+	long maxMemory() const {return _maxMemory;}
+	long memoryUsed() const {return _memoryUsed;} // bytes of the resident blocks
+	int blocks() const {return (int)_blocks.size();} // resident blocks
+	int spilledBlocks() const {return (int)_spilled.size();}
+	long long spilledBytes() const {return _spillSize;}
+	long points() const {return _points;} // points integrated
+
+private:
+	VoxelAccumulator(const VoxelAccumulator &);
+	VoxelAccumulator & operator=(const VoxelAccumulator &);
+
+	struct Voxel;
+	struct Block;
+	struct BlockKey
+	{
+		BlockKey(int x = 0, int y = 0, int z = 0) : x(x), y(y), z(z) {}
+		bool operator<(const BlockKey & k) const
+		{
+			return x < k.x || (x == k.x && (y < k.y || (y == k.y && z < k.z)));
+		}
+		bool operator==(const BlockKey & k) const {return x == k.x && y == k.y && z == k.z;}
+		int x, y, z;
+	};
+	struct Segment
+	{
+		long long offset; // in the spill file
+		int voxels;
+	};
+
+	Block * getBlock(const BlockKey & key);
+	void spill();
+	std::vector<BlockKey> keys() const;
+	const std::vector<Voxel> & voxels(const BlockKey & key, Block & buffer) const;
+
+private:
+	float _voxelSize;
+	float _voxelSizeInv;
+	long _maxMemory;
+	std::string _spillPath;
+	std::map<BlockKey, Block *> _blocks; // resident
+	std::map<BlockKey, std::vector<Segment> > _spilled; // parts of the blocks in the spill file
+	FILE * _spillFile;
+	long long _spillSize; // bytes
+	long _memoryUsed;
+	long _points;
+	int _integrations;
+};
+
+} // namespace util3d
+} // namespace rtabmap
+
+#endif /* VOXELACCUMULATOR_H_ */
@@ -136,7 +136,9 @@ PointT transformPoint(
 		const PointT & pt,
 		const Transform & transform)
 {
-	return pcl::transformPoint(pt, transform.toEigen3f());
+	PointT ptOut = pt;
+	transform.transformPoint(ptOut.x, ptOut.y, ptOut.z);
+	return ptOut;
 }
 
 template<typename PointT>
@@ -37,6 +37,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <set>
 
 #include <rtabmap/core/Link.h>
+#include <rtabmap/core/FlatWords.h>
 #include <rtabmap/utilite/UThread.h>
 #include <pcl/common/eigen.h>
 #include <pcl/point_types.h>
@@ -116,6 +117,39 @@ std::multimap<int, pcl::PointXYZ> RTABMAP_EXP generateWords3DMono(
 		float ransacParam2 = 0.99f,
 		const std::multimap<int, pcl::PointXYZ> & refGuess3D = std::multimap<int, pcl::PointXYZ>(),
 		double * variance = 0);
+// Same as above with the words of the signatures (no copy)
+std::multimap<int, pcl::PointXYZ> RTABMAP_EXP generateWords3DMono(
+		const FlatWords<cv::KeyPoint> & kpts,
+		const FlatWords<cv::KeyPoint> & previousKpts,
+		float fx,
+		float fy,
+		float cx,
+		float cy,
+		const Transform & localTransform,
+		Transform & cameraTransform,
+		int pnpIterations = 100,
+		float pnpReprojError = 8.0f,
+		int pnpFlags = cv::ITERATIVE,
+		float ransacParam1 = 3.0f,
+		float ransacParam2 = 0.99f,
+		const std::multimap<int, pcl::PointXYZ> & refGuess3D = std::multimap<int, pcl::PointXYZ>(),
+		double * variance = 0);
+std::multimap<int, pcl::PointXYZ> RTABMAP_EXP generateWords3DMono(
+		const FlatWords<cv::KeyPoint> & kpts,
+		const FlatWords<cv::KeyPoint> & previousKpts,
+		float fx,
+		float fy,
+		float cx,
+		float cy,
+		const Transform & localTransform,
+		Transform & cameraTransform,
+		int pnpIterations,
+		float pnpReprojError,
+		int pnpFlags,
+		float ransacParam1,
+		float ransacParam2,
+		const FlatWords<pcl::PointXYZ> & refGuess3D,
+		double * variance = 0);
 
 std::multimap<int, cv::KeyPoint> RTABMAP_EXP aggregate(
 		const std::list<int> & wordIds,
@@ -129,38 +163,66 @@ pcl::PointXYZ RTABMAP_EXP projectDepthTo3D(
 		bool smoothing,
 		float maxZError = 0.02f);
 
+// Points are stored row by row in x, y and z arrays of (rows/decimation)*(cols/decimation) floats.
+// Invalid points and points farther than maxDepth (if > 0) are NaN. Large images are
+// projected by bands of rows in parallel (threads <= 0: chosen from the image size).
+// Return the number of valid points.
+int RTABMAP_EXP depthToXYZ(
+		const cv::Mat & imageDepth,
+		float cx, float cy,
+		float fx, float fy,
+		int decimation,
+		float maxDepth,
+		float * x, float * y, float * z,
+		int threads = 0);
+
+int RTABMAP_EXP disparityToXYZ(
+		const cv::Mat & imageDisparity,
+		float cx, float cy,
+		float fx, float baseline,
+		int decimation,
+		float maxDepth,
+		float * x, float * y, float * z,
+		int threads = 0);
+
+// Organized clouds, points farther than maxDepth (if > 0) are NaN
 pcl::PointCloud<pcl::PointXYZ>::Ptr RTABMAP_EXP cloudFromDepth(
 		const cv::Mat & imageDepth,
 		float cx, float cy,
 		float fx, float fy,
-		int decimation = 1);
+		int decimation = 1,
+		float maxDepth = 0.0f);
 
 pcl::PointCloud<pcl::PointXYZRGB>::Ptr RTABMAP_EXP cloudFromDepthRGB(
 		const cv::Mat & imageRgb,
 		const cv::Mat & imageDepth,
 		float cx, float cy,
 		float fx, float fy,
-		int decimation = 1);
+		int decimation = 1,
+		float maxDepth = 0.0f);
 
 pcl::PointCloud<pcl::PointXYZ>::Ptr RTABMAP_EXP cloudFromDisparity(
 		const cv::Mat & imageDisparity,
 		float cx, float cy,
 		float fx, float baseline,
-		int decimation = 1);
+		int decimation = 1,
+		float maxDepth = 0.0f);
 
 pcl::PointCloud<pcl::PointXYZRGB>::Ptr RTABMAP_EXP cloudFromDisparityRGB(
 		const cv::Mat & imageRgb,
 		const cv::Mat & imageDisparity,
 		float cx, float cy,
 		float fx, float baseline,
-		int decimation = 1);
+		int decimation = 1,
+		float maxDepth = 0.0f);
 
 pcl::PointCloud<pcl::PointXYZRGB>::Ptr RTABMAP_EXP cloudFromStereoImages(
 		const cv::Mat & imageLeft,
 		const cv::Mat & imageRight,
 		float cx, float cy,
 		float fx, float baseline,
-		int decimation = 1);
+		int decimation = 1,
+		float maxDepth = 0.0f);
 
 cv::Mat RTABMAP_EXP disparityFromStereoImages(
 		const cv::Mat & leftImage,
@@ -335,6 +397,21 @@ void RTABMAP_EXP findCorrespondences(
 		pcl::PointCloud<pcl::PointXYZ> & inliers2,
 		float maxDepth,
 		std::set<int> * uniqueCorrespondences = 0);
+// Same as above with the words of the signatures (no copy)
+void RTABMAP_EXP findCorrespondences(
+		const std::multimap<int, pcl::PointXYZ> & words1,
+		const FlatWords<pcl::PointXYZ> & words2,
+		pcl::PointCloud<pcl::PointXYZ> & inliers1,
+		pcl::PointCloud<pcl::PointXYZ> & inliers2,
+		float maxDepth,
+		std::set<int> * uniqueCorrespondences = 0);
+void RTABMAP_EXP findCorrespondences(
+		const FlatWords<pcl::PointXYZ> & words1,
+		const FlatWords<pcl::PointXYZ> & words2,
+		pcl::PointCloud<pcl::PointXYZ> & inliers1,
+		pcl::PointCloud<pcl::PointXYZ> & inliers2,
+		float maxDepth,
+		std::set<int> * uniqueCorrespondences = 0);
 
 pcl::PointCloud<pcl::PointXYZ>::Ptr RTABMAP_EXP cvMat2Cloud(
 		const cv::Mat & matrix,
@@ -30,6 +30,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/Signature.h"
 #include "rtabmap/core/Parameters.h"
 #include <iostream>
+#include <algorithm>
 
 #include "rtabmap/utilite/UtiLite.h"
 
@@ -124,7 +125,7 @@ std::string BayesFilter::getPredictionLCStr() const
 void BayesFilter::reset()
 {
 	_posterior.clear();
-	_prediction = cv::Mat();
+	_prediction = Prediction();
 }
 
 const std::map<int, float> & BayesFilter::computePosterior(const Memory * memory, const std::map<int, float> & likelihood)
@@ -152,39 +153,35 @@ const std::map<int, float> & BayesFilter::computePosterior(const Memory * memory
 	UTimer timer;
 	timer.start();
 
-	cv::Mat prior;
-	cv::Mat posterior;
+	std::vector<float> prior;
+	std::vector<float> posterior;
+	std::vector<int> ids = uKeys(likelihood);
 
 	float sum = 0;
 	int j=0;
 	// Recursive Bayes estimation...
 	// STEP 1 - Prediction : Prior*lastPosterior
-	_prediction = this->generatePrediction(memory, uKeys(likelihood));
+	if(!_fullPredictionUpdate && !_prediction.empty())
+	{
+		this->updatePrediction(_prediction, memory, uKeys(_posterior), ids);
+	}
+	else
+	{
+		this->generatePrediction(_prediction, memory, ids);
+	}
 
-	ULOGGER_DEBUG("STEP1-generate prior=%fs, rows=%d, cols=%d", timer.ticks(), _prediction.rows, _prediction.cols);
-	//std::cout << "Prediction=" << _prediction << std::endl;
+	ULOGGER_DEBUG("STEP1-generate prior=%fs, size=%d, columns=%d", timer.ticks(), (int)_prediction.rowStamps.size(), (int)_prediction.columns.size());
 
 	// Adjust the last posterior if some images were
 	// reactivated or removed from the working memory
-	posterior = cv::Mat(likelihood.size(), 1, CV_32FC1);
-	this->updatePosterior(memory, uKeys(likelihood));
-	j=0;
-	for(std::map<int, float>::const_iterator i=_posterior.begin(); i!= _posterior.end(); ++i)
-	{
-		((float*)posterior.data)[j++] = (*i).second;
-	}
-	ULOGGER_DEBUG("STEP1-update posterior=%fs, posterior=%d, _posterior size=%d", posterior.rows, _posterior.size());
-	//std::cout << "LastPosterior=" << posterior << std::endl;
+	this->updatePosterior(memory, ids);
+	posterior = uValues(_posterior);
+	ULOGGER_DEBUG("STEP1-update posterior=%fs, posterior=%d, _posterior size=%d", timer.ticks(), (int)posterior.size(), _posterior.size());
 
 	// Multiply prediction matrix with the last posterior
 	// (m,m) X (m,1) = (m,1)
-	prior = _prediction * posterior;
+	this->multiply(_prediction, ids, posterior, prior);
 	ULOGGER_DEBUG("STEP1-matrix mult time=%fs", timer.ticks());
-	//std::cout << "ResultingPrior=" << prior << std::endl;
-
-	ULOGGER_DEBUG("STEP1-matrix mult time=%fs", timer.ticks());
-	std::vector<float> likelihoodValues = uValues(likelihood);
-	//std::cout << "Likelihood=" << cv::Mat(likelihoodValues) << std::endl;
 
 	// STEP 2 - Update : Multiply with observations (likelihood)
 	j=0;
@@ -193,7 +190,7 @@ const std::map<int, float> & BayesFilter::computePosterior(const Memory * memory
 		std::map<int, float>::iterator p =_posterior.find((*i).first);
 		if(p!= _posterior.end())
 		{
-			(*p).second = (*i).second * ((float*)prior.data)[j++];
+			(*p).second = (*i).second * prior[j++];
 			sum+=(*p).second;
 		}
 		else
@@ -202,7 +199,6 @@ const std::map<int, float> & BayesFilter::computePosterior(const Memory * memory
 		}
 	}
 	ULOGGER_DEBUG("STEP2-likelihood time=%fs", timer.ticks());
-	//std::cout << "Posterior (before normalization)=" << _posterior << std::endl;
 
 	// Normalize
 	ULOGGER_DEBUG("sum=%f", sum);
@@ -214,39 +210,62 @@ const std::map<int, float> & BayesFilter::computePosterior(const Memory * memory
 		}
 	}
 	ULOGGER_DEBUG("normalize time=%fs", timer.ticks());
-	//std::cout << "Posterior=" << _posterior << std::endl;
 
 	return _posterior;
 }
 
 cv::Mat BayesFilter::generatePrediction(const Memory * memory, const std::vector<int> & ids) const
 {
+	Prediction prediction;
 	if(!_fullPredictionUpdate && !_prediction.empty())
 	{
-		return updatePrediction(_prediction, memory, uKeys(_posterior), ids);
+		prediction = _prediction;
+		this->updatePrediction(prediction, memory, uKeys(_posterior), ids);
+	}
+	else
+	{
+		this->generatePrediction(prediction, memory, ids);
+	}
+	return this->toDense(prediction, ids);
+}
+
+typedef std::vector<std::pair<int, float> > PredictionEntries;
+
+static bool entryIdLess(const std::pair<int, float> & entry, int id)
+{
+	return entry.first < id;
+}
+
+// Return the value of the row "id", added with "defaultValue" if not already set
+static float & predictionEntry(PredictionEntries & entries, int id, float defaultValue)
+{
+	PredictionEntries::iterator iter = std::lower_bound(entries.begin(), entries.end(), id, entryIdLess);
+	if(iter == entries.end() || iter->first != id)
+	{
+		iter = entries.insert(iter, std::make_pair(id, defaultValue));
 	}
+	return iter->second;
+}
+
+void BayesFilter::generatePrediction(Prediction & prediction, const Memory * memory, const std::vector<int> & ids) const
+{
 	UDEBUG("");
 
 	UASSERT(memory &&
 		   _predictionLC.size() >= 2 &&
 		   ids.size());
 
-	UTimer timer;
-	timer.start();
 	UTimer timerGlobal;
 	timerGlobal.start();
 
-	std::map<int, int> idToIndexMap;
+	prediction = Prediction();
+	prediction.stamp = 1;
 	for(unsigned int i=0; i<ids.size(); ++i)
 	{
 		UASSERT_MSG(ids[i] != 0, "Signature id is null ?!?");
-		idToIndexMap.insert(idToIndexMap.end(), std::make_pair(ids[i], i));
+		prediction.rowStamps.insert(prediction.rowStamps.end(), std::make_pair(ids[i], prediction.stamp));
 	}
 
-	//int rows = prediction.rows;
-	cv::Mat prediction = cv::Mat::zeros(ids.size(), ids.size(), CV_32FC1);
-	int cols = prediction.cols;
-
 	// Each prior is a column vector
 	UDEBUG("_predictionLC.size()=%d",_predictionLC.size());
 	std::set<int> idsDone;
@@ -286,69 +305,72 @@ cv::Mat BayesFilter::generatePrediction(const Memory * memory, const std::vector
 				}
 
 				// same neighbor tree for loop signatures (margin = 0)
+				PredictionColumn & column = prediction.columns[ids[i]];
+				column.stamp = prediction.stamp;
 				for(std::list<int>::iterator iter = idsLoopMargin.begin(); iter!=idsLoopMargin.end(); ++iter)
 				{
 					float sum = 0.0f; // sum values added
-					sum += this->addNeighborProb(prediction, i, neighbors, idToIndexMap);
+					sum += this->addNeighborProb(column, neighbors, ids);
 					idsDone.insert(*iter);
-					this->normalize(prediction, i, sum, ids[0]<0);
+					this->normalize(column, ids[i], ids, sum, ids[0]<0);
 				}
 			}
 			else
 			{
 				// Set the virtual place prior
-				if(_virtualPlacePrior > 0)
-				{
-					if(cols>1) // The first must be the virtual place
-					{
-						((float*)prediction.data)[i] = _virtualPlacePrior;
-						float val = (1.0-_virtualPlacePrior)/(cols-1);
-						for(int j=1; j<cols; j++)
-						{
-							((float*)prediction.data)[i + j*cols] = val;
-						}
-					}
-					else if(cols>0)
-					{
-						((float*)prediction.data)[i] = 1;
-					}
-				}
-				else
-				{
-					// Only for some tests...
-					// when _virtualPlacePrior=0, set all priors to the same value
-					if(cols>1)
-					{
-						float val = 1.0/cols;
-						for(int j=0; j<cols; j++)
-						{
-							((float*)prediction.data)[i + j*cols] = val;
-						}
-					}
-					else if(cols>0)
-					{
-						((float*)prediction.data)[i] = 1;
-					}
-				}
+				PredictionColumn & column = prediction.columns[ids[i]];
+				column.stamp = prediction.stamp;
+				this->setVirtualPlaceColumn(column, ids[i], (int)ids.size(), true);
 			}
 		}
 	}
 
 	ULOGGER_DEBUG("time = %fs", timerGlobal.ticks());
+}
 
-	return prediction;
+void BayesFilter::setVirtualPlaceColumn(PredictionColumn & column, int id, int rows, bool uniformIfNoPrior) const
+{
+	column.entries.clear();
+	column.background = 0.0f;
+	if(_virtualPlacePrior > 0 || !uniformIfNoPrior)
+	{
+		if(rows>1) // The first must be the virtual place
+		{
+			column.entries.push_back(std::make_pair(id, _virtualPlacePrior));
+			column.background = (1.0-_virtualPlacePrior)/(rows-1);
+		}
+		else if(rows>0)
+		{
+			column.entries.push_back(std::make_pair(id, 1.0f));
+		}
+	}
+	else
+	{
+		// Only for some tests...
+		// when _virtualPlacePrior=0, set all priors to the same value
+		if(rows>1)
+		{
+			float val = 1.0/rows;
+			column.entries.push_back(std::make_pair(id, val));
+			column.background = val;
+		}
+		else if(rows>0)
+		{
+			column.entries.push_back(std::make_pair(id, 1.0f));
+		}
+	}
 }
 
-void BayesFilter::normalize(cv::Mat & prediction, unsigned int index, float addedProbabilitiesSum, bool virtualPlaceUsed) const
+void BayesFilter::normalize(PredictionColumn & column, int id, const std::vector<int> & ids, float addedProbabilitiesSum, bool virtualPlaceUsed) const
 {
-	UASSERT(index < (unsigned int)prediction.rows && index < (unsigned int)prediction.cols);
+	UASSERT(std::binary_search(ids.begin(), ids.end(), id));
 
-	int cols = prediction.cols;
+	int cols = (int)ids.size();
 	// ADD values of not found neighbors to loop closure
 	if(addedProbabilitiesSum < _totalPredictionLCValues-_predictionLC[0])
 	{
 		float delta = _totalPredictionLCValues-_predictionLC[0]-addedProbabilitiesSum;
-		((float*)prediction.data)[index + index*cols] += delta;
+		predictionEntry(column.entries, id, id>0?column.background:0.0f) += delta;
 		addedProbabilitiesSum+=delta;
 	}
 
@@ -359,50 +381,62 @@ void BayesFilter::normalize(cv::Mat & prediction, unsigned int index, float adde
 	}
 
 	// Set all loop events to small values according to the model
+	// (the virtual place is the only row with id < 0)
 	if(allOtherPlacesValue > 0 && cols>1)
 	{
 		float value = allOtherPlacesValue / float(cols - 1);
-		for(int j=virtualPlaceUsed?1:0; j<cols; ++j)
+		int entriesSet = 0;
+		for(PredictionEntries::iterator iter=column.entries.begin(); iter!=column.entries.end(); ++iter)
 		{
-			if(((float*)prediction.data)[index + j*cols] == 0)
+			if(iter->first > 0)
 			{
-				((float*)prediction.data)[index + j*cols] = value;
-				addedProbabilitiesSum += ((float*)prediction.data)[index + j*cols];
+				++entriesSet;
+				if(iter->second == 0)
+				{
+					iter->second = value;
+					addedProbabilitiesSum += value;
+				}
 			}
 		}
+		int backgroundRows = cols - (virtualPlaceUsed?1:0) - entriesSet;
+		if(column.background == 0 && backgroundRows > 0)
+		{
+			column.background = value;
+			addedProbabilitiesSum += value * float(backgroundRows);
+		}
 	}
 
-	//normalize this row
+	//normalize this column
 	float maxNorm = 1 - (virtualPlaceUsed?_predictionLC[0]:0); // 1 - virtual place probability
 	if(addedProbabilitiesSum<maxNorm-0.0001 || addedProbabilitiesSum>maxNorm+0.0001)
 	{
-		for(int j=virtualPlaceUsed?1:0; j<cols; ++j)
+		float factor = maxNorm / addedProbabilitiesSum;
+		for(PredictionEntries::iterator iter=column.entries.begin(); iter!=column.entries.end(); ++iter)
 		{
-			((float*)prediction.data)[index + j*cols] *= maxNorm / addedProbabilitiesSum;
+			if(iter->first > 0)
+			{
+				iter->second *= factor;
+			}
 		}
+		column.background *= factor;
 		addedProbabilitiesSum = maxNorm;
 	}
 
 	// ADD virtual place prob
 	if(virtualPlaceUsed)
 	{
-		((float*)prediction.data)[index] = _predictionLC[0];
-		addedProbabilitiesSum += ((float*)prediction.data)[index];
+		float & value = predictionEntry(column.entries, ids[0], 0.0f);
+		value = _predictionLC[0];
+		addedProbabilitiesSum += value;
 	}
 
-	//debug
-	//for(int j=0; j<cols; ++j)
-	//{
-	//	ULOGGER_DEBUG("test col=%d = %f", i, prediction.data.fl[i + j*cols]);
-	//}
-
 	if(addedProbabilitiesSum<0.99 || addedProbabilitiesSum > 1.01)
 	{
 		UWARN("Prediction is not normalized sum=%f", addedProbabilitiesSum);
 	}
 }
 
-cv::Mat BayesFilter::updatePrediction(const cv::Mat & oldPrediction,
+void BayesFilter::updatePrediction(Prediction & prediction,
 		const Memory * memory,
 		const std::vector<int> & oldIds,
 		const std::vector<int> & newIds) const
@@ -413,36 +447,16 @@ cv::Mat BayesFilter::updatePrediction(const cv::Mat & oldPrediction,
 	UASSERT(memory &&
 		oldIds.size() &&
 		newIds.size() &&
-		oldIds.size() == (unsigned int)oldPrediction.cols &&
-		oldIds.size() == (unsigned int)oldPrediction.rows);
+		oldIds.size() == prediction.rowStamps.size());
 
-	cv::Mat prediction = cv::Mat::zeros(newIds.size(), newIds.size(), CV_32FC1);
+	++prediction.stamp;
 
-	// Create id to index maps
-	std::map<int, int> oldIdToIndexMap;
-	std::map<int, int> newIdToIndexMap;
-	for(unsigned int i=0; i<oldIds.size() || i<newIds.size(); ++i)
-	{
-		if(i<oldIds.size())
-		{
-			UASSERT(oldIds[i]);
-			oldIdToIndexMap.insert(oldIdToIndexMap.end(), std::make_pair(oldIds[i], i));
-			//UDEBUG("oldIdToIndexMap[%d] = %d", oldIds[i], i);
-		}
-		if(i<newIds.size())
-		{
-			UASSERT(newIds[i]);
-			newIdToIndexMap.insert(newIdToIndexMap.end(), std::make_pair(newIds[i], i));
-			//UDEBUG("newIdToIndexMap[%d] = %d", newIds[i], i);
-		}
-	}
-	UDEBUG("time creating id-index maps = %fs", timer.restart());
-
-	//Get removed ids
+	//Get removed ids (ids are sorted)
 	std::set<int> removedIds;
 	for(unsigned int i=0; i<oldIds.size(); ++i)
 	{
-		if(!uContains(newIdToIndexMap, oldIds[i]))
+		UASSERT(oldIds[i]);
+		if(!std::binary_search(newIds.begin(), newIds.end(), oldIds[i]))
 		{
 			removedIds.insert(removedIds.end(), oldIds[i]);
 			UDEBUG("removed id=%d at oldIndex=%d", oldIds[i], i);
@@ -450,103 +464,119 @@ cv::Mat BayesFilter::updatePrediction(const cv::Mat & oldPrediction,
 	}
 	UDEBUG("time getting removed ids = %fs", timer.restart());
 
-	int added = 0;
-	// get ids to update
+	// Neighbors of the removed ids must be updated
 	std::set<int> idsToUpdate;
-	for(unsigned int i=0; i<oldIds.size() || i<newIds.size(); ++i)
+	for(std::set<int>::iterator iter=removedIds.begin(); iter!=removedIds.end(); ++iter)
 	{
-		if(i<oldIds.size())
+		std::map<int, PredictionColumn>::iterator jter = prediction.columns.find(*iter);
+		if(jter != prediction.columns.end())
 		{
-			if(removedIds.find(oldIds[i]) != removedIds.end())
+			const PredictionColumn & column = jter->second;
+			for(PredictionEntries::const_iterator kter=column.entries.begin(); kter!=column.entries.end(); ++kter)
 			{
-				unsigned int cols = oldPrediction.cols;
-				for(unsigned int j=0; j<cols; ++j)
+				if(kter->second != 0.0f &&
+				   kter->first != *iter &&
+				   removedIds.find(kter->first) == removedIds.end())
 				{
-					if(((const float *)oldPrediction.data)[i + j*cols] != 0.0f &&
-					   j!=i &&
-					   removedIds.find(oldIds[j]) == removedIds.end())
+					idsToUpdate.insert(kter->first);
+				}
+			}
+			if(column.background != 0.0f)
+			{
+				// all rows under the background are not null
+				for(std::map<int, int>::iterator kter=prediction.rowStamps.begin(); kter!=prediction.rowStamps.end(); ++kter)
+				{
+					if(kter->first > 0 &&
+					   kter->second <= column.stamp &&
+					   kter->first != *iter &&
+					   removedIds.find(kter->first) == removedIds.end())
 					{
-						//UDEBUG("to update id=%d from id=%d removed (value=%f)", oldIds[j], oldIds[i], ((const float *)oldPrediction.data)[i + j*cols]);
-						idsToUpdate.insert(oldIds[j]);
+						idsToUpdate.insert(kter->first);
 					}
 				}
 			}
+			prediction.columns.erase(jter);
 		}
-		if(i<newIds.size() && !uContains(oldIdToIndexMap,newIds[i]))
+		prediction.rowStamps.erase(*iter);
+	}
+	if(removedIds.size())
+	{
+		// remove the rows of the removed ids
+		for(std::map<int, PredictionColumn>::iterator iter=prediction.columns.begin(); iter!=prediction.columns.end(); ++iter)
 		{
-			std::map<int, int> neighbors = memory->getNeighborsId(newIds[i], _predictionLC.size()-1, 0);
-			float sum = this->addNeighborProb(prediction, i, neighbors, newIdToIndexMap);
-			this->normalize(prediction, i, sum, newIds[0]<0);
-			++added;
-			for(std::map<int,int>::iterator iter=neighbors.begin(); iter!=neighbors.end(); ++iter)
+			PredictionEntries & entries = iter->second.entries;
+			PredictionEntries::iterator last = entries.begin();
+			for(PredictionEntries::iterator jter=entries.begin(); jter!=entries.end(); ++jter)
 			{
-				if(uContains(oldIdToIndexMap, iter->first) &&
-				   removedIds.find(iter->first) == removedIds.end())
+				if(removedIds.find(jter->first) == removedIds.end())
 				{
-					idsToUpdate.insert(iter->first);
+					*last++ = *jter;
 				}
 			}
+			entries.erase(last, entries.end());
 		}
 	}
-	UDEBUG("time getting ids to update = %fs", timer.restart());
+	UDEBUG("time removing ids = %fs", timer.restart());
 
-	// update modified/added ids
-	int modified = 0;
-	for(std::set<int>::iterator iter = idsToUpdate.begin(); iter!=idsToUpdate.end(); ++iter)
+	// Add new ids
+	std::vector<int> addedIds;
+	for(unsigned int i=0; i<newIds.size(); ++i)
 	{
-		std::map<int, int> neighbors = memory->getNeighborsId(*iter, _predictionLC.size()-1, 0);
-		int index = newIdToIndexMap.at(*iter);
-		float sum = this->addNeighborProb(prediction, index, neighbors, newIdToIndexMap);
-		this->normalize(prediction, index, sum, newIds[0]<0);
-		++modified;
+		UASSERT(newIds[i]);
+		if(prediction.rowStamps.find(newIds[i]) == prediction.rowStamps.end())
+		{
+			prediction.rowStamps.insert(std::make_pair(newIds[i], prediction.stamp));
+			addedIds.push_back(newIds[i]);
+		}
 	}
-	UDEBUG("time updating modified/added ids = %fs", timer.restart());
+	UASSERT(prediction.rowStamps.size() == newIds.size());
 
-	//UDEBUG("oldIds.size()=%d, oldPrediction.cols=%d, oldPrediction.rows=%d", oldIds.size(), oldPrediction.cols, oldPrediction.rows);
-	//UDEBUG("newIdToIndexMap.size()=%d, prediction.cols=%d, prediction.rows=%d", newIdToIndexMap.size(), prediction.cols, prediction.rows);
-	// copy not changed probabilities
-	int copied = 0;
-	for(unsigned int i=0; i<oldIds.size(); ++i)
+	int added = 0;
+	for(unsigned int i=0; i<addedIds.size(); ++i)
 	{
-		if(oldIds[i]>0 && removedIds.find(oldIds[i]) == removedIds.end() && idsToUpdate.find(oldIds[i]) == idsToUpdate.end())
+		std::map<int, int> neighbors = memory->getNeighborsId(addedIds[i], _predictionLC.size()-1, 0);
+		PredictionColumn & column = prediction.columns[addedIds[i]];
+		column = PredictionColumn();
+		column.stamp = prediction.stamp;
+		float sum = this->addNeighborProb(column, neighbors, newIds);
+		this->normalize(column, addedIds[i], newIds, sum, newIds[0]<0);
+		++added;
+		for(std::map<int,int>::iterator iter=neighbors.begin(); iter!=neighbors.end(); ++iter)
 		{
-			for(int j=0; j<oldPrediction.cols; ++j)
+			if(std::binary_search(oldIds.begin(), oldIds.end(), iter->first) &&
+			   removedIds.find(iter->first) == removedIds.end())
 			{
-				if(removedIds.find(oldIds[j]) == removedIds.end() && ((const float *)oldPrediction.data)[i + j*oldPrediction.cols] != 0.0f)
-				{
-					//UDEBUG("i=%d, j=%d", i, j);
-					//UDEBUG("oldIds[i]=%d, oldIds[j]=%d", oldIds[i], oldIds[j]);
-					//UDEBUG("newIdToIndexMap.at(oldIds[i])=%d", newIdToIndexMap.at(oldIds[i]));
-					//UDEBUG("newIdToIndexMap.at(oldIds[j])=%d", newIdToIndexMap.at(oldIds[j]));
-					((float *)prediction.data)[newIdToIndexMap.at(oldIds[i]) + newIdToIndexMap.at(oldIds[j])*prediction.cols] = ((const float *)oldPrediction.data)[i + j*oldPrediction.cols];
-				}
+				idsToUpdate.insert(iter->first);
 			}
-			++copied;
 		}
 	}
-	UDEBUG("time copying = %fs", timer.restart());
+	UDEBUG("time adding ids = %fs", timer.restart());
+
+	// update modified ids
+	int modified = 0;
+	for(std::set<int>::iterator iter = idsToUpdate.begin(); iter!=idsToUpdate.end(); ++iter)
+	{
+		std::map<int, int> neighbors = memory->getNeighborsId(*iter, _predictionLC.size()-1, 0);
+		PredictionColumn & column = prediction.columns[*iter];
+		column = PredictionColumn();
+		column.stamp = prediction.stamp;
+		float sum = this->addNeighborProb(column, neighbors, newIds);
+		this->normalize(column, *iter, newIds, sum, newIds[0]<0);
+		++modified;
+	}
+	UDEBUG("time updating modified ids = %fs", timer.restart());
 
 	//update virtual place
 	if(newIds[0] < 0)
 	{
-		if(prediction.cols>1) // The first must be the virtual place
-		{
-			((float*)prediction.data)[0] = _virtualPlacePrior;
-			float val = (1.0-_virtualPlacePrior)/(prediction.cols-1);
-			for(int j=1; j<prediction.cols; j++)
-			{
-				((float*)prediction.data)[j*prediction.cols] = val;
-			}
-		}
-		else if(prediction.cols>0)
-		{
-			((float*)prediction.data)[0] = 1;
-		}
+		PredictionColumn & column = prediction.columns[newIds[0]];
+		column.stamp = prediction.stamp;
+		this->setVirtualPlaceColumn(column, newIds[0], (int)newIds.size(), false);
 	}
 	UDEBUG("time updating virtual place = %fs", timer.restart());
 
+	int copied = (int)oldIds.size() - (int)removedIds.size() - modified - (oldIds[0]<0 && newIds[0]<0?1:0);
 	UDEBUG("Modified=%d, Added=%d, Copied=%d", modified, added, copied);
-	return prediction;
 }
 
 void BayesFilter::updatePosterior(const Memory * memory, const std::vector<int> & likelihoodIds)
@@ -575,24 +605,115 @@ void BayesFilter::updatePosterior(const Memory * memory, const std::vector<int>
 	_posterior = newPosterior;
 }
 
-float BayesFilter::addNeighborProb(cv::Mat & prediction, unsigned int col, const std::map<int, int> & neighbors, const std::map<int, int> & idToIndexMap) const
+float BayesFilter::addNeighborProb(PredictionColumn & column, const std::map<int, int> & neighbors, const std::vector<int> & ids) const
 {
-	UASSERT((unsigned int)prediction.cols == idToIndexMap.size() &&
-			(unsigned int)prediction.rows == idToIndexMap.size() &&
-			col < (unsigned int)prediction.cols &&
-			col < (unsigned int)prediction.rows);
-
 	float sum=0;
 	for(std::map<int, int>::const_iterator iter=neighbors.begin(); iter!=neighbors.end(); ++iter)
 	{
-		int index = uValue(idToIndexMap, iter->first, -1);
-		if(index >= 0)
+		if(std::binary_search(ids.begin(), ids.end(), iter->first))
 		{
-			sum += ((float*)prediction.data)[col + index*prediction.cols] = _predictionLC[iter->second+1];
+			float & value = predictionEntry(column.entries, iter->first, 0.0f);
+			value = _predictionLC[iter->second+1];
+			sum += value;
 		}
 	}
 	return sum;
 }
 
+void BayesFilter::multiply(const Prediction & prediction, const std::vector<int> & ids, const std::vector<float> & posterior, std::vector<float> & prior) const
+{
+	UASSERT(ids.size() == posterior.size() && ids.size() == prediction.rowStamps.size());
+
+	// prior = prediction * posterior
+	std::vector<double> values(ids.size(), 0.0);
+	std::map<int, double> backgroundByStamp; // <column stamp, sum of background*posterior>
+	for(unsigned int i=0; i<ids.size(); ++i)
+	{
+		std::map<int, PredictionColumn>::const_iterator iter = prediction.columns.find(ids[i]);
+		if(iter == prediction.columns.end() || posterior[i] == 0.0f)
+		{
+			continue;
+		}
+		const PredictionColumn & column = iter->second;
+		if(column.background != 0.0f)
+		{
+			backgroundByStamp[column.stamp] += double(column.background) * double(posterior[i]);
+		}
+		for(PredictionEntries::const_iterator jter=column.entries.begin(); jter!=column.entries.end(); ++jter)
+		{
+			std::vector<int>::const_iterator row = std::lower_bound(ids.begin(), ids.end(), jter->first);
+			if(row != ids.end() && *row == jter->first)
+			{
+				// the entry replaces the background of the row
+				float background = 0.0f;
+				if(jter->first > 0 && column.background != 0.0f && prediction.rowStamps.at(jter->first) <= column.stamp)
+				{
+					background = column.background;
+				}
+				values[row - ids.begin()] += double(jter->second - background) * double(posterior[i]);
+			}
+		}
+	}
+
+	// The background of a column is on the rows added before or with the column
+	std::vector<int> stamps(backgroundByStamp.size());
+	std::vector<double> sums(backgroundByStamp.size());
+	int k = (int)backgroundByStamp.size();
+	double sum = 0.0;
+	for(std::map<int, double>::reverse_iterator iter=backgroundByStamp.rbegin(); iter!=backgroundByStamp.rend(); ++iter)
+	{
+		sum += iter->second;
+		--k;
+		stamps[k] = iter->first;
+		sums[k] = sum;
+	}
+
+	prior.resize(ids.size());
+	for(unsigned int i=0; i<ids.size(); ++i)
+	{
+		if(ids[i] > 0 && stamps.size())
+		{
+			std::vector<int>::iterator iter = std::lower_bound(stamps.begin(), stamps.end(), prediction.rowStamps.at(ids[i]));
+			if(iter != stamps.end())
+			{
+				values[i] += sums[iter - stamps.begin()];
+			}
+		}
+		prior[i] = float(values[i]);
+	}
+}
+
+cv::Mat BayesFilter::toDense(const Prediction & prediction, const std::vector<int> & ids) const
+{
+	cv::Mat dense = cv::Mat::zeros(ids.size(), ids.size(), CV_32FC1);
+	for(unsigned int i=0; i<ids.size(); ++i)
+	{
+		std::map<int, PredictionColumn>::const_iterator iter = prediction.columns.find(ids[i]);
+		if(iter != prediction.columns.end())
+		{
+			const PredictionColumn & column = iter->second;
+			if(column.background != 0.0f)
+			{
+				for(unsigned int j=0; j<ids.size(); ++j)
+				{
+					if(ids[j] > 0 && prediction.rowStamps.at(ids[j]) <= column.stamp)
+					{
+						dense.at<float>(j, i) = column.background;
+					}
+				}
+			}
+			for(PredictionEntries::const_iterator jter=column.entries.begin(); jter!=column.entries.end(); ++jter)
+			{
+				std::vector<int>::const_iterator row = std::lower_bound(ids.begin(), ids.end(), jter->first);
+				if(row != ids.end() && *row == jter->first)
+				{
+					dense.at<float>(row - ids.begin(), i) = jter->second;
+				}
+			}
+		}
+	}
+	return dense;
+}
+
 
 } // namespace rtabmap
@@ -59,23 +59,48 @@ public:
 	const std::vector<double> & getPredictionLC() const; // {Vp, Lc, l1, l2, l3, l4...}
 	std::string getPredictionLCStr() const; // for convenience {Vp, Lc, l1, l2, l3, l4...}
 
-	cv::Mat generatePrediction(const Memory * memory, const std::vector<int> & ids) const;
+	cv::Mat generatePrediction(const Memory * memory, const std::vector<int> & ids) const; // dense (ids x ids)
 
 private:
-	cv::Mat updatePrediction(const cv::Mat & oldPrediction,
+	/**
+	 * Column of the prediction matrix (probabilities from one place). Only
+	 * the neighbors, the loop closure and the virtual place have their own value,
+	 * all other rows have the same small value ("background"). Rows added to the
+	 * prediction after the column has been computed are null.
+	 */
+	struct PredictionColumn
+	{
+		PredictionColumn() : background(0.0f), stamp(0) {}
+		std::vector<std::pair<int, float> > entries; // <row id, probability>, sorted by id
+		float background; // value of the rows (ids > 0) not in entries
+		int stamp; // update when the column has been computed
+	};
+	struct Prediction
+	{
+		Prediction() : stamp(0) {}
+		std::map<int, PredictionColumn> columns; // <column id, column>, null columns are not set
+		std::map<int, int> rowStamps; // <row id, update when the row has been added>
+		int stamp; // last update
+		bool empty() const {return rowStamps.empty();}
+	};
+
+	void generatePrediction(Prediction & prediction, const Memory * memory, const std::vector<int> & ids) const;
+	void updatePrediction(Prediction & prediction,
 			const Memory * memory,
 			const std::vector<int> & oldIds,
 			const std::vector<int> & newIds) const;
 	void updatePosterior(const Memory * memory, const std::vector<int> & likelihoodIds);
-	float addNeighborProb(cv::Mat & prediction,
-			unsigned int col,
+	float addNeighborProb(PredictionColumn & column,
 			const std::map<int, int> & neighbors,
-			const std::map<int, int> & idToIndexMap) const;
-	void normalize(cv::Mat & prediction, unsigned int index, float addedProbabilitiesSum, bool virtualPlaceUsed) const;
+			const std::vector<int> & ids) const;
+	void normalize(PredictionColumn & column, int id, const std::vector<int> & ids, float addedProbabilitiesSum, bool virtualPlaceUsed) const;
+	void setVirtualPlaceColumn(PredictionColumn & column, int id, int rows, bool uniformIfNoPrior) const;
+	void multiply(const Prediction & prediction, const std::vector<int> & ids, const std::vector<float> & posterior, std::vector<float> & prior) const;
+	cv::Mat toDense(const Prediction & prediction, const std::vector<int> & ids) const;
 
 private:
 	std::map<int, float> _posterior;
-	cv::Mat _prediction;
+	Prediction _prediction;
 	float _virtualPlacePrior;
 	std::vector<double> _predictionLC; // {Vp, Lc, l1, l2, l3, l4...}
 	bool _fullPredictionUpdate;
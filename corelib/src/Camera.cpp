@@ -175,8 +175,9 @@ cv::Mat Camera::takeImage()
 	img = this->captureImage();
 	if(!img.empty() && !_k.empty() && !_d.empty())
 	{
-		cv::Mat temp = img.clone();
-		cv::undistort(temp, img, _k, _d);
+		cv::Mat undistorted = _framePool.acquire(img.rows, img.cols, img.type());
+		cv::undistort(img, undistorted, _k, _d);
+		img = undistorted;
 	}
 	if(!img.empty() && _mirroring)
 	{
@@ -419,14 +420,14 @@ cv::Mat CameraVideo::captureImage()
 			   w != (unsigned int)img.cols &&
 			   h != (unsigned int)img.rows)
 			{
-				cv::Mat resampled;
+				cv::Mat resampled = this->framePool().acquire(h, w, img.type());
 				cv::resize(img, resampled, cv::Size(w, h));
 				img = resampled;
 			}
 			else
 			{
-				// clone required
-				img = img.clone();
+				// copy required, the capture reuses its buffer
+				img = this->framePool().copy(img);
 			}
 		}
 		else if(_usbDevice)
@@ -378,8 +378,8 @@ void CameraOpenNICV::captureImage(cv::Mat & rgb, cv::Mat & depth, float & fx, fl
 		_capture.retrieve( depth, CV_CAP_OPENNI_DEPTH_MAP );
 		_capture.retrieve( rgb, CV_CAP_OPENNI_BGR_IMAGE );
 
-		depth = depth.clone();
-		rgb = rgb.clone();
+		depth = this->framePool().copy(depth);
+		rgb = this->framePool().copy(rgb);
 		UASSERT(_depthFocal > 0.0f);
 		fx = _depthFocal;
 		fy = _depthFocal;
@@ -744,11 +744,12 @@ void CameraOpenNI2::captureImage(cv::Mat & rgb, cv::Mat & depth, float & fx, flo
 			{
 				int h=depthFrame.getHeight();
 				int w=depthFrame.getWidth();
-				depth = cv::Mat(h, w, CV_16U, (void*)depthFrame.getData()).clone();
+				depth = this->framePool().copy(cv::Mat(h, w, CV_16U, (void*)depthFrame.getData()));
 
 				h=colorFrame.getHeight();
 				w=colorFrame.getWidth();
 				cv::Mat tmp(h, w, CV_8UC3, (void *)colorFrame.getData());
+				rgb = this->framePool().acquire(h, w, CV_8UC3);
 				cv::cvtColor(tmp, rgb, CV_RGB2BGR);
 			}
 			UASSERT(_depthFx != 0.0f && _depthFy != 0.0f);
@@ -39,6 +39,10 @@ namespace rtabmap {
 
 DBDriver::DBDriver(const ParametersMap & parameters) :
 	_emptyTrashesTime(0),
+	_emptyTrashesLatency(0),
+	_emptyTrashesRequestStamp(0),
+	_trashQueueSize(0),
+	_trashMaxSize(Parameters::defaultDbTrashMaxSize()),
 	_timestampUpdate(true)
 {
 	this->parseParameters(parameters);
@@ -52,6 +56,7 @@ DBDriver::~DBDriver()
 
 void DBDriver::parseParameters(const ParametersMap & parameters)
 {
+	Parameters::parse(parameters, Parameters::kDbTrashMaxSize(), _trashMaxSize);
 }
 
 void DBDriver::closeConnection()
@@ -60,9 +65,11 @@ void DBDriver::closeConnection()
 	this->join(true);
 	UDEBUG("");
 	this->emptyTrashes();
+	_savingMutex.lock();
 	_dbSafeAccessMutex.lock();
 	this->disconnectDatabaseQuery();
 	_dbSafeAccessMutex.unlock();
+	_savingMutex.unlock();
 	UDEBUG("");
 }
 
@@ -101,21 +108,29 @@ long DBDriver::getMemoryUsed() const
 
 void DBDriver::mainLoop()
 {
-	this->emptyTrashes();
-	this->kill(); // Do it only once
+	_addSem.acquire();
+	if(!this->isKilled())
+	{
+		this->emptyTrashes();
+	}
+}
+
+void DBDriver::mainLoopKill()
+{
+	_addSem.release();
 }
 
 void DBDriver::beginTransaction() const
 {
 	_transactionMutex.lock();
 	ULOGGER_DEBUG("");
-	this->executeNoResultQuery("BEGIN TRANSACTION;");
+	this->beginTransactionQuery();
 }
 
 void DBDriver::commit() const
 {
 	ULOGGER_DEBUG("");
-	this->executeNoResultQuery("COMMIT;");
+	this->commitQuery();
 	_transactionMutex.unlock();
 }
 
@@ -130,27 +145,53 @@ void DBDriver::emptyTrashes(bool async)
 {
 	if(async)
 	{
-		ULOGGER_DEBUG("Async emptying, start the trash thread");
-		this->start();
+		ULOGGER_DEBUG("Async emptying, wake up the trash thread");
+		_trashesMutex.lock();
+		{
+			_trashQueueSize = int(_trashSignatures.size() + _trashVisualWords.size());
+			if(_emptyTrashesRequestStamp == 0.0)
+			{
+				_emptyTrashesRequestStamp = UTimer::now();
+			}
+			_emptyTrashesTime = 0;
+		}
+		_trashesMutex.unlock();
+		if(!this->isRunning())
+		{
+			this->start();
+		}
+		_addSem.release();
 		return;
 	}
 
+	// Only one thread saves the trash at the same time, wait the one saving
+	_savingMutex.lock();
+
 	UTimer totalTime;
 	totalTime.start();
 
-	std::map<int, Signature*> signatures;
-	std::map<int, VisualWord*> visualWords;
+	// The signatures and words stay in the trash (so they can be read) until they are saved
+	std::vector<Signature*> signatures;
+	std::vector<VisualWord*> visualWords;
+	double requestStamp = 0.0;
 	_trashesMutex.lock();
 	{
 		ULOGGER_DEBUG("signatures=%d, visualWords=%d", _trashSignatures.size(), _trashVisualWords.size());
-		signatures = _trashSignatures;
-		visualWords = _trashVisualWords;
-		_trashSignatures.clear();
-		_trashVisualWords.clear();
+		signatures = uValues(_trashSignatures);
+		visualWords = uValues(_trashVisualWords);
+		_savingSignatures = uKeysSet(_trashSignatures);
+		_savingVisualWords = uKeysSet(_trashVisualWords);
+		requestStamp = _emptyTrashesRequestStamp;
+		_emptyTrashesRequestStamp = 0.0;
+	}
+	_trashesMutex.unlock();
 
+	// Without a writer connection, the other queries wait until the trash is saved
+	bool writerConnection = this->isConnected() && this->hasWriterConnectionQuery();
+	if(!writerConnection)
+	{
 		_dbSafeAccessMutex.lock();
 	}
-	_trashesMutex.unlock();
 
 	if(signatures.size() || visualWords.size())
 	{
@@ -162,14 +203,8 @@ void DBDriver::emptyTrashes(bool async)
 			if(this->isConnected())
 			{
 				//Only one query to the database
-				this->saveOrUpdate(uValues(signatures));
-			}
-
-			for(std::map<int, Signature *>::iterator iter=signatures.begin(); iter!=signatures.end(); ++iter)
-			{
-				delete iter->second;
+				this->saveOrUpdate(signatures);
 			}
-			signatures.clear();
 			ULOGGER_DEBUG("Time emptying memory signatures trash = %f...", timer.ticks());
 		}
 		if(visualWords.size())
@@ -177,24 +212,55 @@ void DBDriver::emptyTrashes(bool async)
 			if(this->isConnected())
 			{
 				//Only one query to the database
-				this->saveOrUpdate(uValues(visualWords));
-			}
-
-			for(std::map<int, VisualWord *>::iterator iter=visualWords.begin(); iter!=visualWords.end(); ++iter)
-			{
-				delete (*iter).second;
+				this->saveOrUpdate(visualWords);
 			}
-			visualWords.clear();
 			ULOGGER_DEBUG("Time emptying memory visualWords trash = %f...", timer.ticks());
 		}
 
 		this->commit();
 	}
 
-	_emptyTrashesTime = totalTime.ticks();
-	ULOGGER_DEBUG("Total time emptying trashes = %fs...", _emptyTrashesTime);
+	if(!writerConnection)
+	{
+		_dbSafeAccessMutex.unlock();
+	}
 
-	_dbSafeAccessMutex.unlock();
+	// Saved, remove them from the trash
+	_trashesMutex.lock();
+	{
+		for(unsigned int i=0; i<signatures.size(); ++i)
+		{
+			_trashSignatures.erase(signatures[i]->id());
+		}
+		for(unsigned int i=0; i<visualWords.size(); ++i)
+		{
+			_trashVisualWords.erase(visualWords[i]->id());
+		}
+		_savingSignatures.clear();
+		_savingVisualWords.clear();
+		if(requestStamp > 0.0)
+		{
+			_emptyTrashesLatency = UTimer::now() - requestStamp;
+		}
+		if(signatures.size() || visualWords.size())
+		{
+			_emptyTrashesTime += totalTime.elapsed();
+		}
+	}
+	_trashesMutex.unlock();
+
+	for(unsigned int i=0; i<signatures.size(); ++i)
+	{
+		delete signatures[i];
+	}
+	for(unsigned int i=0; i<visualWords.size(); ++i)
+	{
+		delete visualWords[i];
+	}
+
+	ULOGGER_DEBUG("Total time emptying trashes = %fs...", totalTime.ticks());
+
+	_savingMutex.unlock();
 }
 
 void DBDriver::asyncSave(Signature * s)
@@ -202,11 +268,20 @@ void DBDriver::asyncSave(Signature * s)
 	if(s)
 	{
 		UDEBUG("s=%d", s->id());
+		bool full = false;
 		_trashesMutex.lock();
 		{
 			_trashSignatures.insert(std::pair<int, Signature*>(s->id(), s));
+			full = _trashMaxSize > 0 && _trashSignatures.size() >= _trashMaxSize;
 		}
 		_trashesMutex.unlock();
+
+		if(full)
+		{
+			// back-pressure: save the trash in this thread
+			UDEBUG("Trash is full (%d signatures), saving it...", (int)_trashMaxSize);
+			this->emptyTrashes();
+		}
 	}
 }
 
@@ -305,11 +380,19 @@ void DBDriver::loadSignatures(const std::list<int> & signIds,
 	std::list<int> ids = signIds;
 	std::list<Signature*>::iterator sIter;
 	bool valueFound = false;
+	bool saving = false;
 	_trashesMutex.lock();
 	{
 		for(std::list<int>::iterator iter = ids.begin(); iter != ids.end();)
 		{
 			valueFound = false;
+			if(_savingSignatures.find(*iter) != _savingSignatures.end())
+			{
+				// being saved, it will be loaded from the database
+				saving = true;
+				++iter;
+				continue;
+			}
 			for(std::map<int, Signature*>::iterator sIter = _trashSignatures.begin(); sIter!=_trashSignatures.end();)
 			{
 				if(sIter->first == *iter)
@@ -341,6 +424,39 @@ void DBDriver::loadSignatures(const std::list<int> & signIds,
 	}
 	_trashesMutex.unlock();
 	UDEBUG("");
+	if(saving)
+	{
+		// wait until they are saved
+		_savingMutex.lock();
+		_savingMutex.unlock();
+	}
+	if(ids.size())
+	{
+		_dbSafeAccessMutex.lock();
+		this->loadSignaturesQuery(ids, signatures);
+		_dbSafeAccessMutex.unlock();
+	}
+}
+
+// Signatures in the trash (or being saved) are ignored, they are left to
+// loadSignatures(). Used by background threads, the trash can be read by
+// the other threads while they are loading.
+void DBDriver::loadSignaturesNotInTrash(const std::list<int> & signIds,
+		std::list<Signature *> & signatures) const
+{
+	UDEBUG("");
+	std::list<int> ids;
+	_trashesMutex.lock();
+	{
+		for(std::list<int>::const_iterator iter = signIds.begin(); iter != signIds.end(); ++iter)
+		{
+			if(_trashSignatures.find(*iter) == _trashSignatures.end())
+			{
+				ids.push_back(*iter);
+			}
+		}
+	}
+	_trashesMutex.unlock();
 	if(ids.size())
 	{
 		_dbSafeAccessMutex.lock();
@@ -355,6 +471,7 @@ void DBDriver::loadWords(const std::set<int> & wordIds, std::list<VisualWord *>
 	std::set<int> ids = wordIds;
 	std::map<int, VisualWord*>::iterator wIter;
 	std::list<VisualWord *> puttedBack;
+	bool saving = false;
 	_trashesMutex.lock();
 	{
 		if(_trashVisualWords.size())
@@ -362,7 +479,13 @@ void DBDriver::loadWords(const std::set<int> & wordIds, std::list<VisualWord *>
 			for(std::set<int>::iterator iter = ids.begin(); iter != ids.end();)
 			{
 				wIter = _trashVisualWords.find(*iter);
-				if(wIter != _trashVisualWords.end())
+				if(wIter != _trashVisualWords.end() && _savingVisualWords.find(*iter) != _savingVisualWords.end())
+				{
+					// being saved, it will be loaded from the database
+					saving = true;
+					++iter;
+				}
+				else if(wIter != _trashVisualWords.end())
 				{
 					UDEBUG("put back word %d from trash", *iter);
 					puttedBack.push_back(wIter->second);
@@ -377,6 +500,12 @@ void DBDriver::loadWords(const std::set<int> & wordIds, std::list<VisualWord *>
 		}
 	}
 	_trashesMutex.unlock();
+	if(saving)
+	{
+		// wait until they are saved
+		_savingMutex.lock();
+		_savingMutex.unlock();
+	}
 	if(ids.size())
 	{
 		_dbSafeAccessMutex.lock();
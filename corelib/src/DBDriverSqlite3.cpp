@@ -38,9 +38,33 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace rtabmap {
 
+// Rows inserted by a multi-row INSERT: the bound parameters
+// (rows x columns) must stay under SQLITE_MAX_VARIABLE_NUMBER (999).
+static const int kInsertBatchRows = 64;
+
+// Time (ms) a connection waits for the other one holding a lock (WAL mode)
+static const int kBusyTimeout = 60000;
+
+static std::string multiRowValues(int columns, int rows)
+{
+	std::string values = "(?";
+	for(int i=1; i<columns; ++i)
+	{
+		values += ",?";
+	}
+	values += ")";
+	std::string query = values;
+	for(int i=1; i<rows; ++i)
+	{
+		query += "," + values;
+	}
+	return query;
+}
+
 DBDriverSqlite3::DBDriverSqlite3(const ParametersMap & parameters) :
 	DBDriver(parameters),
 	_ppDb(0),
+	_ppDbWriter(0),
 	_version("0.0.0"),
 	_dbInMemory(Parameters::defaultDbSqlite3InMemory()),
 	_cacheSize(Parameters::defaultDbSqlite3CacheSize()),
@@ -90,19 +114,32 @@ void DBDriverSqlite3::setCacheSize(unsigned int cacheSize)
 		_cacheSize = cacheSize;
 		std::string query = "PRAGMA cache_size = ";
 		query += uNumber2Str(_cacheSize) + ";";
-		this->executeNoResultQuery(query.c_str());
+		this->executePragma(query.c_str());
 	}
 }
 
 void DBDriverSqlite3::setJournalMode(int journalMode)
 {
-	if(journalMode >= 0 && journalMode < 5)
+	if(journalMode >= 0 && journalMode < 6)
 	{
+		if(this->isConnected() && !_dbInMemory && (journalMode == 5) != (_journalMode == 5))
+		{
+			// Hard reset to open or close the writer connection...
+			join(true);
+			this->emptyTrashes();
+			this->closeConnection();
+			_journalMode = journalMode;
+			this->openConnection(this->getUrl());
+			return;
+		}
 		_journalMode = journalMode;
 		if(this->isConnected())
 		{
 			switch(_journalMode)
 			{
+			case 5:
+				this->executeNoResultQuery("PRAGMA journal_mode = WAL;");
+				break;
 			case 4:
 				this->executeNoResultQuery("PRAGMA journal_mode = OFF;");
 				break;
@@ -138,14 +175,14 @@ void DBDriverSqlite3::setSynchronous(int synchronous)
 			switch(_synchronous)
 			{
 			case 0:
-				this->executeNoResultQuery("PRAGMA synchronous = OFF;");
+				this->executePragma("PRAGMA synchronous = OFF;");
 				break;
 			case 1:
-				this->executeNoResultQuery("PRAGMA synchronous = NORMAL;");
+				this->executePragma("PRAGMA synchronous = NORMAL;");
 				break;
 			case 2:
 			default:
-				this->executeNoResultQuery("PRAGMA synchronous = FULL;");
+				this->executePragma("PRAGMA synchronous = FULL;");
 				break;
 			}
 		}
@@ -166,14 +203,14 @@ void DBDriverSqlite3::setTempStore(int tempStore)
 			switch(_tempStore)
 			{
 			case 2:
-				this->executeNoResultQuery("PRAGMA temp_store = MEMORY;");
+				this->executePragma("PRAGMA temp_store = MEMORY;");
 				break;
 			case 1:
-				this->executeNoResultQuery("PRAGMA temp_store = FILE;");
+				this->executePragma("PRAGMA temp_store = FILE;");
 				break;
 			case 0:
 			default:
-				this->executeNoResultQuery("PRAGMA temp_store = DEFAULT;");
+				this->executePragma("PRAGMA temp_store = DEFAULT;");
 				break;
 			}
 		}
@@ -373,8 +410,29 @@ bool DBDriverSqlite3::connectDatabaseQuery(const std::string & url, bool overwri
 	UINFO("Database version = %s", _version.c_str());
 
 	//Set database optimizations
-	this->setCacheSize(_cacheSize); // this will call the SQL
 	this->setJournalMode(_journalMode); // this will call the SQL
+
+	_ppDbWriter = _ppDb;
+	if(!_dbInMemory && _journalMode == 5)
+	{
+		// In WAL mode, the trash is saved with its own connection
+		// while the other queries are done on the main connection.
+		sqlite3 * ppDbWriter = 0;
+		rc = sqlite3_open_v2(url.c_str(), &ppDbWriter, SQLITE_OPEN_READWRITE, 0);
+		if(rc == SQLITE_OK)
+		{
+			_ppDbWriter = ppDbWriter;
+			sqlite3_busy_timeout(_ppDb, kBusyTimeout);
+			sqlite3_busy_timeout(_ppDbWriter, kBusyTimeout);
+		}
+		else
+		{
+			UERROR("DB error : %s (path=\"%s\"), the trash will be saved on the main connection", sqlite3_errmsg(ppDbWriter), url.c_str());
+			sqlite3_close(ppDbWriter);
+		}
+	}
+
+	this->setCacheSize(_cacheSize); // this will call the SQL
 	this->setSynchronous(_synchronous); // this will call the SQL
 	this->setTempStore(_tempStore); // this will call the SQL
 
@@ -396,6 +454,22 @@ void DBDriverSqlite3::disconnectDatabaseQuery()
 				UERROR("");
 			}
 		}
+		_statements.clear(); // finalized above
+
+		if(_ppDbWriter != _ppDb)
+		{
+			while( (pStmt = sqlite3_next_stmt(_ppDbWriter, 0))!=0 )
+			{
+				rc = sqlite3_finalize(pStmt);
+				if(rc != SQLITE_OK)
+				{
+					UERROR("");
+				}
+			}
+			sqlite3_close(_ppDbWriter);
+		}
+		_ppDbWriter = 0;
+		_writerStatements.clear(); // finalized above
 
 		if(_dbInMemory)
 		{
@@ -419,6 +493,63 @@ bool DBDriverSqlite3::isConnectedQuery() const
 	return _ppDb != 0;
 }
 
+sqlite3_stmt * DBDriverSqlite3::prepareStatement(const std::string & query, bool writer) const
+{
+	sqlite3 * ppDb = writer?_ppDbWriter:_ppDb;
+	std::map<std::string, sqlite3_stmt *> & statements = writer?_writerStatements:_statements;
+	UASSERT(ppDb != 0);
+	int rc = SQLITE_OK;
+	sqlite3_stmt * ppStmt = 0;
+	std::map<std::string, sqlite3_stmt *>::iterator iter = statements.find(query);
+	if(iter != statements.end())
+	{
+		// The statement has been reset after its last use
+		ppStmt = iter->second;
+		rc = sqlite3_clear_bindings(ppStmt);
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(ppDb)).c_str());
+	}
+	else
+	{
+		rc = sqlite3_prepare_v2(ppDb, query.c_str(), -1, &ppStmt, 0);
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s, the query is %s", sqlite3_errmsg(ppDb), query.c_str()).c_str());
+		statements.insert(std::make_pair(query, ppStmt));
+	}
+	return ppStmt;
+}
+
+void DBDriverSqlite3::executePragma(const std::string & sql) const
+{
+	this->executeNoResultQuery(sql);
+	if(_ppDbWriter && _ppDbWriter != _ppDb)
+	{
+		int rc = sqlite3_exec(_ppDbWriter, sql.c_str(), 0, 0, 0);
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s, the query is %s", sqlite3_errmsg(_ppDbWriter), sql.c_str()).c_str());
+	}
+}
+
+bool DBDriverSqlite3::hasWriterConnectionQuery() const
+{
+	return _ppDbWriter != 0 && _ppDbWriter != _ppDb;
+}
+
+void DBDriverSqlite3::beginTransactionQuery() const
+{
+	if(_ppDbWriter)
+	{
+		int rc = sqlite3_exec(_ppDbWriter, "BEGIN TRANSACTION;", 0, 0, 0);
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
+	}
+}
+
+void DBDriverSqlite3::commitQuery() const
+{
+	if(_ppDbWriter)
+	{
+		int rc = sqlite3_exec(_ppDbWriter, "COMMIT;", 0, 0, 0);
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
+	}
+}
+
 // In bytes
 void DBDriverSqlite3::executeNoResultQuery(const std::string & sql) const
 {
@@ -487,8 +618,7 @@ void DBDriverSqlite3::loadNodeDataQuery(std::list<Signature *> & signatures, boo
 				  <<";";
 		}
 
-		rc = sqlite3_prepare_v2(_ppDb, query.str().c_str(), -1, &ppStmt, 0);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		ppStmt = this->prepareStatement(query.str());
 
 		const void * data = 0;
 		int dataSize = 0;
@@ -572,8 +702,8 @@ void DBDriverSqlite3::loadNodeDataQuery(std::list<Signature *> & signatures, boo
 			UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 		}
 
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 		ULOGGER_DEBUG("Time=%fs", timer.ticks());
 	}
@@ -605,7 +735,7 @@ void DBDriverSqlite3::getNodeDataQuery(
 				  << "FROM Image "
 				  << "LEFT OUTER JOIN Depth " // returns all images even if there are no metric data
 				  << "ON Image.id = Depth.id "
-				  << "WHERE Image.id = " << signatureId
+				  << "WHERE Image.id = ?"
 				  <<";";
 		}
 		else
@@ -615,11 +745,13 @@ void DBDriverSqlite3::getNodeDataQuery(
 				  << "FROM Image "
 				  << "LEFT OUTER JOIN Depth " // returns all images even if there are no metric data
 				  << "ON Image.id = Depth.id "
-				  << "WHERE Image.id = " << signatureId
+				  << "WHERE Image.id = ?"
 				  <<";";
 		}
 
-		rc = sqlite3_prepare_v2(_ppDb, query.str().c_str(), -1, &ppStmt, 0);
+		ppStmt = this->prepareStatement(query.str());
+
+		rc = sqlite3_bind_int(ppStmt, 1, signatureId);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 
 		const void * data = 0;
@@ -693,8 +825,8 @@ void DBDriverSqlite3::getNodeDataQuery(
 		UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 
 
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 		ULOGGER_DEBUG("Time=%fs", timer.ticks());
 	}
@@ -712,10 +844,12 @@ void DBDriverSqlite3::getNodeDataQuery(int signatureId, cv::Mat & imageCompresse
 
 		query << "SELECT data "
 			  << "FROM Image "
-			  << "WHERE id = " << signatureId
+			  << "WHERE id = ?"
 			  <<";";
 
-		rc = sqlite3_prepare_v2(_ppDb, query.str().c_str(), -1, &ppStmt, 0);
+		ppStmt = this->prepareStatement(query.str());
+
+		rc = sqlite3_bind_int(ppStmt, 1, signatureId);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 
 		const void * data = 0;
@@ -744,8 +878,8 @@ void DBDriverSqlite3::getNodeDataQuery(int signatureId, cv::Mat & imageCompresse
 		UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 
 
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 		ULOGGER_DEBUG("Time=%fs", timer.ticks());
 	}
@@ -771,25 +905,24 @@ bool DBDriverSqlite3::getNodeInfoQuery(int signatureId,
 		{
 			query << "SELECT pose, map_id, weight, label, stamp, user_data "
 					 "FROM Node "
-					 "WHERE id = " << signatureId <<
-					 ";";
+					 "WHERE id = ?;";
 		}
 		else if(uStrNumCmp(_version, "0.8.5") >= 0)
 		{
 			query << "SELECT pose, map_id, weight, label, stamp "
 					 "FROM Node "
-					 "WHERE id = " << signatureId <<
-					 ";";
+					 "WHERE id = ?;";
 		}
 		else
 		{
 			query << "SELECT pose, map_id, weight "
 					 "FROM Node "
-					 "WHERE id = " << signatureId <<
-					 ";";
+					 "WHERE id = ?;";
 		}
 
-		rc = sqlite3_prepare_v2(_ppDb, query.str().c_str(), -1, &ppStmt, 0);
+		ppStmt = this->prepareStatement(query.str());
+
+		rc = sqlite3_bind_int(ppStmt, 1, signatureId);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 
 		const void * data = 0;
@@ -837,8 +970,8 @@ bool DBDriverSqlite3::getNodeInfoQuery(int signatureId,
 		}
 		UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 	}
 	return found;
@@ -870,8 +1003,7 @@ void DBDriverSqlite3::getAllNodeIdsQuery(std::set<int> & ids, bool ignoreChildre
 				  << "ORDER BY id";
 		}
 
-		rc = sqlite3_prepare_v2(_ppDb, query.str().c_str(), -1, &ppStmt, 0);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		ppStmt = this->prepareStatement(query.str());
 
 
 		// Process the result if one
@@ -883,8 +1015,8 @@ void DBDriverSqlite3::getAllNodeIdsQuery(std::set<int> & ids, bool ignoreChildre
 		}
 		UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 		ULOGGER_DEBUG("Time=%f ids=%d", timer.ticks(), (int)ids.size());
 	}
@@ -905,8 +1037,7 @@ void DBDriverSqlite3::getLastIdQuery(const std::string & tableName, int & id) co
 			  << "FROM " << tableName
 			  << ";";
 
-		rc = sqlite3_prepare_v2(_ppDb, query.str().c_str(), -1, &ppStmt, 0);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		ppStmt = this->prepareStatement(query.str());
 
 
 		// Process the result if one
@@ -922,8 +1053,8 @@ void DBDriverSqlite3::getLastIdQuery(const std::string & tableName, int & id) co
 			ULOGGER_ERROR("No result !?! from the DB");
 		}
 
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 		ULOGGER_DEBUG("Time=%fs", timer.ticks());
 	}
@@ -943,13 +1074,11 @@ void DBDriverSqlite3::getInvertedIndexNiQuery(int nodeId, int & ni) const
 		// Create a new entry in table Signature
 		query << "SELECT count(word_id) "
 			  << "FROM Map_Node_Word "
-			  << "WHERE node_id=" << nodeId << ";";
-
-		//query.append("COMMIT;");
+			  << "WHERE node_id=?;";
 
-		//ULOGGER_DEBUG("DBDriverSqlite3::getSurfNi() Execute query : %s", query.toStdString().c_str());
+		ppStmt = this->prepareStatement(query.str());
 
-		rc = sqlite3_prepare_v2(_ppDb, query.str().c_str(), -1, &ppStmt, 0);
+		rc = sqlite3_bind_int(ppStmt, 1, nodeId);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 
 
@@ -967,8 +1096,8 @@ void DBDriverSqlite3::getInvertedIndexNiQuery(int nodeId, int & ni) const
 		}
 
 
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 		ULOGGER_DEBUG("Time=%fs", timer.ticks());
 	}
@@ -983,9 +1112,11 @@ void DBDriverSqlite3::getNodeIdByLabelQuery(const std::string & label, int & id)
 		int rc = SQLITE_OK;
 		sqlite3_stmt * ppStmt = 0;
 		std::stringstream query;
-		query << "SELECT id FROM Node WHERE label='" << label <<"'";
+		query << "SELECT id FROM Node WHERE label=?";
 
-		rc = sqlite3_prepare_v2(_ppDb, query.str().c_str(), -1, &ppStmt, 0);
+		ppStmt = this->prepareStatement(query.str());
+
+		rc = sqlite3_bind_text(ppStmt, 1, label.c_str(), -1, SQLITE_STATIC);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 
 		// Process the result if one
@@ -997,8 +1128,8 @@ void DBDriverSqlite3::getNodeIdByLabelQuery(const std::string & label, int & id)
 		}
 		UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 		ULOGGER_DEBUG("Time=%f", timer.ticks());
 	}
@@ -1015,8 +1146,7 @@ void DBDriverSqlite3::getAllLabelsQuery(std::map<int, std::string> & labels) con
 		std::stringstream query;
 		query << "SELECT id,label FROM Node WHERE label IS NOT NULL";
 
-		rc = sqlite3_prepare_v2(_ppDb, query.str().c_str(), -1, &ppStmt, 0);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		ppStmt = this->prepareStatement(query.str());
 
 		// Process the result if one
 		rc = sqlite3_step(ppStmt);
@@ -1037,8 +1167,8 @@ void DBDriverSqlite3::getAllLabelsQuery(std::map<int, std::string> & labels) con
 		}
 		UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 		ULOGGER_DEBUG("Time=%f", timer.ticks());
 	}
@@ -1055,11 +1185,11 @@ void DBDriverSqlite3::getWeightQuery(int nodeId, int & weight) const
 		sqlite3_stmt * ppStmt = 0;
 		std::stringstream query;
 
-		query << "SELECT weight FROM node WHERE id =  "
-			  << nodeId
-			  << ";";
+		query << "SELECT weight FROM node WHERE id = ?;";
 
-		rc = sqlite3_prepare_v2(_ppDb, query.str().c_str(), -1, &ppStmt, 0);
+		ppStmt = this->prepareStatement(query.str());
+
+		rc = sqlite3_bind_int(ppStmt, 1, nodeId);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 
 
@@ -1072,8 +1202,8 @@ void DBDriverSqlite3::getWeightQuery(int nodeId, int & weight) const
 		}
 		UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 	}
 }
@@ -1112,8 +1242,7 @@ void DBDriverSqlite3::loadSignaturesQuery(const std::list<int> & ids, std::list<
 				  << "WHERE id=?;";
 		}
 
-		rc = sqlite3_prepare_v2(_ppDb, query.str().c_str(), -1, &ppStmt, 0);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		ppStmt = this->prepareStatement(query.str());
 
 		for(std::list<int>::const_iterator iter=ids.begin(); iter!=ids.end(); ++iter)
 		{
@@ -1202,8 +1331,8 @@ void DBDriverSqlite3::loadSignaturesQuery(const std::list<int> & ids, std::list<
 			UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 		}
 
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 
 		ULOGGER_DEBUG("Time=%fs", timer.ticks());
@@ -1217,8 +1346,7 @@ void DBDriverSqlite3::loadSignaturesQuery(const std::list<int> & ids, std::list<
 		query2 << " ORDER BY word_id"; // Needed for fast insertion below
 		query2 << ";";
 
-		rc = sqlite3_prepare_v2(_ppDb, query2.str().c_str(), -1, &ppStmt, 0);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		ppStmt = this->prepareStatement(query2.str());
 
 		for(std::list<Signature*>::const_iterator iter=nodes.begin(); iter!=nodes.end(); ++iter)
 		{
@@ -1229,8 +1357,9 @@ void DBDriverSqlite3::loadSignaturesQuery(const std::list<int> & ids, std::list<
 
 			int visualWordId = 0;
 			cv::KeyPoint kpt;
-			std::multimap<int, cv::KeyPoint> visualWords;
-			std::multimap<int, pcl::PointXYZ> visualWords3;
+			std::vector<int> visualWordIds;
+			std::vector<cv::KeyPoint> visualWords;
+			std::vector<pcl::PointXYZ> visualWords3;
 			pcl::PointXYZ depth(0,0,0);
 
 			// Process the result if one
@@ -1247,8 +1376,9 @@ void DBDriverSqlite3::loadSignaturesQuery(const std::list<int> & ids, std::list<
 				depth.x = sqlite3_column_double(ppStmt, index++);
 				depth.y = sqlite3_column_double(ppStmt, index++);
 				depth.z = sqlite3_column_double(ppStmt, index++);
-				visualWords.insert(visualWords.end(), std::make_pair(visualWordId, kpt));
-				visualWords3.insert(visualWords3.end(), std::make_pair(visualWordId, depth));
+				visualWordIds.push_back(visualWordId);
+				visualWords.push_back(kpt);
+				visualWords3.push_back(depth);
 				rc = sqlite3_step(ppStmt);
 			}
 			UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
@@ -1259,9 +1389,14 @@ void DBDriverSqlite3::loadSignaturesQuery(const std::list<int> & ids, std::list<
 			}
 			else
 			{
-				(*iter)->setWords(visualWords);
-				(*iter)->setWords3(visualWords3);
-				ULOGGER_DEBUG("Add %d keypoints and %d 3d points to node %d", visualWords.size(), visualWords3.size(), (*iter)->id());
+				ULOGGER_DEBUG("Add %d keypoints and %d 3d points to node %d", (int)visualWords.size(), (int)visualWords3.size(), (*iter)->id());
+				std::vector<int> visualWordIds3 = visualWordIds;
+				FlatWords<cv::KeyPoint> words;
+				FlatWords<pcl::PointXYZ> words3;
+				words.assign(visualWordIds, visualWords); // already sorted by the query
+				words3.assign(visualWordIds3, visualWords3);
+				(*iter)->setWords(words);
+				(*iter)->setWords3(words3);
 			}
 
 			//reset
@@ -1269,8 +1404,8 @@ void DBDriverSqlite3::loadSignaturesQuery(const std::list<int> & ids, std::list<
 			UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 		}
 
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 
 		ULOGGER_DEBUG("Time=%fs", timer.ticks());
@@ -1307,8 +1442,7 @@ void DBDriverSqlite3::loadLastNodesQuery(std::list<Signature *> & nodes) const
 				 "WHERE n.time_enter >= (SELECT MAX(time_enter) FROM Statistics) "
 				 "ORDER BY n.id;";
 
-		rc = sqlite3_prepare_v2(_ppDb, query.c_str(), -1, &ppStmt, 0);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		ppStmt = this->prepareStatement(query);
 
 		// Process the result if one
 		rc = sqlite3_step(ppStmt);
@@ -1320,8 +1454,8 @@ void DBDriverSqlite3::loadLastNodesQuery(std::list<Signature *> & nodes) const
 
 		UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 
 		ULOGGER_DEBUG("Loading %d signatures...", ids.size());
@@ -1349,8 +1483,7 @@ void DBDriverSqlite3::loadQuery(VWDictionary * dictionary) const
 				"WHERE time_enter >= (SELECT MAX(time_enter) FROM Statistics) "
 				"ORDER BY id;";
 
-		rc = sqlite3_prepare_v2(_ppDb, query.c_str(), -1, &ppStmt, 0);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		ppStmt = this->prepareStatement(query);
 
 		// Process the result if one
 		int id = 0;
@@ -1401,8 +1534,8 @@ void DBDriverSqlite3::loadQuery(VWDictionary * dictionary) const
 			rc = sqlite3_step(ppStmt); // next result...
 		}
 		UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 
 		// Get Last word id
@@ -1432,8 +1565,7 @@ void DBDriverSqlite3::loadWordsQuery(const std::set<int> & wordIds, std::list<Vi
 				 "FROM Word as vw "
 				 "WHERE vw.id = ?;";
 
-		rc = sqlite3_prepare_v2(_ppDb, query.str().c_str(), -1, &ppStmt, 0);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		ppStmt = this->prepareStatement(query.str());
 
 		int descriptorSize;
 		const void * descriptor;
@@ -1487,8 +1619,8 @@ void DBDriverSqlite3::loadWordsQuery(const std::set<int> & wordIds, std::list<Vi
 			UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 		}
 
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 
 		ULOGGER_DEBUG("Time=%fs", timer.ticks());
@@ -1533,12 +1665,14 @@ void DBDriverSqlite3::loadLinksQuery(
 		{
 			query << "SELECT to_id, type, transform FROM Link ";
 		}
-		query << "WHERE from_id = " << signatureId;
+		query << "WHERE from_id = ?";
+		bool bindType = false;
 		if(typeIn != Link::kUndef)
 		{
 			if(uStrNumCmp(_version, "0.7.4") >= 0)
 			{
-				query << " AND type = " << typeIn;
+				query << " AND type = ?";
+				bindType = true;
 			}
 			else if(typeIn == Link::kNeighbor)
 			{
@@ -1551,8 +1685,15 @@ void DBDriverSqlite3::loadLinksQuery(
 		}
 		query << " ORDER BY to_id";
 
-		rc = sqlite3_prepare_v2(_ppDb, query.str().c_str(), -1, &ppStmt, 0);
+		ppStmt = this->prepareStatement(query.str());
+
+		rc = sqlite3_bind_int(ppStmt, 1, signatureId);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		if(bindType)
+		{
+			rc = sqlite3_bind_int(ppStmt, 2, typeIn);
+			UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		}
 
 		int toId = -1;
 		int type = Link::kUndef;
@@ -1605,8 +1746,8 @@ void DBDriverSqlite3::loadLinksQuery(
 
 		UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 
 		if(neighbors.size() == 0)
@@ -1646,8 +1787,7 @@ void DBDriverSqlite3::loadLinksQuery(std::list<Signature *> & signatures) const
 				  << "ORDER BY to_id";
 		}
 
-		rc = sqlite3_prepare_v2(_ppDb, query.str().c_str(), -1, &ppStmt, 0);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		ppStmt = this->prepareStatement(query.str());
 
 		for(std::list<Signature*>::iterator iter=signatures.begin(); iter!=signatures.end(); ++iter)
 		{
@@ -1725,8 +1865,8 @@ void DBDriverSqlite3::loadLinksQuery(std::list<Signature *> & signatures) const
 			UDEBUG("time=%fs, node=%d, links.size=%d", timer.ticks(), (*iter)->id(), links.size());
 		}
 
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
 		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
 	}
 }
@@ -1735,7 +1875,7 @@ void DBDriverSqlite3::loadLinksQuery(std::list<Signature *> & signatures) const
 void DBDriverSqlite3::updateQuery(const std::list<Signature *> & nodes, bool updateTimestamp) const
 {
 	UDEBUG("nodes = %d", nodes.size());
-	if(_ppDb && nodes.size())
+	if(_ppDbWriter && nodes.size())
 	{
 		UTimer timer;
 		timer.start();
@@ -1777,8 +1917,7 @@ void DBDriverSqlite3::updateQuery(const std::list<Signature *> & nodes, bool upd
 				query = "UPDATE Node SET weight=? WHERE id=?;";
 			}
 		}
-		rc = sqlite3_prepare_v2(_ppDb, query.c_str(), -1, &ppStmt, 0);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		ppStmt = this->prepareStatement(query, true);
 
 		for(std::list<Signature *>::const_iterator i=nodes.begin(); i!=nodes.end(); ++i)
 		{
@@ -1787,19 +1926,19 @@ void DBDriverSqlite3::updateQuery(const std::list<Signature *> & nodes, bool upd
 			if(s)
 			{
 				rc = sqlite3_bind_int(ppStmt, index++, s->getWeight());
-				UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+				UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 				if(uStrNumCmp(_version, "0.8.5") >= 0)
 				{
 					if(s->getLabel().empty())
 					{
 						rc = sqlite3_bind_null(ppStmt, index++);
-						UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+						UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 					}
 					else
 					{
 						rc = sqlite3_bind_text(ppStmt, index++, s->getLabel().c_str(), -1, SQLITE_STATIC);
-						UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+						UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 					}
 				}
 
@@ -1808,58 +1947,56 @@ void DBDriverSqlite3::updateQuery(const std::list<Signature *> & nodes, bool upd
 					if(s->getUserData().empty())
 					{
 						rc = sqlite3_bind_null(ppStmt, index++);
-						UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+						UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 					}
 					else
 					{
 						rc = sqlite3_bind_blob(ppStmt, index++, s->getUserData().data(), (int)s->getUserData().size(), SQLITE_STATIC);
-						UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+						UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 					}
 				}
 
 				rc = sqlite3_bind_int(ppStmt, index++, s->id());
-				UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+				UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 				//step
 				rc=sqlite3_step(ppStmt);
-				UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+				UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 				rc = sqlite3_reset(ppStmt);
-				UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+				UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 			}
 		}
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 		ULOGGER_DEBUG("Update Node table, Time=%fs", timer.ticks());
 
 		// Update links part1
 		query = "DELETE FROM Link WHERE from_id=?;";
-		rc = sqlite3_prepare_v2(_ppDb, query.c_str(), -1, &ppStmt, 0);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		ppStmt = this->prepareStatement(query, true);
 		for(std::list<Signature *>::const_iterator j=nodes.begin(); j!=nodes.end(); ++j)
 		{
 			if((*j)->isLinksModified())
 			{
 				rc = sqlite3_bind_int(ppStmt, 1, (*j)->id());
-				UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+				UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 				rc=sqlite3_step(ppStmt);
-				UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+				UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 				rc = sqlite3_reset(ppStmt);
-				UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+				UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 			}
 		}
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 		// Update links part2
 		query = queryStepLink();
-		rc = sqlite3_prepare_v2(_ppDb, query.c_str(), -1, &ppStmt, 0);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		ppStmt = this->prepareStatement(query, true);
 		for(std::list<Signature *>::const_iterator j=nodes.begin(); j!=nodes.end(); ++j)
 		{
 			if((*j)->isLinksModified())
@@ -1872,15 +2009,14 @@ void DBDriverSqlite3::updateQuery(const std::list<Signature *> & nodes, bool upd
 				}
 			}
 		}
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 		ULOGGER_DEBUG("Update Neighbors Time=%fs", timer.ticks());
 
 		// Update word references
 		query = queryStepWordsChanged();
-		rc = sqlite3_prepare_v2(_ppDb, query.c_str(), -1, &ppStmt, 0);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		ppStmt = this->prepareStatement(query, true);
 		for(std::list<Signature *>::const_iterator j=nodes.begin(); j!=nodes.end(); ++j)
 		{
 			if((*j)->getWordsChanged().size())
@@ -1892,9 +2028,9 @@ void DBDriverSqlite3::updateQuery(const std::list<Signature *> & nodes, bool upd
 				}
 			}
 		}
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 		ULOGGER_DEBUG("signatures update=%fs", timer.ticks());
 	}
@@ -1902,7 +2038,7 @@ void DBDriverSqlite3::updateQuery(const std::list<Signature *> & nodes, bool upd
 
 void DBDriverSqlite3::updateQuery(const std::list<VisualWord *> & words, bool updateTimestamp) const
 {
-	if(_ppDb && words.size() && updateTimestamp)
+	if(_ppDbWriter && words.size() && updateTimestamp)
 	{
 		// Only timestamp update is done here, so don't enter this if at all if false
 		UTimer timer;
@@ -1912,8 +2048,7 @@ void DBDriverSqlite3::updateQuery(const std::list<VisualWord *> & words, bool up
 		VisualWord * w = 0;
 
 		std::string query = "UPDATE Word SET time_enter = DATETIME('NOW') WHERE id=?;";
-		rc = sqlite3_prepare_v2(_ppDb, query.c_str(), -1, &ppStmt, 0);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		ppStmt = this->prepareStatement(query, true);
 
 		for(std::list<VisualWord *>::const_iterator i=words.begin(); i!=words.end(); ++i)
 		{
@@ -1922,19 +2057,19 @@ void DBDriverSqlite3::updateQuery(const std::list<VisualWord *> & words, bool up
 			if(w)
 			{
 				rc = sqlite3_bind_int(ppStmt, index++, w->id());
-				UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+				UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 				//step
 				rc=sqlite3_step(ppStmt);
-				UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+				UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 				rc = sqlite3_reset(ppStmt);
-				UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+				UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 			}
 		}
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 		ULOGGER_DEBUG("Update Word table, Time=%fs", timer.ticks());
 	}
@@ -1943,7 +2078,7 @@ void DBDriverSqlite3::updateQuery(const std::list<VisualWord *> & words, bool up
 void DBDriverSqlite3::saveQuery(const std::list<Signature *> & signatures) const
 {
 	UDEBUG("");
-	if(_ppDb && signatures.size())
+	if(_ppDbWriter && signatures.size())
 	{
 		std::string type;
 		UTimer timer;
@@ -1953,23 +2088,21 @@ void DBDriverSqlite3::saveQuery(const std::list<Signature *> & signatures) const
 
 		// Signature table
 		std::string query = queryStepNode();
-		rc = sqlite3_prepare_v2(_ppDb, query.c_str(), -1, &ppStmt, 0);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		ppStmt = this->prepareStatement(query, true);
 
 		for(std::list<Signature *>::const_iterator i=signatures.begin(); i!=signatures.end(); ++i)
 		{
 			stepNode(ppStmt, *i);
 		}
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 		UDEBUG("Time=%fs", timer.ticks());
 
 		// Create new entries in table Link
 		query = queryStepLink();
-		rc = sqlite3_prepare_v2(_ppDb, query.c_str(), -1, &ppStmt, 0);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		ppStmt = this->prepareStatement(query, true);
 		for(std::list<Signature *>::const_iterator jter=signatures.begin(); jter!=signatures.end(); ++jter)
 		{
 			// Save links
@@ -1979,47 +2112,64 @@ void DBDriverSqlite3::saveQuery(const std::list<Signature *> & signatures) const
 				stepLink(ppStmt, (*jter)->id(), i->first, i->second.type(), i->second.rotVariance(), i->second.transVariance(), i->second.transform());
 			}
 		}
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 		UDEBUG("Time=%fs", timer.ticks());
 
 
-		// Create new entries in table Map_Word_Node
-		query = queryStepKeypoint();
-		rc = sqlite3_prepare_v2(_ppDb, query.c_str(), -1, &ppStmt, 0);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		// Create new entries in table Map_Word_Node, kInsertBatchRows
+		// keypoints per query, the remaining ones are inserted one by one
+		int keypoints = 0;
+		for(std::list<Signature *>::const_iterator i=signatures.begin(); i!=signatures.end(); ++i)
+		{
+			keypoints += (int)(*i)->getWords().size();
+		}
+		int batched = keypoints - keypoints % kInsertBatchRows;
+		sqlite3_stmt * ppStmtBatch = batched?this->prepareStatement(queryStepKeypoint(kInsertBatchRows), true):0;
+		ppStmt = this->prepareStatement(queryStepKeypoint(), true);
+		int k = 0;
+		int index = 1;
 		for(std::list<Signature *>::const_iterator i=signatures.begin(); i!=signatures.end(); ++i)
 		{
-			UASSERT((*i)->getWords3().empty() || (*i)->getWords().size() == (*i)->getWords3().size());
-			if((*i)->getWords3().size())
+			const FlatWords<cv::KeyPoint> & words = (*i)->getWords();
+			const FlatWords<pcl::PointXYZ> & words3 = (*i)->getWords3();
+			UASSERT(words3.empty() || words.size() == words3.size());
+			for(unsigned int w=0; w<words.size(); ++w, ++k)
 			{
-				std::multimap<int, cv::KeyPoint>::const_iterator w=(*i)->getWords().begin();
-				std::multimap<int, pcl::PointXYZ>::const_iterator p=(*i)->getWords3().begin();
-				for(; w!=(*i)->getWords().end(); ++w, ++p)
+				pcl::PointXYZ pt(0,0,0);
+				if(words3.size())
 				{
-					UASSERT(w->first == p->first); // must be same id!
-					stepKeypoint(ppStmt, (*i)->id(), w->first, w->second, p->second);
+					UASSERT(words.id(w) == words3.id(w)); // must be same id!
+					pt = words3.value(w);
 				}
-			}
-			else
-			{
-				for(std::multimap<int, cv::KeyPoint>::const_iterator w=(*i)->getWords().begin(); w!=(*i)->getWords().end(); ++w)
+				if(k < batched)
+				{
+					bindKeypoint(ppStmtBatch, index, (*i)->id(), words.id(w), words.value(w), pt);
+					if((k+1) % kInsertBatchRows == 0)
+					{
+						rc=sqlite3_step(ppStmtBatch);
+						UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
+						rc = sqlite3_reset(ppStmtBatch);
+						UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
+						index = 1;
+					}
+				}
+				else
 				{
-					stepKeypoint(ppStmt, (*i)->id(), w->first, w->second, pcl::PointXYZ(0,0,0));
+					stepKeypoint(ppStmt, (*i)->id(), words.id(w), words.value(w), pt);
 				}
 			}
 		}
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
-		UDEBUG("Time=%fs", timer.ticks());
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
+		UDEBUG("Time=%fs (%d keypoints, %d batched)", timer.ticks(), keypoints, batched);
 
 		// Add images
 		query = queryStepImage();
-		rc = sqlite3_prepare_v2(_ppDb, query.c_str(), -1, &ppStmt, 0);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		ppStmt = this->prepareStatement(query, true);
 		UDEBUG("Saving %d images", signatures.size());
 
 		for(std::list<Signature *>::const_iterator i=signatures.begin(); i!=signatures.end(); ++i)
@@ -2030,15 +2180,14 @@ void DBDriverSqlite3::saveQuery(const std::list<Signature *> & signatures) const
 			}
 		}
 
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 		UDEBUG("Time=%fs", timer.ticks());
 
 		// Add depths
 		query = queryStepDepth();
-		rc = sqlite3_prepare_v2(_ppDb, query.c_str(), -1, &ppStmt, 0);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		ppStmt = this->prepareStatement(query, true);
 		for(std::list<Signature *>::const_iterator i=signatures.begin(); i!=signatures.end(); ++i)
 		{
 			//metric
@@ -2047,9 +2196,9 @@ void DBDriverSqlite3::saveQuery(const std::list<Signature *> & signatures) const
 				stepDepth(ppStmt, (*i)->id(), (*i)->getDepthCompressed(), (*i)->getLaserScanCompressed(), (*i)->getFx(), (*i)->getFy(), (*i)->getCx(), (*i)->getCy(), (*i)->getLocalTransform());
 			}
 		}
-		// Finalize (delete) the statement
-		rc = sqlite3_finalize(ppStmt);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		// Reset the statement (kept prepared for the next query)
+		rc = sqlite3_reset(ppStmt);
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 		UDEBUG("Time=%fs", timer.ticks());
 	}
@@ -2058,54 +2207,63 @@ void DBDriverSqlite3::saveQuery(const std::list<Signature *> & signatures) const
 void DBDriverSqlite3::saveQuery(const std::list<VisualWord *> & words) const
 {
 	UDEBUG("visualWords size=%d", words.size());
-	if(_ppDb)
+	if(_ppDbWriter)
 	{
 		std::string type;
 		UTimer timer;
 		timer.start();
 		int rc = SQLITE_OK;
 		sqlite3_stmt * ppStmt = 0;
-		std::string query;
 
-		// Create new entries in table Map_SS_VW
-		if(words.size()>0)
+		// Create new entries in table Word, kInsertBatchRows words
+		// per query, the remaining ones are inserted one by one
+		int toSave = 0;
+		for(std::list<VisualWord *>::const_iterator iter=words.begin(); iter!=words.end(); ++iter)
 		{
-			query = std::string("INSERT INTO Word(id, descriptor_size, descriptor) VALUES(?,?,?);");
-			rc = sqlite3_prepare_v2(_ppDb, query.c_str(), -1, &ppStmt, 0);
-			UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+			if(*iter && !(*iter)->isSaved())
+			{
+				++toSave;
+			}
+		}
+		if(toSave>0)
+		{
+			int batched = toSave - toSave % kInsertBatchRows;
+			sqlite3_stmt * ppStmtBatch = batched?this->prepareStatement(queryStepWord(kInsertBatchRows), true):0;
+			ppStmt = this->prepareStatement(queryStepWord(), true);
+			std::vector<cv::Mat> descriptors; // bound without copy, must be valid until the step
+			descriptors.reserve(kInsertBatchRows);
+			int k = 0;
+			int index = 1;
 			for(std::list<VisualWord *>::const_iterator iter=words.begin(); iter!=words.end(); ++iter)
 			{
 				const VisualWord * w = *iter;
 				if(w && !w->isSaved())
 				{
-					rc = sqlite3_bind_int(ppStmt, 1, w->id());
-					UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
-					rc = sqlite3_bind_int(ppStmt, 2, w->getDescriptor().cols);
-					UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
-					UASSERT(w->getDescriptor().type() == CV_32F || w->getDescriptor().type() == CV_8U);
-					if(w->getDescriptor().type() == CV_32F)
+					if(k < batched)
 					{
-						// CV_32F
-						rc = sqlite3_bind_blob(ppStmt, 3, w->getDescriptor().data, w->getDescriptor().cols*sizeof(float), SQLITE_STATIC);
+						descriptors.push_back(w->getDescriptor());
+						bindWord(ppStmtBatch, index, w->id(), descriptors.back());
+						if((k+1) % kInsertBatchRows == 0)
+						{
+							rc=sqlite3_step(ppStmtBatch);
+							UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
+							rc = sqlite3_reset(ppStmtBatch);
+							UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
+							descriptors.clear();
+							index = 1;
+						}
 					}
 					else
 					{
-						// CV_8U
-						rc = sqlite3_bind_blob(ppStmt, 3, w->getDescriptor().data, w->getDescriptor().cols*sizeof(char), SQLITE_STATIC);
+						stepWord(ppStmt, w->id(), w->getDescriptor());
 					}
-					UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
-
-					//execute query
-					rc=sqlite3_step(ppStmt);
-					UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
-
-					rc = sqlite3_reset(ppStmt);
-					UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+					++k;
 				}
 			}
-			// Finalize (delete) the statement
-			rc = sqlite3_finalize(ppStmt);
-			UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+			// Reset the statement (kept prepared for the next query)
+			rc = sqlite3_reset(ppStmt);
+			UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
+			UDEBUG("%d words, %d batched", toSave, batched);
 		}
 
 		UDEBUG("Time=%fs", timer.ticks());
@@ -2135,28 +2293,28 @@ void DBDriverSqlite3::stepNode(sqlite3_stmt * ppStmt, const Signature * s) const
 
 	int index = 1;
 	rc = sqlite3_bind_int(ppStmt, index++, s->id());
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 	rc = sqlite3_bind_int(ppStmt, index++, s->mapId());
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 	rc = sqlite3_bind_int(ppStmt, index++, s->getWeight());
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 	rc = sqlite3_bind_blob(ppStmt, index++, s->getPose().data(), s->getPose().size()*sizeof(float), SQLITE_STATIC);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 	if(uStrNumCmp(_version, "0.8.5") >= 0)
 	{
 		rc = sqlite3_bind_double(ppStmt, index++, s->getStamp());
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 		if(s->getLabel().empty())
 		{
 			rc = sqlite3_bind_null(ppStmt, index++);
-			UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+			UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 		}
 		else
 		{
 			rc = sqlite3_bind_text(ppStmt, index++, s->getLabel().c_str(), -1, SQLITE_STATIC);
-			UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+			UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 		}
 	}
 
@@ -2165,21 +2323,21 @@ void DBDriverSqlite3::stepNode(sqlite3_stmt * ppStmt, const Signature * s) const
 		if(s->getUserData().empty())
 		{
 			rc = sqlite3_bind_null(ppStmt, index++);
-			UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+			UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 		}
 		else
 		{
 			rc = sqlite3_bind_blob(ppStmt, index++, s->getUserData().data(), (int)s->getUserData().size(), SQLITE_STATIC);
-			UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+			UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 		}
 	}
 
 	//step
 	rc=sqlite3_step(ppStmt);
-	UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 	rc = sqlite3_reset(ppStmt);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 }
 
 std::string DBDriverSqlite3::queryStepImage() const
@@ -2200,7 +2358,7 @@ void DBDriverSqlite3::stepImage(sqlite3_stmt * ppStmt,
 	int index = 1;
 
 	rc = sqlite3_bind_int(ppStmt, index++, id);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 	if(!imageBytes.empty())
 	{
@@ -2210,14 +2368,14 @@ void DBDriverSqlite3::stepImage(sqlite3_stmt * ppStmt,
 	{
 		rc = sqlite3_bind_zeroblob(ppStmt, index++, 4);
 	}
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 	//step
 	rc=sqlite3_step(ppStmt);
-	UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 	rc = sqlite3_reset(ppStmt);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 }
 
 std::string DBDriverSqlite3::queryStepDepth() const
@@ -2251,7 +2409,7 @@ void DBDriverSqlite3::stepDepth(sqlite3_stmt * ppStmt,
 	int index = 1;
 
 	rc = sqlite3_bind_int(ppStmt, index++, id);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 	if(!depthBytes.empty())
 	{
@@ -2261,27 +2419,27 @@ void DBDriverSqlite3::stepDepth(sqlite3_stmt * ppStmt,
 	{
 		rc = sqlite3_bind_zeroblob(ppStmt, index++, 4);
 	}
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 	if(uStrNumCmp(_version, "0.7.0") >= 0)
 	{
 		rc = sqlite3_bind_double(ppStmt, index++, fx);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 		rc = sqlite3_bind_double(ppStmt, index++, fy);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 		rc = sqlite3_bind_double(ppStmt, index++, cx);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 		rc = sqlite3_bind_double(ppStmt, index++, cy);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 	}
 	else
 	{
 		rc = sqlite3_bind_double(ppStmt, index++, 1.0f/fx);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 	}
 
 	rc = sqlite3_bind_blob(ppStmt, index++, localTransform.data(), localTransform.size()*sizeof(float), SQLITE_STATIC);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 	if(!depth2dBytes.empty())
 	{
@@ -2291,14 +2449,14 @@ void DBDriverSqlite3::stepDepth(sqlite3_stmt * ppStmt,
 	{
 		rc = sqlite3_bind_zeroblob(ppStmt, index++, 4);
 	}
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 	//step
 	rc=sqlite3_step(ppStmt);
-	UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 	rc = sqlite3_reset(ppStmt);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 }
 
 std::string DBDriverSqlite3::queryStepLink() const
@@ -2341,33 +2499,33 @@ void DBDriverSqlite3::stepLink(
 	int rc = SQLITE_OK;
 	int index = 1;
 	rc = sqlite3_bind_int(ppStmt, index++, fromId);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 	rc = sqlite3_bind_int(ppStmt, index++, toId);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 	rc = sqlite3_bind_int(ppStmt, index++, type);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 	if(uStrNumCmp(_version, "0.8.4") >= 0)
 	{
 		rc = sqlite3_bind_double(ppStmt, index++, rotVariance);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 		rc = sqlite3_bind_double(ppStmt, index++, transVariance);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 	}
 	else if(uStrNumCmp(_version, "0.7.4") >= 0)
 	{
 		rc = sqlite3_bind_double(ppStmt, index++, rotVariance<transVariance?rotVariance:transVariance);
-		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+		UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 	}
 
 	rc = sqlite3_bind_blob(ppStmt, index++, transform.data(), transform.size()*sizeof(float), SQLITE_STATIC);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 	rc=sqlite3_step(ppStmt);
-	UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 	rc=sqlite3_reset(ppStmt);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 }
 
 std::string DBDriverSqlite3::queryStepWordsChanged() const
@@ -2383,22 +2541,23 @@ void DBDriverSqlite3::stepWordsChanged(sqlite3_stmt * ppStmt, int nodeId, int ol
 	int rc = SQLITE_OK;
 	int index = 1;
 	rc = sqlite3_bind_int(ppStmt, index++, newWordId);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 	rc = sqlite3_bind_int(ppStmt, index++, oldWordId);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 	rc = sqlite3_bind_int(ppStmt, index++, nodeId);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 	rc=sqlite3_step(ppStmt);
-	UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 	rc=sqlite3_reset(ppStmt);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 }
 
-std::string DBDriverSqlite3::queryStepKeypoint() const
+std::string DBDriverSqlite3::queryStepKeypoint(int rows) const
 {
-	return "INSERT INTO Map_Node_Word(node_id, word_id, pos_x, pos_y, size, dir, response, depth_x, depth_y, depth_z) VALUES(?,?,?,?,?,?,?,?,?,?);";
+	UASSERT(rows >= 1);
+	return "INSERT INTO Map_Node_Word(node_id, word_id, pos_x, pos_y, size, dir, response, depth_x, depth_y, depth_z) VALUES" + multiRowValues(10, rows) + ";";
 }
 void DBDriverSqlite3::stepKeypoint(sqlite3_stmt * ppStmt, int nodeId, int wordId, const cv::KeyPoint & kp, const pcl::PointXYZ & pt) const
 {
@@ -2408,32 +2567,80 @@ void DBDriverSqlite3::stepKeypoint(sqlite3_stmt * ppStmt, int nodeId, int wordId
 	}
 	int rc = SQLITE_OK;
 	int index = 1;
+	bindKeypoint(ppStmt, index, nodeId, wordId, kp, pt);
+
+	rc=sqlite3_step(ppStmt);
+	UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
+
+	rc = sqlite3_reset(ppStmt);
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
+}
+void DBDriverSqlite3::bindKeypoint(sqlite3_stmt * ppStmt, int & index, int nodeId, int wordId, const cv::KeyPoint & kp, const pcl::PointXYZ & pt) const
+{
+	int rc = SQLITE_OK;
 	rc = sqlite3_bind_int(ppStmt, index++, nodeId);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 	rc = sqlite3_bind_int(ppStmt, index++, wordId);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 	rc = sqlite3_bind_double(ppStmt, index++, kp.pt.x);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 	rc = sqlite3_bind_double(ppStmt, index++, kp.pt.y);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 	rc = sqlite3_bind_int(ppStmt, index++, kp.size);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 	rc = sqlite3_bind_double(ppStmt, index++, kp.angle);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 	rc = sqlite3_bind_double(ppStmt, index++, kp.response);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 	rc = sqlite3_bind_double(ppStmt, index++, pt.x);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 	rc = sqlite3_bind_double(ppStmt, index++, pt.y);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 	rc = sqlite3_bind_double(ppStmt, index++, pt.z);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
+}
+
+std::string DBDriverSqlite3::queryStepWord(int rows) const
+{
+	UASSERT(rows >= 1);
+	return "INSERT INTO Word(id, descriptor_size, descriptor) VALUES" + multiRowValues(3, rows) + ";";
+}
+void DBDriverSqlite3::stepWord(sqlite3_stmt * ppStmt, int wordId, const cv::Mat & descriptor) const
+{
+	if(!ppStmt)
+	{
+		UFATAL("");
+	}
+	int rc = SQLITE_OK;
+	int index = 1;
+	bindWord(ppStmt, index, wordId, descriptor);
 
+	//execute query
 	rc=sqlite3_step(ppStmt);
-	UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_DONE, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 
 	rc = sqlite3_reset(ppStmt);
-	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDb)).c_str());
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
+}
+void DBDriverSqlite3::bindWord(sqlite3_stmt * ppStmt, int & index, int wordId, const cv::Mat & descriptor) const
+{
+	int rc = SQLITE_OK;
+	rc = sqlite3_bind_int(ppStmt, index++, wordId);
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
+	rc = sqlite3_bind_int(ppStmt, index++, descriptor.cols);
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
+	UASSERT(descriptor.type() == CV_32F || descriptor.type() == CV_8U);
+	if(descriptor.type() == CV_32F)
+	{
+		// CV_32F
+		rc = sqlite3_bind_blob(ppStmt, index++, descriptor.data, descriptor.cols*sizeof(float), SQLITE_STATIC);
+	}
+	else
+	{
+		// CV_8U
+		rc = sqlite3_bind_blob(ppStmt, index++, descriptor.data, descriptor.cols*sizeof(char), SQLITE_STATIC);
+	}
+	UASSERT_MSG(rc == SQLITE_OK, uFormat("DB error: %s", sqlite3_errmsg(_ppDbWriter)).c_str());
 }
 
 } // namespace rtabmap
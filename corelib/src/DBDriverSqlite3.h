@@ -55,6 +55,9 @@ private:
 	virtual long getMemoryUsedQuery() const; // In bytes
 
 	virtual void executeNoResultQuery(const std::string & sql) const;
+	virtual bool hasWriterConnectionQuery() const;
+	virtual void beginTransactionQuery() const;
+	virtual void commitQuery() const;
 
 	virtual void getWeightQuery(int signatureId, int & weight) const;
 
@@ -95,7 +98,7 @@ private:
 	std::string queryStepDepth() const;
 	std::string queryStepLink() const;
 	std::string queryStepWordsChanged() const;
-	std::string queryStepKeypoint() const;
+	std::string queryStepKeypoint(int rows = 1) const; // multi-row insert if rows > 1
 	void stepNode(sqlite3_stmt * ppStmt, const Signature * s) const;
 	void stepImage(
 			sqlite3_stmt * ppStmt,
@@ -114,14 +117,24 @@ private:
 	void stepLink(sqlite3_stmt * ppStmt, int fromId, int toId, Link::Type type, float rotVariance, float transVariance, const Transform & transform) const;
 	void stepWordsChanged(sqlite3_stmt * ppStmt, int signatureId, int oldWordId, int newWordId) const;
 	void stepKeypoint(sqlite3_stmt * ppStmt, int signatureId, int wordId, const cv::KeyPoint & kp, const pcl::PointXYZ & pt) const;
+	void bindKeypoint(sqlite3_stmt * ppStmt, int & index, int signatureId, int wordId, const cv::KeyPoint & kp, const pcl::PointXYZ & pt) const;
+	std::string queryStepWord(int rows = 1) const; // multi-row insert if rows > 1
+	void stepWord(sqlite3_stmt * ppStmt, int wordId, const cv::Mat & descriptor) const;
+	void bindWord(sqlite3_stmt * ppStmt, int & index, int wordId, const cv::Mat & descriptor) const;
 
 private:
+	// Prepared statements are cached by query, they must be reset after use
+	sqlite3_stmt * prepareStatement(const std::string & query, bool writer = false) const;
+	void executePragma(const std::string & sql) const; // on all connections
 	void loadLinksQuery(std::list<Signature *> & signatures) const;
 	int loadOrSaveDb(sqlite3 *pInMemory, const std::string & fileName, int isSave) const;
 	bool getVersion(std::string &) const;
 
 private:
 	sqlite3 * _ppDb;
+	sqlite3 * _ppDbWriter; // used by save/update queries, same as _ppDb if not in WAL mode
+	mutable std::map<std::string, sqlite3_stmt *> _statements; // <query, prepared statement>
+	mutable std::map<std::string, sqlite3_stmt *> _writerStatements; // <query, prepared statement>
 	std::string _version;
 	bool _dbInMemory;
 	unsigned int _cacheSize;
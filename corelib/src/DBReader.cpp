@@ -38,7 +38,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/RtabmapEvent.h"
 #include "rtabmap/core/OdometryEvent.h"
 #include "rtabmap/core/util3d.h"
-#include "rtabmap/core/Compression.h"
+#include "rtabmap/core/DecompressionService.h"
 
 namespace rtabmap {
 
@@ -75,6 +75,7 @@ bool DBReader::init(int startIndex)
 	}
 	_ids.clear();
 	_currentId=_ids.end();
+	_prefetched.clear();
 
 	if(!UFile::exists(_path))
 	{
@@ -170,17 +171,11 @@ void DBReader::mainLoop()
 		{
 			this->post(new RtabmapEventCmd(RtabmapEventCmd::kCmdGoal, "", goalId));
 
-			if(!_ignoreGoalDelay && _currentId != _ids.end())
+			if(!_ignoreGoalDelay && _prefetched.size())
 			{
-				// get stamp for the next signature to compute the delay
-				// that was used originally for planning
-				int weight;
-				std::string label;
-				double stamp;
-				int mapId;
-				Transform localTransform, pose;
-				std::vector<unsigned char> userData;
-				_dbDriver->getNodeInfo(*_currentId, pose, mapId, weight, label, stamp, userData);
+				// get stamp for the next signature (already read) to compute
+				// the delay that was used originally for planning
+				double stamp = _prefetched.front().stamp;
 				if(previousStamp && stamp && stamp > previousStamp)
 				{
 					double delay = stamp - previousStamp;
@@ -230,69 +225,27 @@ SensorData DBReader::getNextData()
 			UDEBUG("slept=%fs vs target=%fs", slept, 1.0/double(frameRate));
 		}
 
-		if(!this->isKilled() && _currentId != _ids.end())
+		if(!this->isKilled())
 		{
-			cv::Mat imageBytes;
-			cv::Mat depthBytes;
-			cv::Mat laserScanBytes;
-			int mapId;
-			float fx,fy,cx,cy;
-			Transform localTransform, pose;
-			float rotVariance = 1.0f;
-			float transVariance = 1.0f;
-			std::vector<unsigned char> userData;
-			_dbDriver->getNodeData(*_currentId, imageBytes, depthBytes, laserScanBytes, fx, fy, cx, cy, localTransform);
-
-			// info
-			int weight;
-			std::string label;
-			double stamp;
-			_dbDriver->getNodeInfo(*_currentId, pose, mapId, weight, label, stamp, userData);
-
-			if(!_odometryIgnored)
-			{
-				std::map<int, Link> links;
-				_dbDriver->loadLinks(*_currentId, links, Link::kNeighbor);
-				if(links.size())
-				{
-					// assume the first is the backward neighbor, take its variance
-					rotVariance = links.begin()->second.rotVariance();
-					transVariance = links.begin()->second.transVariance();
-				}
-			}
-			else
-			{
-				pose.setNull();
-			}
-
-			int seq = *_currentId;
-			++_currentId;
-			if(imageBytes.empty())
-			{
-				UWARN("No image loaded from the database for id=%d!", *_currentId);
-			}
+			this->prefetch();
+		}
 
-			rtabmap::CompressionThread ctImage(imageBytes, true);
-			rtabmap::CompressionThread ctDepth(depthBytes, true);
-			rtabmap::CompressionThread ctLaserScan(laserScanBytes, false);
-			ctImage.start();
-			ctDepth.start();
-			ctLaserScan.start();
-			ctImage.join();
-			ctDepth.join();
-			ctLaserScan.join();
+		if(!this->isKilled() && _prefetched.size())
+		{
+			const Prefetched & node = _prefetched.front();
 			data = SensorData(
-					ctLaserScan.getUncompressedData(),
-					ctImage.getUncompressedData(),
-					ctDepth.getUncompressedData(),
-					fx,fy,cx,cy,
-					localTransform,
-					pose,
-					rotVariance,
-					transVariance,
-					seq,
-					stamp,
-					userData);
+					node.data.laserScan(),
+					node.data.image(),
+					node.data.depth(),
+					node.fx,node.fy,node.cx,node.cy,
+					node.localTransform,
+					node.pose,
+					node.rotVariance,
+					node.transVariance,
+					node.id,
+					node.stamp,
+					node.userData);
+			_prefetched.pop_front();
 			UDEBUG("Laser=%d RGB/Left=%d Depth=%d Right=%d",
 					data.laserScan().empty()?0:1,
 					data.image().empty()?0:1,
@@ -307,4 +260,53 @@ SensorData DBReader::getNextData()
 	return data;
 }
 
+void DBReader::prefetch()
+{
+	// Read the next nodes in advance, so that they are decoded
+	// while the previous ones are processed
+	int size = DecompressionService::instance().threads()*2;
+	while((int)_prefetched.size() < size && _currentId != _ids.end())
+	{
+		Prefetched node;
+		cv::Mat imageBytes;
+		cv::Mat depthBytes;
+		cv::Mat laserScanBytes;
+		int mapId;
+		node.rotVariance = 1.0f;
+		node.transVariance = 1.0f;
+		_dbDriver->getNodeData(*_currentId, imageBytes, depthBytes, laserScanBytes, node.fx, node.fy, node.cx, node.cy, node.localTransform);
+
+		// info
+		int weight;
+		std::string label;
+		_dbDriver->getNodeInfo(*_currentId, node.pose, mapId, weight, label, node.stamp, node.userData);
+
+		if(!_odometryIgnored)
+		{
+			std::map<int, Link> links;
+			_dbDriver->loadLinks(*_currentId, links, Link::kNeighbor);
+			if(links.size())
+			{
+				// assume the first is the backward neighbor, take its variance
+				node.rotVariance = links.begin()->second.rotVariance();
+				node.transVariance = links.begin()->second.transVariance();
+			}
+		}
+		else
+		{
+			node.pose.setNull();
+		}
+
+		node.id = *_currentId;
+		++_currentId;
+		if(imageBytes.empty())
+		{
+			UWARN("No image loaded from the database for id=%d!", node.id);
+		}
+
+		node.data = DecompressionService::instance().decompress(imageBytes, depthBytes, laserScanBytes, node.id);
+		_prefetched.push_back(node);
+	}
+}
+
 } /* namespace rtabmap */
@@ -0,0 +1,339 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/DecompressionService.h"
+#include "rtabmap/core/Compression.h"
+#include "rtabmap/core/Signature.h"
+
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UThreadNode.h>
+
+namespace rtabmap {
+
+enum DecompressionPart {kPartImage = 0, kPartDepth = 1, kPartLaserScan = 2};
+
+// Shared by the futures and the pending parts of a node
+class DecompressionState
+{
+public:
+	DecompressionState(DecompressionService * service, int id) :
+		service(service),
+		id(id),
+		refs(1),
+		remaining(0)
+	{}
+
+	DecompressionService * service;
+	int id;
+	cv::Mat compressed[3];
+	cv::Mat raw[3];
+	UMutex mutex;
+	int refs; // futures and pending parts
+	int remaining; // parts not decoded
+	USemaphore done;
+};
+
+static void releaseState(DecompressionState * state)
+{
+	state->mutex.lock();
+	bool unused = --state->refs == 0;
+	state->mutex.unlock();
+	if(unused)
+	{
+		delete state;
+	}
+}
+
+class DecompressionWorker : public UThreadNode
+{
+public:
+	DecompressionWorker(DecompressionService & service) : _service(service) {}
+	virtual ~DecompressionWorker() {this->join(true);}
+
+private:
+	virtual void mainLoopKill()
+	{
+		_service._tasksAdded.release();
+	}
+	virtual void mainLoop()
+	{
+		_service._tasksAdded.acquire();
+		if(!this->isKilled())
+		{
+			// may have been decoded by a thread waiting a future
+			_service.runTask();
+		}
+	}
+
+private:
+	DecompressionService & _service;
+};
+
+//
+// DecompressionFuture
+//
+DecompressionFuture::DecompressionFuture() :
+	_state(0)
+{
+}
+
+DecompressionFuture::DecompressionFuture(DecompressionState * state) :
+	_state(state)
+{
+}
+
+DecompressionFuture::DecompressionFuture(const DecompressionFuture & future) :
+	_state(future._state)
+{
+	if(_state)
+	{
+		UScopeMutex lock(_state->mutex);
+		++_state->refs;
+	}
+}
+
+DecompressionFuture & DecompressionFuture::operator=(const DecompressionFuture & future)
+{
+	if(future._state)
+	{
+		UScopeMutex lock(future._state->mutex);
+		++future._state->refs;
+	}
+	if(_state)
+	{
+		releaseState(_state);
+	}
+	_state = future._state;
+	return *this;
+}
+
+DecompressionFuture::~DecompressionFuture()
+{
+	if(_state)
+	{
+		releaseState(_state);
+	}
+}
+
+bool DecompressionFuture::isReady() const
+{
+	UASSERT(_state != 0);
+	UScopeMutex lock(_state->mutex);
+	return _state->remaining == 0;
+}
+
+void DecompressionFuture::wait() const
+{
+	UASSERT(_state != 0);
+	while(!this->isReady())
+	{
+		// help the workers instead of blocking
+		if(!_state->service->runTask())
+		{
+			_state->done.acquire();
+			_state->done.release(); // for the other copies of the future
+		}
+	}
+}
+
+int DecompressionFuture::id() const
+{
+	UASSERT(_state != 0);
+	return _state->id;
+}
+
+const cv::Mat & DecompressionFuture::image() const
+{
+	this->wait();
+	return _state->raw[kPartImage];
+}
+
+const cv::Mat & DecompressionFuture::depth() const
+{
+	this->wait();
+	return _state->raw[kPartDepth];
+}
+
+const cv::Mat & DecompressionFuture::laserScan() const
+{
+	this->wait();
+	return _state->raw[kPartLaserScan];
+}
+
+//
+// DecompressionService
+//
+DecompressionService * DecompressionService::instance_ = 0;
+UDestroyer<DecompressionService> DecompressionService::destroyer_;
+UMutex DecompressionService::instanceMutex_;
+
+DecompressionService & DecompressionService::instance()
+{
+	UScopeMutex lock(instanceMutex_);
+	if(!instance_)
+	{
+		instance_ = new DecompressionService();
+		destroyer_.setDoomed(instance_);
+	}
+	return *instance_;
+}
+
+DecompressionService::DecompressionService(int threads)
+{
+	UASSERT(threads >= 1);
+	_workers.resize(threads);
+	for(int i=0; i<threads; ++i)
+	{
+		_workers[i] = new DecompressionWorker(*this);
+		_workers[i]->start();
+	}
+}
+
+DecompressionService::~DecompressionService()
+{
+	while(this->runTask())
+	{
+		// pending futures get their results
+	}
+	for(unsigned int i=0; i<_workers.size(); ++i)
+	{
+		_workers[i]->kill();
+	}
+	// a worker may have taken the release of another one before it was killed
+	_tasksAdded.release((int)_workers.size());
+	for(unsigned int i=0; i<_workers.size(); ++i)
+	{
+		delete _workers[i];
+	}
+}
+
+DecompressionFuture DecompressionService::decompress(
+		const cv::Mat & imageCompressed,
+		const cv::Mat & depthCompressed,
+		const cv::Mat & laserScanCompressed,
+		int id)
+{
+	DecompressionState * state = new DecompressionState(this, id);
+	state->compressed[kPartImage] = imageCompressed;
+	state->compressed[kPartDepth] = depthCompressed;
+	state->compressed[kPartLaserScan] = laserScanCompressed;
+
+	std::list<std::pair<DecompressionState *, int> > tasks;
+	for(int i=0; i<3; ++i)
+	{
+		if(!state->compressed[i].empty())
+		{
+			tasks.push_back(std::make_pair(state, i));
+		}
+	}
+	state->remaining = (int)tasks.size();
+	state->refs += (int)tasks.size();
+	if(tasks.size())
+	{
+		_tasksMutex.lock();
+		_tasks.splice(_tasks.end(), tasks);
+		_tasksMutex.unlock();
+		_tasksAdded.release(state->remaining);
+	}
+	return DecompressionFuture(state);
+}
+
+DecompressionFuture DecompressionService::decompress(const Signature & signature)
+{
+	return this->decompress(
+			signature.getImageRaw().empty()?signature.getImageCompressed():cv::Mat(),
+			signature.getDepthRaw().empty()?signature.getDepthCompressed():cv::Mat(),
+			signature.getLaserScanRaw().empty()?signature.getLaserScanCompressed():cv::Mat(),
+			signature.id());
+}
+
+std::vector<DecompressionFuture> DecompressionService::decompress(const std::list<Signature *> & signatures)
+{
+	std::vector<DecompressionFuture> futures;
+	futures.reserve(signatures.size());
+	for(std::list<Signature *>::const_iterator iter=signatures.begin(); iter!=signatures.end(); ++iter)
+	{
+		UASSERT(*iter != 0);
+		futures.push_back(this->decompress(**iter));
+	}
+	return futures;
+}
+
+void DecompressionService::uncompressData(const std::list<Signature *> & signatures)
+{
+	std::vector<DecompressionFuture> futures = this->decompress(signatures);
+	int i = 0;
+	for(std::list<Signature *>::const_iterator iter=signatures.begin(); iter!=signatures.end(); ++iter, ++i)
+	{
+		Signature * s = *iter;
+		if(s->getImageRaw().empty())
+		{
+			s->setImageRaw(futures[i].image());
+		}
+		if(s->getDepthRaw().empty())
+		{
+			s->setDepthRaw(futures[i].depth());
+		}
+		if(s->getLaserScanRaw().empty())
+		{
+			s->setLaserScanRaw(futures[i].laserScan());
+		}
+	}
+}
+
+bool DecompressionService::runTask()
+{
+	_tasksMutex.lock();
+	if(_tasks.empty())
+	{
+		_tasksMutex.unlock();
+		return false;
+	}
+	DecompressionState * state = _tasks.front().first;
+	int part = _tasks.front().second;
+	_tasks.pop_front();
+	_tasksMutex.unlock();
+
+	// the compressed data is not modified until decoded
+	cv::Mat raw = part == kPartLaserScan?
+			rtabmap::uncompressData(state->compressed[part]):
+			uncompressImage(state->compressed[part]);
+
+	state->mutex.lock();
+	state->raw[part] = raw;
+	state->compressed[part] = cv::Mat();
+	bool done = --state->remaining == 0;
+	state->mutex.unlock();
+	if(done)
+	{
+		state->done.release();
+	}
+	releaseState(state);
+	return true;
+}
+
+} /* namespace rtabmap */
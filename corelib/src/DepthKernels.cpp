@@ -0,0 +1,402 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "DepthKernels.h"
+
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UThreadNode.h>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <float.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RTABMAP_DEPTH_SSE
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define RTABMAP_DEPTH_AVX2
+#endif
+
+namespace rtabmap
+{
+
+// Points done by each thread, so that small images are done in the calling thread
+static const int kPointsPerThread = 256*1024;
+static const int kMaxThreads = 8;
+
+static inline int bitCount(int mask)
+{
+	int count = 0;
+	for(; mask; mask &= mask-1)
+	{
+		++count;
+	}
+	return count;
+}
+
+#ifdef RTABMAP_DEPTH_SSE
+static inline __m128 load4(const float * p) {return _mm_loadu_ps(p);}
+static inline __m128 load4(const unsigned short * p)
+{
+	return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128()));
+}
+static inline __m128 load4(const short * p)
+{
+	__m128i v = _mm_loadl_epi64((const __m128i*)p);
+	return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16)); // sign extended
+}
+static inline __m128 select4(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+#endif
+
+#ifdef RTABMAP_DEPTH_AVX2
+static inline __m256 load8(const float * p) {return _mm256_loadu_ps(p);}
+static inline __m256 load8(const unsigned short * p)
+{
+	return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p)));
+}
+static inline __m256 load8(const short * p)
+{
+	return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)p)));
+}
+#endif
+
+DepthProjector::DepthProjector() :
+	_disparity(false),
+	_decimation(1),
+	_rows(0),
+	_cols(0),
+	_scale(1.0f),
+	_cx(0.0f),
+	_cy(0.0f),
+	_fxInv(0.0f),
+	_fyInv(0.0f),
+	_fx(0.0f),
+	_baseline(0.0f),
+	_maxDepth(FLT_MAX)
+{
+}
+
+DepthProjector DepthProjector::fromDepth(
+		const cv::Mat & depth,
+		float cx, float cy,
+		float fx, float fy,
+		int decimation,
+		float maxDepth)
+{
+	UASSERT(!depth.empty() && (depth.type() == CV_16UC1 || depth.type() == CV_32FC1));
+	UASSERT(decimation >= 1);
+	DepthProjector projector;
+	projector._image = depth;
+	projector._decimation = decimation;
+	projector._rows = depth.rows/decimation;
+	projector._cols = depth.cols/decimation;
+	projector._scale = depth.type() == CV_16UC1?0.001f:1.0f;
+	projector._cx = cx > 0.0f ? cx : float(depth.cols/2) - 0.5f;
+	projector._cy = cy > 0.0f ? cy : float(depth.rows/2) - 0.5f;
+	projector._fxInv = 1.0f/fx;
+	projector._fyInv = 1.0f/fy;
+	projector._maxDepth = maxDepth > 0.0f?maxDepth:FLT_MAX;
+	return projector;
+}
+
+DepthProjector DepthProjector::fromDisparity(
+		const cv::Mat & disparity,
+		float cx, float cy,
+		float fx, float baseline,
+		int decimation,
+		float maxDepth)
+{
+	UASSERT(!disparity.empty() && (disparity.type() == CV_16SC1 || disparity.type() == CV_32FC1));
+	UASSERT(decimation >= 1);
+	DepthProjector projector;
+	projector._image = disparity;
+	projector._disparity = true;
+	projector._decimation = decimation;
+	projector._rows = disparity.rows/decimation;
+	projector._cols = disparity.cols/decimation;
+	projector._scale = disparity.type() == CV_16SC1?1.0f/16.0f:1.0f;
+	projector._cx = cx;
+	projector._cy = cy;
+	projector._fx = fx;
+	projector._baseline = baseline;
+	projector._maxDepth = maxDepth > 0.0f?maxDepth:FLT_MAX;
+	return projector;
+}
+
+int DepthProjector::project(int row, float * x, float * y, float * z) const
+{
+	UASSERT(row >= 0 && row < _rows);
+	int v = row*_decimation;
+	if(_disparity)
+	{
+		if(_image.type() == CV_16SC1)
+		{
+			return projectDisparityRow(_image.ptr<short>(v), float(v), x, y, z);
+		}
+		return projectDisparityRow(_image.ptr<float>(v), float(v), x, y, z);
+	}
+	if(_image.type() == CV_16UC1)
+	{
+		return projectDepthRow(_image.ptr<unsigned short>(v), float(v), x, y, z);
+	}
+	return projectDepthRow(_image.ptr<float>(v), float(v), x, y, z);
+}
+
+template<typename T>
+int DepthProjector::projectDepthRow(const T * row, float v, float * x, float * y, float * z) const
+{
+	const float bad_point = std::numeric_limits<float>::quiet_NaN();
+	// Negative depths are kept (as projectDepthTo3D() does) if there is no maximum depth
+	const float minDepth = _maxDepth < FLT_MAX?0.0f:-FLT_MAX;
+	const float yFactor = (v - _cy) * _fyInv;
+	int count = 0;
+	int i = 0;
+	if(_decimation == 1)
+	{
+#ifdef RTABMAP_DEPTH_AVX2
+		{
+			const __m256 scale = _mm256_set1_ps(_scale);
+			const __m256 cx = _mm256_set1_ps(_cx);
+			const __m256 fxInv = _mm256_set1_ps(_fxInv);
+			const __m256 yf = _mm256_set1_ps(yFactor);
+			const __m256 low = _mm256_set1_ps(minDepth);
+			const __m256 high = _mm256_set1_ps(_maxDepth);
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256 nan = _mm256_set1_ps(bad_point);
+			const __m256 step = _mm256_set1_ps(8.0f);
+			__m256 u = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+			for(; i+8 <= _cols; i+=8, u = _mm256_add_ps(u, step))
+			{
+				__m256 d = _mm256_mul_ps(load8(row+i), scale);
+				__m256 valid = _mm256_and_ps(
+						_mm256_cmp_ps(d, zero, _CMP_NEQ_OQ),
+						_mm256_and_ps(_mm256_cmp_ps(d, low, _CMP_GE_OQ), _mm256_cmp_ps(d, high, _CMP_LE_OQ)));
+				_mm256_storeu_ps(x+i, _mm256_blendv_ps(nan, _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(u, cx), fxInv), d), valid));
+				_mm256_storeu_ps(y+i, _mm256_blendv_ps(nan, _mm256_mul_ps(yf, d), valid));
+				_mm256_storeu_ps(z+i, _mm256_blendv_ps(nan, d, valid));
+				count += bitCount(_mm256_movemask_ps(valid));
+			}
+		}
+#endif
+#ifdef RTABMAP_DEPTH_SSE
+		{
+			const __m128 scale = _mm_set1_ps(_scale);
+			const __m128 cx = _mm_set1_ps(_cx);
+			const __m128 fxInv = _mm_set1_ps(_fxInv);
+			const __m128 yf = _mm_set1_ps(yFactor);
+			const __m128 low = _mm_set1_ps(minDepth);
+			const __m128 high = _mm_set1_ps(_maxDepth);
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 nan = _mm_set1_ps(bad_point);
+			const __m128 step = _mm_set1_ps(4.0f);
+			__m128 u = _mm_setr_ps(float(i), float(i+1), float(i+2), float(i+3));
+			for(; i+4 <= _cols; i+=4, u = _mm_add_ps(u, step))
+			{
+				__m128 d = _mm_mul_ps(load4(row+i), scale);
+				// NaN depths fail the ordered comparisons
+				__m128 valid = _mm_and_ps(
+						_mm_cmpneq_ps(d, zero),
+						_mm_and_ps(_mm_cmpge_ps(d, low), _mm_cmple_ps(d, high)));
+				_mm_storeu_ps(x+i, select4(valid, _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(u, cx), fxInv), d), nan));
+				_mm_storeu_ps(y+i, select4(valid, _mm_mul_ps(yf, d), nan));
+				_mm_storeu_ps(z+i, select4(valid, d, nan));
+				count += bitCount(_mm_movemask_ps(valid));
+			}
+		}
+#endif
+	}
+	for(; i < _cols; ++i)
+	{
+		int u = i*_decimation;
+		float d = float(row[u]) * _scale;
+		if(d != 0.0f && d >= minDepth && d <= _maxDepth)
+		{
+			x[i] = (float(u) - _cx) * _fxInv * d;
+			y[i] = yFactor * d;
+			z[i] = d;
+			++count;
+		}
+		else
+		{
+			x[i] = y[i] = z[i] = bad_point;
+		}
+	}
+	return count;
+}
+
+template<typename T>
+int DepthProjector::projectDisparityRow(const T * row, float v, float * x, float * y, float * z) const
+{
+	const float bad_point = std::numeric_limits<float>::quiet_NaN();
+	if(_baseline <= 0.0f || _fx <= 0.0f)
+	{
+		for(int i=0; i<_cols; ++i)
+		{
+			x[i] = y[i] = z[i] = bad_point;
+		}
+		return 0;
+	}
+	const float vcy = v - _cy;
+	int count = 0;
+	int i = 0;
+	if(_decimation == 1)
+	{
+#ifdef RTABMAP_DEPTH_AVX2
+		{
+			const __m256 scale = _mm256_set1_ps(_scale);
+			const __m256 cx = _mm256_set1_ps(_cx);
+			const __m256 vc = _mm256_set1_ps(vcy);
+			const __m256 fx = _mm256_set1_ps(_fx);
+			const __m256 baseline = _mm256_set1_ps(_baseline);
+			const __m256 high = _mm256_set1_ps(_maxDepth);
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256 nan = _mm256_set1_ps(bad_point);
+			const __m256 step = _mm256_set1_ps(8.0f);
+			__m256 u = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+			for(; i+8 <= _cols; i+=8, u = _mm256_add_ps(u, step))
+			{
+				__m256 d = _mm256_mul_ps(load8(row+i), scale);
+				__m256 invW = _mm256_div_ps(baseline, d);
+				__m256 depth = _mm256_mul_ps(fx, invW);
+				__m256 valid = _mm256_and_ps(_mm256_cmp_ps(d, zero, _CMP_GT_OQ), _mm256_cmp_ps(depth, high, _CMP_LE_OQ));
+				_mm256_storeu_ps(x+i, _mm256_blendv_ps(nan, _mm256_mul_ps(_mm256_sub_ps(u, cx), invW), valid));
+				_mm256_storeu_ps(y+i, _mm256_blendv_ps(nan, _mm256_mul_ps(vc, invW), valid));
+				_mm256_storeu_ps(z+i, _mm256_blendv_ps(nan, depth, valid));
+				count += bitCount(_mm256_movemask_ps(valid));
+			}
+		}
+#endif
+#ifdef RTABMAP_DEPTH_SSE
+		{
+			const __m128 scale = _mm_set1_ps(_scale);
+			const __m128 cx = _mm_set1_ps(_cx);
+			const __m128 vc = _mm_set1_ps(vcy);
+			const __m128 fx = _mm_set1_ps(_fx);
+			const __m128 baseline = _mm_set1_ps(_baseline);
+			const __m128 high = _mm_set1_ps(_maxDepth);
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 nan = _mm_set1_ps(bad_point);
+			const __m128 step = _mm_set1_ps(4.0f);
+			__m128 u = _mm_setr_ps(float(i), float(i+1), float(i+2), float(i+3));
+			for(; i+4 <= _cols; i+=4, u = _mm_add_ps(u, step))
+			{
+				__m128 d = _mm_mul_ps(load4(row+i), scale);
+				__m128 invW = _mm_div_ps(baseline, d);
+				__m128 depth = _mm_mul_ps(fx, invW);
+				__m128 valid = _mm_and_ps(_mm_cmpgt_ps(d, zero), _mm_cmple_ps(depth, high));
+				_mm_storeu_ps(x+i, select4(valid, _mm_mul_ps(_mm_sub_ps(u, cx), invW), nan));
+				_mm_storeu_ps(y+i, select4(valid, _mm_mul_ps(vc, invW), nan));
+				_mm_storeu_ps(z+i, select4(valid, depth, nan));
+				count += bitCount(_mm_movemask_ps(valid));
+			}
+		}
+#endif
+	}
+	for(; i < _cols; ++i)
+	{
+		int u = i*_decimation;
+		float d = float(row[u]) * _scale;
+		float invW = _baseline / d;
+		float depth = _fx * invW;
+		if(d > 0.0f && depth <= _maxDepth)
+		{
+			x[i] = (float(u) - _cx) * invW;
+			y[i] = vcy * invW;
+			z[i] = depth;
+			++count;
+		}
+		else
+		{
+			x[i] = y[i] = z[i] = bad_point;
+		}
+	}
+	return count;
+}
+
+// Process the rows [first, end) of a kernel
+class RowsThread : public UThreadNode
+{
+public:
+	RowsThread(const RowsKernel & kernel, int first, int end) :
+		_kernel(kernel),
+		_first(first),
+		_end(end),
+		_count(0)
+	{}
+	virtual ~RowsThread() {}
+	int count() const {return _count;}
+private:
+	void mainLoop() {
+		_count = _kernel.process(_first, _end);
+		this->kill();
+	}
+	const RowsKernel & _kernel;
+	int _first;
+	int _end;
+	int _count;
+};
+
+int processRows(const RowsKernel & kernel, int rows, int cols, int threads)
+{
+	if(rows <= 0)
+	{
+		return 0;
+	}
+	if(threads <= 0)
+	{
+		threads = std::min(kMaxThreads, rows*cols / kPointsPerThread);
+	}
+	threads = std::max(1, std::min(threads, rows));
+	if(threads == 1)
+	{
+		return kernel.process(0, rows);
+	}
+
+	std::vector<RowsThread*> rowsThreads(threads);
+	int rowsPerThread = rows / threads;
+	for(int i=0; i<threads; ++i)
+	{
+		rowsThreads[i] = new RowsThread(kernel, i*rowsPerThread, i==threads-1?rows:(i+1)*rowsPerThread);
+		rowsThreads[i]->start();
+	}
+	int count = 0;
+	for(int i=0; i<threads; ++i)
+	{
+		rowsThreads[i]->join();
+		count += rowsThreads[i]->count();
+		delete rowsThreads[i];
+	}
+	return count;
+}
+
+} // namespace rtabmap
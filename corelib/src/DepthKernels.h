@@ -0,0 +1,114 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <opencv2/core/core.hpp>
+
+namespace rtabmap
+{
+
+/**
+ * Projection in 3D of the rows of a depth image (CV_16UC1 in mm or
+ * CV_32FC1 in meters) or a disparity image (CV_16SC1 with 4 fractional
+ * bits or CV_32FC1). A row of the decimated image is written in three
+ * arrays x, y and z (structure of arrays). Pixels without valid depth,
+ * or farther than maxDepth if maxDepth > 0, give NaN points.
+ *
+ * Without decimation, pixels are converted 8 at the time with AVX2 or
+ * 4 at the time with SSE2 when the compiler targets them.
+ */
+class RTABMAP_EXP DepthProjector
+{
+public:
+	static DepthProjector fromDepth(
+			const cv::Mat & depth,
+			float cx, float cy, // if <= 0, the center of the image is used
+			float fx, float fy,
+			int decimation,
+			float maxDepth);
+	static DepthProjector fromDisparity(
+			const cv::Mat & disparity,
+			float cx, float cy,
+			float fx, float baseline,
+			int decimation,
+			float maxDepth);
+
+	int rows() const {return _rows;} // of the decimated image
+	int cols() const {return _cols;} // of the decimated image
+
+	/**
+	 * Project the row "row" of the decimated image in x, y and z
+	 * (cols() floats each). Return the number of valid points.
+	 */
+	int project(int row, float * x, float * y, float * z) const;
+
+private:
+	DepthProjector();
+	template<typename T>
+	int projectDepthRow(const T * row, float v, float * x, float * y, float * z) const;
+	template<typename T>
+	int projectDisparityRow(const T * row, float v, float * x, float * y, float * z) const;
+
+private:
+	cv::Mat _image;
+	bool _disparity;
+	int _decimation;
+	int _rows;
+	int _cols;
+	float _scale; // raw value to depth (m) or disparity (pixels)
+	float _cx;
+	float _cy;
+	float _fxInv; // depth
+	float _fyInv; // depth
+	float _fx; // disparity
+	float _baseline; // disparity
+	float _maxDepth; // FLT_MAX if not set
+};
+
+/**
+ * Work done on a band of rows by processRows().
+ */
+class RTABMAP_EXP RowsKernel
+{
+public:
+	virtual ~RowsKernel() {}
+	// Process the rows [first, end), return the number of valid points
+	virtual int process(int first, int end) const = 0;
+};
+
+/**
+ * Process the rows [0, rows) of an image of rows*cols points in bands
+ * of consecutive rows done in parallel. If threads <= 0, the number of
+ * threads is chosen from the number of points (small images are done
+ * in the calling thread). Return the sum of the valid points.
+ */
+int RTABMAP_EXP processRows(const RowsKernel & kernel, int rows, int cols, int threads = 0);
+
+} // namespace rtabmap
@@ -0,0 +1,203 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "DescriptorSlab.h"
+#include "VisualWord.h"
+
+#include <rtabmap/utilite/ULogger.h>
+
+#include <algorithm>
+#include <string.h>
+
+namespace rtabmap
+{
+
+// Rows allocated the first time
+static const int kSlabMinCapacity = 1024;
+
+DescriptorSlab::DescriptorSlab() :
+	_rows(0)
+{
+}
+
+DescriptorSlab::~DescriptorSlab()
+{
+	this->clear();
+}
+
+bool DescriptorSlab::add(VisualWord * word)
+{
+	UASSERT(word != 0);
+	if(word->_slab == this)
+	{
+		return true;
+	}
+	UASSERT(word->_slab == 0);
+
+	const cv::Mat & descriptor = word->_descriptor;
+	if(descriptor.rows != 1 || (descriptor.type() != CV_32F && descriptor.type() != CV_8U))
+	{
+		return false;
+	}
+	if(this->size() == 0 && !_data.empty() && (descriptor.cols != _data.cols || descriptor.type() != _data.type()))
+	{
+		// no words anymore in the slab, start again with the new descriptor format
+		this->clear();
+	}
+	if(_data.empty())
+	{
+		_data = cv::Mat(kSlabMinCapacity, descriptor.cols, descriptor.type());
+		_words.resize(_data.rows, (VisualWord*)0);
+	}
+	else if(descriptor.cols != _data.cols || descriptor.type() != _data.type())
+	{
+		return false;
+	}
+
+	int index;
+	if(_freeRows.size())
+	{
+		index = _freeRows.back();
+		_freeRows.pop_back();
+	}
+	else
+	{
+		if(_rows == _data.rows)
+		{
+			this->reserve(_data.rows*2);
+		}
+		index = _rows++;
+	}
+
+	descriptor.copyTo(_data.row(index));
+	_words[index] = word;
+	word->_slab = this;
+	word->_row = index;
+	word->_descriptor = cv::Mat(); // the row is the only copy
+	return true;
+}
+
+void DescriptorSlab::remove(VisualWord * word, bool keepDescriptor)
+{
+	UASSERT(word != 0);
+	if(word->_slab != this)
+	{
+		return;
+	}
+	UASSERT(word->_row >= 0 && word->_row < _rows && _words[word->_row] == word);
+
+	if(keepDescriptor)
+	{
+		word->_descriptor = _data.row(word->_row).clone();
+	}
+	_words[word->_row] = 0;
+	_releasedRows.push_back(word->_row);
+	word->_slab = 0;
+	word->_row = -1;
+}
+
+void DescriptorSlab::recycle()
+{
+	_freeRows.insert(_freeRows.end(), _releasedRows.begin(), _releasedRows.end());
+	_releasedRows.clear();
+}
+
+void DescriptorSlab::compact()
+{
+	this->recycle();
+	if(_freeRows.empty())
+	{
+		return;
+	}
+
+	// Fill the holes (from the first) with the last rows
+	int freeRows = (int)_freeRows.size();
+	std::sort(_freeRows.begin(), _freeRows.end());
+	size_t rowBytes = _data.cols * _data.elemSize();
+	for(unsigned int i=0; i<_freeRows.size(); ++i)
+	{
+		while(_rows > 0 && _words[_rows-1] == 0)
+		{
+			--_rows;
+		}
+		if(_freeRows[i] >= _rows)
+		{
+			break;
+		}
+		int last = _rows-1;
+		int hole = _freeRows[i];
+		memcpy(_data.ptr(hole), _data.ptr(last), rowBytes);
+		_words[hole] = _words[last];
+		_words[hole]->_row = hole;
+		_words[last] = 0;
+		--_rows;
+	}
+	while(_rows > 0 && _words[_rows-1] == 0)
+	{
+		--_rows;
+	}
+	_freeRows.clear();
+
+	// Give back memory if the slab is mostly empty
+	if(_data.rows > kSlabMinCapacity && _rows*4 < _data.rows)
+	{
+		this->reserve(std::max(_rows*2, kSlabMinCapacity));
+	}
+	UDEBUG("Compacted %d free rows (rows=%d, capacity=%d)", freeRows, _rows, _data.rows);
+}
+
+void DescriptorSlab::clear()
+{
+	for(int i=0; i<_rows; ++i)
+	{
+		if(_words[i])
+		{
+			_words[i]->_slab = 0;
+			_words[i]->_row = -1;
+		}
+	}
+	_data = cv::Mat();
+	_rows = 0;
+	_words.clear();
+	_freeRows.clear();
+	_releasedRows.clear();
+}
+
+void DescriptorSlab::reserve(int capacity)
+{
+	UASSERT(capacity >= _rows);
+	// The old matrix stays valid while an index is built on it
+	cv::Mat data(capacity, _data.cols, _data.type());
+	if(_rows)
+	{
+		_data.rowRange(0, _rows).copyTo(data.rowRange(0, _rows));
+	}
+	_data = data;
+	_words.resize(capacity, (VisualWord*)0);
+}
+
+} // namespace rtabmap
@@ -0,0 +1,89 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+namespace rtabmap
+{
+
+class VisualWord;
+
+/**
+ * Descriptors of the visual words stored row by row in one contiguous
+ * growable matrix. A word added to the slab keeps only its row: its own
+ * descriptor is released. A removed word gets back its own copy of
+ * the descriptor, so it can still be saved after the row is reused.
+ *
+ * Rows of removed words are not reused before recycle() is called,
+ * so a search index built on data() stays valid until then.
+ */
+class RTABMAP_EXP DescriptorSlab
+{
+public:
+	DescriptorSlab();
+	~DescriptorSlab();
+
+	/**
+	 * Move the descriptor of the word in the slab. Return false if the descriptor
+	 * has not the same size or type than the others (the word keeps its descriptor).
+	 */
+	bool add(VisualWord * word);
+	void remove(VisualWord * word, bool keepDescriptor = true); // the word gets back its own descriptor
+	void recycle(); // rows of removed words can be reused
+	void compact(); // recycle, then move the last rows in the free rows so that all rows are used
+	void clear(); // words still in the slab lose their descriptor
+
+	cv::Mat row(int index) const {return _data.row(index);}
+	cv::Mat data() const {return _data.rowRange(0, _rows);} // not copied
+	const VisualWord * word(int index) const {return _words[index];} // null if the row is free
+	int rows() const {return _rows;}
+	int size() const {return _rows - (int)_freeRows.size() - (int)_releasedRows.size();}
+	int capacity() const {return _data.rows;}
+	bool isDense() const {return _freeRows.empty() && _releasedRows.empty();}
+	int dim() const {return _data.cols;}
+	int type() const {return _data.type();}
+
+private:
+	DescriptorSlab(const DescriptorSlab &);
+	DescriptorSlab & operator=(const DescriptorSlab &);
+
+	void reserve(int capacity);
+
+private:
+	cv::Mat _data;
+	int _rows; // rows used in _data, including free rows
+	std::vector<VisualWord *> _words; // word of each row
+	std::vector<int> _freeRows; // can be reused
+	std::vector<int> _releasedRows; // free rows still indexed
+};
+
+} // namespace rtabmap
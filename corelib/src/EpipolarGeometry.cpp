@@ -434,6 +434,38 @@ int EpipolarGeometry::findPairs(const std::multimap<int, cv::KeyPoint> & wordsA,
 	return realPairsCount;
 }
 
+int EpipolarGeometry::findPairs(
+		const FlatWords<cv::KeyPoint> & wordsA,
+		const FlatWords<cv::KeyPoint> & wordsB,
+		std::list<std::pair<int, std::pair<cv::KeyPoint, cv::KeyPoint> > > & pairs)
+{
+	const std::vector<int> & idsA = wordsA.ids();
+	const std::vector<int> & idsB = wordsB.ids();
+	pairs.clear();
+	int realPairsCount = 0;
+	unsigned int a = 0;
+	unsigned int b = 0;
+	while(a < idsA.size() && b < idsB.size())
+	{
+		if(idsA[a] < idsB[b])
+		{
+			++a;
+		}
+		else if(idsB[b] < idsA[a])
+		{
+			++b;
+		}
+		else
+		{
+			pairs.push_back(std::pair<int, std::pair<cv::KeyPoint, cv::KeyPoint> >(idsA[a], std::pair<cv::KeyPoint, cv::KeyPoint>(wordsA.value(a), wordsB.value(b))));
+			++a;
+			++b;
+			++realPairsCount;
+		}
+	}
+	return realPairsCount;
+}
+
 /**
  * if a=[1 2 3 4 6 6], b=[1 1 2 4 5 6 6], results= [(2,2) (4,4)]
  * realPairsCount = 5
@@ -464,6 +496,60 @@ int EpipolarGeometry::findPairsUnique(
 	return realPairsCount;
 }
 
+int EpipolarGeometry::findPairsUnique(
+		const FlatWords<cv::KeyPoint> & wordsA,
+		const FlatWords<cv::KeyPoint> & wordsB,
+		std::list<std::pair<int, std::pair<cv::KeyPoint, cv::KeyPoint> > > & pairs)
+{
+	const std::vector<int> & idsA = wordsA.ids();
+	const std::vector<int> & idsB = wordsB.ids();
+	int realPairsCount = 0;
+	pairs.clear();
+	unsigned int a = 0;
+	unsigned int b = 0;
+	while(a < idsA.size() && b < idsB.size())
+	{
+		if(idsA[a] < idsB[b])
+		{
+			++a;
+		}
+		else if(idsB[b] < idsA[a])
+		{
+			++b;
+		}
+		else
+		{
+			// same id, get the occurrences in both
+			int id = idsA[a];
+			unsigned int endA = a+1;
+			unsigned int endB = b+1;
+			while(endA < idsA.size() && idsA[endA] == id)
+			{
+				++endA;
+			}
+			while(endB < idsB.size() && idsB[endB] == id)
+			{
+				++endB;
+			}
+			unsigned int nA = endA - a;
+			unsigned int nB = endB - b;
+			if(nA == 1 && nB == 1)
+			{
+				pairs.push_back(std::pair<int, std::pair<cv::KeyPoint, cv::KeyPoint> >(id, std::pair<cv::KeyPoint, cv::KeyPoint>(wordsA.value(a), wordsB.value(b))));
+				++realPairsCount;
+			}
+			else if(nA>1 && nB>1)
+			{
+				// just update the count
+				realPairsCount += nA > nB ? nB : nA;
+			}
+			a = endA;
+			b = endB;
+		}
+	}
+	return realPairsCount;
+}
+
 /**
  * if a=[1 2 3 4 6 6], b=[1 1 2 4 5 6 6], results= [(1,1a) (1,1b) (2,2) (4,4) (6a,6a) (6a,6b) (6b,6a) (6b,6b)]
  * realPairsCount = 5
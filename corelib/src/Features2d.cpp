@@ -33,6 +33,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/utilite/UMath.h"
 #include "rtabmap/utilite/ULogger.h"
 #include "rtabmap/utilite/UTimer.h"
+#include "rtabmap/utilite/UThreadNode.h"
 #include <opencv2/imgproc/imgproc_c.h>
 #include <opencv2/gpu/gpu.hpp>
 #include <opencv2/core/version.hpp>
@@ -315,18 +316,91 @@ cv::Rect Feature2D::computeRoi(const cv::Mat & image, const std::vector<float> &
 		return cv::Rect();
 	}
 }
+// Extract the keypoints of the tiles first, first+step, first+2*step...
+class KeypointsTilesThread : public UThreadNode
+{
+public:
+	KeypointsTilesThread(
+			const Feature2D * feature2D,
+			const cv::Mat & image,
+			const std::vector<cv::Rect> & tiles,
+			int first,
+			int step,
+			std::vector<std::vector<cv::KeyPoint> > & keypoints) :
+		_feature2D(feature2D),
+		_image(image),
+		_tiles(tiles),
+		_first(first),
+		_step(step),
+		_keypoints(keypoints)
+	{}
+	virtual ~KeypointsTilesThread() {}
+private:
+	void mainLoop() {
+		// each thread writes only the keypoints of its own tiles
+		for(int i=_first; i<(int)_tiles.size(); i+=_step)
+		{
+			_keypoints[i] = _feature2D->generateKeypointsImpl(_image, _tiles[i]);
+		}
+		this->kill();
+	}
+	const Feature2D * _feature2D;
+	const cv::Mat & _image;
+	const std::vector<cv::Rect> & _tiles;
+	int _first;
+	int _step;
+	std::vector<std::vector<cv::KeyPoint> > & _keypoints;
+};
+
+// Compute the descriptors of a range of keypoints
+class DescriptorsThread : public UThreadNode
+{
+public:
+	DescriptorsThread(
+			const Feature2D * feature2D,
+			const cv::Mat & image,
+			const std::vector<cv::KeyPoint>::const_iterator & begin,
+			const std::vector<cv::KeyPoint>::const_iterator & end) :
+		_feature2D(feature2D),
+		_image(image),
+		_keypoints(begin, end)
+	{}
+	virtual ~DescriptorsThread() {}
+	const std::vector<cv::KeyPoint> & keypoints() const {return _keypoints;} // keypoints without descriptor are removed
+	const cv::Mat & descriptors() const {return _descriptors;}
+private:
+	void mainLoop() {
+		_descriptors = _feature2D->generateDescriptorsImpl(_image, _keypoints);
+		this->kill();
+	}
+	const Feature2D * _feature2D;
+	const cv::Mat & _image;
+	std::vector<cv::KeyPoint> _keypoints;
+	cv::Mat _descriptors;
+};
 
 /////////////////////
 // Feature2D
 /////////////////////
 Feature2D::Feature2D(const ParametersMap & parameters) :
-		maxFeatures_(Parameters::defaultKpWordsPerImage())
+		maxFeatures_(Parameters::defaultKpWordsPerImage()),
+		gridRows_(Parameters::defaultKpGridRows()),
+		gridCols_(Parameters::defaultKpGridCols()),
+		gridOverlap_(Parameters::defaultKpGridOverlap()),
+		extractionThreads_(Parameters::defaultKpExtractionThreads())
 {
 	this->parseParameters(parameters);
 }
 void Feature2D::parseParameters(const ParametersMap & parameters)
 {
 	Parameters::parse(parameters, Parameters::kKpWordsPerImage(), maxFeatures_);
+	Parameters::parse(parameters, Parameters::kKpGridRows(), gridRows_);
+	Parameters::parse(parameters, Parameters::kKpGridCols(), gridCols_);
+	Parameters::parse(parameters, Parameters::kKpGridOverlap(), gridOverlap_);
+	Parameters::parse(parameters, Parameters::kKpExtractionThreads(), extractionThreads_);
+	UASSERT(gridRows_ >= 1 && gridCols_ >= 1);
+	UASSERT(gridOverlap_ >= 0);
+	UASSERT(extractionThreads_ >= 1);
 }
 Feature2D * Feature2D::create(Feature2D::Type & type, const ParametersMap & parameters)
 {
@@ -386,7 +460,15 @@ std::vector<cv::KeyPoint> Feature2D::generateKeypoints(const cv::Mat & image, co
 		UTimer timer;
 
 		// Get keypoints
-		keypoints = this->generateKeypointsImpl(image, roi.width && roi.height?roi:cv::Rect(0,0,image.cols, image.rows));
+		cv::Rect globalRoi = roi.width && roi.height?roi:cv::Rect(0,0,image.cols, image.rows);
+		if(gridRows_ > 1 || gridCols_ > 1)
+		{
+			keypoints = this->generateKeypointsTiled(image, globalRoi);
+		}
+		else
+		{
+			keypoints = this->generateKeypointsImpl(image, globalRoi);
+		}
 		ULOGGER_DEBUG("Keypoints extraction time = %f s, keypoints extracted = %d", timer.ticks(), keypoints.size());
 
 		limitKeypoints(keypoints, maxFeatures_);
@@ -416,12 +498,118 @@ std::vector<cv::KeyPoint> Feature2D::generateKeypoints(const cv::Mat & image, co
 
 cv::Mat Feature2D::generateDescriptors(const cv::Mat & image, std::vector<cv::KeyPoint> & keypoints) const
 {
-	cv::Mat descriptors = generateDescriptorsImpl(image, keypoints);
+	cv::Mat descriptors;
+	int threads = this->isDescriptorsThreadSafe()?std::min(extractionThreads_, (int)keypoints.size()):1;
+	if(threads > 1)
+	{
+		UTimer timer;
+		std::vector<DescriptorsThread*> descriptorsThreads(threads);
+		int keypointsPerThread = (int)keypoints.size() / threads;
+		for(int i=0; i<threads; ++i)
+		{
+			descriptorsThreads[i] = new DescriptorsThread(
+					this,
+					image,
+					keypoints.begin() + i*keypointsPerThread,
+					i==threads-1?keypoints.end():keypoints.begin() + (i+1)*keypointsPerThread);
+			descriptorsThreads[i]->start();
+		}
+
+		// Put back the ranges in order, the extractor may have removed some keypoints
+		keypoints.clear();
+		for(int i=0; i<threads; ++i)
+		{
+			descriptorsThreads[i]->join();
+			keypoints.insert(keypoints.end(), descriptorsThreads[i]->keypoints().begin(), descriptorsThreads[i]->keypoints().end());
+			if(descriptorsThreads[i]->descriptors().rows)
+			{
+				descriptors.push_back(descriptorsThreads[i]->descriptors());
+			}
+			delete descriptorsThreads[i];
+		}
+		UDEBUG("Descriptors computed with %d threads (%f s)", threads, timer.ticks());
+	}
+	else
+	{
+		descriptors = generateDescriptorsImpl(image, keypoints);
+	}
 	UASSERT_MSG(descriptors.rows == (int)keypoints.size(), uFormat("descriptors=%d, keypoints=%d", descriptors.rows, (int)keypoints.size()).c_str());
 	UDEBUG("Descriptors extracted = %d, remaining kpts=%d", descriptors.rows, (int)keypoints.size());
 	return descriptors;
 }
 
+// Return the keypoints relative to the roi, like generateKeypointsImpl()
+std::vector<cv::KeyPoint> Feature2D::generateKeypointsTiled(const cv::Mat & image, const cv::Rect & roi) const
+{
+	// The roi is split in a grid of cells, each cell is extracted in a tile
+	// which is the cell with the overlap on each side (inside the roi).
+	int rows = std::min(gridRows_, roi.height);
+	int cols = std::min(gridCols_, roi.width);
+	std::vector<cv::Rect> cells(rows*cols);
+	std::vector<cv::Rect> tiles(rows*cols);
+	for(int i=0; i<rows; ++i)
+	{
+		int y = roi.y + i*roi.height/rows;
+		int height = roi.y + (i+1)*roi.height/rows - y;
+		int top = std::max(roi.y, y-gridOverlap_);
+		int bottom = std::min(roi.y+roi.height, y+height+gridOverlap_);
+		for(int j=0; j<cols; ++j)
+		{
+			int x = roi.x + j*roi.width/cols;
+			int width = roi.x + (j+1)*roi.width/cols - x;
+			int left = std::max(roi.x, x-gridOverlap_);
+			int right = std::min(roi.x+roi.width, x+width+gridOverlap_);
+			cells[i*cols+j] = cv::Rect(x, y, width, height);
+			tiles[i*cols+j] = cv::Rect(left, top, right-left, bottom-top);
+		}
+	}
+
+	std::vector<std::vector<cv::KeyPoint> > tilesKeypoints(tiles.size());
+	int threads = this->isKeypointsThreadSafe()?std::min(extractionThreads_, (int)tiles.size()):1;
+	if(threads > 1)
+	{
+		std::vector<KeypointsTilesThread*> keypointsThreads(threads);
+		for(int i=0; i<threads; ++i)
+		{
+			keypointsThreads[i] = new KeypointsTilesThread(this, image, tiles, i, threads, tilesKeypoints);
+			keypointsThreads[i]->start();
+		}
+		for(int i=0; i<threads; ++i)
+		{
+			keypointsThreads[i]->join();
+			delete keypointsThreads[i];
+		}
+	}
+	else
+	{
+		for(unsigned int i=0; i<tiles.size(); ++i)
+		{
+			tilesKeypoints[i] = this->generateKeypointsImpl(image, tiles[i]);
+		}
+	}
+
+	// Keep only the keypoints inside the cell of their tile, so that
+	// a keypoint detected in the overlap of two tiles is not duplicated.
+	std::vector<cv::KeyPoint> keypoints;
+	for(unsigned int i=0; i<tiles.size(); ++i)
+	{
+		const cv::Rect & cell = cells[i];
+		for(std::vector<cv::KeyPoint>::iterator iter=tilesKeypoints[i].begin(); iter!=tilesKeypoints[i].end(); ++iter)
+		{
+			float x = iter->pt.x + tiles[i].x;
+			float y = iter->pt.y + tiles[i].y;
+			if(x >= cell.x && x < cell.x+cell.width && y >= cell.y && y < cell.y+cell.height)
+			{
+				iter->pt.x = x - roi.x;
+				iter->pt.y = y - roi.y;
+				keypoints.push_back(*iter);
+			}
+		}
+	}
+	UDEBUG("Keypoints extracted in %d tiles (%dx%d) with %d threads = %d", (int)tiles.size(), rows, cols, threads, (int)keypoints.size());
+	return keypoints;
+}
+
 //////////////////////////
 //SURF
 //////////////////////////
@@ -0,0 +1,311 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/FlatGraph.h"
+
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UConversion.h>
+
+#include <algorithm>
+
+namespace rtabmap {
+
+FlatGraph::FlatGraph() :
+	_offsets(1, 0),
+	_finalized(true)
+{
+}
+
+FlatGraph::FlatGraph(const std::map<int, Transform> & poses, const std::multimap<int, Link> & links) :
+	_offsets(1, 0),
+	_finalized(true)
+{
+	this->reserve((int)poses.size(), (int)links.size());
+	for(std::map<int, Transform>::const_iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+	{
+		this->addNode(iter->first, iter->second);
+	}
+	for(std::multimap<int, Link>::const_iterator iter=links.begin(); iter!=links.end(); ++iter)
+	{
+		this->addLink(iter->second);
+		_links.back().setFrom(iter->first);
+	}
+	this->finalize();
+}
+
+void FlatGraph::clear()
+{
+	_ids.clear();
+	_poses.clear();
+	_offsets.resize(1);
+	_links.clear();
+	_linksTo.clear();
+	_finalized = true;
+}
+
+void FlatGraph::reserve(int nodes, int links)
+{
+	_ids.reserve(nodes);
+	_poses.reserve(nodes);
+	_offsets.reserve(nodes+1);
+	_links.reserve(links);
+	_linksTo.reserve(links);
+}
+
+void FlatGraph::addNode(int id, const Transform & pose)
+{
+	_ids.push_back(id);
+	_poses.push_back(pose);
+	_finalized = false;
+}
+
+void FlatGraph::addLink(const Link & link)
+{
+	_links.push_back(link);
+	_finalized = false;
+}
+
+void FlatGraph::finalize()
+{
+	if(_finalized)
+	{
+		return;
+	}
+
+	// Nodes, usually already sorted
+	bool sorted = true;
+	for(unsigned int i=1; i<_ids.size() && sorted; ++i)
+	{
+		sorted = _ids[i-1] < _ids[i];
+	}
+	if(!sorted)
+	{
+		std::vector<std::pair<int, int> > order(_ids.size());
+		for(unsigned int i=0; i<_ids.size(); ++i)
+		{
+			order[i] = std::make_pair(_ids[i], i);
+		}
+		std::sort(order.begin(), order.end());
+		std::vector<Transform> poses(_poses.size());
+		for(unsigned int i=0; i<order.size(); ++i)
+		{
+			UASSERT_MSG(i==0 || order[i-1].first != order[i].first, uFormat("Node %d added twice!", order[i].first).c_str());
+			_ids[i] = order[i].first;
+			poses[i] = _poses[order[i].second];
+		}
+		_poses.swap(poses);
+	}
+
+	// Links, grouped by "from" node with a stable counting sort
+	std::vector<int> from(_links.size());
+	_offsets.assign(_ids.size()+1, 0);
+	int ignored = 0;
+	for(unsigned int k=0; k<_links.size(); ++k)
+	{
+		from[k] = this->index(_links[k].from());
+		if(from[k] >= 0)
+		{
+			++_offsets[from[k]+1];
+		}
+		else
+		{
+			++ignored;
+		}
+	}
+	for(unsigned int i=1; i<_offsets.size(); ++i)
+	{
+		_offsets[i] += _offsets[i-1];
+	}
+	std::vector<Link> links(_offsets.back());
+	std::vector<int> next(_offsets.begin(), _offsets.end()-1);
+	for(unsigned int k=0; k<_links.size(); ++k)
+	{
+		if(from[k] >= 0)
+		{
+			links[next[from[k]]++] = _links[k];
+		}
+	}
+	_links.swap(links);
+	_linksTo.resize(_links.size());
+	for(unsigned int k=0; k<_links.size(); ++k)
+	{
+		_linksTo[k] = this->index(_links[k].to());
+	}
+	if(ignored)
+	{
+		UWARN("%d links ignored, their \"from\" node is not in the graph", ignored);
+	}
+	_finalized = true;
+}
+
+int FlatGraph::index(int id) const
+{
+	std::vector<int>::const_iterator iter = std::lower_bound(_ids.begin(), _ids.end(), id);
+	if(iter != _ids.end() && *iter == id)
+	{
+		return int(iter - _ids.begin());
+	}
+	return -1;
+}
+
+void FlatGraph::setPoses(const std::vector<Transform> & poses)
+{
+	UASSERT(poses.size() == _poses.size());
+	_poses = poses;
+}
+
+int FlatGraph::removeNullPoses()
+{
+	UASSERT(_finalized);
+	std::vector<int> indices(_ids.size(), -1); // old -> new
+	int n = 0;
+	for(unsigned int i=0; i<_ids.size(); ++i)
+	{
+		if(!_poses[i].isNull())
+		{
+			indices[i] = n;
+			_ids[n] = _ids[i];
+			_poses[n] = _poses[i];
+			++n;
+		}
+	}
+	int removed = (int)_ids.size() - n;
+	if(removed == 0)
+	{
+		return 0;
+	}
+
+	int l = 0;
+	for(unsigned int i=0; i<indices.size(); ++i)
+	{
+		int begin = _offsets[i];
+		int end = _offsets[i+1];
+		if(indices[i] >= 0)
+		{
+			_offsets[indices[i]] = l;
+			for(int k=begin; k<end; ++k)
+			{
+				if(_linksTo[k] < 0 || indices[_linksTo[k]] >= 0)
+				{
+					_links[l] = _links[k];
+					_linksTo[l] = _linksTo[k] < 0?-1:indices[_linksTo[k]];
+					++l;
+				}
+			}
+		}
+	}
+	_ids.resize(n);
+	_poses.resize(n);
+	_offsets.resize(n+1);
+	_offsets[n] = l;
+	_links.resize(l);
+	_linksTo.resize(l);
+	return removed;
+}
+
+int FlatGraph::findLink(int from, int to) const
+{
+	UASSERT(_finalized);
+	int i = this->index(from);
+	if(i >= 0)
+	{
+		for(int k=_offsets[i]; k<_offsets[i+1]; ++k)
+		{
+			if(_links[k].to() == to)
+			{
+				return k;
+			}
+		}
+	}
+	// let's try to -> from
+	i = this->index(to);
+	if(i >= 0)
+	{
+		for(int k=_offsets[i]; k<_offsets[i+1]; ++k)
+		{
+			if(_links[k].to() == from)
+			{
+				return k;
+			}
+		}
+	}
+	return -1;
+}
+
+void FlatGraph::toMaps(std::map<int, Transform> & poses, std::multimap<int, Link> & links) const
+{
+	this->toMaps(poses);
+	this->appendLinks(links);
+}
+
+void FlatGraph::toMaps(std::map<int, Transform> & poses) const
+{
+	UASSERT(_finalized);
+	for(unsigned int i=0; i<_ids.size(); ++i)
+	{
+		poses.insert(poses.end(), std::make_pair(_ids[i], _poses[i]));
+	}
+}
+
+std::map<int, Transform> FlatGraph::posesMap() const
+{
+	std::map<int, Transform> poses;
+	this->toMaps(poses);
+	return poses;
+}
+
+std::multimap<int, Link> FlatGraph::linksMap() const
+{
+	std::multimap<int, Link> links;
+	this->appendLinks(links);
+	return links;
+}
+
+void FlatGraph::appendLinks(std::multimap<int, Link> & links) const
+{
+	UASSERT(_finalized);
+	for(unsigned int i=0; i<_ids.size(); ++i)
+	{
+		for(int k=_offsets[i]; k<_offsets[i+1]; ++k)
+		{
+			// the hint keeps the order of the links of the same node
+			links.insert(links.end(), std::make_pair(_ids[i], _links[k]));
+		}
+	}
+}
+
+long FlatGraph::memoryUsed() const
+{
+	return sizeof(FlatGraph) +
+			_ids.capacity()*sizeof(int) +
+			_poses.capacity()*sizeof(Transform) +
+			_offsets.capacity()*sizeof(int) +
+			_links.capacity()*sizeof(Link) +
+			_linksTo.capacity()*sizeof(int);
+}
+
+} /* namespace rtabmap */
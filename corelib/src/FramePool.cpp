@@ -0,0 +1,110 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/FramePool.h"
+#include <rtabmap/utilite/ULogger.h>
+
+namespace rtabmap
+{
+
+FramePool::FramePool(int maxBuffers) :
+	_maxBuffers(maxBuffers),
+	_allocations(0)
+{
+	UASSERT(maxBuffers >= 0);
+}
+
+cv::Mat FramePool::acquire(int rows, int cols, int type)
+{
+	UScopeMutex lock(_mutex);
+	int oldest = -1;
+	for(unsigned int i=0; i<_buffers.size(); ++i)
+	{
+		if(!isReferenced(_buffers[i]))
+		{
+			if(_buffers[i].rows == rows && _buffers[i].cols == cols && _buffers[i].type() == type)
+			{
+				return _buffers[i];
+			}
+			else if(oldest < 0)
+			{
+				oldest = i; // free buffer of another size
+			}
+		}
+	}
+
+	cv::Mat buffer(rows, cols, type);
+	++_allocations;
+	if(oldest >= 0)
+	{
+		_buffers[oldest] = buffer;
+	}
+	else if((int)_buffers.size() < _maxBuffers)
+	{
+		_buffers.push_back(buffer);
+	}
+	else
+	{
+		UDEBUG("All %d buffers are referenced, allocating a buffer outside the pool", _maxBuffers);
+	}
+	return buffer;
+}
+
+cv::Mat FramePool::copy(const cv::Mat & image)
+{
+	if(image.empty())
+	{
+		return cv::Mat();
+	}
+	cv::Mat buffer = this->acquire(image.rows, image.cols, image.type());
+	image.copyTo(buffer);
+	return buffer;
+}
+
+void FramePool::clear()
+{
+	UScopeMutex lock(_mutex);
+	_buffers.clear();
+}
+
+int FramePool::buffers() const
+{
+	UScopeMutex lock(_mutex);
+	return (int)_buffers.size();
+}
+
+bool FramePool::isReferenced(const cv::Mat & buffer)
+{
+	// referenced only by the pool if the count is 1
+#if CV_MAJOR_VERSION > 2
+	return buffer.u && CV_XADD(&buffer.u->refcount, 0) > 1;
+#else
+	return buffer.refcount && CV_XADD(buffer.refcount, 0) > 1;
+#endif
+}
+
+} // namespace rtabmap
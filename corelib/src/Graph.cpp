@@ -35,6 +35,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <pcl/common/common.h>
 #include <set>
 #include <queue>
+#include <functional>
 #include "toro3d/treeoptimizer3.hh"
 #include "toro3d/treeoptimizer2.hh"
 
@@ -77,6 +78,9 @@ Optimizer * Optimizer::create(const ParametersMap & parameters)
 	case Optimizer::kTypeG2O:
 		optimizer = new G2OOptimizer(parameters);
 		break;
+	case Optimizer::kTypeIncremental:
+		optimizer = new IncrementalOptimizer(parameters);
+		break;
 	case Optimizer::kTypeTORO:
 	default:
 		optimizer = new TOROOptimizer(parameters);
@@ -100,6 +104,9 @@ Optimizer * Optimizer::create(Optimizer::Type & type, const ParametersMap & para
 	case Optimizer::kTypeG2O:
 		optimizer = new G2OOptimizer(parameters);
 		break;
+	case Optimizer::kTypeIncremental:
+		optimizer = new IncrementalOptimizer(parameters);
+		break;
 	case Optimizer::kTypeTORO:
 	default:
 		optimizer = new TOROOptimizer(parameters);
@@ -132,6 +139,35 @@ void Optimizer::parseParameters(const ParametersMap & parameters)
 	Parameters::parse(parameters, Parameters::kRGBDOptimizeSlam2D(), slam2d_);
 }
 
+std::vector<Transform> Optimizer::optimize(
+		int rootId,
+		const FlatGraph & graph,
+		std::list<std::map<int, Transform> > * intermediateGraphes)
+{
+	UASSERT(graph.isFinalized());
+	std::map<int, Transform> poses;
+	std::multimap<int, Link> links;
+	graph.toMaps(poses, links);
+	std::map<int, Transform> optimizedPoses = this->optimize(rootId, poses, links, intermediateGraphes);
+
+	std::vector<Transform> output;
+	if(optimizedPoses.size())
+	{
+		// both sorted by id
+		output.resize(graph.size());
+		std::map<int, Transform>::iterator iter = optimizedPoses.begin();
+		for(int i=0; i<graph.size() && iter!=optimizedPoses.end(); ++i)
+		{
+			if(iter->first == graph.id(i))
+			{
+				output[i] = iter->second;
+				++iter;
+			}
+		}
+	}
+	return output;
+}
+
 void Optimizer::getConnectedGraph(
 		int fromId,
 		const std::map<int, Transform> & posesIn,
@@ -876,6 +912,223 @@ std::map<int, Transform> G2OOptimizer::optimize(
 	return optimizedPoses;
 }
 
+////////////////////////////////////////////
+// Spatial index
+////////////////////////////////////////////
+PosesIndex::PosesIndex(float cellSize) :
+	_cellSize(cellSize)
+{
+	UASSERT(_cellSize > 0.0f);
+}
+
+void PosesIndex::setCellSize(float cellSize)
+{
+	UASSERT(cellSize > 0.0f);
+	if(cellSize != _cellSize)
+	{
+		_cellSize = cellSize;
+		_cells.clear();
+		for(std::map<int, Transform>::iterator iter=_poses.begin(); iter!=_poses.end(); ++iter)
+		{
+			this->addToCell(iter->first, iter->second);
+		}
+	}
+}
+
+void PosesIndex::update(int id, const Transform & pose)
+{
+	std::map<int, Transform>::iterator iter = _poses.find(id);
+	if(iter == _poses.end())
+	{
+		this->addToCell(id, pose);
+		_poses.insert(std::make_pair(id, pose));
+	}
+	else
+	{
+		this->move(iter, pose);
+	}
+}
+
+void PosesIndex::update(const std::map<int, Transform> & poses)
+{
+	// Both maps are sorted by id: walk them together, removing the
+	// poses not in the new map and moving the others in place.
+	std::map<int, Transform>::iterator jter = _poses.begin();
+	for(std::map<int, Transform>::const_iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+	{
+		while(jter != _poses.end() && jter->first < iter->first)
+		{
+			this->removeFromCell(jter->first, jter->second);
+			_poses.erase(jter++);
+		}
+		if(jter != _poses.end() && jter->first == iter->first)
+		{
+			this->move(jter++, iter->second);
+		}
+		else
+		{
+			this->addToCell(iter->first, iter->second);
+			_poses.insert(jter, *iter);
+		}
+	}
+	while(jter != _poses.end())
+	{
+		this->removeFromCell(jter->first, jter->second);
+		_poses.erase(jter++);
+	}
+}
+
+void PosesIndex::remove(int id)
+{
+	std::map<int, Transform>::iterator iter = _poses.find(id);
+	if(iter != _poses.end())
+	{
+		this->removeFromCell(iter->first, iter->second);
+		_poses.erase(iter);
+	}
+}
+
+void PosesIndex::clear()
+{
+	_poses.clear();
+	_cells.clear();
+}
+
+int PosesIndex::radiusSearch(
+		const Transform & pose,
+		float radius,
+		std::vector<int> & ids,
+		std::vector<float> & sqrDistances,
+		int maxNeighbors) const
+{
+	ids.clear();
+	sqrDistances.clear();
+	if(radius <= 0.0f || _poses.empty())
+	{
+		return 0;
+	}
+
+	Entry query(0, pose);
+	float sqrRadius = radius*radius;
+	Cell minCell = this->cell(query.x-radius, query.y-radius, query.z-radius);
+	Cell maxCell = this->cell(query.x+radius, query.y+radius, query.z+radius);
+	std::vector<std::pair<float, int> > found; // <squared distance, id>
+	double cellsInRange = double(maxCell.x-minCell.x+1) * double(maxCell.y-minCell.y+1) * double(maxCell.z-minCell.z+1);
+	if(cellsInRange <= (double)_cells.size())
+	{
+		for(int x=minCell.x; x<=maxCell.x; ++x)
+		{
+			for(int y=minCell.y; y<=maxCell.y; ++y)
+			{
+				for(int z=minCell.z; z<=maxCell.z; ++z)
+				{
+					std::map<Cell, std::vector<Entry> >::const_iterator iter = _cells.find(Cell(x,y,z));
+					if(iter != _cells.end())
+					{
+						this->search(query, iter->second, sqrRadius, found);
+					}
+				}
+			}
+		}
+	}
+	else
+	{
+		// The radius covers more cells than the ones used
+		for(std::map<Cell, std::vector<Entry> >::const_iterator iter=_cells.begin(); iter!=_cells.end(); ++iter)
+		{
+			if(iter->first.x >= minCell.x && iter->first.x <= maxCell.x &&
+			   iter->first.y >= minCell.y && iter->first.y <= maxCell.y &&
+			   iter->first.z >= minCell.z && iter->first.z <= maxCell.z)
+			{
+				this->search(query, iter->second, sqrRadius, found);
+			}
+		}
+	}
+
+	std::sort(found.begin(), found.end());
+	if(maxNeighbors > 0 && (int)found.size() > maxNeighbors)
+	{
+		found.resize(maxNeighbors);
+	}
+	ids.resize(found.size());
+	sqrDistances.resize(found.size());
+	for(unsigned int i=0; i<found.size(); ++i)
+	{
+		ids[i] = found[i].second;
+		sqrDistances[i] = found[i].first;
+	}
+	return (int)found.size();
+}
+
+PosesIndex::Cell PosesIndex::cell(float x, float y, float z) const
+{
+	return Cell(int(std::floor(x/_cellSize)), int(std::floor(y/_cellSize)), int(std::floor(z/_cellSize)));
+}
+
+void PosesIndex::move(std::map<int, Transform>::iterator iter, const Transform & pose)
+{
+	if(this->cell(iter->second) == this->cell(pose))
+	{
+		std::vector<Entry> & entries = _cells.at(this->cell(pose));
+		for(unsigned int i=0; i<entries.size(); ++i)
+		{
+			if(entries[i].id == iter->first)
+			{
+				entries[i] = Entry(iter->first, pose);
+				break;
+			}
+		}
+	}
+	else
+	{
+		this->removeFromCell(iter->first, iter->second);
+		this->addToCell(iter->first, pose);
+	}
+	iter->second = pose;
+}
+
+void PosesIndex::addToCell(int id, const Transform & pose)
+{
+	UASSERT_MSG(uIsFinite(pose.x()) && uIsFinite(pose.y()) && uIsFinite(pose.z()),
+			uFormat("Invalid pose (%d) %s", id, pose.prettyPrint().c_str()).c_str());
+	_cells[this->cell(pose)].push_back(Entry(id, pose));
+}
+
+void PosesIndex::removeFromCell(int id, const Transform & pose)
+{
+	std::map<Cell, std::vector<Entry> >::iterator iter = _cells.find(this->cell(pose));
+	UASSERT(iter != _cells.end());
+	std::vector<Entry> & entries = iter->second;
+	for(unsigned int i=0; i<entries.size(); ++i)
+	{
+		if(entries[i].id == id)
+		{
+			entries[i] = entries.back();
+			entries.pop_back();
+			break;
+		}
+	}
+	if(entries.empty())
+	{
+		_cells.erase(iter);
+	}
+}
+
+void PosesIndex::search(const Entry & query, const std::vector<Entry> & entries, float sqrRadius, std::vector<std::pair<float, int> > & found) const
+{
+	for(unsigned int i=0; i<entries.size(); ++i)
+	{
+		float dx = entries[i].x - query.x;
+		float dy = entries[i].y - query.y;
+		float dz = entries[i].z - query.z;
+		float d = dx*dx + dy*dy + dz*dz;
+		if(d <= sqrRadius)
+		{
+			found.push_back(std::make_pair(d, entries[i].id));
+		}
+	}
+}
+
 ////////////////////////////////////////////
 // Graph utilities
 ////////////////////////////////////////////
@@ -943,53 +1196,58 @@ std::map<int, Transform> radiusPosesFiltering(
 {
 	if(poses.size() > 1 && radius > 0.0f)
 	{
-		pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
-		cloud->resize(poses.size());
-		int i=0;
-		for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter, ++i)
-		{
-			(*cloud)[i] = pcl::PointXYZ(iter->second.x(), iter->second.y(), iter->second.z());
-			UASSERT_MSG(pcl::isFinite((*cloud)[i]), uFormat("Invalid pose (%d) %s", iter->first, iter->second.prettyPrint().c_str()).c_str());
-		}
+		PosesIndex index(radius);
+		index.update(poses);
+		return radiusPosesFiltering(index, radius, angle, keepLatest);
+	}
+	else
+	{
+		return poses;
+	}
+}
 
+std::map<int, Transform> radiusPosesFiltering(
+		const PosesIndex & index,
+		float radius,
+		float angle,
+		bool keepLatest)
+{
+	const std::map<int, Transform> & poses = index.poses();
+	if(poses.size() > 1 && radius > 0.0f)
+	{
 		// radius filtering
-		std::vector<int> names = uKeys(poses);
-		std::vector<Transform> transforms = uValues(poses);
-
-		pcl::search::KdTree<pcl::PointXYZ>::Ptr tree (new pcl::search::KdTree<pcl::PointXYZ> (false));
-		tree->setInputCloud(cloud);
-		std::set<int> indicesChecked;
-		std::set<int> indicesKept;
+		std::set<int> idsChecked;
+		std::set<int> idsKept;
 
-		for(unsigned int i=0; i<cloud->size(); ++i)
+		for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter)
 		{
-			if(indicesChecked.find(i) == indicesChecked.end())
+			if(idsChecked.find(iter->first) == idsChecked.end())
 			{
-				std::vector<int> kIndices;
+				std::vector<int> kIds;
 				std::vector<float> kDistances;
-				tree->radiusSearch(cloud->at(i), radius, kIndices, kDistances);
+				index.radiusSearch(iter->second, radius, kIds, kDistances);
 
-				std::set<int> cloudIndices;
-				const Transform & currentT = transforms.at(i);
+				std::set<int> cloudIds;
+				const Transform & currentT = iter->second;
 				Eigen::Vector3f vA = currentT.toEigen3f().rotation()*Eigen::Vector3f(1,0,0);
-				for(unsigned int j=0; j<kIndices.size(); ++j)
+				for(unsigned int j=0; j<kIds.size(); ++j)
 				{
-					if(indicesChecked.find(kIndices[j]) == indicesChecked.end())
+					if(idsChecked.find(kIds[j]) == idsChecked.end())
 					{
 						if(angle > 0.0f)
 						{
-							const Transform & checkT = transforms.at(kIndices[j]);
+							const Transform & checkT = poses.find(kIds[j])->second;
 							// same orientation?
 							Eigen::Vector3f vB = checkT.toEigen3f().rotation()*Eigen::Vector3f(1,0,0);
 							double a = pcl::getAngle3D(Eigen::Vector4f(vA[0], vA[1], vA[2], 0), Eigen::Vector4f(vB[0], vB[1], vB[2], 0));
 							if(a <= angle)
 							{
-								cloudIndices.insert(kIndices[j]);
+								cloudIds.insert(kIds[j]);
 							}
 						}
 						else
 						{
-							cloudIndices.insert(kIndices[j]);
+							cloudIds.insert(kIds[j]);
 						}
 					}
 				}
@@ -997,42 +1255,38 @@ std::map<int, Transform> radiusPosesFiltering(
 				if(keepLatest)
 				{
 					bool lastAdded = false;
-					for(std::set<int>::reverse_iterator iter = cloudIndices.rbegin(); iter!=cloudIndices.rend(); ++iter)
+					for(std::set<int>::reverse_iterator jter = cloudIds.rbegin(); jter!=cloudIds.rend(); ++jter)
 					{
 						if(!lastAdded)
 						{
-							indicesKept.insert(*iter);
+							idsKept.insert(*jter);
 							lastAdded = true;
 						}
-						indicesChecked.insert(*iter);
+						idsChecked.insert(*jter);
 					}
 				}
 				else
 				{
 					bool firstAdded = false;
-					for(std::set<int>::iterator iter = cloudIndices.begin(); iter!=cloudIndices.end(); ++iter)
+					for(std::set<int>::iterator jter = cloudIds.begin(); jter!=cloudIds.end(); ++jter)
 					{
 						if(!firstAdded)
 						{
-							indicesKept.insert(*iter);
+							idsKept.insert(*jter);
 							firstAdded = true;
 						}
-						indicesChecked.insert(*iter);
+						idsChecked.insert(*jter);
 					}
 				}
 			}
 		}
 
-		//pcl::IndicesPtr indicesOut(new std::vector<int>);
-		//indicesOut->insert(indicesOut->end(), indicesKept.begin(), indicesKept.end());
-		UINFO("Cloud filtered In = %d, Out = %d", cloud->size(), indicesKept.size());
-		//pcl::io::savePCDFile("duplicateIn.pcd", *cloud);
-		//pcl::io::savePCDFile("duplicateOut.pcd", *cloud, *indicesOut);
+		UINFO("Cloud filtered In = %d, Out = %d", (int)poses.size(), (int)idsKept.size());
 
 		std::map<int, Transform> keptPoses;
-		for(std::set<int>::iterator iter = indicesKept.begin(); iter!=indicesKept.end(); ++iter)
+		for(std::set<int>::iterator iter = idsKept.begin(); iter!=idsKept.end(); ++iter)
 		{
-			keptPoses.insert(std::make_pair(names.at(*iter), transforms.at(*iter)));
+			keptPoses.insert(*poses.find(*iter));
 		}
 
 		return keptPoses;
@@ -1045,52 +1299,48 @@ std::map<int, Transform> radiusPosesFiltering(
 
 std::multimap<int, int> radiusPosesClustering(const std::map<int, Transform> & poses, float radius, float angle)
 {
-	std::multimap<int, int> clusters;
 	if(poses.size() > 1 && radius > 0.0f)
 	{
-		pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
-		cloud->resize(poses.size());
-		int i=0;
-		for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter, ++i)
-		{
-			(*cloud)[i] = pcl::PointXYZ(iter->second.x(), iter->second.y(), iter->second.z());
-			UASSERT_MSG(pcl::isFinite((*cloud)[i]), uFormat("Invalid pose (%d) %s", iter->first, iter->second.prettyPrint().c_str()).c_str());
-		}
+		PosesIndex index(radius);
+		index.update(poses);
+		return radiusPosesClustering(index, radius, angle);
+	}
+	return std::multimap<int, int>();
+}
 
+std::multimap<int, int> radiusPosesClustering(const PosesIndex & index, float radius, float angle)
+{
+	std::multimap<int, int> clusters;
+	const std::map<int, Transform> & poses = index.poses();
+	if(poses.size() > 1 && radius > 0.0f)
+	{
 		// radius clustering (nearest neighbors)
-		std::vector<int> ids = uKeys(poses);
-		std::vector<Transform> transforms = uValues(poses);
-
-		pcl::search::KdTree<pcl::PointXYZ>::Ptr tree (new pcl::search::KdTree<pcl::PointXYZ> (false));
-		tree->setInputCloud(cloud);
-
-		for(unsigned int i=0; i<cloud->size(); ++i)
+		for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter)
 		{
-			std::vector<int> kIndices;
+			std::vector<int> kIds;
 			std::vector<float> kDistances;
-			tree->radiusSearch(cloud->at(i), radius, kIndices, kDistances);
+			index.radiusSearch(iter->second, radius, kIds, kDistances);
 
-			std::set<int> cloudIndices;
-			const Transform & currentT = transforms.at(i);
+			const Transform & currentT = iter->second;
 			Eigen::Vector3f vA = currentT.toEigen3f().rotation()*Eigen::Vector3f(1,0,0);
-			for(unsigned int j=0; j<kIndices.size(); ++j)
+			for(std::vector<int>::iterator jter=kIds.begin(); jter!=kIds.end(); ++jter)
 			{
-				if((int)i != kIndices[j])
+				if(iter->first != *jter)
 				{
 					if(angle > 0.0f)
 					{
-						const Transform & checkT = transforms.at(kIndices[j]);
+						const Transform & checkT = poses.find(*jter)->second;
 						// same orientation?
 						Eigen::Vector3f vB = checkT.toEigen3f().rotation()*Eigen::Vector3f(1,0,0);
 						double a = pcl::getAngle3D(Eigen::Vector4f(vA[0], vA[1], vA[2], 0), Eigen::Vector4f(vB[0], vB[1], vB[2], 0));
 						if(a <= angle)
 						{
-							clusters.insert(std::make_pair(ids[i], ids[kIndices[j]]));
+							clusters.insert(std::make_pair(iter->first, *jter));
 						}
 					}
 					else
 					{
-						clusters.insert(std::make_pair(ids[i], ids[kIndices[j]]));
+						clusters.insert(std::make_pair(iter->first, *jter));
 					}
 				}
 			}
@@ -1099,55 +1349,6 @@ std::multimap<int, int> radiusPosesClustering(const std::map<int, Transform> & p
 	return clusters;
 }
 
-
-class Node
-{
-public:
-	Node(int id, int fromId, const rtabmap::Transform & pose) :
-		id_(id),
-		costSoFar_(0.0f),
-		distToEnd_(0.0f),
-		fromId_(fromId),
-		closed_(false),
-		pose_(pose)
-	{}
-
-	int id() const {return id_;}
-	int fromId() const {return fromId_;}
-	bool isClosed() const {return closed_;}
-	bool isOpened() const {return !closed_;}
-	float costSoFar() const {return costSoFar_;} // Dijkstra cost
-	float distToEnd() const {return distToEnd_;} // Breath-first cost
-	float totalCost() const {return costSoFar_ + distToEnd_;} // A* cost
-	rtabmap::Transform pose() const {return pose_;}
-	float distFrom(const rtabmap::Transform & pose) const
-	{
-		return pose_.getDistanceSquared(pose); // use sqrt distance
-	}
-
-	void setClosed(bool closed) {closed_ = closed;}
-	void setFromId(int fromId) {fromId_ = fromId;}
-	void setCostSoFar(float costSoFar) {costSoFar_ = costSoFar;}
-	void setDistToEnd(float distToEnd) {distToEnd_ = distToEnd;}
-
-private:
-	int id_;
-	float costSoFar_;
-	float distToEnd_;
-	int fromId_;
-	bool closed_;
-	rtabmap::Transform pose_;
-};
-
-typedef std::pair<int, float> Pair; // first is id, second is cost
-struct Order
-{
-    bool operator()(Pair const& a, Pair const& b) const
-    {
-        return a.second > b.second;
-    }
-};
-
 std::list<std::pair<int, Transform> > computePath(
 			const std::map<int, rtabmap::Transform> & poses,
 			const std::multimap<int, int> & links,
@@ -1155,92 +1356,88 @@ std::list<std::pair<int, Transform> > computePath(
 			int to,
 			bool updateNewCosts)
 {
-	std::list<std::pair<int, Transform> > path;
-
-	//A*
-	int startNode = from;
-	int endNode = to;
-	rtabmap::Transform endPose = poses.at(endNode);
-	std::map<int, Node> nodes;
-	nodes.insert(std::make_pair(startNode, Node(startNode, 0, poses.at(startNode))));
-	std::priority_queue<Pair, std::vector<Pair>, Order> pq;
-	std::multimap<float, int> pqmap;
-	if(updateNewCosts)
+	FlatGraph graph;
+	graph.reserve((int)poses.size(), (int)links.size());
+	for(std::map<int, Transform>::const_iterator iter=poses.begin(); iter!=poses.end(); ++iter)
 	{
-		pqmap.insert(std::make_pair(0, startNode));
+		graph.addNode(iter->first, iter->second);
 	}
-	else
+	Link link;
+	for(std::multimap<int, int>::const_iterator iter=links.begin(); iter!=links.end(); ++iter)
 	{
-		pq.push(Pair(startNode, 0));
+		link.setFrom(iter->first);
+		link.setTo(iter->second);
+		graph.addLink(link);
 	}
+	graph.finalize();
+	return computePath(graph, from, to, updateNewCosts);
+}
 
-	while((updateNewCosts && pqmap.size()) || (!updateNewCosts && pq.size()))
+std::list<std::pair<int, Transform> > computePath(
+			const FlatGraph & graph,
+			int from,
+			int to,
+			bool updateNewCosts)
+{
+	UASSERT(graph.isFinalized());
+	std::list<std::pair<int, Transform> > path;
+
+	//A* on the node indices
+	int startNode = graph.index(from);
+	int endNode = graph.index(to);
+	UASSERT_MSG(startNode >= 0, uFormat("Node %d not found in the graph", from).c_str());
+	UASSERT_MSG(endNode >= 0, uFormat("Node %d not found in the graph", to).c_str());
+	const Transform & endPose = graph.pose(endNode);
+
+	// 0=not seen, 1=opened, 2=closed
+	std::vector<unsigned char> states(graph.size(), 0);
+	std::vector<float> costsSoFar(graph.size(), 0.0f);
+	std::vector<float> distsToEnd(graph.size(), 0.0f);
+	std::vector<int> fromNodes(graph.size(), -1);
+	// <cost, index>, nodes with an updated cost are pushed again
+	std::priority_queue<std::pair<float, int>, std::vector<std::pair<float, int> >, std::greater<std::pair<float, int> > > pq;
+	states[startNode] = 1;
+	pq.push(std::make_pair(0.0f, startNode));
+
+	while(pq.size())
 	{
-		Node * currentNode;
-		if(updateNewCosts)
-		{
-			currentNode = &nodes.find(pqmap.begin()->second)->second;
-			pqmap.erase(pqmap.begin());
-		}
-		else
+		int current = pq.top().second;
+		pq.pop();
+		if(states[current] == 2)
 		{
-			currentNode = &nodes.find(pq.top().first)->second;
-			pq.pop();
+			continue; // already reached with a lower cost
 		}
+		states[current] = 2;
 
-		currentNode->setClosed(true);
-
-		if(currentNode->id() == endNode)
+		if(current == endNode)
 		{
-			while(currentNode->id()!=startNode)
+			for(int i=current; i>=0; i=fromNodes[i])
 			{
-				path.push_front(std::make_pair(currentNode->id(), currentNode->pose()));
-				currentNode = &nodes.find(currentNode->fromId())->second;
+				path.push_front(std::make_pair(graph.id(i), graph.pose(i)));
 			}
-			path.push_front(std::make_pair(startNode, poses.at(startNode)));
 			break;
 		}
 
 		// lookup neighbors
-		for(std::multimap<int, int>::const_iterator iter = links.find(currentNode->id());
-			iter!=links.end() && iter->first == currentNode->id();
-			++iter)
+		const Transform & currentPose = graph.pose(current);
+		for(int k=graph.linksBegin(current); k<graph.linksEnd(current); ++k)
 		{
-			std::map<int, Node>::iterator nodeIter = nodes.find(iter->second);
-			if(nodeIter == nodes.end())
+			int neighbor = graph.linkTo(k);
+			UASSERT_MSG(neighbor >= 0, uFormat("Node %d not found in the graph", graph.link(k).to()).c_str());
+			float costSoFar = costsSoFar[current] + currentPose.getDistanceSquared(graph.pose(neighbor)); // use sqrt distance
+			if(states[neighbor] == 0)
 			{
-				std::map<int, rtabmap::Transform>::const_iterator poseIter = poses.find(iter->second);
-				UASSERT(poseIter != poses.end());
-				Node n(iter->second, currentNode->id(), poseIter->second);
-				n.setCostSoFar(currentNode->costSoFar() + currentNode->distFrom(poseIter->second));
-				n.setDistToEnd(n.distFrom(endPose));
-				nodes.insert(std::make_pair(iter->second, n));
-				if(updateNewCosts)
-				{
-					pqmap.insert(std::make_pair(n.totalCost(), n.id()));
-				}
-				else
-				{
-					pq.push(Pair(n.id(), n.totalCost()));
-				}
+				states[neighbor] = 1;
+				fromNodes[neighbor] = current;
+				costsSoFar[neighbor] = costSoFar;
+				distsToEnd[neighbor] = graph.pose(neighbor).getDistanceSquared(endPose);
+				pq.push(std::make_pair(costSoFar + distsToEnd[neighbor], neighbor));
 			}
-			else if(updateNewCosts && nodeIter->second.isOpened())
+			else if(updateNewCosts && states[neighbor] == 1 && costsSoFar[neighbor] > costSoFar)
 			{
-				float newCostSoFar = currentNode->costSoFar() + currentNode->distFrom(nodeIter->second.pose());
-				if(nodeIter->second.costSoFar() > newCostSoFar)
-				{
-					// update the cost in the priority queue
-					for(std::multimap<float, int>::iterator mapIter=pqmap.begin(); mapIter!=pqmap.end(); ++mapIter)
-					{
-						if(mapIter->second == nodeIter->first)
-						{
-							pqmap.erase(mapIter);
-							nodeIter->second.setCostSoFar(newCostSoFar);
-							pqmap.insert(std::make_pair(nodeIter->second.totalCost(), nodeIter->first));
-							break;
-						}
-					}
-				}
+				fromNodes[neighbor] = current;
+				costsSoFar[neighbor] = costSoFar;
+				pq.push(std::make_pair(costSoFar + distsToEnd[neighbor], neighbor));
 			}
 		}
 	}
@@ -1291,46 +1488,38 @@ std::map<int, float> getNodesInRadius(
 		float radius)
 {
 	UASSERT(uContains(nodes, nodeId));
-	std::map<int, float> foundNodes;
-	if(nodes.size() <= 1)
+	if(nodes.size() <= 1 || radius <= 0.0f)
 	{
-		return foundNodes;
+		return std::map<int, float>();
 	}
+	PosesIndex index(radius);
+	index.update(nodes);
+	return getNodesInRadius(nodeId, index, maxNearestNeighbors, radius);
+}
 
-	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
-	cloud->resize(nodes.size());
-	std::vector<int> ids(nodes.size());
-	int oi = 0;
-	for(std::map<int, Transform>::const_iterator iter = nodes.begin(); iter!=nodes.end(); ++iter)
+std::map<int, float> getNodesInRadius(
+		int nodeId,
+		const PosesIndex & nodes,
+		int maxNearestNeighbors,
+		float radius)
+{
+	UASSERT(nodes.contains(nodeId));
+	std::map<int, float> foundNodes;
+	if(nodes.size() <= 1)
 	{
-		if(iter->first != nodeId)
-		{
-			(*cloud)[oi] = pcl::PointXYZ(iter->second.x(), iter->second.y(), iter->second.z());
-			UASSERT_MSG(pcl::isFinite((*cloud)[oi]), uFormat("Invalid pose (%d) %s", iter->first, iter->second.prettyPrint().c_str()).c_str());
-			ids[oi] = iter->first;
-			++oi;
-		}
+		return foundNodes;
 	}
-	cloud->resize(oi);
-	ids.resize(oi);
 
-	Transform fromT = nodes.at(nodeId);
-
-	if(cloud->size())
+	// the query is found too, ask one more
+	std::vector<int> ind;
+	std::vector<float> dist;
+	nodes.radiusSearch(nodes.poses().at(nodeId), radius, ind, dist, maxNearestNeighbors>0?maxNearestNeighbors+1:0);
+	for(unsigned int i=0; i<ind.size() && (maxNearestNeighbors<=0 || (int)foundNodes.size() < maxNearestNeighbors); ++i)
 	{
-		pcl::search::KdTree<pcl::PointXYZ>::Ptr kdTree(new pcl::search::KdTree<pcl::PointXYZ>);
-		kdTree->setInputCloud(cloud);
-		std::vector<int> ind;
-		std::vector<float> dist;
-		pcl::PointXYZ pt(fromT.x(), fromT.y(), fromT.z());
-		kdTree->radiusSearch(pt, radius, ind, dist, maxNearestNeighbors);
-		for(unsigned int i=0; i<ind.size(); ++i)
+		if(ind[i] != nodeId)
 		{
-			if(ind[i] >=0)
-			{
-				UDEBUG("Inlier %d: %f", ids[ind[i]], sqrt(dist[i]));
-				foundNodes.insert(std::make_pair(ids[ind[i]], dist[i]));
-			}
+			UDEBUG("Inlier %d: %f", ind[i], sqrt(dist[i]));
+			foundNodes.insert(std::make_pair(ind[i], dist[i]));
 		}
 	}
 	UDEBUG("found nodes=%d", (int)foundNodes.size());
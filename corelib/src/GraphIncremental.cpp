@@ -0,0 +1,1028 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/Graph.h"
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <rtabmap/utilite/UStl.h>
+#include <rtabmap/utilite/UConversion.h>
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+#include <Eigen/Cholesky>
+#include <Eigen/StdVector>
+#include <algorithm>
+#include <string.h>
+
+namespace rtabmap {
+
+namespace graph {
+
+// Added on the diagonal so that poses not linked to the fixed pose don't make the system singular
+static const double kDamping = 1e-9;
+
+////////////////////////////////////////////
+// Pose models
+////////////////////////////////////////////
+
+// x, y, theta
+struct PoseModel2D
+{
+	enum {D = 3};
+	typedef Eigen::Vector3d Estimate;
+	typedef Eigen::Matrix<double, 3, 1> Vector;
+	typedef Eigen::Matrix<double, 3, 3> Block;
+
+	static Estimate fromTransform(const Transform & t)
+	{
+		return Estimate(t.x(), t.y(), t.theta());
+	}
+	static Transform toTransform(const Estimate & e)
+	{
+		return Transform(e[0], e[1], 0, 0, 0, e[2]);
+	}
+	static Estimate compose(const Estimate & a, const Estimate & b)
+	{
+		double c = cos(a[2]);
+		double s = sin(a[2]);
+		return Estimate(a[0] + c*b[0] - s*b[1], a[1] + s*b[0] + c*b[1], normalizeAngle(a[2] + b[2]));
+	}
+	static Estimate inverse(const Estimate & a)
+	{
+		double c = cos(a[2]);
+		double s = sin(a[2]);
+		return Estimate(-c*a[0] - s*a[1], s*a[0] - c*a[1], -a[2]);
+	}
+	static void plus(Estimate & x, const Vector & delta)
+	{
+		x += delta;
+		x[2] = normalizeAngle(x[2]);
+	}
+	static void information(const Link & link, bool covarianceIgnored, Vector & sqrtInformation)
+	{
+		sqrtInformation.setOnes();
+		if(!covarianceIgnored)
+		{
+			sqrtInformation[0] = sqrtInformation[1] = 1.0/sqrt((double)link.transVariance());
+			sqrtInformation[2] = 1.0/sqrt((double)link.rotVariance());
+		}
+	}
+	// error = (xi^-1 * xj) - z
+	static void linearize(const Estimate & xi, const Estimate & xj, const Estimate & z, Vector & error, Block & Ji, Block & Jj)
+	{
+		double ci = cos(xi[2]);
+		double si = sin(xi[2]);
+		double cz = cos(z[2]);
+		double sz = sin(z[2]);
+		Eigen::Matrix2d RiT;
+		RiT << ci, si, -si, ci;
+		Eigen::Matrix2d RzT;
+		RzT << cz, sz, -sz, cz;
+		Eigen::Matrix2d dRiT;
+		dRiT << -si, ci, -ci, -si;
+		Eigen::Vector2d dt = xj.head<2>() - xi.head<2>();
+
+		error.head<2>() = RzT * (RiT * dt - z.head<2>());
+		error[2] = normalizeAngle(xj[2] - xi[2] - z[2]);
+
+		Ji.setZero();
+		Ji.topLeftCorner<2,2>() = -RzT * RiT;
+		Ji.topRightCorner<2,1>() = RzT * dRiT * dt;
+		Ji(2,2) = -1;
+		Jj.setZero();
+		Jj.topLeftCorner<2,2>() = RzT * RiT;
+		Jj(2,2) = 1;
+	}
+	static double normalizeAngle(double a)
+	{
+		while(a > M_PI) a -= 2.0*M_PI;
+		while(a < -M_PI) a += 2.0*M_PI;
+		return a;
+	}
+};
+
+// x, y, z + rotation, the update is applied on the right: x * [exp(rotation) translation]
+struct PoseModel3D
+{
+	enum {D = 6};
+	typedef Eigen::Isometry3d Estimate;
+	typedef Eigen::Matrix<double, 6, 1> Vector;
+	typedef Eigen::Matrix<double, 6, 6> Block;
+
+	static Estimate fromTransform(const Transform & t)
+	{
+		Eigen::Affine3d a = t.toEigen3d();
+		Estimate pose;
+		pose.translation() = a.translation();
+		pose.linear() = a.rotation();
+		return pose;
+	}
+	static Transform toTransform(const Estimate & e)
+	{
+		return Transform::fromEigen3d(e);
+	}
+	static Estimate compose(const Estimate & a, const Estimate & b)
+	{
+		return a*b;
+	}
+	static Estimate inverse(const Estimate & a)
+	{
+		return a.inverse();
+	}
+	static void plus(Estimate & x, const Vector & delta)
+	{
+		x.translation() += x.linear() * delta.head<3>();
+		Eigen::Quaterniond q(x.linear());
+		q = q * Eigen::Quaterniond(exp(delta.tail<3>()));
+		x.linear() = q.normalized().toRotationMatrix();
+	}
+	static void information(const Link & link, bool covarianceIgnored, Vector & sqrtInformation)
+	{
+		sqrtInformation.setOnes();
+		if(!covarianceIgnored)
+		{
+			sqrtInformation.head<3>().setConstant(1.0/sqrt((double)link.transVariance()));
+			sqrtInformation.tail<3>().setConstant(1.0/sqrt((double)link.rotVariance()));
+		}
+	}
+	// E = z^-1 * xi^-1 * xj, error = [translation(E) log(rotation(E))]
+	static void linearize(const Estimate & xi, const Estimate & xj, const Estimate & z, Vector & error, Block & Ji, Block & Jj)
+	{
+		Estimate a = xi.inverse() * xj;
+		Estimate e = z.inverse() * a;
+		Eigen::Vector3d phi = log(e.linear());
+		error.head<3>() = e.translation();
+		error.tail<3>() = phi;
+
+		// derivative of the error for an update of E on the right
+		Block m = Block::Zero();
+		m.topLeftCorner<3,3>() = e.linear();
+		m.bottomRightCorner<3,3>() = rightJacobianInverse(phi);
+
+		// xi * exp(-di) * xi^-1 * xj = xj * exp(-Ad(xj^-1 * xi) * di)
+		Estimate b = a.inverse();
+		Block adjoint = Block::Zero();
+		adjoint.topLeftCorner<3,3>() = b.linear();
+		adjoint.topRightCorner<3,3>() = skew(b.translation()) * b.linear();
+		adjoint.bottomRightCorner<3,3>() = b.linear();
+
+		Jj = m;
+		Ji = -m * adjoint;
+	}
+	static Eigen::Matrix3d exp(const Eigen::Vector3d & phi)
+	{
+		double angle = phi.norm();
+		if(angle < 1e-12)
+		{
+			return Eigen::Matrix3d::Identity() + skew(phi);
+		}
+		return Eigen::AngleAxisd(angle, phi/angle).toRotationMatrix();
+	}
+	static Eigen::Vector3d log(const Eigen::Matrix3d & r)
+	{
+		Eigen::AngleAxisd aa(r);
+		return aa.angle() * aa.axis();
+	}
+	static Eigen::Matrix3d skew(const Eigen::Vector3d & v)
+	{
+		Eigen::Matrix3d m;
+		m << 0, -v[2], v[1],
+			 v[2], 0, -v[0],
+			 -v[1], v[0], 0;
+		return m;
+	}
+	static Eigen::Matrix3d rightJacobianInverse(const Eigen::Vector3d & phi)
+	{
+		double angle = phi.norm();
+		Eigen::Matrix3d w = skew(phi);
+		if(angle < 1e-6 || angle > M_PI - 1e-3)
+		{
+			return Eigen::Matrix3d::Identity() + 0.5*w;
+		}
+		return Eigen::Matrix3d::Identity() + 0.5*w + (1.0/(angle*angle) - (1.0+cos(angle))/(2.0*angle*sin(angle))) * w*w;
+	}
+};
+
+////////////////////////////////////////////
+// Incremental graph
+////////////////////////////////////////////
+class IncrementalGraph
+{
+public:
+	virtual ~IncrementalGraph() {}
+	virtual bool isSlam2d() const = 0;
+	virtual bool isCovarianceIgnored() const = 0;
+
+	// Compare with the previous graph, return the number of poses kept
+	virtual int update(const FlatGraph & graph) = 0;
+
+	// One Gauss-Newton iteration, return false if the system cannot be solved
+	virtual bool iterate(float relinearizeThreshold, int & updatedRows, bool & converged) = 0;
+
+	// Optimized poses in the order of graph.ids(), the root keeping its input pose
+	virtual std::vector<Transform> poses(int rootId, const FlatGraph & graph) const = 0;
+};
+
+template<typename Model>
+class IncrementalGraphImpl : public IncrementalGraph
+{
+	typedef typename Model::Estimate Estimate;
+	typedef typename Model::Vector Vector;
+	typedef typename Model::Block Block;
+
+	struct Node
+	{
+		EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+		int id;
+		Transform input;
+		Estimate linearization;
+		Vector delta; // from the linearization point
+		std::vector<int> edges;
+		bool removed; // not in the graph anymore, kept in the factor until compact()
+	};
+
+	struct Edge
+	{
+		EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+		int from; // node positions
+		int to;
+		Link link;
+		Estimate measurement;
+		Vector sqrtInformation;
+		// whitened error and jacobians at the linearization points
+		Vector error;
+		Block jacobianFrom;
+		Block jacobianTo;
+		bool dirty; // to linearize again
+		bool seen;
+	};
+
+	struct EdgeKey
+	{
+		EdgeKey(int f, int t, int ty, int n) : from(f), to(t), type(ty), occurrence(n) {}
+		int from;
+		int to;
+		int type;
+		int occurrence; // for links with same ids and type
+		bool operator<(const EdgeKey & k) const
+		{
+			if(from != k.from) return from < k.from;
+			if(to != k.to) return to < k.to;
+			if(type != k.type) return type < k.type;
+			return occurrence < k.occurrence;
+		}
+	};
+
+	struct Entry
+	{
+		EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+		int row;
+		Block value;
+	};
+
+	typedef std::vector<Node, Eigen::aligned_allocator<Node> > Nodes;
+	typedef std::vector<Edge, Eigen::aligned_allocator<Edge> > Edges;
+	typedef std::vector<Entry, Eigen::aligned_allocator<Entry> > Column;
+	typedef std::vector<Block, Eigen::aligned_allocator<Block> > Blocks;
+	typedef std::vector<Vector, Eigen::aligned_allocator<Vector> > Vectors;
+
+public:
+	IncrementalGraphImpl(bool covarianceIgnored) :
+		covarianceIgnored_(covarianceIgnored),
+		removed_(0),
+		factored_(0),
+		stamp_(0)
+	{
+	}
+	virtual ~IncrementalGraphImpl() {}
+
+	virtual bool isSlam2d() const {return Model::D == 3;}
+	virtual bool isCovarianceIgnored() const {return covarianceIgnored_;}
+
+	virtual int update(const FlatGraph & graph)
+	{
+		int oldSize = (int)nodes_.size();
+		int first = oldSize; // first row of the factor to compute again
+
+		// Removed nodes. Removing a node from the factor means computing it again
+		// from the node's row (all of it for the fixed pose 0), so the nodes removed
+		// stay in the system with their links (their information is kept like if
+		// they were marginalized) until they are the half of it.
+		std::vector<unsigned char> kept(oldSize, 0);
+		int keptNodes = 0;
+		for(int i=0; i<graph.size(); ++i)
+		{
+			UASSERT(!graph.pose(i).isNull());
+			std::map<int, int>::const_iterator jter = positions_.find(graph.id(i));
+			if(jter != positions_.end())
+			{
+				kept[jter->second] = 1;
+				nodes_[jter->second].input = graph.pose(i);
+				++keptNodes;
+			}
+		}
+		int removedNodes = 0;
+		removed_ = 0;
+		for(int i=0; i<oldSize; ++i)
+		{
+			if(!kept[i])
+			{
+				if(!nodes_[i].removed)
+				{
+					++removedNodes;
+				}
+				++removed_;
+			}
+			nodes_[i].removed = kept[i] == 0;
+		}
+		bool compactNodes = removed_ > 0 && removed_*2 >= oldSize;
+		if(compactNodes)
+		{
+			for(int i=0; i<oldSize; ++i)
+			{
+				if(!kept[i])
+				{
+					first = std::min(first, i); // removing the fixed pose (0) resets the factor
+				}
+			}
+			removed_ = 0;
+		}
+
+		// Removed, modified and new links
+		for(unsigned int i=0; i<edges_.size(); ++i)
+		{
+			edges_[i].seen = false;
+		}
+		std::list<std::pair<EdgeKey, Link> > newLinks;
+		for(int k=0; k<graph.linksSize(); ++k)
+		{
+			const Link & link = graph.link(k);
+			int from = link.from();
+			int to = link.to();
+			UASSERT(!link.transform().isNull());
+			if(from == to)
+			{
+				UWARN("Link %d->%d ignored (same node)", from, to);
+				continue;
+			}
+			if(graph.linkTo(k) < 0)
+			{
+				UERROR("Link %d->%d ignored, pose of a node not found", from, to);
+				continue;
+			}
+			int n = 0;
+			for(int j=graph.linksBegin(graph.index(from)); j<k; ++j)
+			{
+				if(graph.link(j).to() == to && graph.link(j).type() == link.type())
+				{
+					++n;
+				}
+			}
+			EdgeKey key(from, to, link.type(), n);
+			typename std::map<EdgeKey, int>::iterator jter = edgeIndex_.find(key);
+			if(jter != edgeIndex_.end())
+			{
+				Edge & edge = edges_[jter->second];
+				edge.seen = true;
+				if(memcmp(edge.link.transform().data(), link.transform().data(), 12*sizeof(float)) != 0 ||
+				   edge.link.rotVariance() != link.rotVariance() ||
+				   edge.link.transVariance() != link.transVariance())
+				{
+					edge.link = link;
+					edge.measurement = Model::fromTransform(link.transform());
+					Model::information(link, covarianceIgnored_, edge.sqrtInformation);
+					edge.dirty = true;
+					touch(edge, first);
+				}
+			}
+			else
+			{
+				newLinks.push_back(std::make_pair(key, link));
+				std::map<int, int>::const_iterator kter;
+				if((kter=positions_.find(from)) != positions_.end() && kter->second > 0)
+				{
+					first = std::min(first, kter->second);
+				}
+				if((kter=positions_.find(to)) != positions_.end() && kter->second > 0)
+				{
+					first = std::min(first, kter->second);
+				}
+			}
+		}
+		bool edgesRemoved = false;
+		for(unsigned int i=0; i<edges_.size(); ++i)
+		{
+			Edge & edge = edges_[i];
+			if(!edge.seen)
+			{
+				if(!compactNodes && (nodes_[edge.from].removed || nodes_[edge.to].removed))
+				{
+					// stays with the removed node
+					edge.seen = true;
+				}
+				else
+				{
+					touch(edge, first);
+					edgesRemoved = true;
+				}
+			}
+		}
+
+		this->truncate(first);
+
+		if(compactNodes || edgesRemoved)
+		{
+			if(!compactNodes)
+			{
+				kept.assign(oldSize, 1);
+			}
+			this->compact(kept);
+		}
+		int firstNew = (int)nodes_.size();
+
+		// New nodes, appended in order of id
+		int newNodes = 0;
+		for(int i=0; i<graph.size(); ++i)
+		{
+			if(positions_.find(graph.id(i)) == positions_.end())
+			{
+				Node node;
+				node.id = graph.id(i);
+				node.input = graph.pose(i);
+				node.linearization = Model::fromTransform(graph.pose(i));
+				node.delta.setZero();
+				node.removed = false;
+				positions_.insert(std::make_pair(node.id, (int)nodes_.size()));
+				nodes_.push_back(node);
+				++newNodes;
+			}
+		}
+		this->resize();
+
+		for(typename std::list<std::pair<EdgeKey, Link> >::iterator iter=newLinks.begin(); iter!=newLinks.end(); ++iter)
+		{
+			const Link & link = iter->second;
+			Edge edge;
+			edge.from = positions_.at(link.from());
+			edge.to = positions_.at(link.to());
+			edge.link = link;
+			edge.measurement = Model::fromTransform(link.transform());
+			Model::information(link, covarianceIgnored_, edge.sqrtInformation);
+			edge.dirty = true;
+			edge.seen = true;
+			edgeIndex_.insert(std::make_pair(iter->first, (int)edges_.size()));
+			nodes_[edge.from].edges.push_back((int)edges_.size());
+			nodes_[edge.to].edges.push_back((int)edges_.size());
+			edges_.push_back(edge);
+		}
+
+		if(newNodes)
+		{
+			this->initialize(firstNew);
+		}
+
+		UDEBUG("poses=%d (new=%d, removed=%d, pending removal=%d), links=%d (new=%d), rows to update=%d",
+				(int)nodes_.size(), newNodes, removedNodes, removed_, (int)edges_.size(), (int)newLinks.size(), (int)nodes_.size()-factored_);
+		return keptNodes;
+	}
+
+	virtual bool iterate(float relinearizeThreshold, int & updatedRows, bool & converged)
+	{
+		updatedRows = 0;
+		converged = true;
+		int size = (int)nodes_.size();
+		if(factored_ >= size)
+		{
+			return true;
+		}
+
+		for(unsigned int i=0; i<edges_.size(); ++i)
+		{
+			Edge & edge = edges_[i];
+			if(edge.dirty)
+			{
+				Vector error;
+				Model::linearize(nodes_[edge.from].linearization, nodes_[edge.to].linearization, edge.measurement, error, edge.jacobianFrom, edge.jacobianTo);
+				edge.error = edge.sqrtInformation.asDiagonal() * error;
+				edge.jacobianFrom = edge.sqrtInformation.asDiagonal() * edge.jacobianFrom;
+				edge.jacobianTo = edge.sqrtInformation.asDiagonal() * edge.jacobianTo;
+				edge.dirty = false;
+			}
+		}
+
+		// Rows of the factor and forward substitution
+		int start = std::max(factored_, 1); // the first pose is fixed
+		for(int i=start; i<size; ++i)
+		{
+			if(!this->factorizeRow(i))
+			{
+				UERROR("Cholesky decomposition failed for pose %d", nodes_[i].id);
+				this->truncate(i);
+				return false;
+			}
+		}
+		updatedRows = size - start;
+		factored_ = size;
+
+		// Back substitution. Like the "wildfire" of iSAM2, the rows not computed
+		// again are solved only if they depend on a row computed again or on a
+		// row with an update that changed.
+		double wildfireThreshold = relinearizeThreshold * 0.1;
+		for(int i=size-1; i>0; --i)
+		{
+			const Column & column = columns_[i];
+			bool solve = i >= start;
+			for(unsigned int j=0; j<column.size() && !solve; ++j)
+			{
+				solve = column[j].row >= start || changed_[column[j].row] != 0;
+			}
+			changed_[i] = 0;
+			if(solve)
+			{
+				Vector x = y_[i];
+				for(unsigned int j=0; j<column.size(); ++j)
+				{
+					x -= column[j].value.transpose() * nodes_[column[j].row].delta;
+				}
+				Vector delta = diagonal_[i].transpose().template triangularView<Eigen::Upper>().solve(x);
+				changed_[i] = (delta - nodes_[i].delta).cwiseAbs().maxCoeff() > wildfireThreshold?1:0;
+				nodes_[i].delta = delta;
+			}
+		}
+
+		// Linearize again poses with large updates
+		int first = size;
+		for(int i=1; i<size; ++i)
+		{
+			Node & node = nodes_[i];
+			if(node.delta.cwiseAbs().maxCoeff() > relinearizeThreshold)
+			{
+				Model::plus(node.linearization, node.delta);
+				node.delta.setZero();
+				for(unsigned int j=0; j<node.edges.size(); ++j)
+				{
+					Edge & edge = edges_[node.edges[j]];
+					edge.dirty = true;
+					touch(edge, first);
+				}
+			}
+		}
+		if(first < size)
+		{
+			converged = false;
+			this->truncate(first);
+		}
+		return true;
+	}
+
+	virtual std::vector<Transform> poses(int rootId, const FlatGraph & graph) const
+	{
+		UASSERT((int)nodes_.size() - removed_ == graph.size());
+		std::vector<Transform> optimizedPoses(graph.size());
+		std::map<int, int>::const_iterator iter = positions_.find(rootId);
+		UASSERT(iter != positions_.end());
+		const Node & root = nodes_[iter->second];
+		// the graph is moved so that the root keeps its input pose
+		Transform correction = Model::toTransform(Model::fromTransform(root.input)) * Model::toTransform(estimate(root)).inverse();
+		for(int i=0; i<graph.size(); ++i)
+		{
+			const Node & node = nodes_[positions_.at(graph.id(i))];
+			Transform t = correction * Model::toTransform(estimate(node));
+			if(Model::D == 3)
+			{
+				float roll, pitch, yaw;
+				node.input.getEulerAngles(roll, pitch, yaw);
+				t = Transform(t.x(), t.y(), node.input.z(), roll, pitch, t.theta());
+			}
+			UASSERT_MSG(!t.isNull(), uFormat("Optimized pose %d is null!?!?", node.id).c_str());
+			optimizedPoses[i] = t;
+		}
+		return optimizedPoses;
+	}
+
+private:
+	static Estimate estimate(const Node & node)
+	{
+		Estimate e = node.linearization;
+		Model::plus(e, node.delta);
+		return e;
+	}
+
+	static void touch(const Edge & edge, int & first)
+	{
+		// the fixed pose (0) has no row
+		if(edge.from > 0)
+		{
+			first = std::min(first, edge.from);
+		}
+		if(edge.to > 0)
+		{
+			first = std::min(first, edge.to);
+		}
+	}
+
+	// Forget the rows of the factor from "first"
+	void truncate(int first)
+	{
+		if(first >= factored_)
+		{
+			return;
+		}
+		for(int i=factored_-1; i>=first; --i)
+		{
+			std::vector<std::pair<int, int> > & pattern = rowPatterns_[i];
+			for(unsigned int j=0; j<pattern.size(); ++j)
+			{
+				int col = pattern[j].first;
+				if(col < first)
+				{
+					// entries are sorted by row, remove the ones of the rows truncated
+					columns_[col].resize(pattern[j].second);
+					parents_[col] = columns_[col].empty()?-1:columns_[col][0].row;
+				}
+			}
+			pattern.clear();
+		}
+		for(int i=first; i<factored_; ++i)
+		{
+			columns_[i].clear();
+			parents_[i] = -1;
+		}
+		factored_ = first;
+	}
+
+	// Remove the nodes not kept and the links not seen, the factor should be truncated before the first removed node
+	void compact(const std::vector<unsigned char> & kept)
+	{
+		Nodes nodes;
+		nodes.reserve(nodes_.size());
+		positions_.clear();
+		std::vector<int> newPositions(nodes_.size(), -1);
+		for(unsigned int i=0; i<nodes_.size(); ++i)
+		{
+			if(kept[i])
+			{
+				newPositions[i] = (int)nodes.size();
+				positions_.insert(std::make_pair(nodes_[i].id, (int)nodes.size()));
+				nodes.push_back(nodes_[i]);
+				nodes.back().edges.clear();
+			}
+		}
+		nodes_.swap(nodes);
+
+		Edges edges;
+		edges.reserve(edges_.size());
+		std::map<EdgeKey, int> edgeIndex;
+		for(typename std::map<EdgeKey, int>::iterator iter=edgeIndex_.begin(); iter!=edgeIndex_.end(); ++iter)
+		{
+			Edge & edge = edges_[iter->second];
+			if(edge.seen)
+			{
+				UASSERT(newPositions[edge.from] >= 0 && newPositions[edge.to] >= 0);
+				edge.from = newPositions[edge.from];
+				edge.to = newPositions[edge.to];
+				int index = (int)edges.size();
+				edgeIndex.insert(edgeIndex.end(), std::make_pair(iter->first, index));
+				nodes_[edge.from].edges.push_back(index);
+				nodes_[edge.to].edges.push_back(index);
+				edges.push_back(edge);
+			}
+		}
+		edges_.swap(edges);
+		edgeIndex_.swap(edgeIndex);
+		UASSERT(factored_ <= (int)nodes_.size());
+	}
+
+	void resize()
+	{
+		int size = (int)nodes_.size();
+		diagonal_.resize(size);
+		y_.resize(size);
+		rowPatterns_.resize(size);
+		columns_.resize(size);
+		parents_.resize(size, -1);
+		changed_.resize(size, 0);
+		work_.resize(size);
+		workStamps_.resize(size, 0);
+		visitStamps_.resize(size, 0);
+	}
+
+	// New nodes get the same correction than the optimized nodes they are linked to
+	void initialize(int firstNew)
+	{
+		std::vector<unsigned char> done(nodes_.size(), 0);
+		std::list<int> queue;
+		for(int i=0; i<firstNew; ++i)
+		{
+			done[i] = 1;
+		}
+		for(unsigned int i=firstNew; i<nodes_.size(); ++i)
+		{
+			const Node & node = nodes_[i];
+			for(unsigned int j=0; j<node.edges.size(); ++j)
+			{
+				const Edge & edge = edges_[node.edges[j]];
+				int u = edge.from == (int)i?edge.to:edge.from;
+				if(u < firstNew && done[u] == 1)
+				{
+					done[u] = 2; // queued
+					queue.push_back(u);
+				}
+			}
+		}
+		for(unsigned int i=firstNew; i<=nodes_.size(); ++i)
+		{
+			while(queue.size())
+			{
+				int u = queue.front();
+				queue.pop_front();
+				const Node & node = nodes_[u];
+				Estimate correction = Model::compose(estimate(node), Model::inverse(Model::fromTransform(node.input)));
+				for(unsigned int j=0; j<node.edges.size(); ++j)
+				{
+					const Edge & edge = edges_[node.edges[j]];
+					int v = edge.from == u?edge.to:edge.from;
+					if(!done[v])
+					{
+						done[v] = 1;
+						nodes_[v].linearization = Model::compose(correction, Model::fromTransform(nodes_[v].input));
+						nodes_[v].delta.setZero();
+						queue.push_back(v);
+					}
+				}
+			}
+			// not linked to an optimized node: start from its input pose
+			if(i < nodes_.size() && !done[i])
+			{
+				done[i] = 1;
+				queue.push_back(i);
+			}
+		}
+	}
+
+	// Up-looking block Cholesky: row i of L from rows 0 to i-1, then y(i)
+	bool factorizeRow(int i)
+	{
+		const Node & node = nodes_[i];
+		int stamp = ++stamp_;
+		Block d = Block::Identity() * kDamping;
+		Vector b = Vector::Zero();
+		pattern_.clear();
+		for(unsigned int k=0; k<node.edges.size(); ++k)
+		{
+			const Edge & edge = edges_[node.edges[k]];
+			bool isFrom = edge.from == i;
+			int other = isFrom?edge.to:edge.from;
+			const Block & a = isFrom?edge.jacobianFrom:edge.jacobianTo;
+			d += a.transpose() * a;
+			b += a.transpose() * edge.error;
+			if(other > 0 && other < i)
+			{
+				if(workStamps_[other] != stamp)
+				{
+					workStamps_[other] = stamp;
+					work_[other].setZero();
+				}
+				work_[other] += a.transpose() * (isFrom?edge.jacobianTo:edge.jacobianFrom);
+
+				// pattern of the row: path from "other" to i in the elimination tree
+				for(int r=other; r!=-1 && r<i && visitStamps_[r]!=stamp; r=parents_[r])
+				{
+					visitStamps_[r] = stamp;
+					pattern_.push_back(r);
+					if(parents_[r] == -1)
+					{
+						parents_[r] = i;
+					}
+				}
+			}
+		}
+		std::sort(pattern_.begin(), pattern_.end());
+
+		for(unsigned int k=0; k<pattern_.size(); ++k)
+		{
+			int j = pattern_[k];
+			if(workStamps_[j] != stamp)
+			{
+				workStamps_[j] = stamp;
+				work_[j].setZero();
+			}
+			Block l = diagonal_[j].template triangularView<Eigen::Lower>().solve(work_[j].transpose()).transpose();
+			const Column & column = columns_[j];
+			for(unsigned int c=0; c<column.size(); ++c)
+			{
+				int p = column[c].row;
+				if(workStamps_[p] != stamp)
+				{
+					workStamps_[p] = stamp;
+					work_[p].setZero();
+				}
+				work_[p] -= l * column[c].value.transpose();
+			}
+			d -= l * l.transpose();
+			work_[j] = l;
+		}
+
+		Eigen::LLT<Block> llt(d);
+		if(llt.info() != Eigen::Success)
+		{
+			return false;
+		}
+		diagonal_[i] = llt.matrixL();
+
+		std::vector<std::pair<int, int> > & rowPattern = rowPatterns_[i];
+		rowPattern.resize(pattern_.size());
+		Vector y = -b;
+		for(unsigned int k=0; k<pattern_.size(); ++k)
+		{
+			int j = pattern_[k];
+			rowPattern[k] = std::make_pair(j, (int)columns_[j].size());
+			Entry entry;
+			entry.row = i;
+			entry.value = work_[j];
+			columns_[j].push_back(entry);
+			y -= work_[j] * y_[j];
+		}
+		y_[i] = diagonal_[i].template triangularView<Eigen::Lower>().solve(y);
+		return true;
+	}
+
+private:
+	bool covarianceIgnored_;
+
+	Nodes nodes_; // in order of insertion, the first one is fixed
+	int removed_; // nodes removed from the graph still in the system
+	std::map<int, int> positions_; // <id, position>
+	Edges edges_;
+	std::map<EdgeKey, int> edgeIndex_;
+
+	// Block lower triangular factor L of the system H = J^T * J, a row per node
+	int factored_; // rows up to date
+	Blocks diagonal_;
+	std::vector<Column> columns_; // below the diagonal, sorted by row
+	std::vector<std::vector<std::pair<int, int> > > rowPatterns_; // <column, index in the column>
+	std::vector<int> parents_; // elimination tree
+	Vectors y_; // L * y = -J^T * error
+	std::vector<unsigned char> changed_; // delta changed on the last back substitution
+
+	// work space of factorizeRow()
+	Blocks work_;
+	std::vector<int> workStamps_;
+	std::vector<int> visitStamps_;
+	std::vector<int> pattern_;
+	int stamp_;
+};
+
+////////////////////////////////////////////
+// Incremental optimizer
+////////////////////////////////////////////
+IncrementalOptimizer::IncrementalOptimizer(int iterations, bool slam2d, bool covarianceIgnored, float relinearizeThreshold) :
+		Optimizer(iterations, slam2d, covarianceIgnored),
+		relinearizeThreshold_(relinearizeThreshold),
+		graph_(0),
+		lastIterations_(0),
+		lastUpdatedRows_(0)
+{
+}
+
+IncrementalOptimizer::IncrementalOptimizer(const ParametersMap & parameters) :
+		Optimizer(parameters),
+		relinearizeThreshold_(Parameters::defaultRGBDOptimizeRelinearizeThreshold()),
+		graph_(0),
+		lastIterations_(0),
+		lastUpdatedRows_(0)
+{
+	Parameters::parse(parameters, Parameters::kRGBDOptimizeRelinearizeThreshold(), relinearizeThreshold_);
+}
+
+IncrementalOptimizer::~IncrementalOptimizer()
+{
+	delete graph_;
+}
+
+void IncrementalOptimizer::parseParameters(const ParametersMap & parameters)
+{
+	Optimizer::parseParameters(parameters);
+	Parameters::parse(parameters, Parameters::kRGBDOptimizeRelinearizeThreshold(), relinearizeThreshold_);
+}
+
+void IncrementalOptimizer::reset()
+{
+	delete graph_;
+	graph_ = 0;
+}
+
+std::map<int, Transform> IncrementalOptimizer::optimize(
+		int rootId,
+		const std::map<int, Transform> & poses,
+		const std::multimap<int, Link> & edgeConstraints,
+		std::list<std::map<int, Transform> > * intermediateGraphes)
+{
+	FlatGraph graph(poses, edgeConstraints);
+	std::vector<Transform> optimizedPoses = this->optimize(rootId, graph, intermediateGraphes);
+	std::map<int, Transform> output;
+	if(optimizedPoses.size())
+	{
+		graph.setPoses(optimizedPoses);
+		graph.toMaps(output);
+	}
+	return output;
+}
+
+std::vector<Transform> IncrementalOptimizer::optimize(
+		int rootId,
+		const FlatGraph & graph,
+		std::list<std::map<int, Transform> > * intermediateGraphes)
+{
+	UASSERT(graph.isFinalized());
+	std::vector<Transform> optimizedPoses;
+	UDEBUG("Optimizing graph...");
+	lastIterations_ = 0;
+	lastUpdatedRows_ = 0;
+	if(graph.linksSize()>=1 && graph.size()>=2 && iterations() > 0)
+	{
+		UASSERT(graph.contains(rootId));
+		if(graph_ && (graph_->isSlam2d() != isSlam2d() || graph_->isCovarianceIgnored() != isCovarianceIgnored()))
+		{
+			this->reset();
+		}
+		if(graph_ == 0)
+		{
+			if(isSlam2d())
+			{
+				graph_ = new IncrementalGraphImpl<PoseModel2D>(isCovarianceIgnored());
+			}
+			else
+			{
+				graph_ = new IncrementalGraphImpl<PoseModel3D>(isCovarianceIgnored());
+			}
+		}
+
+		UTimer timer;
+		int kept = graph_->update(graph);
+		double updateTime = timer.elapsed();
+
+		bool converged = false;
+		for(int i=0; i<iterations() && !converged; ++i)
+		{
+			int rows = 0;
+			if(!graph_->iterate(relinearizeThreshold_, rows, converged))
+			{
+				UERROR("Optimization failed, the previous solution is discarded.");
+				this->reset();
+				return optimizedPoses;
+			}
+			++lastIterations_;
+			lastUpdatedRows_ += rows;
+			if(intermediateGraphes && !converged)
+			{
+				std::vector<Transform> poses = graph_->poses(rootId, graph);
+				intermediateGraphes->push_back(std::map<int, Transform>());
+				for(int j=0; j<graph.size(); ++j)
+				{
+					intermediateGraphes->back().insert(intermediateGraphes->back().end(), std::make_pair(graph.id(j), poses[j]));
+				}
+			}
+		}
+		optimizedPoses = graph_->poses(rootId, graph);
+		UINFO("Incremental optimization: %d poses (%d kept), %d iterations, %d rows updated (update=%fs, total=%fs)",
+				graph.size(), kept, lastIterations_, lastUpdatedRows_, updateTime, timer.elapsed());
+	}
+	else if(graph.size() == 1 || iterations() <= 0)
+	{
+		optimizedPoses = graph.poses();
+	}
+	else
+	{
+		UWARN("This method should be called at least with 1 pose!");
+	}
+	UDEBUG("Optimizing graph...end!");
+	return optimizedPoses;
+}
+
+} /* namespace graph */
+
+} /* namespace rtabmap */
@@ -0,0 +1,355 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "HammingMatcher.h"
+
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UConversion.h>
+
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+// SIMD kernels are compiled with function target attributes, so
+// no global compiler flags are required and the binary still runs
+// on CPUs without AVX2/AVX-512.
+#if (defined(__x86_64__) || defined(__i386__)) && \
+	(defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define RTABMAP_HAMMING_AVX2
+#include <immintrin.h>
+#if (defined(__clang__) && __clang_major__ >= 6) || (!defined(__clang__) && __GNUC__ >= 8)
+#define RTABMAP_HAMMING_AVX512
+#endif
+#endif
+
+namespace rtabmap
+{
+
+typedef unsigned long long HammingWord;
+
+// Compute distances between one query row and "rows" rows of data, "stride" bytes each
+typedef void (*HammingDistancesFn)(const unsigned char * query, const unsigned char * data, int rows, int stride, int * distances);
+
+static inline int popcount64(HammingWord x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return __builtin_popcountll(x);
+#else
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (int)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+static void hammingDistancesPortable(const unsigned char * query, const unsigned char * data, int rows, int stride, int * distances)
+{
+	for(int r=0; r<rows; ++r)
+	{
+		distances[r] = HammingMatcher::distance(query, data + r*stride, stride);
+	}
+}
+
+#ifdef RTABMAP_HAMMING_AVX2
+// popcount of bytes with a 4-bits lookup table (Mula et al.), then summed with vpsadbw
+__attribute__((target("avx2")))
+static void hammingDistancesAVX2(const unsigned char * query, const unsigned char * data, int rows, int stride, int * distances)
+{
+	const __m256i lookup = _mm256_setr_epi8(
+			0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+			0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i lowMask = _mm256_set1_epi8(0x0f);
+	const __m256i zero = _mm256_setzero_si256();
+	for(int r=0; r<rows; ++r)
+	{
+		const unsigned char * row = data + r*stride;
+		__m256i acc = zero;
+		for(int b=0; b<stride; b+=32)
+		{
+			__m256i x = _mm256_xor_si256(
+					_mm256_load_si256((const __m256i *)(query+b)),
+					_mm256_load_si256((const __m256i *)(row+b)));
+			__m256i lo = _mm256_and_si256(x, lowMask);
+			__m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), lowMask);
+			__m256i count = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+			acc = _mm256_add_epi64(acc, _mm256_sad_epu8(count, zero));
+		}
+		__m128i sum = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+		sum = _mm_add_epi64(sum, _mm_unpackhi_epi64(sum, sum));
+		distances[r] = _mm_cvtsi128_si32(sum);
+	}
+}
+#endif
+
+#ifdef RTABMAP_HAMMING_AVX512
+__attribute__((target("avx512f,avx512vpopcntdq")))
+static void hammingDistancesAVX512(const unsigned char * query, const unsigned char * data, int rows, int stride, int * distances)
+{
+	for(int r=0; r<rows; ++r)
+	{
+		const unsigned char * row = data + r*stride;
+		__m512i acc = _mm512_setzero_si512();
+		for(int b=0; b<stride; b+=64)
+		{
+			__m512i x = _mm512_xor_si512(
+					_mm512_load_si512((const void *)(query+b)),
+					_mm512_load_si512((const void *)(row+b)));
+			acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(x));
+		}
+		distances[r] = (int)_mm512_reduce_add_epi64(acc);
+	}
+}
+#endif
+
+static int registerSize(HammingMatcher::Instructions instructions)
+{
+	if(instructions == HammingMatcher::kAVX512)
+	{
+		return 64;
+	}
+	else if(instructions == HammingMatcher::kAVX2)
+	{
+		return 32;
+	}
+	return sizeof(HammingWord);
+}
+
+static HammingDistancesFn distancesFunction(HammingMatcher::Instructions instructions)
+{
+#ifdef RTABMAP_HAMMING_AVX512
+	if(instructions == HammingMatcher::kAVX512)
+	{
+		return hammingDistancesAVX512;
+	}
+#endif
+#ifdef RTABMAP_HAMMING_AVX2
+	if(instructions == HammingMatcher::kAVX2)
+	{
+		return hammingDistancesAVX2;
+	}
+#endif
+	return hammingDistancesPortable;
+}
+
+static unsigned char * alignedMalloc(size_t size)
+{
+	// keep the original pointer just before the aligned one
+	unsigned char * raw = (unsigned char *)malloc(size + 64 + sizeof(void*));
+	UASSERT(raw != 0);
+	unsigned char * aligned = (unsigned char *)(((size_t)(raw + sizeof(void*)) + 63) & ~(size_t)63);
+	((void **)aligned)[-1] = raw;
+	return aligned;
+}
+
+static void alignedFree(unsigned char * ptr)
+{
+	if(ptr)
+	{
+		free(((void **)ptr)[-1]);
+	}
+}
+
+HammingMatcher::Instructions HammingMatcher::availableInstructions()
+{
+#ifdef RTABMAP_HAMMING_AVX2
+	__builtin_cpu_init();
+#ifdef RTABMAP_HAMMING_AVX512
+	if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq"))
+	{
+		return kAVX512;
+	}
+#endif
+	if(__builtin_cpu_supports("avx2"))
+	{
+		return kAVX2;
+	}
+#endif
+	return kPortable;
+}
+
+const char * HammingMatcher::instructionsName(Instructions instructions)
+{
+	if(instructions == kAVX512)
+	{
+		return "AVX-512 VPOPCNTDQ";
+	}
+	else if(instructions == kAVX2)
+	{
+		return "AVX2";
+	}
+	return "Portable";
+}
+
+HammingMatcher::HammingMatcher(Instructions instructions) :
+	_instructions(instructions),
+	_data(0),
+	_rows(0),
+	_bytes(0),
+	_stride(0)
+{
+	if(_instructions > availableInstructions())
+	{
+		UWARN("Hamming matcher: %s instructions are not available, using %s instead.",
+				instructionsName(_instructions), instructionsName(availableInstructions()));
+		_instructions = availableInstructions();
+	}
+}
+
+HammingMatcher::~HammingMatcher()
+{
+	release();
+}
+
+cv::Mat HammingMatcher::create(int rows, int bytes)
+{
+	UASSERT(rows >= 0 && bytes > 0);
+	release();
+	int reg = registerSize(_instructions);
+	_rows = rows;
+	_bytes = bytes;
+	_stride = ((bytes + reg - 1) / reg) * reg;
+	if(_rows)
+	{
+		// padding bytes must stay at zero, they are included in the distance
+		_data = alignedMalloc(_rows * _stride);
+		memset(_data, 0, _rows * _stride);
+	}
+	return data();
+}
+
+void HammingMatcher::setData(const cv::Mat & descriptors)
+{
+	UASSERT(descriptors.empty() || descriptors.type() == CV_8U);
+	if(descriptors.empty())
+	{
+		release();
+		return;
+	}
+	cv::Mat block = create(descriptors.rows, descriptors.cols);
+	descriptors.copyTo(block);
+	UASSERT(block.data == _data);
+}
+
+void HammingMatcher::release()
+{
+	alignedFree(_data);
+	_data = 0;
+	_rows = 0;
+	_bytes = 0;
+	_stride = 0;
+}
+
+cv::Mat HammingMatcher::data() const
+{
+	if(_rows == 0)
+	{
+		return cv::Mat();
+	}
+	return cv::Mat(_rows, _bytes, CV_8U, _data, _stride);
+}
+
+void HammingMatcher::knnMatch(const cv::Mat & query, std::vector<std::vector<cv::DMatch> > & matches, int k) const
+{
+	matches.clear();
+	if(query.empty() || _rows == 0 || k <= 0)
+	{
+		return;
+	}
+	UASSERT(query.type() == CV_8U);
+	UASSERT_MSG(query.cols == _bytes, uFormat("query=%d train=%d", query.cols, _bytes).c_str());
+
+	// Aligned and zero padded copy of the queries
+	unsigned char * queries = alignedMalloc(query.rows * _stride);
+	memset(queries, 0, query.rows * _stride);
+	for(int i=0; i<query.rows; ++i)
+	{
+		memcpy(queries + i*_stride, query.ptr(i), _bytes);
+	}
+
+	HammingDistancesFn distancesFn = distancesFunction(_instructions);
+
+	// Train rows are processed by blocks fitting in L2 cache, all
+	// queries are compared to a block before loading the next one.
+	int blockRows = std::max(1, (256*1024) / _stride);
+	std::vector<int> distances(std::min(blockRows, _rows));
+	matches.resize(query.rows);
+	for(int i=0; i<query.rows; ++i)
+	{
+		matches[i].reserve(k);
+	}
+	for(int start=0; start<_rows; start+=blockRows)
+	{
+		int n = std::min(blockRows, _rows-start);
+		const unsigned char * block = _data + start*_stride;
+		for(int i=0; i<query.rows; ++i)
+		{
+			distancesFn(queries + i*_stride, block, n, _stride, &distances[0]);
+
+			// keep the k best sorted by distance (ties: lowest train index first)
+			std::vector<cv::DMatch> & best = matches[i];
+			for(int j=0; j<n; ++j)
+			{
+				float d = (float)distances[j];
+				if((int)best.size() < k || d < best.back().distance)
+				{
+					if((int)best.size() == k)
+					{
+						best.pop_back();
+					}
+					int pos = (int)best.size();
+					while(pos > 0 && best[pos-1].distance > d)
+					{
+						--pos;
+					}
+					best.insert(best.begin()+pos, cv::DMatch(i, start+j, d));
+				}
+			}
+		}
+	}
+
+	alignedFree(queries);
+}
+
+int HammingMatcher::distance(const unsigned char * a, const unsigned char * b, int bytes)
+{
+	int distance = 0;
+	int i=0;
+	for(; i+(int)sizeof(HammingWord)<=bytes; i+=sizeof(HammingWord))
+	{
+		HammingWord wa, wb;
+		memcpy(&wa, a+i, sizeof(HammingWord));
+		memcpy(&wb, b+i, sizeof(HammingWord));
+		distance += popcount64(wa ^ wb);
+	}
+	for(; i<bytes; ++i)
+	{
+		distance += popcount64((HammingWord)(a[i] ^ b[i]));
+	}
+	return distance;
+}
+
+} // namespace rtabmap
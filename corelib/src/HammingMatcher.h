@@ -0,0 +1,93 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+#include <vector>
+
+namespace rtabmap
+{
+
+/**
+ * Exact brute force k-nearest neighbors matcher for binary descriptors (CV_8U).
+ * The train descriptors are kept in one contiguous block aligned on 64 bytes,
+ * each row padded with zeros to a multiple of the SIMD register size. The
+ * distance kernel is selected at runtime: AVX-512 VPOPCNTDQ, AVX2 or a
+ * portable 64-bits popcount.
+ */
+class RTABMAP_EXP HammingMatcher
+{
+public:
+	enum Instructions {kPortable, kAVX2, kAVX512};
+
+	// Best instructions available on this CPU (and supported by the compiler)
+	static Instructions availableInstructions();
+	static const char * instructionsName(Instructions instructions);
+
+public:
+	HammingMatcher(Instructions instructions = availableInstructions());
+	~HammingMatcher();
+
+	/**
+	 * Allocate the train block and return a header on it (rows x bytes, CV_8U, not
+	 * owning the data). Rows can be filled directly by the caller. Previous data is released.
+	 */
+	cv::Mat create(int rows, int bytes);
+	void setData(const cv::Mat & descriptors); // copy the descriptors in the train block
+	void release();
+
+	int rows() const {return _rows;}
+	int bytes() const {return _bytes;}
+	bool empty() const {return _rows == 0;}
+	cv::Mat data() const;
+	Instructions instructions() const {return _instructions;}
+
+	/**
+	 * Same output than cv::BFMatcher(cv::NORM_HAMMING).knnMatch(query, data(), matches, k):
+	 * matches are sorted by distance and trainIdx is the row in the train block.
+	 */
+	void knnMatch(const cv::Mat & query, std::vector<std::vector<cv::DMatch> > & matches, int k) const;
+
+	static int distance(const unsigned char * a, const unsigned char * b, int bytes); // portable kernel, any alignment
+
+private:
+	HammingMatcher(const HammingMatcher &);
+	HammingMatcher & operator=(const HammingMatcher &);
+
+private:
+	Instructions _instructions;
+	unsigned char * _data; // aligned on 64 bytes
+	int _rows;
+	int _bytes;
+	int _stride; // bytes of a row in _data, multiple of the register size
+};
+
+} // namespace rtabmap
@@ -0,0 +1,289 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "InvertedIndex.h"
+
+#include <rtabmap/utilite/ULogger.h>
+
+#include <algorithm>
+
+namespace rtabmap
+{
+
+InvertedIndex::InvertedIndex() :
+	_signatureIds(1, 0), // slots start at 1 (the first delta is the slot)
+	_slotWords(1),
+	_totalReferences(0)
+{
+}
+
+void InvertedIndex::add(int wordId, int signatureId, int count)
+{
+	UASSERT(signatureId > 0 && count > 0);
+	int slot = this->addSlot(signatureId);
+	Postings & postings = _postings[wordId];
+	if(postings.data.empty() || slot > postings.last)
+	{
+		append(slot, count, postings);
+	}
+	else if(slot == postings.last)
+	{
+		// more occurrences of the last signature
+		int & value = postings.data[postings.lastEntry];
+		if(value & 1)
+		{
+			postings.data[postings.lastEntry+1] += count;
+		}
+		else
+		{
+			value |= 1;
+			postings.data.push_back(1+count);
+		}
+	}
+	else
+	{
+		// the references of a signature are added at once when it gets its slot, should not happen often
+		std::vector<std::pair<int, int> > values;
+		decode(postings, values);
+		std::vector<std::pair<int, int> >::iterator iter = std::lower_bound(values.begin(), values.end(), std::make_pair(slot, 0));
+		if(iter != values.end() && iter->first == slot)
+		{
+			iter->second += count;
+		}
+		else
+		{
+			values.insert(iter, std::make_pair(slot, count));
+		}
+		encode(values, postings);
+	}
+	postings.references += count;
+	_totalReferences += count;
+	_slotWords[slot].insert(_slotWords[slot].end(), count, wordId);
+}
+
+int InvertedIndex::removeSignature(int signatureId, std::vector<int> * unusedWords)
+{
+	std::map<int, int>::iterator slotIter = _slots.find(signatureId);
+	if(slotIter == _slots.end())
+	{
+		return 0;
+	}
+	int slot = slotIter->second;
+	_signatureIds[slot] = 0;
+	_slots.erase(slotIter);
+
+	int removed = 0;
+	std::vector<int> sortedIds;
+	sortedIds.swap(_slotWords[slot]);
+	std::sort(sortedIds.begin(), sortedIds.end());
+	for(unsigned int i=0; i<sortedIds.size();)
+	{
+		unsigned int j = i+1;
+		while(j<sortedIds.size() && sortedIds[j] == sortedIds[i])
+		{
+			++j;
+		}
+		std::map<int, Postings>::iterator jter = _postings.find(sortedIds[i]);
+		if(jter != _postings.end())
+		{
+			Postings & postings = jter->second;
+			int count = int(j-i);
+			postings.references -= count;
+			removed += count;
+			if(--postings.signatures == 0)
+			{
+				_postings.erase(jter);
+				if(unusedWords)
+				{
+					unusedWords->push_back(sortedIds[i]);
+				}
+			}
+			else if(++postings.removed > postings.signatures)
+			{
+				std::vector<std::pair<int, int> > values;
+				decode(postings, values);
+				encode(values, postings);
+			}
+		}
+		i = j;
+	}
+	_totalReferences -= removed;
+
+	if(_signatureIds.size() > 64 && _slots.size()*2 < _signatureIds.size())
+	{
+		this->compactSlots();
+	}
+	return removed;
+}
+
+void InvertedIndex::clear()
+{
+	_postings.clear();
+	_signatureIds.resize(1);
+	_slotWords.clear();
+	_slotWords.resize(1);
+	_slots.clear();
+	_totalReferences = 0;
+}
+
+InvertedIndex::Reader InvertedIndex::postings(int wordId) const
+{
+	std::map<int, Postings>::const_iterator iter = _postings.find(wordId);
+	if(iter != _postings.end())
+	{
+		return Reader(iter->second.data, &_signatureIds[0]);
+	}
+	return Reader();
+}
+
+int InvertedIndex::signatures(int wordId) const
+{
+	std::map<int, Postings>::const_iterator iter = _postings.find(wordId);
+	return iter != _postings.end()?iter->second.signatures:0;
+}
+
+int InvertedIndex::references(int wordId) const
+{
+	std::map<int, Postings>::const_iterator iter = _postings.find(wordId);
+	return iter != _postings.end()?iter->second.references:0;
+}
+
+int InvertedIndex::slot(int signatureId) const
+{
+	std::map<int, int>::const_iterator iter = _slots.find(signatureId);
+	return iter != _slots.end()?iter->second:-1;
+}
+
+long InvertedIndex::memoryUsed() const
+{
+	long total = sizeof(InvertedIndex);
+	for(std::map<int, Postings>::const_iterator iter=_postings.begin(); iter!=_postings.end(); ++iter)
+	{
+		// approximation of the map node
+		total += sizeof(std::pair<int, Postings>) + 4*sizeof(void*) + iter->second.data.capacity()*sizeof(int);
+	}
+	total += _signatureIds.capacity()*sizeof(int) + _slots.size()*(sizeof(std::pair<int, int>) + 4*sizeof(void*));
+	for(unsigned int i=0; i<_slotWords.size(); ++i)
+	{
+		total += sizeof(std::vector<int>) + _slotWords[i].capacity()*sizeof(int);
+	}
+	return total;
+}
+
+int InvertedIndex::addSlot(int signatureId)
+{
+	std::map<int, int>::iterator iter = _slots.find(signatureId);
+	if(iter != _slots.end())
+	{
+		return iter->second;
+	}
+	int slot = (int)_signatureIds.size();
+	_signatureIds.push_back(signatureId);
+	_slotWords.push_back(std::vector<int>());
+	_slots.insert(std::make_pair(signatureId, slot));
+	return slot;
+}
+
+// Number again the slots in use, in the same order
+void InvertedIndex::compactSlots()
+{
+	UDEBUG("slots=%d, used=%d", (int)_signatureIds.size(), (int)_slots.size());
+	std::vector<int> newSlots(_signatureIds.size(), 0);
+	std::vector<int> signatureIds(1, 0);
+	std::vector<std::vector<int> > slotWords(1);
+	signatureIds.reserve(_slots.size()+1);
+	slotWords.reserve(_slots.size()+1);
+	for(unsigned int i=1; i<_signatureIds.size(); ++i)
+	{
+		if(_signatureIds[i])
+		{
+			newSlots[i] = (int)signatureIds.size();
+			_slots[_signatureIds[i]] = newSlots[i];
+			signatureIds.push_back(_signatureIds[i]);
+			slotWords.push_back(std::vector<int>());
+			slotWords.back().swap(_slotWords[i]);
+		}
+	}
+
+	std::vector<std::pair<int, int> > values;
+	for(std::map<int, Postings>::iterator iter=_postings.begin(); iter!=_postings.end(); ++iter)
+	{
+		decode(iter->second, values);
+		for(unsigned int i=0; i<values.size(); ++i)
+		{
+			values[i].first = newSlots[values[i].first];
+		}
+		encode(values, iter->second);
+	}
+	_signatureIds.swap(signatureIds);
+	_slotWords.swap(slotWords);
+}
+
+void InvertedIndex::decode(const Postings & postings, std::vector<std::pair<int, int> > & values) const
+{
+	values.resize(postings.signatures);
+	Reader reader(postings.data, &_signatureIds[0]);
+	int i=0;
+	for(; reader.next(); ++i)
+	{
+		values[i].first = reader.slot();
+		values[i].second = reader.count();
+	}
+	UASSERT(i == postings.signatures);
+}
+
+void InvertedIndex::encode(const std::vector<std::pair<int, int> > & values, Postings & postings)
+{
+	int references = postings.references;
+	postings = Postings();
+	postings.references = references;
+	postings.data.reserve(values.size());
+	for(unsigned int i=0; i<values.size(); ++i)
+	{
+		append(values[i].first, values[i].second, postings);
+	}
+}
+
+void InvertedIndex::append(int slot, int count, Postings & postings)
+{
+	UASSERT(slot > postings.last);
+	int delta = slot - postings.last;
+	postings.lastEntry = (int)postings.data.size();
+	if(count > 1)
+	{
+		postings.data.push_back((delta << 1) | 1);
+		postings.data.push_back(count);
+	}
+	else
+	{
+		postings.data.push_back(delta << 1);
+	}
+	postings.last = slot;
+	++postings.signatures;
+}
+
+} // namespace rtabmap
@@ -0,0 +1,138 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+
+#include "rtabmap/core/RtabmapExp.h" // DLL export/import defines
+
+#include <map>
+#include <vector>
+
+namespace rtabmap
+{
+
+/**
+ * Inverted index of the visual words: for each word, the signatures
+ * referencing it with the occurrence of the word in the signature.
+ *
+ * Signatures are indexed by a dense slot, given in order of insertion.
+ * The postings of a word are sorted by slot and delta-encoded in one int
+ * array: each signature is one int ((delta << 1) | hasCount), followed by
+ * its occurrence only if it is greater than 1. Adding the references of a
+ * signature (new or reactivated, it gets a new slot) is an append.
+ *
+ * Removing a signature frees its slot (tombstone): the readers skip it and
+ * the postings are compacted lazily, a word when half of its entries are
+ * removed, all slots when half of them are free. The words indexed for a
+ * slot are kept to know which postings reference it.
+ */
+class RTABMAP_EXP InvertedIndex
+{
+private:
+	struct Postings
+	{
+		Postings() : signatures(0), references(0), removed(0), last(0), lastEntry(0) {}
+		std::vector<int> data;
+		int signatures; // number of signatures
+		int references; // sum of the occurrences
+		int removed; // entries of removed signatures, still in data
+		int last; // last slot
+		int lastEntry; // position of the last slot in data
+	};
+
+public:
+	/**
+	 * Read the postings of a word in order of slot (signatures
+	 * removed are skipped):
+	 *   for(InvertedIndex::Reader r = index.postings(wordId); r.next();)
+	 *      r.signatureId(), r.slot(), r.count()
+	 */
+	class Reader
+	{
+	public:
+		Reader() : _iter(0), _end(0), _signatureIds(0), _slot(0), _count(0) {}
+		bool next()
+		{
+			while(_iter != _end)
+			{
+				int value = *_iter++;
+				_slot += value >> 1;
+				_count = (value & 1)?*_iter++:1;
+				if(_signatureIds[_slot])
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+		int signatureId() const {return _signatureIds[_slot];}
+		int slot() const {return _slot;}
+		int count() const {return _count;}
+	private:
+		friend class InvertedIndex;
+		Reader(const std::vector<int> & data, const int * signatureIds) :
+			_iter(data.empty()?0:&data[0]), _end(data.empty()?0:&data[0] + data.size()), _signatureIds(signatureIds), _slot(0), _count(0) {}
+		const int * _iter;
+		const int * _end;
+		const int * _signatureIds;
+		int _slot;
+		int _count;
+	};
+
+public:
+	InvertedIndex();
+
+	void add(int wordId, int signatureId, int count = 1);
+	// All references of a signature, the words without references after are added to unusedWords
+	int removeSignature(int signatureId, std::vector<int> * unusedWords = 0); // return the references removed
+	void clear();
+
+	Reader postings(int wordId) const;
+	int signatures(int wordId) const; // number of signatures referencing the word
+	int references(int wordId) const; // total occurrences of the word
+	int totalReferences() const {return _totalReferences;}
+	int words() const {return (int)_postings.size();}
+	int slot(int signatureId) const; // -1 if the signature is not indexed
+	int slots() const {return (int)_signatureIds.size();} // upper bound of the slots
+	long memoryUsed() const; // in bytes
+
+private:
+	int addSlot(int signatureId);
+	void compactSlots();
+	void decode(const Postings & postings, std::vector<std::pair<int, int> > & values) const; // <slot, count>, without removed signatures
+	static void encode(const std::vector<std::pair<int, int> > & values, Postings & postings);
+	static void append(int slot, int count, Postings & postings);
+
+private:
+	std::map<int, Postings> _postings; // <word id, postings>, words without references are removed
+	std::vector<int> _signatureIds; // <slot, signature id>, 0 for slot 0 and removed signatures
+	std::vector<std::vector<int> > _slotWords; // <slot, words added (once per occurrence)>
+	std::map<int, int> _slots; // <signature id, slot>
+	int _totalReferences;
+};
+
+} // namespace rtabmap
@@ -0,0 +1,466 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/MapAssembler.h"
+#include "rtabmap/core/Signature.h"
+#include "rtabmap/core/util3d.h"
+#include "rtabmap/core/VoxelAccumulator.h"
+
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UMutex.h>
+#include <rtabmap/utilite/USemaphore.h>
+#include <rtabmap/utilite/UThreadNode.h>
+#include <rtabmap/utilite/UTimer.h>
+
+#include <pcl/common/transforms.h>
+#include <algorithm>
+#include <cmath>
+
+namespace rtabmap {
+
+// Node clouds that can be created in advance of the merge, per thread
+static const int kJobsAheadPerThread = 4;
+
+struct MapAssemblerJob
+{
+	MapAssemblerJob() : id(0), signature(0), done(false) {}
+	int id;
+	Transform pose;
+	const Signature * signature; // cloud created from the signature if set
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr input; // otherwise this cloud is transformed
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr output;
+	bool done;
+};
+
+class MapAssemblerMerger
+{
+public:
+	virtual ~MapAssemblerMerger() {}
+	virtual void merge(const MapAssemblerJob & job) = 0;
+};
+
+// Node clouds copied in one cloud allocated at the end
+class ConcatenateMerger : public MapAssemblerMerger
+{
+public:
+	ConcatenateMerger() : _points(0) {}
+	virtual void merge(const MapAssemblerJob & job)
+	{
+		if(job.output.get() && job.output->size())
+		{
+			_clouds.push_back(job.output);
+			_points += job.output->size();
+		}
+	}
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud()
+	{
+		pcl::PointCloud<pcl::PointXYZRGB>::Ptr output(new pcl::PointCloud<pcl::PointXYZRGB>);
+		output->resize(_points);
+		pcl::PointCloud<pcl::PointXYZRGB>::iterator iter = output->begin();
+		for(unsigned int i=0; i<_clouds.size(); ++i)
+		{
+			iter = std::copy(_clouds[i]->begin(), _clouds[i]->end(), iter);
+			_clouds[i].reset();
+		}
+		_clouds.clear();
+		_points = 0;
+		return output;
+	}
+private:
+	std::vector<pcl::PointCloud<pcl::PointXYZRGB>::Ptr> _clouds;
+	size_t _points;
+};
+
+// Node clouds integrated in a voxel grid as they come
+class VoxelAccumulatorMerger : public MapAssemblerMerger
+{
+public:
+	VoxelAccumulatorMerger(util3d::VoxelAccumulator & accumulator) : _accumulator(accumulator) {}
+	virtual void merge(const MapAssemblerJob & job)
+	{
+		if(job.output.get())
+		{
+			_accumulator.integrate(*job.output);
+		}
+	}
+private:
+	util3d::VoxelAccumulator & _accumulator;
+};
+
+// Node clouds kept separately
+class CloudsMerger : public MapAssemblerMerger
+{
+public:
+	virtual void merge(const MapAssemblerJob & job)
+	{
+		if(job.output.get() && job.output->size())
+		{
+			clouds.insert(std::make_pair(job.id, job.output));
+		}
+	}
+	std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr> clouds;
+};
+
+class MapAssemblerWorker : public UThreadNode
+{
+public:
+	MapAssemblerWorker(
+			std::vector<MapAssemblerJob> & jobs,
+			int & next,
+			UMutex & mutex,
+			USemaphore & ahead,
+			USemaphore & done,
+			int decimation,
+			float voxelSize,
+			float maxDepth) :
+		_jobs(jobs),
+		_next(next),
+		_mutex(mutex),
+		_ahead(ahead),
+		_done(done),
+		_decimation(decimation),
+		_voxelSize(voxelSize),
+		_maxDepth(maxDepth)
+	{}
+	virtual ~MapAssemblerWorker() {}
+
+	static void process(MapAssemblerJob & job, int decimation, float voxelSize, float maxDepth)
+	{
+		if(job.signature)
+		{
+			job.output = MapAssembler::createCloud(*job.signature, job.pose, decimation, voxelSize, maxDepth);
+		}
+		else if(job.input.get() && job.input->size())
+		{
+			job.output.reset(new pcl::PointCloud<pcl::PointXYZRGB>);
+			pcl::transformPointCloud(*job.input, *job.output, job.pose.toEigen4f());
+		}
+	}
+
+private:
+	void mainLoop()
+	{
+		// don't get too far ahead of the merge
+		_ahead.acquire();
+
+		_mutex.lock();
+		int index = _next < (int)_jobs.size()?_next++:-1;
+		_mutex.unlock();
+		if(index < 0)
+		{
+			this->kill();
+			return;
+		}
+
+		MapAssemblerJob job = _jobs[index];
+		process(job, _decimation, _voxelSize, _maxDepth);
+
+		_mutex.lock();
+		_jobs[index].output = job.output;
+		_jobs[index].done = true;
+		_mutex.unlock();
+		_done.release();
+	}
+
+private:
+	std::vector<MapAssemblerJob> & _jobs;
+	int & _next;
+	UMutex & _mutex;
+	USemaphore & _ahead;
+	USemaphore & _done;
+	int _decimation;
+	float _voxelSize;
+	float _maxDepth;
+};
+
+class MapAssemblerJobs
+{
+public:
+	static void run(MapAssembler & assembler, std::vector<MapAssemblerJob> & jobs, MapAssemblerMerger & merger)
+	{
+		UTimer timer;
+		static const pcl::PointCloud<pcl::PointXYZRGB> emptyCloud;
+		int threads = std::min(assembler._threads, (int)jobs.size());
+		if(threads <= 1)
+		{
+			for(unsigned int i=0; i<jobs.size(); ++i)
+			{
+				MapAssemblerWorker::process(jobs[i], assembler._decimation, assembler._voxelSize, assembler._maxDepth);
+				merger.merge(jobs[i]);
+				assembler.nodeProcessed(jobs[i].id, jobs[i].output.get()?*jobs[i].output:emptyCloud, i, (int)jobs.size());
+				jobs[i].output.reset();
+			}
+		}
+		else
+		{
+			int next = 0;
+			UMutex mutex;
+			USemaphore ahead(threads*kJobsAheadPerThread);
+			USemaphore done;
+			std::vector<MapAssemblerWorker*> workers(threads);
+			for(int i=0; i<threads; ++i)
+			{
+				workers[i] = new MapAssemblerWorker(jobs, next, mutex, ahead, done,
+						assembler._decimation, assembler._voxelSize, assembler._maxDepth);
+				workers[i]->start();
+			}
+
+			// Merge in order of the jobs
+			for(unsigned int i=0; i<jobs.size(); ++i)
+			{
+				while(true)
+				{
+					mutex.lock();
+					bool isDone = jobs[i].done;
+					mutex.unlock();
+					if(isDone)
+					{
+						break;
+					}
+					done.acquire();
+				}
+				merger.merge(jobs[i]);
+				assembler.nodeProcessed(jobs[i].id, jobs[i].output.get()?*jobs[i].output:emptyCloud, i, (int)jobs.size());
+				mutex.lock();
+				jobs[i].output.reset();
+				mutex.unlock();
+				ahead.release();
+			}
+
+			for(int i=0; i<threads; ++i)
+			{
+				workers[i]->join();
+				delete workers[i];
+			}
+		}
+		UDEBUG("Processed %d nodes with %d threads (%fs)", (int)jobs.size(), threads, timer.ticks());
+	}
+};
+
+MapAssembler::MapAssembler(int threads) :
+	_threads(threads),
+	_decimation(1),
+	_voxelSize(0.0f),
+	_maxDepth(0.0f),
+	_assembledVoxelSize(0.0f)
+{
+	UASSERT(_threads >= 1);
+}
+
+void MapAssembler::setThreads(int threads)
+{
+	UASSERT(threads >= 1);
+	_threads = threads;
+}
+
+void MapAssembler::setNodeFilters(int decimation, float voxelSize, float maxDepth)
+{
+	UASSERT(decimation >= 1 && voxelSize >= 0.0f && maxDepth >= 0.0f);
+	_decimation = decimation;
+	_voxelSize = voxelSize;
+	_maxDepth = maxDepth;
+}
+
+void MapAssembler::setAssembledVoxelSize(float voxelSize)
+{
+	UASSERT(voxelSize >= 0.0f);
+	_assembledVoxelSize = voxelSize;
+}
+
+pcl::PointCloud<pcl::PointXYZRGB>::Ptr MapAssembler::assemble(
+		const std::map<int, Transform> & poses,
+		const std::map<int, const Signature *> & signatures)
+{
+	std::vector<MapAssemblerJob> jobs;
+	jobs.reserve(poses.size());
+	for(std::map<int, Transform>::const_iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+	{
+		std::map<int, const Signature *>::const_iterator jter = signatures.find(iter->first);
+		if(!iter->second.isNull() && jter != signatures.end() && jter->second)
+		{
+			jobs.push_back(MapAssemblerJob());
+			jobs.back().id = iter->first;
+			jobs.back().pose = iter->second;
+			jobs.back().signature = jter->second;
+		}
+	}
+	if(_assembledVoxelSize > 0.0f)
+	{
+		util3d::VoxelAccumulator accumulator(_assembledVoxelSize);
+		VoxelAccumulatorMerger merger(accumulator);
+		MapAssemblerJobs::run(*this, jobs, merger);
+		return accumulator.cloud();
+	}
+	ConcatenateMerger merger;
+	MapAssemblerJobs::run(*this, jobs, merger);
+	return merger.cloud();
+}
+
+void MapAssembler::assemble(
+		const std::map<int, Transform> & poses,
+		const std::map<int, const Signature *> & signatures,
+		util3d::VoxelAccumulator & accumulator)
+{
+	std::vector<MapAssemblerJob> jobs;
+	jobs.reserve(poses.size());
+	for(std::map<int, Transform>::const_iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+	{
+		std::map<int, const Signature *>::const_iterator jter = signatures.find(iter->first);
+		if(!iter->second.isNull() && jter != signatures.end() && jter->second)
+		{
+			jobs.push_back(MapAssemblerJob());
+			jobs.back().id = iter->first;
+			jobs.back().pose = iter->second;
+			jobs.back().signature = jter->second;
+		}
+	}
+	VoxelAccumulatorMerger merger(accumulator);
+	MapAssemblerJobs::run(*this, jobs, merger);
+}
+
+pcl::PointCloud<pcl::PointXYZRGB>::Ptr MapAssembler::assemble(
+		const std::map<int, Transform> & poses,
+		const std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr> & clouds)
+{
+	std::vector<MapAssemblerJob> jobs;
+	jobs.reserve(poses.size());
+	for(std::map<int, Transform>::const_iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+	{
+		std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr>::const_iterator jter = clouds.find(iter->first);
+		if(!iter->second.isNull() && jter != clouds.end())
+		{
+			jobs.push_back(MapAssemblerJob());
+			jobs.back().id = iter->first;
+			jobs.back().pose = iter->second;
+			jobs.back().input = jter->second;
+		}
+	}
+	if(_assembledVoxelSize > 0.0f)
+	{
+		util3d::VoxelAccumulator accumulator(_assembledVoxelSize);
+		VoxelAccumulatorMerger merger(accumulator);
+		MapAssemblerJobs::run(*this, jobs, merger);
+		return accumulator.cloud();
+	}
+	ConcatenateMerger merger;
+	MapAssemblerJobs::run(*this, jobs, merger);
+	return merger.cloud();
+}
+
+std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr> MapAssembler::createClouds(
+		const std::map<int, Transform> & poses,
+		const std::map<int, const Signature *> & signatures,
+		bool transformed)
+{
+	std::vector<MapAssemblerJob> jobs;
+	jobs.reserve(poses.size());
+	for(std::map<int, Transform>::const_iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+	{
+		std::map<int, const Signature *>::const_iterator jter = signatures.find(iter->first);
+		if(!iter->second.isNull() && jter != signatures.end() && jter->second)
+		{
+			jobs.push_back(MapAssemblerJob());
+			jobs.back().id = iter->first;
+			jobs.back().pose = transformed?iter->second:Transform::getIdentity();
+			jobs.back().signature = jter->second;
+		}
+	}
+	CloudsMerger merger;
+	MapAssemblerJobs::run(*this, jobs, merger);
+	return merger.clouds;
+}
+
+pcl::PointCloud<pcl::PointXYZRGB>::Ptr MapAssembler::createCloud(
+		const Signature & signature,
+		const Transform & pose,
+		int decimation,
+		float voxelSize,
+		float maxDepth)
+{
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
+	cv::Mat image, depth;
+	signature.uncompressDataConst(&image, &depth, 0);
+	if(!image.empty() && !depth.empty())
+	{
+		if(depth.type() == CV_8UC1)
+		{
+			// right image, fy is the baseline
+			cloud = util3d::cloudFromStereoImages(
+					image,
+					depth,
+					signature.getCx(), signature.getCy(),
+					signature.getFx(), signature.getFy(),
+					decimation,
+					maxDepth);
+		}
+		else
+		{
+			cloud = util3d::cloudFromDepthRGB(
+					image,
+					depth,
+					signature.getCx(), signature.getCy(),
+					signature.getFx(), signature.getFy(),
+					decimation,
+					maxDepth);
+		}
+
+		if(cloud->size())
+		{
+			if(voxelSize > 0.0f)
+			{
+				cloud = util3d::voxelize<pcl::PointXYZRGB>(cloud, voxelSize);
+			}
+			else
+			{
+				cloud = util3d::removeNaNFromPointCloud<pcl::PointXYZRGB>(cloud);
+			}
+		}
+
+		if(cloud->size())
+		{
+			pcl::transformPointCloud(*cloud, *cloud, (pose * signature.getLocalTransform()).toEigen4f());
+		}
+	}
+	else if(signature.getWords3().size())
+	{
+		// 3D words are already in the base frame
+		const FlatWords<pcl::PointXYZ> & words3 = signature.getWords3();
+		cloud->resize(words3.size());
+		for(unsigned int i=0; i<words3.size(); ++i)
+		{
+			pcl::PointXYZRGB & pt = cloud->at(i);
+			pt.x = words3.value(i).x;
+			pt.y = words3.value(i).y;
+			pt.z = words3.value(i).z;
+			pt.r = pt.g = pt.b = 255;
+		}
+		pcl::transformPointCloud(*cloud, *cloud, pose.toEigen4f());
+	}
+	return cloud;
+}
+
+} /* namespace rtabmap */
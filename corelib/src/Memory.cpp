@@ -39,6 +39,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/VWDictionary.h"
 #include <rtabmap/core/EpipolarGeometry.h>
 #include "VisualWord.h"
+#include "InvertedIndex.h"
 #include "rtabmap/core/Features2d.h"
 #include "rtabmap/core/util3d.h"
 #include "DBDriverSqlite3.h"
@@ -71,6 +72,7 @@ Memory::Memory(const ParametersMap & parameters) :
 	_imageDecimation(Parameters::defaultMemImageDecimation()),
 	_laserScanVoxelSize(Parameters::defaultMemLaserScanVoxelSize()),
 	_localSpaceLinksKeptInWM(Parameters::defaultMemLocalSpaceLinksKeptInWM()),
+	_prefetchMaxSize(Parameters::defaultMemPrefetchMaxSize()),
 	_rehearsalMaxDistance(Parameters::defaultRGBDLinearUpdate()),
 	_rehearsalMaxAngle(Parameters::defaultRGBDAngularUpdate()),
 	_idCount(kIdStart),
@@ -81,10 +83,18 @@ Memory::Memory(const ParametersMap & parameters) :
 	_linksChanged(false),
 	_signaturesAdded(0),
 	_postInitClosingEvents(false),
+	_revision(0),
+	_revisionReset(1),
+	_prefetchThread(0),
+	_prefetchHits(0),
+	_prefetchMisses(0),
+	_prefetchStaged(0),
+	_prefetchStagedMemory(0),
 
 	_featureType((Feature2D::Type)Parameters::defaultKpDetectorStrategy()),
 	_badSignRatio(Parameters::defaultKpBadSignRatio()),
 	_tfIdfLikelihoodUsed(Parameters::defaultKpTfIdfLikelihoodUsed()),
+	_tfIdfLikelihoodThreads(Parameters::defaultKpTfIdfLikelihoodThreads()),
 	_parallelized(Parameters::defaultKpParallelized()),
 	_wordsMaxDepth(Parameters::defaultKpMaxDepth()),
 	_roiRatios(std::vector<float>(4, 0.0f)),
@@ -263,8 +273,7 @@ bool Memory::init(const std::string & dbUrl, bool dbOverwritten, const Parameter
 			const std::map<int, Signature *> & signatures = this->getSignatures();
 			for(std::map<int, Signature *>::const_iterator i=signatures.begin(); i!=signatures.end(); ++i)
 			{
-				const std::multimap<int, cv::KeyPoint> & words = i->second->getWords();
-				std::list<int> keys = uUniqueKeys(words);
+				const std::vector<int> & keys = i->second->getWords().ids();
 				wordIds.insert(keys.begin(), keys.end());
 			}
 			if(wordIds.size())
@@ -299,14 +308,11 @@ bool Memory::init(const std::string & dbUrl, bool dbOverwritten, const Parameter
 		Signature * s = this->_getSignature(i->first);
 		UASSERT(s != 0);
 
-		const std::multimap<int, cv::KeyPoint> & words = s->getWords();
+		const FlatWords<cv::KeyPoint> & words = s->getWords();
 		if(words.size())
 		{
 			UDEBUG("node=%d, word references=%d", s->id(), words.size());
-			for(std::multimap<int, cv::KeyPoint>::const_iterator iter = words.begin(); iter!=words.end(); ++iter)
-			{
-				_vwd->addWordRef(iter->first, i->first);
-			}
+			_vwd->addWordsRef(words.ids(), i->first);
 			s->setEnabled(true);
 		}
 	}
@@ -326,6 +332,7 @@ Memory::~Memory()
 {
 	if(_postInitClosingEvents) UEventsManager::post(new RtabmapEventInit(RtabmapEventInit::kClosing));
 	UDEBUG("");
+	this->clearPrefetched();
 	if(!_memoryChanged && !_linksChanged)
 	{
 		UDEBUG("");
@@ -397,6 +404,7 @@ void Memory::parseParameters(const ParametersMap & parameters)
 	Parameters::parse(parameters, Parameters::kMemImageDecimation(), _imageDecimation);
 	Parameters::parse(parameters, Parameters::kMemLaserScanVoxelSize(), _laserScanVoxelSize);
 	Parameters::parse(parameters, Parameters::kMemLocalSpaceLinksKeptInWM(), _localSpaceLinksKeptInWM);
+	Parameters::parse(parameters, Parameters::kMemPrefetchMaxSize(), _prefetchMaxSize);
 	Parameters::parse(parameters, Parameters::kRGBDLinearUpdate(), _rehearsalMaxDistance);
 	Parameters::parse(parameters, Parameters::kRGBDAngularUpdate(), _rehearsalMaxAngle);
 
@@ -404,6 +412,7 @@ void Memory::parseParameters(const ParametersMap & parameters)
 	UASSERT_MSG(_similarityThreshold >= 0.0f && _similarityThreshold <= 1.0f, uFormat("value=%f", _similarityThreshold).c_str());
 	UASSERT_MSG(_recentWmRatio >= 0.0f && _recentWmRatio <= 1.0f, uFormat("value=%f", _recentWmRatio).c_str());
 	UASSERT(_imageDecimation >= 1);
+	UASSERT_MSG(_prefetchMaxSize >= 0, uFormat("value=%d", _prefetchMaxSize).c_str());
 
 	// SLAM mode vs Localization mode
 	iter = parameters.find(Parameters::kMemIncrementalMemory());
@@ -477,6 +486,7 @@ void Memory::parseParameters(const ParametersMap & parameters)
 	}
 
 	Parameters::parse(parameters, Parameters::kKpTfIdfLikelihoodUsed(), _tfIdfLikelihoodUsed);
+	Parameters::parse(parameters, Parameters::kKpTfIdfLikelihoodThreads(), _tfIdfLikelihoodThreads);
 	Parameters::parse(parameters, Parameters::kKpParallelized(), _parallelized);
 	Parameters::parse(parameters, Parameters::kKpBadSignRatio(), _badSignRatio);
 	Parameters::parse(parameters, Parameters::kKpMaxDepth(), _wordsMaxDepth);
@@ -611,12 +621,14 @@ bool Memory::update(const SensorData & data, Statistics * stats)
 					if(sTo)
 					{
 						sTo->removeLink(s->id());
+						this->setLinksRevision(sTo->id());
 					}
 					else
 					{
 						UERROR("Link %d of %d not in WM/STM?!?", iter->first, s->id());
 					}
 					s->removeLink(iter->first);
+					this->setLinksRevision(s->id());
 				}
 			}
 		}
@@ -723,6 +735,12 @@ void Memory::addSignatureToStm(Signature * signature, float poseRotVariance, flo
 
 		_signatures.insert(_signatures.end(), std::pair<int, Signature *>(signature->id(), signature));
 		_stMem.insert(_stMem.end(), signature->id());
+		if(_stMem.size() > 1 && signature->getLinks().size())
+		{
+			this->setLinksRevision(*(++_stMem.rbegin())); // neighbor link added
+		}
+		this->setDataRevision(signature->id());
+		this->setLinksRevision(signature->id());
 
 		if(_vwd)
 		{
@@ -927,6 +945,24 @@ std::map<int, int> Memory::getNeighborsId(int signatureId,
 	return ids;
 }
 
+void Memory::getChangedNodes(int revision, std::set<int> & dataChanged, std::set<int> & linksChanged) const
+{
+	for(std::map<int, int>::const_iterator iter=_dataRevisions.begin(); iter!=_dataRevisions.end(); ++iter)
+	{
+		if(iter->second > revision)
+		{
+			dataChanged.insert(iter->first);
+		}
+	}
+	for(std::map<int, int>::const_iterator iter=_linksRevisions.begin(); iter!=_linksRevisions.end(); ++iter)
+	{
+		if(iter->second > revision)
+		{
+			linksChanged.insert(iter->first);
+		}
+	}
+}
+
 int Memory::getNextId()
 {
 	return ++_idCount;
@@ -956,12 +992,14 @@ int Memory::incrementMapId()
 						if(sTo)
 						{
 							sTo->removeLink(s->id());
+							this->setLinksRevision(sTo->id());
 						}
 						else
 						{
 							UERROR("Link %d of %d not in WM/STM?!?", iter->first, s->id());
 						}
 						s->removeLink(iter->first);
+						this->setLinksRevision(s->id());
 					}
 				}
 			}
@@ -998,6 +1036,16 @@ double Memory::getDbSavingTime() const
 	return _dbDriver?_dbDriver->getEmptyTrashesTime():0;
 }
 
+double Memory::getDbSavingLatency() const
+{
+	return _dbDriver?_dbDriver->getEmptyTrashesLatency():0;
+}
+
+int Memory::getDbTrashQueueSize() const
+{
+	return _dbDriver?_dbDriver->getTrashQueueSize():0;
+}
+
 std::set<int> Memory::getAllSignatureIds() const
 {
 	std::set<int> ids;
@@ -1016,12 +1064,14 @@ void Memory::clear()
 {
 	UDEBUG("");
 
+	this->clearPrefetched();
+
 	this->cleanUnusedWords();
 
 	if(_dbDriver)
 	{
+		_dbDriver->join(true);
 		_dbDriver->emptyTrashes();
-		_dbDriver->join();
 	}
 
 	// Save some stats to the db, save only when the mem is not empty
@@ -1091,6 +1141,9 @@ void Memory::clear()
 	_idMapCount = kIdStart;
 	_memoryChanged = false;
 	_linksChanged = false;
+	_dataRevisions.clear();
+	_linksRevisions.clear();
+	_revisionReset = ++_revision;
 
 	if(_dbDriver)
 	{
@@ -1109,6 +1162,77 @@ void Memory::clear()
 	UDEBUG("");
 }
 
+// Compute the tf-idf terms of a range of words. The terms are
+// kept in the order of the words so that they can be summed in
+// the same order than the single thread version.
+class TfIdfLikelihoodThread : public UThreadNode
+{
+public:
+	TfIdfLikelihoodThread(
+			const VWDictionary * vwd,
+			const std::vector<int> & wordIds,
+			int begin,
+			int end,
+			const std::vector<int> & positions,
+			const std::vector<float> & positionNi,
+			float N) :
+		_vwd(vwd),
+		_wordIds(wordIds),
+		_begin(begin),
+		_end(end),
+		_positions(positions),
+		_positionNi(positionNi),
+		_N(N)
+	{}
+	virtual ~TfIdfLikelihoodThread() {}
+	const std::vector<std::pair<int, float> > & terms() const {return _terms;} // <position, term>
+private:
+	void mainLoop() {
+		float nwi; // nwi is the number of a specific word referenced by a place
+		float ni; // ni is the total of words referenced by a place
+		float nw; // nw is the number of places referenced by a specific word
+		float N = _N; // N is the total number of places
+		float logNnw;
+		const InvertedIndex & invertedIndex = _vwd->getInvertedIndex();
+		for(int i=_begin; i<_end; ++i)
+		{
+			if(_vwd->getWord(_wordIds[i]))
+			{
+				nw = invertedIndex.signatures(_wordIds[i]);
+				if(nw)
+				{
+					logNnw = log10(N/nw);
+					if(logNnw)
+					{
+						for(InvertedIndex::Reader j=invertedIndex.postings(_wordIds[i]); j.next();)
+						{
+							int position = _positions[j.slot()];
+							if(position >= 0)
+							{
+								nwi = j.count();
+								ni = _positionNi[position];
+								if(ni != 0)
+								{
+									_terms.push_back(std::make_pair(position, ( nwi  * logNnw ) / ni));
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+		this->kill();
+	}
+	const VWDictionary * _vwd;
+	const std::vector<int> & _wordIds;
+	int _begin;
+	int _end;
+	const std::vector<int> & _positions;
+	const std::vector<float> & _positionNi;
+	float _N;
+	std::vector<std::pair<int, float> > _terms;
+};
+
 /**
  * Compute the likelihood of the signature with some others in the memory.
  * Important: Assuming that all other ids are under 'signature' id.
@@ -1175,7 +1299,7 @@ std::map<int, float> Memory::computeLikelihood(const Signature * signature, cons
 			likelihood.insert(likelihood.end(), std::pair<int, float>(*iter, 0.0f));
 		}
 
-		const std::list<int> & wordIds = uUniqueKeys(signature->getWords());
+		const std::vector<int> & wordIds = signature->getWords().uniqueIds();
 
 		float nwi; // nwi is the number of a specific word referenced by a place
 		float ni; // ni is the total of words referenced by a place
@@ -1187,30 +1311,83 @@ std::map<int, float> Memory::computeLikelihood(const Signature * signature, cons
 
 		N = this->getSignatures().size();
 
-		if(N)
+		if(N && _tfIdfLikelihoodThreads > 1 && (int)wordIds.size() >= _tfIdfLikelihoodThreads)
+		{
+			UDEBUG("processing with %d threads... ", _tfIdfLikelihoodThreads);
+			// Locations are indexed by their position in the likelihood (sorted by id),
+			// found from their slot in the inverted index (-1 if not compared)
+			const InvertedIndex & invertedIndex = _vwd->getInvertedIndex();
+			std::vector<int> positions(invertedIndex.slots(), -1);
+			std::vector<float> positionNi(likelihood.size());
+			int position = 0;
+			for(std::map<int, float>::iterator iter=likelihood.begin(); iter!=likelihood.end(); ++iter, ++position)
+			{
+				int slot = invertedIndex.slot(iter->first);
+				if(slot >= 0)
+				{
+					positions[slot] = position;
+				}
+				positionNi[position] = this->getNi(iter->first);
+			}
+
+			std::vector<TfIdfLikelihoodThread*> threads(_tfIdfLikelihoodThreads);
+			int wordsPerThread = (int)wordIds.size() / _tfIdfLikelihoodThreads;
+			for(int i=0; i<_tfIdfLikelihoodThreads; ++i)
+			{
+				threads[i] = new TfIdfLikelihoodThread(
+						_vwd,
+						wordIds,
+						i*wordsPerThread,
+						i==_tfIdfLikelihoodThreads-1?(int)wordIds.size():(i+1)*wordsPerThread,
+						positions,
+						positionNi,
+						N);
+				threads[i]->start();
+			}
+
+			// Sum the terms in the order of the words, like below
+			std::vector<float> sums(likelihood.size(), 0.0f);
+			for(int i=0; i<_tfIdfLikelihoodThreads; ++i)
+			{
+				threads[i]->join();
+				const std::vector<std::pair<int, float> > & terms = threads[i]->terms();
+				for(unsigned int j=0; j<terms.size(); ++j)
+				{
+					sums[terms[j].first] += terms[j].second;
+				}
+				delete threads[i];
+			}
+
+			position = 0;
+			for(std::map<int, float>::iterator iter=likelihood.begin(); iter!=likelihood.end(); ++iter, ++position)
+			{
+				iter->second = sums[position];
+			}
+		}
+		else if(N)
 		{
 			UDEBUG("processing... ");
+			const InvertedIndex & invertedIndex = _vwd->getInvertedIndex();
 			// Pour chaque mot dans la signature SURF
-			for(std::list<int>::const_iterator i=wordIds.begin(); i!=wordIds.end(); ++i)
+			for(std::vector<int>::const_iterator i=wordIds.begin(); i!=wordIds.end(); ++i)
 			{
 				// "Inverted index" - Pour chaque endroit contenu dans chaque mot
 				vw = _vwd->getWord(*i);
 				if(vw)
 				{
-					const std::map<int, int> & refs = vw->getReferences();
-					nw = refs.size();
+					nw = invertedIndex.signatures(*i);
 					if(nw)
 					{
 						logNnw = log10(N/nw);
 						if(logNnw)
 						{
-							for(std::map<int, int>::const_iterator j=refs.begin(); j!=refs.end(); ++j)
+							for(InvertedIndex::Reader j=invertedIndex.postings(*i); j.next();)
 							{
-								std::map<int, float>::iterator iter = likelihood.find(j->first);
+								std::map<int, float>::iterator iter = likelihood.find(j.signatureId());
 								if(iter != likelihood.end())
 								{
-									nwi = j->second;
-									ni = this->getNi(j->first);
+									nwi = j.count();
+									ni = this->getNi(j.signatureId());
 									if(ni != 0)
 									{
 										//UDEBUG("%d, %f %f %f %f", vw->id(), logNnw, nwi, ni, ( nwi  * logNnw ) / ni);
@@ -1340,7 +1517,8 @@ void Memory::joinTrashThread()
 	if(_dbDriver)
 	{
 		UDEBUG("");
-		_dbDriver->join();
+		// the trash thread is persistent, save what is remaining (or wait the thread saving it)
+		_dbDriver->emptyTrashes();
 		UDEBUG("");
 	}
 }
@@ -1516,7 +1694,8 @@ void Memory::moveToTrash(Signature * s, bool keepLinkedToGraph, std::list<int> *
 	if(s)
 	{
 		// If not saved to database or it is a bad signature (not saved), remove links!
-		if(!keepLinkedToGraph || (!s->isSaved() && s->isBadSignature() && _badSignaturesIgnored))
+		bool removedFromGraph = !keepLinkedToGraph || (!s->isSaved() && s->isBadSignature() && _badSignaturesIgnored);
+		if(removedFromGraph)
 		{
 			UASSERT_MSG(this->isInSTM(s->id()),
 					uFormat("Deleting location (%d) outside the STM is not implemented!", s->id()).c_str());
@@ -1540,6 +1719,7 @@ void Memory::moveToTrash(Signature * s, bool keepLinkedToGraph, std::list<int> *
 					}
 
 					sTo->removeLink(s->id());
+					this->setLinksRevision(sTo->id());
 				}
 				else
 				{
@@ -1562,6 +1742,7 @@ void Memory::moveToTrash(Signature * s, bool keepLinkedToGraph, std::list<int> *
 					if(sTo)
 					{
 						sTo->removeLink(s->id());
+						this->setLinksRevision(sTo->id());
 					}
 					else
 					{
@@ -1575,8 +1756,8 @@ void Memory::moveToTrash(Signature * s, bool keepLinkedToGraph, std::list<int> *
 		this->disableWordsRef(s->id());
 		if(!keepLinkedToGraph)
 		{
-			std::list<int> keys = uUniqueKeys(s->getWords());
-			for(std::list<int>::const_iterator i=keys.begin(); i!=keys.end(); ++i)
+			std::vector<int> keys = s->getWords().uniqueIds();
+			for(std::vector<int>::const_iterator i=keys.begin(); i!=keys.end(); ++i)
 			{
 				// assume just removed word doesn't have any other references
 				VisualWord * w = _vwd->getUnusedWord(*i);
@@ -1597,6 +1778,12 @@ void Memory::moveToTrash(Signature * s, bool keepLinkedToGraph, std::list<int> *
 		_workingMem.erase(s->id());
 		_stMem.erase(s->id());
 		_signatures.erase(s->id());
+		if(removedFromGraph)
+		{
+			// still in the global graph otherwise, its last changes must be in the map deltas
+			_dataRevisions.erase(s->id());
+			_linksRevisions.erase(s->id());
+		}
 
 		if(_lastSignature == s)
 		{
@@ -1668,10 +1855,13 @@ bool Memory::labelSignature(int id, const std::string & label)
 		if(s)
 		{
 			s->setLabel(label);
+			this->setDataRevision(id);
 			return true;
 		}
 		else if(_dbDriver)
 		{
+			// a prefetched copy would be outdated
+			this->clearPrefetched();
 			std::list<int> ids;
 			ids.push_back(id);
 			std::list<Signature *> signatures;
@@ -1680,6 +1870,7 @@ bool Memory::labelSignature(int id, const std::string & label)
 			{
 				signatures.front()->setLabel(label);
 				_dbDriver->asyncSave(signatures.front()); // move it again to trash
+				this->setDataRevision(id);
 				return true;
 			}
 		}
@@ -1718,10 +1909,13 @@ bool Memory::setUserData(int id, const std::vector<unsigned char> & data)
 	if(s)
 	{
 		s->setUserData(data);
+		this->setDataRevision(id);
 		return true;
 	}
 	else if(_dbDriver)
 	{
+		// a prefetched copy would be outdated
+		this->clearPrefetched();
 		std::list<int> ids;
 		ids.push_back(id);
 		std::list<Signature *> signatures;
@@ -1730,6 +1924,7 @@ bool Memory::setUserData(int id, const std::vector<unsigned char> & data)
 		{
 			signatures.front()->setUserData(data);
 			_dbDriver->asyncSave(signatures.front()); // move it again to trash
+			this->setDataRevision(id);
 			return true;
 		}
 	}
@@ -1772,6 +1967,8 @@ void Memory::removeLink(int oldId, int newId)
 
 			oldS->removeLink(newS->id());
 			newS->removeLink(oldS->id());
+			this->setLinksRevision(oldS->id());
+			this->setLinksRevision(newS->id());
 
 			if(type!=Link::kVirtualClosure)
 			{
@@ -2515,6 +2712,8 @@ bool Memory::addLink(int oldId, int newId, const Transform & transform, Link::Ty
 
 		oldS->addLink(Link(oldS->id(), newS->id(), type, transform.inverse(), rotVariance, transVariance));
 		newS->addLink(Link(newS->id(), oldS->id(), type, transform, rotVariance, transVariance));
+		this->setLinksRevision(oldS->id());
+		this->setLinksRevision(newS->id());
 
 		if(type!=Link::kVirtualClosure)
 		{
@@ -2566,6 +2765,8 @@ void Memory::updateLink(int fromId, int toId, const Transform & transform, float
 
 		fromS->addLink(Link(fromId, toId, type, transform, rotVariance, transVariance));
 		toS->addLink(Link(toId, fromId, type, transform.inverse(), rotVariance, transVariance));
+		this->setLinksRevision(fromId);
+		this->setLinksRevision(toId);
 
 		if(type!=Link::kVirtualClosure)
 		{
@@ -2583,6 +2784,15 @@ void Memory::removeAllVirtualLinks()
 	UDEBUG("");
 	for(std::map<int, Signature*>::iterator iter=_signatures.begin(); iter!=_signatures.end(); ++iter)
 	{
+		const std::map<int, Link> & links = iter->second->getLinks();
+		for(std::map<int, Link>::const_iterator jter=links.begin(); jter!=links.end(); ++jter)
+		{
+			if(jter->second.type() == Link::kVirtualClosure)
+			{
+				this->setLinksRevision(iter->first);
+				break;
+			}
+		}
 		iter->second->removeVirtualLinks();
 	}
 }
@@ -2632,8 +2842,8 @@ void Memory::dumpSignatures(const char * fileNameSign, bool words3D) const
 			{
 				if(words3D)
 				{
-					const std::multimap<int, pcl::PointXYZ> & ref = ss->getWords3();
-					for(std::multimap<int, pcl::PointXYZ>::const_iterator jter=ref.begin(); jter!=ref.end(); ++jter)
+					const FlatWords<pcl::PointXYZ> & ref = ss->getWords3();
+					for(FlatWords<pcl::PointXYZ>::const_iterator jter=ref.begin(); jter!=ref.end(); ++jter)
 					{
 						//show only valid point according to current parameters
 						if(pcl::isFinite(jter->second) &&
@@ -2646,8 +2856,8 @@ void Memory::dumpSignatures(const char * fileNameSign, bool words3D) const
 				}
 				else
 				{
-					const std::multimap<int, cv::KeyPoint> & ref = ss->getWords();
-					for(std::multimap<int, cv::KeyPoint>::const_iterator jter=ref.begin(); jter!=ref.end(); ++jter)
+					const FlatWords<cv::KeyPoint> & ref = ss->getWords();
+					for(FlatWords<cv::KeyPoint>::const_iterator jter=ref.begin(); jter!=ref.end(); ++jter)
 					{
 						fprintf(foutSign, "%d ", (*jter).first);
 					}
@@ -2805,6 +3015,8 @@ bool Memory::rehearsalMerge(int oldId, int newId)
 		//remove mutual links
 		oldS->removeLink(newId);
 		newS->removeLink(oldId);
+		this->setLinksRevision(oldS->id());
+		this->setLinksRevision(newS->id());
 
 		if(_idUpdatedToNewOneRehearsal)
 		{
@@ -2820,6 +3032,7 @@ bool Memory::rehearsalMerge(int oldId, int newId)
 				{
 					// modify neighbor "from"
 					s->changeLinkIds(oldS->id(), newS->id());
+					this->setLinksRevision(s->id());
 
 					newS->addLink(link);
 				}
@@ -2835,6 +3048,9 @@ bool Memory::rehearsalMerge(int oldId, int newId)
 
 			// Set old image to new signature
 			this->copyData(oldS, newS);
+			this->setDataRevision(newS->id());
+			this->setLinksRevision(oldS->id());
+			this->setLinksRevision(newS->id());
 
 			// update weight
 			newS->setWeight(newS->getWeight() + 1 + oldS->getWeight());
@@ -2847,6 +3063,7 @@ bool Memory::rehearsalMerge(int oldId, int newId)
 		else
 		{
 			newS->addLink(Link(newS->id(), oldS->id(), Link::kGlobalClosure, Transform(), 1.0f, 1.0f)); // to keep track of the merged location
+			this->setLinksRevision(newS->id());
 
 			// update weight
 			oldS->setWeight(newS->getWeight() + 1 + oldS->getWeight());
@@ -3349,6 +3566,77 @@ void Memory::copyData(const Signature * from, Signature * to)
 	UDEBUG("Merging time = %fs", timer.ticks());
 }
 
+void Memory::extractFeatures(SensorData & data, Statistics * stats) const
+{
+	UASSERT(_feature2D != 0);
+	if(data.featuresExtracted() || data.image().empty() || _feature2D->getMaxFeatures() < 0)
+	{
+		return;
+	}
+	UASSERT(data.image().type() == CV_8UC1 || data.image().type() == CV_8UC3);
+	UASSERT(data.depth().empty() || ((data.depth().type() == CV_16UC1 || data.depth().type() == CV_32FC1) && data.depth().rows == data.image().rows && data.depth().cols == data.image().cols));
+
+	UTimer timer;
+	timer.start();
+	float t;
+	cv::Mat imageMono;
+	// convert to grayscale
+	if(data.image().channels() > 1)
+	{
+		cv::cvtColor(data.image(), imageMono, cv::COLOR_BGR2GRAY);
+	}
+	else
+	{
+		imageMono = data.image();
+	}
+	cv::Rect roi = Feature2D::computeRoi(imageMono, _roiRatios);
+
+	std::vector<cv::KeyPoint> keypoints = _feature2D->generateKeypoints(imageMono, roi);
+	t = timer.ticks();
+	if(stats) stats->addStatistic(Statistics::kTimingMemKeypoints_detection(), t*1000.0f);
+	UDEBUG("time keypoints (%d) = %fs", (int)keypoints.size(), t);
+
+	bool subPixelOn = _subPixWinSize > 0 && _subPixIterations > 0;
+	if(!subPixelOn && keypoints.size() && !data.depth().empty() && _wordsMaxDepth > 0.0f)
+	{
+		// don't extract descriptors of keypoints that createSignature() would remove
+		Feature2D::filterKeypointsByDepth(keypoints, data.depth(), _wordsMaxDepth);
+		UDEBUG("filter keypoints by depth (%d)", (int)keypoints.size());
+	}
+
+	cv::Mat descriptors;
+	if(keypoints.size())
+	{
+		// descriptors should be extracted before subpixel
+		descriptors = _feature2D->generateDescriptors(imageMono, keypoints);
+		t = timer.ticks();
+		if(stats) stats->addStatistic(Statistics::kTimingMemDescriptors_extraction(), t*1000.0f);
+		UDEBUG("time descriptors (%d) = %fs", descriptors.rows, t);
+
+		if(subPixelOn)
+		{
+			std::vector<cv::Point2f> corners;
+			cv::KeyPoint::convert(keypoints, corners);
+			cv::cornerSubPix( imageMono, corners,
+					cv::Size( _subPixWinSize, _subPixWinSize ),
+					cv::Size( -1, -1 ),
+					cv::TermCriteria( CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, _subPixIterations, _subPixEps ) );
+
+			for(unsigned int i=0;i<corners.size(); ++i)
+			{
+				keypoints[i].pt = corners[i];
+			}
+
+			t = timer.ticks();
+			if(stats) stats->addStatistic(Statistics::kTimingMemSubpixel(), t*1000.0f);
+			UDEBUG("time subpix kpts=%fs", t);
+		}
+	}
+
+	// disparity/depth filtering and 3D keypoints are done in createSignature()
+	data.setFeatures(keypoints, descriptors);
+}
+
 class PreUpdateThread : public UThreadNode
 {
 public:
@@ -3434,7 +3722,7 @@ Signature * Memory::createSignature(const SensorData & data, Statistics * stats)
 	}
 
 	pcl::PointCloud<pcl::PointXYZ>::Ptr keypoints3D(new pcl::PointCloud<pcl::PointXYZ>);
-	if(data.keypoints().size() == 0)
+	if(!data.featuresExtracted())
 	{
 		if(_feature2D->getMaxFeatures() >= 0)
 		{
@@ -3633,19 +3921,13 @@ Signature * Memory::createSignature(const SensorData & data, Statistics * stats)
 					}
 				}
 			}
-
-			UDEBUG("ratio=%f, meanWordsPerLocation=%d", _badSignRatio, meanWordsPerLocation);
-			if(descriptors.rows && descriptors.rows < _badSignRatio * float(meanWordsPerLocation))
-			{
-				descriptors = cv::Mat();
-			}
 		}
 		else
 		{
 			UDEBUG("_feature2D->getMaxFeatures()(%d<0) so don't extract any features...", _feature2D->getMaxFeatures());
 		}
 	}
-	else
+	else if(data.keypoints().size())
 	{
 		keypoints = data.keypoints();
 		descriptors = data.descriptors().clone();
@@ -3697,7 +3979,7 @@ Signature * Memory::createSignature(const SensorData & data, Statistics * stats)
 			//depth
 			if(_wordsMaxDepth)
 			{
-				Feature2D::filterKeypointsByDepth(keypoints, descriptors, _wordsMaxDepth);
+				Feature2D::filterKeypointsByDepth(keypoints, descriptors, data.depth(), _wordsMaxDepth);
 				UDEBUG("filter keypoints by depth (%d)", (int)keypoints.size());
 			}
 
@@ -3708,6 +3990,12 @@ Signature * Memory::createSignature(const SensorData & data, Statistics * stats)
 		}
 	}
 
+	UDEBUG("ratio=%f, meanWordsPerLocation=%d", _badSignRatio, meanWordsPerLocation);
+	if(descriptors.rows && descriptors.rows < _badSignRatio * float(meanWordsPerLocation))
+	{
+		descriptors = cv::Mat();
+	}
+
 	if(_parallelized)
 	{
 		preUpdateThread.join(); // Wait the dictionary to be updated
@@ -3737,32 +4025,30 @@ Signature * Memory::createSignature(const SensorData & data, Statistics * stats)
 		UDEBUG("id %d is a bad signature", id);
 	}
 
-	std::multimap<int, cv::KeyPoint> words;
-	std::multimap<int, pcl::PointXYZ> words3D;
+	FlatWords<cv::KeyPoint> words;
+	FlatWords<pcl::PointXYZ> words3D;
 	if(wordIds.size() > 0)
 	{
 		UASSERT(wordIds.size() == keypoints.size());
 		UASSERT(keypoints3D->size() == 0 || keypoints3D->size() == wordIds.size());
-		unsigned int i=0;
-		for(std::list<int>::iterator iter=wordIds.begin(); iter!=wordIds.end() && i < keypoints.size(); ++iter, ++i)
+		std::vector<int> ids(wordIds.begin(), wordIds.end());
+		std::vector<cv::KeyPoint> kpts(keypoints);
+		if(_imageDecimation > 1)
 		{
-			if(_imageDecimation > 1)
-			{
-				cv::KeyPoint kpt = keypoints[i];
-				kpt.pt.x /= float(_imageDecimation);
-				kpt.pt.y /= float(_imageDecimation);
-				kpt.size /= float(_imageDecimation);
-				words.insert(std::pair<int, cv::KeyPoint>(*iter, kpt));
-			}
-			else
-			{
-				words.insert(std::pair<int, cv::KeyPoint>(*iter, keypoints[i]));
-			}
-			if(keypoints3D->size())
+			for(unsigned int i=0; i<kpts.size(); ++i)
 			{
-				words3D.insert(std::pair<int, pcl::PointXYZ>(*iter, keypoints3D->at(i)));
+				kpts[i].pt.x /= float(_imageDecimation);
+				kpts[i].pt.y /= float(_imageDecimation);
+				kpts[i].size /= float(_imageDecimation);
 			}
 		}
+		if(keypoints3D->size())
+		{
+			std::vector<int> ids3D(ids);
+			std::vector<pcl::PointXYZ> pts(keypoints3D->begin(), keypoints3D->end());
+			words3D.assign(ids3D, pts); // sorted like the keypoints below
+		}
+		words.assign(ids, kpts);
 	}
 
 	if(words.size() > 8 &&
@@ -3786,18 +4072,17 @@ Signature * Memory::createSignature(const SensorData & data, Statistics * stats)
 
 			// words3D should have the same size than words
 			float bad_point = std::numeric_limits<float>::quiet_NaN ();
-			for(std::multimap<int, cv::KeyPoint>::const_iterator iter=words.begin(); iter!=words.end(); ++iter)
+			std::vector<int> ids(words.ids());
+			std::vector<pcl::PointXYZ> pts(ids.size(), pcl::PointXYZ(bad_point,bad_point,bad_point));
+			for(unsigned int i=0; i<ids.size(); ++i)
 			{
-				std::multimap<int, pcl::PointXYZ>::iterator jter=inliers.find(iter->first);
+				std::multimap<int, pcl::PointXYZ>::iterator jter=inliers.find(ids[i]);
 				if(jter != inliers.end())
 				{
-					words3D.insert(std::make_pair(iter->first, jter->second));
-				}
-				else
-				{
-					words3D.insert(std::make_pair(iter->first, pcl::PointXYZ(bad_point,bad_point,bad_point)));
+					pts[i] = jter->second;
 				}
 			}
+			words3D.assign(ids, pts);
 
 			t = timer.ticks();
 			UASSERT(words3D.size() == words.size());
@@ -3912,14 +4197,9 @@ void Memory::disableWordsRef(int signatureId)
 	Signature * ss = this->_getSignature(signatureId);
 	if(ss && ss->isEnabled())
 	{
-		const std::multimap<int, cv::KeyPoint> & words = ss->getWords();
-		const std::list<int> & keys = uUniqueKeys(words);
 		int count = _vwd->getTotalActiveReferences();
 		// First remove all references
-		for(std::list<int>::const_iterator i=keys.begin(); i!=keys.end(); ++i)
-		{
-			_vwd->removeAllWordRef(*i, signatureId);
-		}
+		_vwd->removeAllWordsRef(signatureId);
 
 		count -= _vwd->getTotalActiveReferences();
 		ss->setEnabled(false);
@@ -3969,10 +4249,10 @@ void Memory::enableWordsRef(const std::list<int> & signatureIds)
 		if(ss && !ss->isEnabled())
 		{
 			surfSigns.push_back(ss);
-			std::list<int> uniqueKeys = uUniqueKeys(ss->getWords());
+			std::vector<int> uniqueKeys = ss->getWords().uniqueIds();
 
 			//Find words in the signature which they are not in the current dictionary
-			for(std::list<int>::const_iterator k=uniqueKeys.begin(); k!=uniqueKeys.end(); ++k)
+			for(std::vector<int>::const_iterator k=uniqueKeys.begin(); k!=uniqueKeys.end(); ++k)
 			{
 				if(_vwd->getWord(*k) == 0 && _vwd->getUnusedWord(*k) == 0)
 				{
@@ -4024,14 +4304,10 @@ void Memory::enableWordsRef(const std::list<int> & signatureIds)
 		}
 		UDEBUG("Added %d to dictionary, time=%fs", vws.size()-refsToChange.size(), timer.ticks());
 
-		//update the global references map and update the signatures reactivated
-		for(std::map<int, int>::const_iterator iter=refsToChange.begin(); iter != refsToChange.end(); ++iter)
+		//update the signatures reactivated, all references at once
+		for(std::list<Signature *>::iterator j=surfSigns.begin(); j!=surfSigns.end(); ++j)
 		{
-			//uInsert(_wordRefsToChange, (const std::pair<int, int>)*iter); // This will be used to change references in the database
-			for(std::list<Signature *>::iterator j=surfSigns.begin(); j!=surfSigns.end(); ++j)
-			{
-				(*j)->changeWordsRef(iter->first, iter->second);
-			}
+			(*j)->changeWordsRef(refsToChange);
 		}
 		UDEBUG("changing ref, total=%d, time=%fs", refsToChange.size(), timer.ticks());
 	}
@@ -4041,12 +4317,9 @@ void Memory::enableWordsRef(const std::list<int> & signatureIds)
 	// Reactivate references and signatures
 	for(std::list<Signature *>::iterator j=surfSigns.begin(); j!=surfSigns.end(); ++j)
 	{
-		const std::vector<int> & keys = uKeys((*j)->getWords());
+		const std::vector<int> & keys = (*j)->getWords().ids();
 		// Add all references
-		for(std::vector<int>::const_iterator i=keys.begin(); i!=keys.end(); ++i)
-		{
-			_vwd->addWordRef(*i, (*j)->id());
-		}
+		_vwd->addWordsRef(keys, (*j)->id());
 		if(keys.size())
 		{
 			(*j)->setEnabled(true);
@@ -4057,6 +4330,100 @@ void Memory::enableWordsRef(const std::list<int> & signatureIds)
 	UDEBUG("%d words total ref added from %d signatures, time=%fs...", count, surfSigns.size(), timer.ticks());
 }
 
+class PrefetchThread : public UThreadNode
+{
+public:
+	PrefetchThread(DBDriver * dbDriver, const std::list<int> & ids) :
+		_dbDriver(dbDriver),
+		_ids(ids)
+	{}
+	virtual ~PrefetchThread()
+	{
+		for(std::list<Signature *>::iterator iter=_signatures.begin(); iter!=_signatures.end(); ++iter)
+		{
+			delete *iter;
+		}
+	}
+	std::list<Signature *> & signatures() {return _signatures;}
+private:
+	void mainLoop() {
+		// Signatures still in the trash are not prefetched, taking them out of
+		// the trash would hide them from the lookups of the main thread.
+		_dbDriver->loadSignaturesNotInTrash(_ids, _signatures);
+		this->kill();
+	}
+	DBDriver * _dbDriver;
+	std::list<int> _ids;
+	std::list<Signature *> _signatures;
+};
+
+// Approximation of the memory used by a signature loaded from the database
+static long signatureMemoryUsed(const Signature * s)
+{
+	long total = sizeof(Signature);
+	total += s->getWords().memoryUsed();
+	total += s->getWords3().memoryUsed();
+	// map nodes
+	total += (long)s->getLinks().size() * (sizeof(std::pair<int, Link>) + 4*sizeof(void*));
+	total += (long)(s->getImageCompressed().total() * s->getImageCompressed().elemSize());
+	total += (long)(s->getDepthCompressed().total() * s->getDepthCompressed().elemSize());
+	total += (long)(s->getLaserScanCompressed().total() * s->getLaserScanCompressed().elemSize());
+	return total;
+}
+
+// Load in background the signatures that may be reactivated on next
+// retrieval. They are added to WM only by reactivateSignatures().
+void Memory::prefetchSignatures(const std::list<int> & ids)
+{
+	this->clearPrefetched();
+	if(!_dbDriver || _prefetchMaxSize <= 0)
+	{
+		return;
+	}
+
+	std::list<int> idsToLoad;
+	for(std::list<int>::const_iterator iter=ids.begin(); iter!=ids.end() && (int)idsToLoad.size() < _prefetchMaxSize; ++iter)
+	{
+		if(*iter > 0 && !this->getSignature(*iter) && !uContains(idsToLoad, *iter))
+		{
+			idsToLoad.push_back(*iter);
+		}
+	}
+
+	if(idsToLoad.size())
+	{
+		UDEBUG("Prefetching %d locations...", (int)idsToLoad.size());
+		_prefetchThread = new PrefetchThread(_dbDriver, idsToLoad);
+		_prefetchThread->start();
+	}
+}
+
+void Memory::joinPrefetchThread()
+{
+	if(_prefetchThread)
+	{
+		_prefetchThread->join();
+		std::list<Signature *> & signatures = _prefetchThread->signatures();
+		for(std::list<Signature *>::iterator iter=signatures.begin(); iter!=signatures.end(); ++iter)
+		{
+			_prefetched.insert(std::make_pair((*iter)->id(), *iter));
+		}
+		signatures.clear();
+		delete _prefetchThread;
+		_prefetchThread = 0;
+	}
+}
+
+void Memory::clearPrefetched()
+{
+	this->joinPrefetchThread();
+	for(std::map<int, Signature *>::iterator iter=_prefetched.begin(); iter!=_prefetched.end(); ++iter)
+	{
+		delete iter->second;
+	}
+	_prefetched.clear();
+}
+
 std::set<int> Memory::reactivateSignatures(const std::list<int> & ids, unsigned int maxLoaded, double & timeDbAccess)
 {
 	// get the signatures, if not in the working memory, they
@@ -4081,12 +4448,54 @@ std::set<int> Memory::reactivateSignatures(const std::list<int> & ids, unsigned
 
 	UDEBUG("idsToLoad = %d", idsToLoad.size());
 
-	std::list<Signature *> reactivatedSigns;
-	if(_dbDriver)
+	// Take the signatures already loaded in background
+	this->joinPrefetchThread();
+	_prefetchStaged = (int)_prefetched.size();
+	_prefetchStagedMemory = 0;
+	for(std::map<int, Signature *>::iterator iter=_prefetched.begin(); iter!=_prefetched.end(); ++iter)
+	{
+		_prefetchStagedMemory += signatureMemoryUsed(iter->second);
+	}
+	std::map<int, Signature *> loadedSigns;
+	std::list<int> idsNotPrefetched;
+	for(std::list<int>::iterator iter=idsToLoad.begin(); iter!=idsToLoad.end(); ++iter)
+	{
+		std::map<int, Signature *>::iterator jter = _prefetched.find(*iter);
+		if(jter != _prefetched.end())
+		{
+			loadedSigns.insert(*jter);
+			_prefetched.erase(jter);
+		}
+		else
+		{
+			idsNotPrefetched.push_back(*iter);
+		}
+	}
+	_prefetchHits = (int)loadedSigns.size();
+	_prefetchMisses = (int)idsNotPrefetched.size();
+	this->clearPrefetched(); // not retrieved
+	UDEBUG("prefetch hits=%d misses=%d (staged=%d)", _prefetchHits, _prefetchMisses, _prefetchStaged);
+
+	if(_dbDriver && idsNotPrefetched.size())
 	{
-		_dbDriver->loadSignatures(idsToLoad, reactivatedSigns);
+		std::list<Signature *> signatures;
+		_dbDriver->loadSignatures(idsNotPrefetched, signatures);
+		for(std::list<Signature *>::iterator iter=signatures.begin(); iter!=signatures.end(); ++iter)
+		{
+			loadedSigns.insert(std::make_pair((*iter)->id(), *iter));
+		}
 	}
 	timeDbAccess = timer.getElapsedTime();
+
+	std::list<Signature *> reactivatedSigns;
+	for(std::list<int>::iterator iter=idsToLoad.begin(); iter!=idsToLoad.end(); ++iter)
+	{
+		std::map<int, Signature *>::iterator jter = loadedSigns.find(*iter);
+		if(jter != loadedSigns.end())
+		{
+			reactivatedSigns.push_back(jter->second);
+		}
+	}
 	std::list<int> idsLoaded;
 	for(std::list<Signature *>::iterator i=reactivatedSigns.begin(); i!=reactivatedSigns.end(); ++i)
 	{
@@ -4104,55 +4513,70 @@ void Memory::getMetricConstraints(
 		std::map<int, Transform> & poses,
 		std::multimap<int, Link> & links,
 		bool lookInDatabase)
+{
+	FlatGraph graph;
+	this->getMetricConstraints(ids, graph, lookInDatabase);
+	graph.toMaps(poses, links);
+}
+
+void Memory::getMetricConstraints(
+		const std::vector<int> & ids,
+		FlatGraph & graph,
+		bool lookInDatabase)
 {
 	UDEBUG("");
+	graph.clear();
+	graph.reserve((int)ids.size(), (int)ids.size()*2);
 	for(unsigned int i=0; i<ids.size(); ++i)
 	{
 		Transform pose = getOdomPose(ids[i], lookInDatabase);
 		if(!pose.isNull())
 		{
-			poses.insert(std::make_pair(ids[i], pose));
+			graph.addNode(ids[i], pose);
 		}
 	}
+	graph.finalize();
 
-	for(unsigned int i=0; i<ids.size(); ++i)
+	// Links are added by node in order, so the links already added
+	// for the node i are in [firstLinks[i], firstLinks[i+1])
+	std::vector<int> firstLinks(graph.size()+1, 0);
+	for(int i=0; i<graph.size(); ++i)
 	{
-		if(uContains(poses, ids[i]))
+		int id = graph.id(i);
+		firstLinks[i] = graph.linksSize();
+		std::map<int, Link> neighbors = this->getNeighborLinks(id, lookInDatabase); // only direct neighbors
+		for(std::map<int, Link>::iterator jter=neighbors.begin(); jter!=neighbors.end(); ++jter)
 		{
-			std::map<int, Link> neighbors = this->getNeighborLinks(ids[i], lookInDatabase); // only direct neighbors
-			for(std::map<int, Link>::iterator jter=neighbors.begin(); jter!=neighbors.end(); ++jter)
+			int j = graph.index(jter->first);
+			if(j >= 0 && jter->second.isValid())
 			{
-				if(uContains(poses, jter->first) && jter->second.isValid())
+				bool edgeAlreadyAdded = false;
+				if(j < i)
 				{
-					bool edgeAlreadyAdded = false;
-					for(std::multimap<int, Link>::iterator iter = links.lower_bound(jter->first);
-							iter != links.end() && iter->first == jter->first;
-							++iter)
-					{
-						if(iter->second.to() == ids[i])
-						{
-							edgeAlreadyAdded = true;
-						}
-					}
-					if(!edgeAlreadyAdded)
+					for(int k=firstLinks[j]; k<firstLinks[j+1] && !edgeAlreadyAdded; ++k)
 					{
-						links.insert(std::make_pair(ids[i], jter->second));
+						edgeAlreadyAdded = graph.links()[k].to() == id;
 					}
 				}
+				if(!edgeAlreadyAdded)
+				{
+					graph.addLink(jter->second);
+				}
 			}
+		}
 
-			std::map<int, Link> loops = this->getLoopClosureLinks(ids[i], lookInDatabase);
-			for(std::map<int, Link>::iterator jter=loops.begin(); jter!=loops.end(); ++jter)
+		std::map<int, Link> loops = this->getLoopClosureLinks(id, lookInDatabase);
+		for(std::map<int, Link>::iterator jter=loops.begin(); jter!=loops.end(); ++jter)
+		{
+			if(jter->first < id &&
+				graph.contains(jter->first) &&
+				jter->second.isValid()) // null transform means a child (rehearsed location)
 			{
-				if(jter->first < ids[i] &&
-					uContains(poses, jter->first) &&
-					jter->second.isValid()) // null transform means a child (rehearsed location)
-				{
-					links.insert(std::make_pair(ids[i],jter->second));
-				}
+				graph.addLink(jter->second);
 			}
 		}
 	}
+	graph.finalize();
 }
 
 } // namespace rtabmap
@@ -0,0 +1,418 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/OccupancyGrid.h"
+
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UTimer.h>
+#include <algorithm>
+#include <list>
+#include <cmath>
+
+namespace rtabmap {
+
+// Cells in a tile side
+static const int kTileSize = 64;
+
+// Cell i is centered on i*cellSize
+static int cellIndex(float value, float cellSize)
+{
+	return int(std::floor(value/cellSize + 0.5f));
+}
+
+static int tileIndex(int cell)
+{
+	return cell>=0?cell/kTileSize:(cell+1)/kTileSize-1;
+}
+
+// Fill holes, remove empty cells on obstacle borders and erode obstacles
+static void filterMap(cv::Mat & map, bool erode)
+{
+	// fill holes and remove empty from obstacle borders
+	cv::Mat updatedMap = map.clone();
+	std::list<std::pair<int, int> > obstacleIndices;
+	for(int i=2; i<map.rows-2; ++i)
+	{
+		for(int j=2; j<map.cols-2; ++j)
+		{
+			if(map.at<char>(i, j) == -1 &&
+				map.at<char>(i+1, j) != -1 &&
+				map.at<char>(i-1, j) != -1 &&
+				map.at<char>(i, j+1) != -1 &&
+				map.at<char>(i, j-1) != -1)
+			{
+				updatedMap.at<char>(i, j) = 0;
+			}
+			else if(map.at<char>(i, j) == 100)
+			{
+				// obstacle/empty/unknown -> remove empty
+				// unknown/empty/obstacle -> remove empty
+				if(map.at<char>(i-1, j) == 0 &&
+					map.at<char>(i-2, j) == -1)
+				{
+					updatedMap.at<char>(i-1, j) = -1;
+				}
+				else if(map.at<char>(i+1, j) == 0 &&
+						map.at<char>(i+2, j) == -1)
+				{
+					updatedMap.at<char>(i+1, j) = -1;
+				}
+				if(map.at<char>(i, j-1) == 0 &&
+					map.at<char>(i, j-2) == -1)
+				{
+					updatedMap.at<char>(i, j-1) = -1;
+				}
+				else if(map.at<char>(i, j+1) == 0 &&
+						map.at<char>(i, j+2) == -1)
+				{
+					updatedMap.at<char>(i, j+1) = -1;
+				}
+
+				if(erode)
+				{
+					obstacleIndices.push_back(std::make_pair(i, j));
+				}
+			}
+			else if(map.at<char>(i, j) == 0)
+			{
+				// obstacle/empty/obstacle -> remove empty
+				if(map.at<char>(i-1, j) == 100 &&
+					map.at<char>(i+1, j) == 100)
+				{
+					updatedMap.at<char>(i, j) = -1;
+				}
+				else if(map.at<char>(i, j-1) == 100 &&
+					map.at<char>(i, j+1) == 100)
+				{
+					updatedMap.at<char>(i, j) = -1;
+				}
+			}
+
+		}
+	}
+	map = updatedMap;
+
+	if(erode)
+	{
+		// remove obstacles which touch to empty cells but not unknown cells
+		cv::Mat erodedMap = map.clone();
+		for(std::list<std::pair<int,int> >::iterator iter = obstacleIndices.begin();
+			iter!= obstacleIndices.end();
+			++iter)
+		{
+			int i = iter->first;
+			int j = iter->second;
+			bool touchEmpty = map.at<char>(i+1, j) == 0 ||
+				map.at<char>(i-1, j) == 0 ||
+				map.at<char>(i, j+1) == 0 ||
+				map.at<char>(i, j-1) == 0;
+			if(touchEmpty && map.at<char>(i+1, j) != -1 &&
+				map.at<char>(i-1, j) != -1 &&
+				map.at<char>(i, j+1) != -1 &&
+				map.at<char>(i, j-1) != -1)
+			{
+				erodedMap.at<char>(i, j) = 0; // empty
+			}
+		}
+		map = erodedMap;
+	}
+
+}
+
+OccupancyGrid::OccupancyGrid(float cellSize, float linearUpdate, float angularUpdate) :
+	_cellSize(cellSize),
+	_linearUpdate(linearUpdate),
+	_angularUpdate(angularUpdate),
+	_lastUpdatedNodes(0),
+	_lastUpdatedTiles(0)
+{
+	UASSERT(_cellSize > 0.0f);
+	UASSERT(_linearUpdate >= 0.0f && _angularUpdate >= 0.0f);
+}
+
+void OccupancyGrid::setCellSize(float cellSize)
+{
+	UASSERT(cellSize > 0.0f);
+	if(cellSize != _cellSize)
+	{
+		_cellSize = cellSize;
+		this->clear();
+	}
+}
+
+void OccupancyGrid::setUpdateThresholds(float linearUpdate, float angularUpdate)
+{
+	UASSERT(linearUpdate >= 0.0f && angularUpdate >= 0.0f);
+	_linearUpdate = linearUpdate;
+	_angularUpdate = angularUpdate;
+}
+
+void OccupancyGrid::update(
+		const std::map<int, Transform> & poses,
+		const std::map<int, std::pair<cv::Mat, cv::Mat> > & occupancy)
+{
+	UTimer timer;
+	std::set<TileKey> tilesUpdated;
+	_lastUpdatedNodes = 0;
+
+	// Remove the nodes not in the graph anymore
+	for(std::map<int, Node>::iterator iter=_nodes.begin(); iter!=_nodes.end();)
+	{
+		if(poses.find(iter->first) == poses.end() || occupancy.find(iter->first) == occupancy.end())
+		{
+			for(std::map<TileKey, Cells>::iterator jter=iter->second.cells.begin(); jter!=iter->second.cells.end(); ++jter)
+			{
+				_tiles.at(jter->first).nodes.erase(iter->first);
+				tilesUpdated.insert(jter->first);
+			}
+			_nodes.erase(iter++);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+
+	// Project the new nodes and the ones which moved
+	float x,y,z,roll,pitch,yaw;
+	for(std::map<int, Transform>::const_iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+	{
+		std::map<int, std::pair<cv::Mat, cv::Mat> >::const_iterator localMap = occupancy.find(iter->first);
+		if(localMap == occupancy.end())
+		{
+			continue;
+		}
+		UASSERT(!iter->second.isNull());
+
+		std::map<int, Node>::iterator jter = _nodes.find(iter->first);
+		if(jter != _nodes.end())
+		{
+			(jter->second.pose.inverse() * iter->second).getTranslationAndEulerAngles(x,y,z,roll,pitch,yaw);
+			if(sqrt(x*x + y*y) <= _linearUpdate && fabs(yaw) <= _angularUpdate)
+			{
+				continue;
+			}
+			for(std::map<TileKey, Cells>::iterator kter=jter->second.cells.begin(); kter!=jter->second.cells.end(); ++kter)
+			{
+				_tiles.at(kter->first).nodes.erase(iter->first);
+				tilesUpdated.insert(kter->first);
+			}
+			jter->second.cells.clear();
+		}
+		else
+		{
+			jter = _nodes.insert(std::make_pair(iter->first, Node())).first;
+		}
+
+		this->project(iter->second, localMap->second, jter->second);
+		for(std::map<TileKey, Cells>::iterator kter=jter->second.cells.begin(); kter!=jter->second.cells.end(); ++kter)
+		{
+			_tiles[kter->first].nodes.insert(iter->first);
+			tilesUpdated.insert(kter->first);
+		}
+		++_lastUpdatedNodes;
+	}
+
+	// Draw again the tiles touched
+	for(std::set<TileKey>::iterator iter=tilesUpdated.begin(); iter!=tilesUpdated.end(); ++iter)
+	{
+		std::map<TileKey, Tile>::iterator jter = _tiles.find(*iter);
+		UASSERT(jter != _tiles.end());
+		if(jter->second.nodes.empty())
+		{
+			_tiles.erase(jter);
+		}
+		else
+		{
+			this->draw(*iter, jter->second);
+		}
+	}
+	_lastUpdatedTiles = (int)tilesUpdated.size();
+
+	UDEBUG("nodes=%d (projected %d) tiles=%d (drawn %d) time=%fs",
+			(int)_nodes.size(), _lastUpdatedNodes, (int)_tiles.size(), _lastUpdatedTiles, timer.ticks());
+}
+
+void OccupancyGrid::clear()
+{
+	_nodes.clear();
+	_tiles.clear();
+	_lastUpdatedNodes = 0;
+	_lastUpdatedTiles = 0;
+}
+
+cv::Mat OccupancyGrid::getMap(float & xMin, float & yMin, float minMapSize, bool erode) const
+{
+	UASSERT(minMapSize >= 0.0f);
+	UTimer timer;
+
+	// Bounds (in cells) of the poses and the cells set
+	int minX=0, minY=0, maxX=0, maxY=0;
+	bool undefinedSize = minMapSize == 0.0f;
+	if(!undefinedSize)
+	{
+		minX = minY = cellIndex(-minMapSize/2.0f, _cellSize);
+		maxX = maxY = cellIndex(minMapSize/2.0f, _cellSize);
+	}
+	for(std::map<int, Node>::const_iterator iter=_nodes.begin(); iter!=_nodes.end(); ++iter)
+	{
+		const cv::Point2i & cell = iter->second.cell;
+		if(undefinedSize)
+		{
+			minX = maxX = cell.x;
+			minY = maxY = cell.y;
+			undefinedSize = false;
+		}
+		else
+		{
+			minX = std::min(minX, cell.x);
+			maxX = std::max(maxX, cell.x);
+			minY = std::min(minY, cell.y);
+			maxY = std::max(maxY, cell.y);
+		}
+	}
+	for(std::map<TileKey, Tile>::const_iterator iter=_tiles.begin(); iter!=_tiles.end(); ++iter)
+	{
+		const cv::Rect & bounds = iter->second.bounds;
+		if(bounds.area())
+		{
+			int x = iter->first.second*kTileSize + bounds.x;
+			int y = iter->first.first*kTileSize + bounds.y;
+			minX = std::min(minX, x);
+			maxX = std::max(maxX, x+bounds.width-1);
+			minY = std::min(minY, y);
+			maxY = std::max(maxY, y+bounds.height-1);
+		}
+	}
+
+	cv::Mat map;
+	if(!undefinedSize && minX != maxX && minY != maxY)
+	{
+		int margin = 10;
+		minX -= margin;
+		minY -= margin;
+		maxX += margin;
+		maxY += margin;
+		xMin = float(minX)*_cellSize;
+		yMin = float(minY)*_cellSize;
+		if(maxY - minY > 99999 || maxX - minX > 99999)
+		{
+			UERROR("Large map size!! map min=(%f, %f) max=(%f,%f). "
+					"There's maybe an error with the poses provided! The map will not be created!",
+					xMin, yMin, float(maxX)*_cellSize, float(maxY)*_cellSize);
+		}
+		else
+		{
+			cv::Rect mapRect(minX, minY, maxX-minX+1, maxY-minY+1);
+			map = cv::Mat(mapRect.height, mapRect.width, CV_8S, cv::Scalar(-1));
+			for(std::map<TileKey, Tile>::const_iterator iter=_tiles.begin(); iter!=_tiles.end(); ++iter)
+			{
+				cv::Rect tileRect(iter->first.second*kTileSize, iter->first.first*kTileSize, kTileSize, kTileSize);
+				cv::Rect roi = tileRect & mapRect;
+				if(roi.area())
+				{
+					iter->second.map(roi - tileRect.tl()).copyTo(map(roi - mapRect.tl()));
+				}
+			}
+			UDEBUG("map %dx%d assembled from %d tiles (%fs)", map.cols, map.rows, (int)_tiles.size(), timer.ticks());
+
+			filterMap(map, erode);
+		}
+	}
+	UDEBUG("timer=%fs", timer.ticks());
+	return map;
+}
+
+void OccupancyGrid::project(const Transform & pose, const std::pair<cv::Mat, cv::Mat> & occupancy, Node & node) const
+{
+	float x,y,z,roll,pitch,yaw;
+	pose.getTranslationAndEulerAngles(x,y,z,roll,pitch,yaw);
+	float cosT = cos(yaw);
+	float sinT = sin(yaw);
+
+	node.pose = pose;
+	node.cell = cv::Point2i(cellIndex(x, _cellSize), cellIndex(y, _cellSize));
+	for(int k=0; k<2; ++k)
+	{
+		const cv::Mat & points = k==0?occupancy.first:occupancy.second;
+		if(points.rows)
+		{
+			UASSERT(points.type() == CV_32FC2);
+			for(int i=0; i<points.rows; ++i)
+			{
+				const float * pt = points.ptr<float>(i);
+				int cx = cellIndex(cosT*pt[0] - sinT*pt[1] + x, _cellSize);
+				int cy = cellIndex(sinT*pt[0] + cosT*pt[1] + y, _cellSize);
+				TileKey key(tileIndex(cy), tileIndex(cx));
+				Cells & cells = node.cells[key];
+				cv::Point2i cell(cx - key.second*kTileSize, cy - key.first*kTileSize);
+				if(k==0)
+				{
+					cells.empty.push_back(cell);
+				}
+				else
+				{
+					cells.occupied.push_back(cell);
+				}
+			}
+		}
+	}
+}
+
+void OccupancyGrid::draw(const TileKey & key, Tile & tile) const
+{
+	if(tile.map.empty())
+	{
+		tile.map = cv::Mat(kTileSize, kTileSize, CV_8S);
+	}
+	tile.map.setTo(-1);
+	cv::Point2i min(kTileSize, kTileSize), max(-1, -1);
+	// by increasing id, obstacles of a node over its empty space
+	for(std::set<int>::const_iterator iter=tile.nodes.begin(); iter!=tile.nodes.end(); ++iter)
+	{
+		const Cells & cells = _nodes.at(*iter).cells.at(key);
+		for(unsigned int i=0; i<cells.empty.size(); ++i)
+		{
+			tile.map.at<char>(cells.empty[i].y, cells.empty[i].x) = 0; // free space
+			min.x = std::min(min.x, cells.empty[i].x);
+			min.y = std::min(min.y, cells.empty[i].y);
+			max.x = std::max(max.x, cells.empty[i].x);
+			max.y = std::max(max.y, cells.empty[i].y);
+		}
+		for(unsigned int i=0; i<cells.occupied.size(); ++i)
+		{
+			tile.map.at<char>(cells.occupied[i].y, cells.occupied[i].x) = 100; // obstacles
+			min.x = std::min(min.x, cells.occupied[i].x);
+			min.y = std::min(min.y, cells.occupied[i].y);
+			max.x = std::max(max.x, cells.occupied[i].x);
+			max.y = std::max(max.y, cells.occupied[i].y);
+		}
+	}
+	tile.bounds = max.x>=0?cv::Rect(min.x, min.y, max.x-min.x+1, max.y-min.y+1):cv::Rect();
+}
+
+} /* namespace rtabmap */
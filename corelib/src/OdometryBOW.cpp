@@ -147,7 +147,7 @@ Transform OdometryBOW::computeTransform(
 			nFeatures = (int)newSignature->getWords().size();
 			if(this->isInfoDataFilled() && info)
 			{
-				info->words = newSignature->getWords();
+				info->words = newSignature->getWords().toMultimap();
 			}
 		}
 
@@ -161,7 +161,7 @@ Transform OdometryBOW::computeTransform(
 					if((int)newSignature->getWords().size() >= this->getMinInliers())
 					{
 						// find correspondences
-						std::vector<int> ids = uListToVector(uUniqueKeys(newSignature->getWords()));
+						std::vector<int> ids = newSignature->getWords().uniqueIds();
 						std::vector<cv::Point3f> objectPoints(ids.size());
 						std::vector<cv::Point2f> imagePoints(ids.size());
 						int oi=0;
@@ -235,7 +235,7 @@ Transform OdometryBOW::computeTransform(
 								std::vector<float> errorSqrdDists(inliersV.size());
 								for(unsigned int i=0; i<inliersV.size(); ++i)
 								{
-									std::multimap<int, pcl::PointXYZ>::const_iterator iter = newSignature->getWords3().find(matches[inliersV[i]]);
+									FlatWords<pcl::PointXYZ>::const_iterator iter = newSignature->getWords3().find(matches[inliersV[i]]);
 									UASSERT(iter != newSignature->getWords3().end());
 									const cv::Point3f & objPt = objectPoints[inliersV[i]];
 									pcl::PointXYZ newPt = util3d::transformPoint(iter->second, this->getPose()*transform);
@@ -373,9 +373,9 @@ Transform OdometryBOW::computeTransform(
 				}
 
 				// update local map
-				std::list<int> uniques = uUniqueKeys(newSignature->getWords3());
+				std::vector<int> uniques = newSignature->getWords3().uniqueIds();
 				Transform t = this->getPose()*output;
-				for(std::list<int>::iterator iter = uniques.begin(); iter!=uniques.end(); ++iter)
+				for(std::vector<int>::iterator iter = uniques.begin(); iter!=uniques.end(); ++iter)
 				{
 					// Only add unique words not in local map
 					if(newSignature->getWords3().count(*iter) == 1)
@@ -403,13 +403,13 @@ Transform OdometryBOW::computeTransform(
 			localMap_.clear();
 
 			int count = 0;
-			std::list<int> uniques = uUniqueKeys(newSignature->getWords3());
+			std::vector<int> uniques = newSignature->getWords3().uniqueIds();
 			if((int)uniques.size() >= this->getMinInliers())
 			{
 				output.setIdentity();
 
 				Transform t = this->getPose(); // initial pose maybe not identity...
-				for(std::list<int>::iterator iter = uniques.begin(); iter!=uniques.end(); ++iter)
+				for(std::vector<int>::iterator iter = uniques.begin(); iter!=uniques.end(); ++iter)
 				{
 					// Only add unique words
 					if(newSignature->getWords3().count(*iter) == 1)
@@ -0,0 +1,716 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/Odometry.h"
+#include "rtabmap/core/OdometryInfo.h"
+#include "rtabmap/core/Features2d.h"
+#include "rtabmap/core/util3d.h"
+#include "HammingMatcher.h"
+#include "rtabmap/utilite/ULogger.h"
+#include "rtabmap/utilite/UTimer.h"
+#include "rtabmap/utilite/UConversion.h"
+#include "rtabmap/utilite/UStl.h"
+#include "rtabmap/utilite/UMath.h"
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/calib3d/calib3d.hpp>
+#include <limits>
+#include <algorithm>
+
+namespace rtabmap {
+
+// Hamming distance for binary descriptors (CV_8U), squared L2 distance for the others (CV_32F)
+static float descriptorDistance(const unsigned char * a, const unsigned char * b, int cols, bool binary)
+{
+	if(binary)
+	{
+		return (float)HammingMatcher::distance(a, b, cols);
+	}
+	const float * fa = (const float *)a;
+	const float * fb = (const float *)b;
+	float distance = 0.0f;
+	for(int i=0; i<cols; ++i)
+	{
+		float d = fa[i] - fb[i];
+		distance += d*d;
+	}
+	return distance;
+}
+
+OdometryF2M::OdometryF2M(const ParametersMap & parameters) :
+	Odometry(parameters),
+	maxSize_(Parameters::defaultOdomF2MMaxSize()),
+	nndr_(Parameters::defaultOdomF2MNNDR()),
+	searchRadius_(Parameters::defaultOdomF2MSearchRadius()),
+	stereoWinSize_(Parameters::defaultStereoWinSize()),
+	stereoIterations_(Parameters::defaultStereoIterations()),
+	stereoEps_(Parameters::defaultStereoEps()),
+	stereoMaxLevel_(Parameters::defaultStereoMaxLevel()),
+	stereoMaxSlope_(Parameters::defaultStereoMaxSlope()),
+	subPixWinSize_(Parameters::defaultOdomSubPixWinSize()),
+	subPixIterations_(Parameters::defaultOdomSubPixIterations()),
+	subPixEps_(Parameters::defaultOdomSubPixEps()),
+	feature2D_(0),
+	mapPoints_(new pcl::PointCloud<pcl::PointXYZ>),
+	nextId_(1),
+	frames_(0),
+	motion_(Transform::getIdentity())
+{
+	Parameters::parse(parameters, Parameters::kOdomF2MMaxSize(), maxSize_);
+	Parameters::parse(parameters, Parameters::kOdomF2MNNDR(), nndr_);
+	Parameters::parse(parameters, Parameters::kOdomF2MSearchRadius(), searchRadius_);
+	Parameters::parse(parameters, Parameters::kStereoWinSize(), stereoWinSize_);
+	Parameters::parse(parameters, Parameters::kStereoIterations(), stereoIterations_);
+	Parameters::parse(parameters, Parameters::kStereoEps(), stereoEps_);
+	Parameters::parse(parameters, Parameters::kStereoMaxLevel(), stereoMaxLevel_);
+	Parameters::parse(parameters, Parameters::kStereoMaxSlope(), stereoMaxSlope_);
+	Parameters::parse(parameters, Parameters::kOdomSubPixWinSize(), subPixWinSize_);
+	Parameters::parse(parameters, Parameters::kOdomSubPixIterations(), subPixIterations_);
+	Parameters::parse(parameters, Parameters::kOdomSubPixEps(), subPixEps_);
+	UASSERT(maxSize_ >= 0);
+	UASSERT(nndr_ > 0.0f);
+	UASSERT(searchRadius_ >= 0.0f);
+
+	ParametersMap::const_iterator iter;
+	Feature2D::Type detectorStrategy = (Feature2D::Type)Parameters::defaultOdomFeatureType();
+	if((iter=parameters.find(Parameters::kOdomFeatureType())) != parameters.end())
+	{
+		detectorStrategy = (Feature2D::Type)std::atoi((*iter).second.c_str());
+	}
+
+	ParametersMap customParameters;
+	int maxFeatures = Parameters::defaultOdomMaxFeatures();
+	Parameters::parse(parameters, Parameters::kOdomMaxFeatures(), maxFeatures);
+	customParameters.insert(ParametersPair(Parameters::kKpWordsPerImage(), uNumber2Str(maxFeatures)));
+	// add only feature stuff
+	for(ParametersMap::const_iterator iter=parameters.begin(); iter!=parameters.end(); ++iter)
+	{
+		std::string group = uSplit(iter->first, '/').front();
+		if(group.compare("SURF") == 0 ||
+			group.compare("SIFT") == 0 ||
+			group.compare("BRIEF") == 0 ||
+			group.compare("FAST") == 0 ||
+			group.compare("ORB") == 0 ||
+			group.compare("FREAK") == 0 ||
+			group.compare("GFTT") == 0 ||
+			group.compare("BRISK") == 0)
+		{
+			customParameters.insert(*iter);
+		}
+	}
+
+	feature2D_ = Feature2D::create(detectorStrategy, customParameters);
+}
+
+OdometryF2M::~OdometryF2M()
+{
+	delete feature2D_;
+}
+
+void OdometryF2M::reset(const Transform & initialPose)
+{
+	Odometry::reset(initialPose);
+	mapPoints_->clear();
+	mapDescriptors_ = cv::Mat();
+	mapIds_.clear();
+	mapLastSeen_.clear();
+	frames_ = 0;
+	motion_.setIdentity();
+}
+
+// Keypoints, descriptors and their 3D position in base frame (NaN if unknown)
+void OdometryF2M::extractFeatures(
+		const SensorData & data,
+		std::vector<cv::KeyPoint> & keypoints,
+		cv::Mat & descriptors,
+		pcl::PointCloud<pcl::PointXYZ>::Ptr & points) const
+{
+	cv::Mat imageMono;
+	// convert to grayscale
+	if(data.image().channels() > 1)
+	{
+		cv::cvtColor(data.image(), imageMono, cv::COLOR_BGR2GRAY);
+	}
+	else
+	{
+		imageMono = data.image();
+	}
+
+	cv::Rect roi = Feature2D::computeRoi(imageMono, this->getRoiRatios());
+	keypoints = feature2D_->generateKeypoints(imageMono, roi);
+	if(keypoints.empty())
+	{
+		return;
+	}
+
+	bool subPixelOn = subPixWinSize_ > 0 && subPixIterations_ > 0;
+	if(!data.depth().empty() && this->getMaxDepth() > 0.0f && !subPixelOn)
+	{
+		Feature2D::filterKeypointsByDepth(keypoints, data.depth(), this->getMaxDepth());
+	}
+
+	// descriptors should be extracted before subpixel
+	descriptors = feature2D_->generateDescriptors(imageMono, keypoints);
+	if(keypoints.empty())
+	{
+		return;
+	}
+
+	if(subPixelOn)
+	{
+		std::vector<cv::Point2f> corners;
+		cv::KeyPoint::convert(keypoints, corners);
+		cv::cornerSubPix( imageMono, corners,
+				cv::Size( subPixWinSize_, subPixWinSize_ ),
+				cv::Size( -1, -1 ),
+				cv::TermCriteria( CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, subPixIterations_, subPixEps_ ) );
+		for(unsigned int i=0;i<corners.size(); ++i)
+		{
+			keypoints[i].pt = corners[i];
+		}
+	}
+
+	if(!data.rightImage().empty())
+	{
+		//stereo
+		std::vector<cv::Point2f> leftCorners;
+		cv::KeyPoint::convert(keypoints, leftCorners);
+		cv::Mat disparity = util3d::disparityFromStereoImages(
+				imageMono,
+				data.rightImage(),
+				leftCorners,
+				stereoWinSize_,
+				stereoMaxLevel_,
+				stereoIterations_,
+				stereoEps_,
+				stereoMaxSlope_);
+		if(this->getMaxDepth() > 0.0f)
+		{
+			// disparity = baseline * fx / depth;
+			float minDisparity = data.baseline() * data.fx() / this->getMaxDepth();
+			Feature2D::filterKeypointsByDisparity(keypoints, descriptors, disparity, minDisparity);
+		}
+		points = util3d::generateKeypoints3DDisparity(keypoints, disparity, data.fx(), data.baseline(), data.cx(), data.cy(), data.localTransform());
+	}
+	else
+	{
+		//depth
+		if(this->getMaxDepth() > 0.0f && subPixelOn)
+		{
+			Feature2D::filterKeypointsByDepth(keypoints, descriptors, data.depth(), this->getMaxDepth());
+		}
+		points = util3d::generateKeypoints3DDepth(keypoints, data.depth(), data.fx(), data.fy(), data.cx(), data.cy(), data.localTransform());
+	}
+	UASSERT(points->size() == keypoints.size() && descriptors.rows == (int)keypoints.size());
+}
+
+// For each keypoint, the index of the matched point of the local map (-1 if not matched).
+// If guess is not null, only keypoints around the projection of the map points are compared.
+int OdometryF2M::matchFeatures(
+		const SensorData & data,
+		const std::vector<cv::KeyPoint> & keypoints,
+		const cv::Mat & descriptors,
+		const Transform & guess,
+		std::vector<int> & matches) const
+{
+	UASSERT(descriptors.type() == mapDescriptors_.type() && descriptors.cols == mapDescriptors_.cols);
+	bool binary = descriptors.type() == CV_8U;
+	int cols = descriptors.cols; // bytes or floats
+	float ratio = binary?nndr_:nndr_*nndr_; // L2 distances are squared
+
+	// keypoints in a grid of cells of the size of the search window
+	bool guided = !guess.isNull() && searchRadius_ > 0.0f;
+	float cellSize = guided?searchRadius_:1.0f;
+	int gridCols = guided?int(data.image().cols/cellSize)+1:1;
+	int gridRows = guided?int(data.image().rows/cellSize)+1:1;
+	std::vector<std::vector<int> > grid(gridCols*gridRows);
+	for(unsigned int i=0; i<keypoints.size(); ++i)
+	{
+		int c = guided?std::max(0, std::min(gridCols-1, int(keypoints[i].pt.x/cellSize))):0;
+		int r = guided?std::max(0, std::min(gridRows-1, int(keypoints[i].pt.y/cellSize))):0;
+		grid[r*gridCols+c].push_back(i);
+	}
+
+	Transform cameraInv;
+	float fx = data.fx();
+	float fy = data.fy()>0?data.fy():data.fx();
+	if(guided)
+	{
+		cameraInv = (guess * data.localTransform()).inverse();
+	}
+
+	// All map points against all keypoints: the two nearest keypoints
+	// of each map point with the SIMD brute force matcher
+	std::vector<std::vector<cv::DMatch> > knnMatches;
+	if(!guided && binary && descriptors.rows)
+	{
+		HammingMatcher matcher;
+		matcher.setData(descriptors);
+		matcher.knnMatch(mapDescriptors_, knnMatches, 2);
+	}
+
+	std::vector<float> distances(keypoints.size(), std::numeric_limits<float>::max());
+	matches.assign(keypoints.size(), -1);
+	float radiusSqrd = searchRadius_*searchRadius_;
+	for(int j=0; j<(int)mapPoints_->size(); ++j)
+	{
+		int best = -1;
+		float bestDistance = std::numeric_limits<float>::max();
+		float secondDistance = std::numeric_limits<float>::max();
+		if(knnMatches.size())
+		{
+			if(knnMatches[j].size())
+			{
+				best = knnMatches[j][0].trainIdx;
+				bestDistance = knnMatches[j][0].distance;
+			}
+			if(knnMatches[j].size() > 1)
+			{
+				secondDistance = knnMatches[j][1].distance;
+			}
+		}
+		else
+		{
+			int c0=0, c1=0, r0=0, r1=0;
+			float u=0.0f, v=0.0f;
+			if(guided)
+			{
+				pcl::PointXYZ pt = util3d::transformPoint(mapPoints_->at(j), cameraInv);
+				if(pt.z <= 0.0f)
+				{
+					continue;
+				}
+				u = fx*pt.x/pt.z + data.cx();
+				v = fy*pt.y/pt.z + data.cy();
+				c0 = int((u-searchRadius_)/cellSize);
+				c1 = int((u+searchRadius_)/cellSize);
+				r0 = int((v-searchRadius_)/cellSize);
+				r1 = int((v+searchRadius_)/cellSize);
+				if(c1 < 0 || r1 < 0 || c0 >= gridCols || r0 >= gridRows)
+				{
+					continue; // not in the image
+				}
+				c0 = std::max(c0, 0); c1 = std::min(c1, gridCols-1);
+				r0 = std::max(r0, 0); r1 = std::min(r1, gridRows-1);
+			}
+
+			// best and second best keypoints
+			const unsigned char * mapDescriptor = mapDescriptors_.ptr(j);
+			for(int r=r0; r<=r1; ++r)
+			{
+				for(int c=c0; c<=c1; ++c)
+				{
+					const std::vector<int> & cell = grid[r*gridCols+c];
+					for(unsigned int k=0; k<cell.size(); ++k)
+					{
+						int i = cell[k];
+						if(guided)
+						{
+							float du = keypoints[i].pt.x - u;
+							float dv = keypoints[i].pt.y - v;
+							if(du*du + dv*dv > radiusSqrd)
+							{
+								continue;
+							}
+						}
+						float d = descriptorDistance(descriptors.ptr(i), mapDescriptor, cols, binary);
+						if(d < bestDistance)
+						{
+							secondDistance = bestDistance;
+							bestDistance = d;
+							best = i;
+						}
+						else if(d < secondDistance)
+						{
+							secondDistance = d;
+						}
+					}
+				}
+			}
+		}
+
+		// a keypoint is matched to only one map point, the closest one
+		if(best >= 0 &&
+		   (secondDistance == std::numeric_limits<float>::max() || bestDistance < ratio * secondDistance) &&
+		   bestDistance < distances[best])
+		{
+			distances[best] = bestDistance;
+			matches[best] = j;
+		}
+	}
+
+	int count = 0;
+	for(unsigned int i=0; i<matches.size(); ++i)
+	{
+		if(matches[i] >= 0)
+		{
+			++count;
+		}
+	}
+	return count;
+}
+
+// return not null transform if odometry is correctly computed
+Transform OdometryF2M::computeTransform(
+		const SensorData & data,
+		OdometryInfo * info)
+{
+	UTimer timer;
+	Transform output;
+
+	if(info)
+	{
+		info->type = 0;
+	}
+
+	double variance = 0;
+	int inliers = 0;
+	int correspondences = 0;
+	int nFeatures = 0;
+
+	if(data.depthOrRightImage().empty() || data.fx() <= 0.0f)
+	{
+		UERROR("Frame-to-map odometry requires calibrated depth or stereo images.");
+		return output;
+	}
+
+	std::vector<cv::KeyPoint> keypoints;
+	cv::Mat descriptors;
+	pcl::PointCloud<pcl::PointXYZ>::Ptr points(new pcl::PointCloud<pcl::PointXYZ>);
+	extractFeatures(data, keypoints, descriptors, points);
+	nFeatures = (int)keypoints.size();
+	UDEBUG("features=%d (%fs)", nFeatures, timer.ticks());
+
+	std::vector<int> matches(keypoints.size(), -1);
+	std::vector<int> inliersV;
+	if(mapPoints_->size() && descriptors.rows &&
+	   (descriptors.type() != mapDescriptors_.type() || descriptors.cols != mapDescriptors_.cols))
+	{
+		UWARN("Descriptors changed (type=%d/%d, size=%d/%d), local map is cleared.",
+				descriptors.type(), mapDescriptors_.type(), descriptors.cols, mapDescriptors_.cols);
+		this->reset(this->getPose());
+	}
+
+	if(mapPoints_->size() == 0)
+	{
+		int valid = 0;
+		for(unsigned int i=0; i<points->size(); ++i)
+		{
+			if(pcl::isFinite(points->at(i)))
+			{
+				++valid;
+			}
+		}
+		if(valid >= this->getMinInliers())
+		{
+			output.setIdentity();
+		}
+		else
+		{
+			UWARN("Not enough 3D features to initialize the local map (%d < %d)", valid, this->getMinInliers());
+		}
+	}
+	else if(nFeatures > 0 && nFeatures >= this->getMinInliers())
+	{
+		// constant velocity model for the guess, all keypoints are compared if the guided search fails
+		correspondences = matchFeatures(data, keypoints, descriptors, this->getPose() * motion_, matches);
+		if(correspondences < this->getMinInliers() && searchRadius_ > 0.0f)
+		{
+			UDEBUG("Guided matching failed (%d < %d), matching with all features...", correspondences, this->getMinInliers());
+			correspondences = matchFeatures(data, keypoints, descriptors, Transform(), matches);
+		}
+		UDEBUG("localMap=%d, new=%d, matches=%d (%fs)", (int)mapPoints_->size(), nFeatures, correspondences, timer.ticks());
+
+		Transform transform;
+		std::vector<int> matchedIndices; // keypoint indices
+		if(this->isPnPEstimationUsed())
+		{
+			std::vector<cv::Point3f> objectPoints;
+			std::vector<cv::Point2f> imagePoints;
+			for(unsigned int i=0; i<matches.size(); ++i)
+			{
+				if(matches[i] >= 0)
+				{
+					const pcl::PointXYZ & pt = mapPoints_->at(matches[i]);
+					objectPoints.push_back(cv::Point3f(pt.x, pt.y, pt.z));
+					imagePoints.push_back(keypoints[i].pt);
+					matchedIndices.push_back(i);
+				}
+			}
+
+			if((int)matchedIndices.size() >= this->getMinInliers())
+			{
+				//PnPRansac
+				cv::Mat K = (cv::Mat_<double>(3,3) <<
+					data.fx(), 0, data.cx(),
+					0, data.fy()>0?data.fy():data.fx(), data.cy(),
+					0, 0, 1);
+				Transform guess = (this->getPose() * motion_ * data.localTransform()).inverse();
+				cv::Mat R = (cv::Mat_<double>(3,3) <<
+						(double)guess.r11(), (double)guess.r12(), (double)guess.r13(),
+						(double)guess.r21(), (double)guess.r22(), (double)guess.r23(),
+						(double)guess.r31(), (double)guess.r32(), (double)guess.r33());
+				cv::Mat rvec(1,3, CV_64FC1);
+				cv::Rodrigues(R, rvec);
+				cv::Mat tvec = (cv::Mat_<double>(1,3) << (double)guess.x(), (double)guess.y(), (double)guess.z());
+				std::vector<int> pnpInliers;
+				cv::solvePnPRansac(objectPoints,
+						imagePoints,
+						K,
+						cv::Mat(),
+						rvec,
+						tvec,
+						true,
+						this->getIterations(),
+						this->getPnPReprojError(),
+						0,
+						pnpInliers,
+						this->getPnPFlags());
+
+				if((int)pnpInliers.size() >= this->getMinInliers())
+				{
+					cv::Rodrigues(rvec, R);
+					Transform pnp(R.at<double>(0,0), R.at<double>(0,1), R.at<double>(0,2), tvec.at<double>(0),
+								   R.at<double>(1,0), R.at<double>(1,1), R.at<double>(1,2), tvec.at<double>(1),
+								   R.at<double>(2,0), R.at<double>(2,1), R.at<double>(2,2), tvec.at<double>(2));
+
+					// make it incremental
+					transform = (data.localTransform() * pnp * this->getPose()).inverse();
+
+					// compute variance (like in PCL computeVariance() method of sac_model.h)
+					std::vector<float> errorSqrdDists;
+					for(unsigned int i=0; i<pnpInliers.size(); ++i)
+					{
+						const pcl::PointXYZ & pt = points->at(matchedIndices[pnpInliers[i]]);
+						if(pcl::isFinite(pt))
+						{
+							const cv::Point3f & objPt = objectPoints[pnpInliers[i]];
+							pcl::PointXYZ newPt = util3d::transformPoint(pt, this->getPose()*transform);
+							errorSqrdDists.push_back(uNormSquared(objPt.x-newPt.x, objPt.y-newPt.y, objPt.z-newPt.z));
+						}
+					}
+					if(errorSqrdDists.size())
+					{
+						std::sort(errorSqrdDists.begin(), errorSqrdDists.end());
+						double median_error_sqr = (double)errorSqrdDists[errorSqrdDists.size () >> 1];
+						variance = 2.1981 * median_error_sqr;
+					}
+				}
+				else
+				{
+					UWARN("PnP not enough inliers (%d < %d), rejecting the transform...", (int)pnpInliers.size(), this->getMinInliers());
+				}
+				inliersV = pnpInliers;
+			}
+			else
+			{
+				UWARN("Not enough correspondences (%d < %d)", (int)matchedIndices.size(), this->getMinInliers());
+			}
+		}
+		else
+		{
+			pcl::PointCloud<pcl::PointXYZ>::Ptr inliers1(new pcl::PointCloud<pcl::PointXYZ>); // local map
+			pcl::PointCloud<pcl::PointXYZ>::Ptr inliers2(new pcl::PointCloud<pcl::PointXYZ>); // new
+			for(unsigned int i=0; i<matches.size(); ++i)
+			{
+				if(matches[i] >= 0 && pcl::isFinite(points->at(i)))
+				{
+					inliers1->push_back(mapPoints_->at(matches[i]));
+					inliers2->push_back(points->at(i));
+					matchedIndices.push_back(i);
+				}
+			}
+
+			if((int)matchedIndices.size() >= this->getMinInliers())
+			{
+				// the transform returned is global odometry pose, not incremental one
+				Transform t = util3d::transformFromXYZCorrespondences(
+						inliers2,
+						inliers1,
+						this->getInlierDistance(),
+						this->getIterations(),
+						this->getRefineIterations()>0, 3.0, this->getRefineIterations(),
+						&inliersV,
+						&variance);
+
+				if(!t.isNull() && (int)inliersV.size() >= this->getMinInliers())
+				{
+					// make it incremental
+					transform = this->getPose().inverse() * t;
+				}
+				else
+				{
+					UWARN("Transform not valid (inliers = %d/%d)", (int)inliersV.size(), (int)matchedIndices.size());
+				}
+			}
+			else
+			{
+				UWARN("Not enough inliers %d < %d", (int)matchedIndices.size(), this->getMinInliers());
+			}
+		}
+		inliers = (int)inliersV.size();
+
+		// keep only the inliers, others will be added as new points
+		std::vector<int> inlierMatches(matches.size(), -1);
+		for(unsigned int i=0; i<inliersV.size(); ++i)
+		{
+			int index = matchedIndices[inliersV[i]];
+			inlierMatches[index] = matches[index];
+		}
+		if(this->isInfoDataFilled() && info)
+		{
+			for(unsigned int i=0; i<matchedIndices.size(); ++i)
+			{
+				info->wordMatches.push_back(mapIds_[matches[matchedIndices[i]]]);
+			}
+			for(unsigned int i=0; i<inliersV.size(); ++i)
+			{
+				info->wordInliers.push_back(mapIds_[matches[matchedIndices[inliersV[i]]]]);
+			}
+		}
+		matches = inlierMatches;
+
+		if(!transform.isNull())
+		{
+			UDEBUG("Odom transform = %s", transform.prettyPrint().c_str());
+			output = transform;
+		}
+	}
+	else
+	{
+		UWARN("Not enough features in the new image (%d < %d)", nFeatures, this->getMinInliers());
+	}
+
+	std::vector<int> ids(keypoints.size(), 0);
+	if(!output.isNull())
+	{
+		this->updateLocalMap(this->getPose() * output, descriptors, points, matches, ids);
+		motion_ = output;
+	}
+
+	if(info)
+	{
+		if(this->isInfoDataFilled())
+		{
+			for(unsigned int i=0; i<keypoints.size(); ++i)
+			{
+				if(ids[i] > 0)
+				{
+					info->words.insert(std::make_pair(ids[i], keypoints[i]));
+				}
+			}
+			for(unsigned int i=0; i<mapPoints_->size(); ++i)
+			{
+				const pcl::PointXYZ & pt = mapPoints_->at(i);
+				info->localMap.insert(std::make_pair(mapIds_[i], cv::Point3f(pt.x, pt.y, pt.z)));
+			}
+		}
+		info->variance = variance;
+		info->inliers = inliers;
+		info->matches = correspondences;
+		info->features = nFeatures;
+		info->localMapSize = (int)mapPoints_->size();
+	}
+
+	UINFO("Odom update time = %fs lost=%s features=%d inliers=%d/%d variance=%f local_map=%d",
+			timer.elapsed(),
+			output.isNull()?"true":"false",
+			nFeatures,
+			inliers,
+			correspondences,
+			variance,
+			(int)mapPoints_->size());
+	return output;
+}
+
+// Add the new points (pose is the new pose), then remove the points not seen for the longest time
+void OdometryF2M::updateLocalMap(
+		const Transform & pose,
+		const cv::Mat & descriptors,
+		const pcl::PointCloud<pcl::PointXYZ>::Ptr & points,
+		const std::vector<int> & matches,
+		std::vector<int> & ids)
+{
+	++frames_;
+	ids.resize(matches.size());
+	for(unsigned int i=0; i<matches.size(); ++i)
+	{
+		if(matches[i] >= 0)
+		{
+			mapLastSeen_[matches[i]] = frames_;
+			ids[i] = mapIds_[matches[i]];
+		}
+		else if(pcl::isFinite(points->at(i)))
+		{
+			mapPoints_->push_back(util3d::transformPoint(points->at(i), pose));
+			mapDescriptors_.push_back(descriptors.row(i));
+			mapIds_.push_back(nextId_);
+			mapLastSeen_.push_back(frames_);
+			ids[i] = nextId_++;
+		}
+		else
+		{
+			ids[i] = 0;
+		}
+	}
+
+	if(maxSize_ > 0 && (int)mapPoints_->size() > maxSize_)
+	{
+		// keep the most recently seen points, in the same order
+		std::vector<std::pair<int, int> > ages(mapLastSeen_.size()); // <-last seen, index>
+		for(unsigned int i=0; i<mapLastSeen_.size(); ++i)
+		{
+			ages[i] = std::make_pair(-mapLastSeen_[i], (int)i);
+		}
+		std::nth_element(ages.begin(), ages.begin()+maxSize_, ages.end());
+		std::vector<int> kept(maxSize_);
+		for(int i=0; i<maxSize_; ++i)
+		{
+			kept[i] = ages[i].second;
+		}
+		std::sort(kept.begin(), kept.end());
+
+		pcl::PointCloud<pcl::PointXYZ>::Ptr mapPoints(new pcl::PointCloud<pcl::PointXYZ>);
+		mapPoints->resize(maxSize_);
+		cv::Mat mapDescriptors(maxSize_, mapDescriptors_.cols, mapDescriptors_.type());
+		std::vector<int> mapIds(maxSize_);
+		std::vector<int> mapLastSeen(maxSize_);
+		for(int i=0; i<maxSize_; ++i)
+		{
+			mapPoints->at(i) = mapPoints_->at(kept[i]);
+			mapDescriptors_.row(kept[i]).copyTo(mapDescriptors.row(i));
+			mapIds[i] = mapIds_[kept[i]];
+			mapLastSeen[i] = mapLastSeen_[kept[i]];
+		}
+		UDEBUG("Removed %d points from the local map", (int)mapPoints_->size()-maxSize_);
+		mapPoints_ = mapPoints;
+		mapDescriptors_ = mapDescriptors;
+		mapIds_ = mapIds;
+		mapLastSeen_ = mapLastSeen;
+	}
+}
+
+} // namespace rtabmap
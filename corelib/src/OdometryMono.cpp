@@ -498,7 +498,7 @@ Transform OdometryMono::computeTransform(const SensorData & data, OdometryInfo *
 			int ii=0;
 			for(std::map<int, cv::Point2f>::iterator iter=cornersMap_.begin(); iter!=cornersMap_.end(); ++iter)
 			{
-				std::multimap<int, cv::KeyPoint>::const_iterator jter=refS->getWords().find(iter->first);
+				FlatWords<cv::KeyPoint>::const_iterator jter=refS->getWords().find(iter->first);
 				UASSERT(jter != refS->getWords().end());
 				refCorners[ii] = jter->second.pt;
 				refCornersGuess[ii] = iter->second;
@@ -832,7 +832,7 @@ Transform OdometryMono::computeTransform(const SensorData & data, OdometryInfo *
 								if(!reject)
 								{
 									///
-									std::vector<int> wordsId = uKeys(memory_->getLastWorkingSignature()->getWords());
+									std::vector<int> wordsId = memory_->getLastWorkingSignature()->getWords().ids();
 									UASSERT(wordsId.size());
 									UASSERT(cornerIds.size() == objectPoints.size());
 									std::multimap<int, pcl::PointXYZ> keyFrameWords3D;
@@ -880,10 +880,10 @@ Transform OdometryMono::computeTransform(const SensorData & data, OdometryInfo *
 			// generate kpts
 		if(memory_->update(SensorData(newFrame)))
 		{
-			const std::multimap<int, cv::KeyPoint> & words = memory_->getLastWorkingSignature()->getWords();
+			const FlatWords<cv::KeyPoint> & words = memory_->getLastWorkingSignature()->getWords();
 			if((int)words.size() > this->getMinInliers())
 			{
-				for(std::multimap<int, cv::KeyPoint>::const_iterator iter=words.begin(); iter!=words.end(); ++iter)
+				for(FlatWords<cv::KeyPoint>::const_iterator iter=words.begin(); iter!=words.end(); ++iter)
 				{
 					cornersMap_.insert(std::make_pair(iter->first, iter->second.pt));
 				}
@@ -45,14 +45,11 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "SimpleIni.h"
 
-#include <pcl/search/kdtree.h>
-#include <pcl/filters/crop_box.h>
-#include <pcl/io/pcd_io.h>
-
 #include "rtabmap/core/util3d.h"
 
 #include <stdlib.h>
 #include <set>
+#include <algorithm>
 
 #define LOG_F "LogF.txt"
 #define LOG_I "LogI.txt"
@@ -116,10 +113,12 @@ Rtabmap::Rtabmap() :
 	_epipolarGeometry(0),
 	_bayesFilter(0),
 	_graphOptimizer(0),
+	_globalGraphOptimizer(0),
 	_memory(0),
 	_foutFloat(0),
 	_foutInt(0),
 	_wDir("."),
+	_optimizedPosesIndex(new graph::PosesIndex()),
 	_mapCorrection(Transform::getIdentity()),
 	_mapTransform(Transform::getIdentity()),
 	_pathCurrentIndex(0),
@@ -131,6 +130,7 @@ Rtabmap::Rtabmap() :
 Rtabmap::~Rtabmap() {
 	UDEBUG("");
 	this->close();
+	delete _optimizedPosesIndex;
 }
 
 std::string Rtabmap::getVersion()
@@ -312,10 +312,15 @@ void Rtabmap::close()
 	_loopClosureHypothesis = std::make_pair(0,0.0f);
 	_lastProcessTime = 0.0;
 	_optimizedPoses.clear();
+	_optimizedPosesIndex->clear();
 	_constraints.clear();
 	_mapCorrection.setIdentity();
 	_mapTransform.setIdentity();
 	this->clearPath();
+	for(int i=0; i<4; ++i)
+	{
+		_mapDeltaCaches[i] = MapDeltaCache();
+	}
 
 	flushStatisticLogs();
 	if(_foutFloat)
@@ -349,6 +354,11 @@ void Rtabmap::close()
 		delete _graphOptimizer;
 		_graphOptimizer = 0;
 	}
+	if(_globalGraphOptimizer)
+	{
+		delete _globalGraphOptimizer;
+		_globalGraphOptimizer = 0;
+	}
 	_databasePath.clear();
 	parseParameters(Parameters::getDefaultParameters()); // reset to default parameters
 	_modifiedParameters.clear();
@@ -384,6 +394,8 @@ void Rtabmap::parseParameters(const ParametersMap & parameters)
 	Parameters::parse(parameters, Parameters::kRGBDLocalLoopDetectionTime(), _localLoopClosureDetectionTime);
 	Parameters::parse(parameters, Parameters::kRGBDLocalLoopDetectionSpace(), _localLoopClosureDetectionSpace);
 	Parameters::parse(parameters, Parameters::kRGBDLocalRadius(), _localRadius);
+	// poses are mostly searched in the local radius
+	_optimizedPosesIndex->setCellSize(_localRadius > 0.0f?_localRadius:1.0f);
 	Parameters::parse(parameters, Parameters::kRGBDLocalLoopDetectionMaxDiffID(), _localDetectMaxDiffID);
 	Parameters::parse(parameters, Parameters::kRGBDLocalLoopDetectionPathFilteringRadius(), _localPathFilteringRadius);
 	Parameters::parse(parameters, Parameters::kRGBDOptimizeFromGraphEnd(), _optimizeFromGraphEnd);
@@ -441,6 +453,25 @@ void Rtabmap::parseParameters(const ParametersMap & parameters)
 		optimizerType = (graph::Optimizer::Type)Parameters::defaultRGBDOptimizeStrategy();
 		_graphOptimizer = graph::Optimizer::create(optimizerType, parameters);
 	}
+	// The incremental optimizer keeps the factorization of the local map between
+	// the updates, the global maps requested are optimized by another optimizer.
+	if(_graphOptimizer->type() == graph::Optimizer::kTypeIncremental)
+	{
+		if(_globalGraphOptimizer == 0)
+		{
+			graph::Optimizer::Type globalType = graph::Optimizer::kTypeG2O; // TORO if not available
+			_globalGraphOptimizer = graph::Optimizer::create(globalType, parameters);
+		}
+		else
+		{
+			_globalGraphOptimizer->parseParameters(parameters);
+		}
+	}
+	else if(_globalGraphOptimizer)
+	{
+		delete _globalGraphOptimizer;
+		_globalGraphOptimizer = 0;
+	}
 
 	if(_memory)
 	{
@@ -562,7 +593,7 @@ std::multimap<int, cv::KeyPoint> Rtabmap::getWords(int locationId) const
 		const Signature * s = _memory->getSignature(locationId);
 		if(s)
 		{
-			return s->getWords();
+			return s->getWords().toMultimap();
 		}
 	}
 	return std::multimap<int, cv::KeyPoint>();
@@ -630,6 +661,7 @@ int Rtabmap::triggerNewMap()
 		mapId = _memory->incrementMapId();
 		UINFO("New map triggered, new map = %d", mapId);
 		_optimizedPoses.clear();
+		_optimizedPosesIndex->clear();
 		_constraints.clear();
 	}
 	return mapId;
@@ -734,10 +766,15 @@ void Rtabmap::resetMemory()
 	_loopClosureHypothesis = std::make_pair(0,0.0f);
 	_lastProcessTime = 0.0;
 	_optimizedPoses.clear();
+	_optimizedPosesIndex->clear();
 	_constraints.clear();
 	_mapCorrection.setIdentity();
 	_mapTransform.setIdentity();
 	this->clearPath();
+	for(int i=0; i<4; ++i)
+	{
+		_mapDeltaCaches[i] = MapDeltaCache();
+	}
 
 	if(_memory)
 	{
@@ -745,6 +782,7 @@ void Rtabmap::resetMemory()
 		if(_memory->getLastWorkingSignature())
 		{
 			optimizeCurrentMap(_memory->getLastWorkingSignature()->id(), false, _optimizedPoses, &_constraints);
+			_optimizedPosesIndex->update(_optimizedPoses);
 		}
 		if(_bayesFilter)
 		{
@@ -786,6 +824,8 @@ bool Rtabmap::process(const SensorData & data)
 	double timeRealTimeLimitReachedProcess = 0;
 	double timeMemoryCleanup = 0;
 	double timeEmptyingTrash = 0;
+	double timeEmptyingTrashLatency = 0;
+	int trashQueueSize = 0;
 	double timeJoiningTrash = 0;
 	double timeStatsCreation = 0;
 
@@ -801,6 +841,10 @@ bool Rtabmap::process(const SensorData & data)
 
 	std::map<int, int> childCount;
 	std::set<int> signaturesRetrieved;
+	int prefetchHits = 0;
+	int prefetchMisses = 0;
+	int prefetchStaged = 0;
+	long prefetchStagedMemory = 0;
 	int localLoopClosuresInTimeFound = 0;
 	bool scanMatchingSuccess = false;
 
@@ -906,6 +950,7 @@ bool Rtabmap::process(const SensorData & data)
 		if(rehearsedId > 0)
 		{
 			_optimizedPoses.erase(rehearsedId);
+			_optimizedPosesIndex->remove(rehearsedId);
 		}
 		else if(_rgbdLinearUpdate > 0.0f && _rgbdAngularUpdate > 0.0f)
 		{
@@ -935,6 +980,7 @@ bool Rtabmap::process(const SensorData & data)
 
 		Transform newPose = _mapCorrection * signature->getPose();
 		_optimizedPoses.insert(std::make_pair(signature->id(), newPose));
+		_optimizedPosesIndex->update(signature->id(), _optimizedPoses.at(signature->id()));
 
 		//============================================================
 		// Scan matching
@@ -1148,10 +1194,13 @@ bool Rtabmap::process(const SensorData & data)
 	}
 
 	//============================================================
-	// Before retrieval, make sure the trash has finished
+	// The trash is saved in background: signatures and words being
+	// saved are still read from the trash by the retrieval, so don't
+	// wait for it (it is flushed synchronously on close/reset)
 	//============================================================
-	_memory->joinTrashThread();
 	timeEmptyingTrash = _memory->getDbSavingTime();
+	timeEmptyingTrashLatency = _memory->getDbSavingLatency();
+	trashQueueSize = _memory->getDbTrashQueueSize();
 	timeJoiningTrash = timer.ticks();
 	ULOGGER_INFO("Time emptying memory trash = %fs,  joining (actual overhead) = %fs", timeEmptyingTrash, timeJoiningTrash);
 
@@ -1342,7 +1391,7 @@ bool Rtabmap::process(const SensorData & data)
 		else if(retrievalLocalIds.size() < _maxLocalRetrieved)
 		{
 			// retrieval based on the nodes near the current pose
-			std::map<int, float> nearNodes = graph::getNodesInRadius(signature->id(), _optimizedPoses, 0, _localRadius);
+			std::map<int, float> nearNodes = graph::getNodesInRadius(signature->id(), *_optimizedPosesIndex, 0, _localRadius);
 			// sort by distance
 			std::multimap<float, int> nearNodesByDist;
 			for(std::map<int, float>::iterator iter=nearNodes.begin(); iter!=nearNodes.end(); ++iter)
@@ -1393,6 +1442,10 @@ bool Rtabmap::process(const SensorData & data)
 				timeRetrievalDbAccess);
 
 		ULOGGER_INFO("retrieval of %d (db time = %fs)", (int)signaturesRetrieved.size(), timeRetrievalDbAccess);
+		prefetchHits = _memory->getPrefetchHits();
+		prefetchMisses = _memory->getPrefetchMisses();
+		prefetchStaged = _memory->getPrefetchStaged();
+		prefetchStagedMemory = _memory->getPrefetchStagedMemory();
 
 		timeRetrievalDbAccess += timeGetNeighborsTimeDb + timeGetNeighborsSpaceDb;
 		UINFO("total timeRetrievalDbAccess=%fs", timeRetrievalDbAccess);
@@ -1640,6 +1693,7 @@ bool Rtabmap::process(const SensorData & data)
 			UINFO("Update map correction: SLAM mode");
 			// SLAM mode!
 			optimizeCurrentMap(signature->id(), false, _optimizedPoses, &_constraints);
+			_optimizedPosesIndex->update(_optimizedPoses);
 
 			// Update map correction, it should be identify when optimizing from the last node
 			_mapCorrection = _optimizedPoses.at(signature->id()) * signature->getPose().inverse();
@@ -1658,6 +1712,7 @@ bool Rtabmap::process(const SensorData & data)
 			{
 				// update optimized poses
 				optimizeCurrentMap(oldId, false, _optimizedPoses, &_constraints);
+				_optimizedPosesIndex->update(_optimizedPoses);
 			}
 			UASSERT(_optimizedPoses.find(oldId) != _optimizedPoses.end());
 
@@ -1712,7 +1767,7 @@ bool Rtabmap::process(const SensorData & data)
 	}
 	dictionarySize = (int)_memory->getVWDictionary()->getVisualWords().size();
 	refWordsCount = (int)signature->getWords().size();
-	refUniqueWordsCount = (int)uUniqueKeys(signature->getWords()).size();
+	refUniqueWordsCount = (int)signature->getWords().uniqueIds().size();
 
 	// Posterior is empty if a bad signature is detected
 	float vpHypothesis = posterior.size()?posterior.at(Memory::kIdVirtual):0.0f;
@@ -1812,6 +1867,10 @@ bool Rtabmap::process(const SensorData & data)
 
 			// retrieval
 			statistics_.addStatistic(Statistics::kMemorySignatures_retrieved(), (float)signaturesRetrieved.size());
+			statistics_.addStatistic(Statistics::kMemoryPrefetch_hits(), prefetchHits);
+			statistics_.addStatistic(Statistics::kMemoryPrefetch_misses(), prefetchMisses);
+			statistics_.addStatistic(Statistics::kMemoryPrefetch_staged(), prefetchStaged);
+			statistics_.addStatistic(Statistics::kMemoryPrefetch_staged_memory(), (float)prefetchStagedMemory/1024.0f);
 
 			// Surf specific parameters
 			statistics_.addStatistic(Statistics::kKeypointDictionary_size(), dictionarySize);
@@ -1913,6 +1972,7 @@ bool Rtabmap::process(const SensorData & data)
 			{
 				if(!uContains(ids, iter->first))
 				{
+					_optimizedPosesIndex->remove(iter->first);
 					_optimizedPoses.erase(iter++);
 				}
 				else
@@ -1935,6 +1995,7 @@ bool Rtabmap::process(const SensorData & data)
 		else
 		{
 			_optimizedPoses.clear();
+			_optimizedPosesIndex->clear();
 			_constraints.clear();
 		}
 	}
@@ -1953,6 +2014,8 @@ bool Rtabmap::process(const SensorData & data)
 		statistics_.addStatistic(Statistics::kTimingForgetting(), timeRealTimeLimitReachedProcess*1000);
 		statistics_.addStatistic(Statistics::kTimingJoining_trash(), timeJoiningTrash*1000);
 		statistics_.addStatistic(Statistics::kTimingEmptying_trash(), timeEmptyingTrash*1000);
+		statistics_.addStatistic(Statistics::kTimingEmptying_trash_latency(), timeEmptyingTrashLatency*1000);
+		statistics_.addStatistic(Statistics::kMemoryTrash_queue_size(), trashQueueSize);
 		statistics_.addStatistic(Statistics::kTimingMemory_cleanup(), timeMemoryCleanup*1000);
 		statistics_.addStatistic(Statistics::kMemorySignatures_removed(), signaturesRemoved.size());
 
@@ -1993,6 +2056,47 @@ bool Rtabmap::process(const SensorData & data)
 	//Start trashing
 	_memory->emptyTrash();
 
+	//============================================================
+	// Prefetch in background the locations that may be retrieved on next update
+	//============================================================
+	std::list<int> prefetchIds;
+	if(_rgbdSlamMode && _maxLocalRetrieved > 0)
+	{
+		// nodes ahead on the planned path
+		for(unsigned int i=_pathCurrentIndex; i<_path.size() && prefetchIds.size() < _maxLocalRetrieved; ++i)
+		{
+			if(_memory->getSignature(_path[i].first) == 0)
+			{
+				prefetchIds.push_back(_path[i].first);
+			}
+		}
+	}
+	int prefetchMargin = (int)_bayesFilter->getPredictionLC().size()-1;
+	if(_highestHypothesis.first > 0 && prefetchMargin > 0 && _memory->getSignature(_highestHypothesis.first))
+	{
+		// nodes in LTM linked to the neighborhood of the highest hypothesis, nearest first
+		std::map<int, int> neighbors = _memory->getNeighborsId(_highestHypothesis.first, prefetchMargin, 0, true);
+		std::multimap<int, int> neighborsByMargin;
+		for(std::map<int, int>::iterator iter=neighbors.begin(); iter!=neighbors.end(); ++iter)
+		{
+			neighborsByMargin.insert(std::make_pair(iter->second, iter->first));
+		}
+		for(std::multimap<int, int>::iterator iter=neighborsByMargin.begin(); iter!=neighborsByMargin.end(); ++iter)
+		{
+			const Signature * s = _memory->getSignature(iter->second);
+			UASSERT(s!=0);
+			const std::map<int, Link> & links = s->getLinks();
+			for(std::map<int, Link>::const_iterator jter=links.begin(); jter!=links.end(); ++jter)
+			{
+				if(_memory->getSignature(jter->first) == 0)
+				{
+					prefetchIds.push_back(jter->first);
+				}
+			}
+		}
+	}
+	_memory->prefetchSignatures(prefetchIds);
+
 	// Log info...
 	// TODO : use a specific class which will handle the RtabmapEvent
 	if(_foutFloat && _foutInt)
@@ -2149,10 +2253,6 @@ std::map<int, Transform> Rtabmap::getForwardWMPoses(
 		const Signature * fromS = _memory->getSignature(fromId);
 		UASSERT(fromS != 0);
 
-		pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
-		cloud->resize(_optimizedPoses.size());
-		std::vector<int> ids(_optimizedPoses.size());
-		int oi = 0;
 		const std::set<int> & stm = _memory->getStMem();
 		//get margins
 		std::map<int, int> margins;
@@ -2160,85 +2260,36 @@ std::map<int, Transform> Rtabmap::getForwardWMPoses(
 		{
 			margins = _memory->getNeighborsId(fromId, maxDiffID, 0, true, false);
 		}
-		for(std::map<int, Transform>::const_iterator iter = _optimizedPoses.begin(); iter!=_optimizedPoses.end(); ++iter)
-		{
-			if(iter->first != fromId)
-			{
-				// Only locations in Working Memory not too far from the current node (so inside the margin)
-				bool diffIdOk = maxDiffID == 0 || uContains(margins, iter->first);
-				if(stm.find(iter->first) == stm.end() && diffIdOk)
-				{
-					(*cloud)[oi] = pcl::PointXYZ(iter->second.x(), iter->second.y(), iter->second.z());
-					ids[oi++] = iter->first;
-				}
-			}
-		}
-
-		cloud->resize(oi);
-		ids.resize(oi);
 
 		UASSERT(_optimizedPoses.find(fromId) != _optimizedPoses.end());
 		Transform fromT = _optimizedPoses.at(fromId);
+		Transform fromTInv = fromT.inverse();
 
-		if(cloud->size())
+		// Poses in the radius sorted by distance, then keep the ones in front of fromId
+		std::vector<int> ids;
+		std::vector<float> sqrDistances;
+		_optimizedPosesIndex->radiusSearch(fromT, radius, ids, sqrDistances);
+		for(unsigned int i=0; i<ids.size() && (maxNearestNeighbors <= 0 || (int)poses.size() < maxNearestNeighbors); ++i)
 		{
-			//if(cloud->size())
-			//{
-			//	pcl::io::savePCDFile("radiusPoses.pcd", *cloud);
-			//	UWARN("Saved radiusPoses.pcd");
-			//}
-
+			// Only locations in Working Memory not too far from the current node (so inside the margin)
+			if(ids[i] == fromId ||
+			   stm.find(ids[i]) != stm.end() ||
+			   (maxDiffID > 0 && !uContains(margins, ids[i])))
+			{
+				continue;
+			}
+			std::map<int, Transform>::const_iterator iter = _optimizedPoses.find(ids[i]);
+			if(iter == _optimizedPoses.end())
+			{
+				continue;
+			}
 			//filter poses in front of the fromId
-			float x,y,z, roll,pitch,yaw;
-			fromT.getTranslationAndEulerAngles(x,y,z, roll,pitch,yaw);
-
-			pcl::CropBox<pcl::PointXYZ> cropbox;
-			cropbox.setInputCloud(cloud);
-			cropbox.setMin(Eigen::Vector4f(-1, -radius, -999999, 0));
-			cropbox.setMax(Eigen::Vector4f(radius, radius, 999999, 0));
-			cropbox.setRotation(Eigen::Vector3f(roll, pitch, yaw));
-			cropbox.setTranslation(Eigen::Vector3f(x, y, z));
-			cropbox.setRotation(Eigen::Vector3f(roll,pitch,yaw));
-			pcl::IndicesPtr indices(new std::vector<int>());
-			cropbox.filter(*indices);
-
-			//if(indices->size())
-			//{
-			//	pcl::io::savePCDFile("radiusCrop.pcd", *cloud, *indices);
-			//	UWARN("Saved radiusCrop.pcd");
-			//}
-
-			if(indices->size())
-			{
-				pcl::search::KdTree<pcl::PointXYZ>::Ptr kdTree(new pcl::search::KdTree<pcl::PointXYZ>);
-				kdTree->setInputCloud(cloud, indices);
-				std::vector<int> ind;
-				std::vector<float> dist;
-				pcl::PointXYZ pt(fromT.x(), fromT.y(), fromT.z());
-				kdTree->radiusSearch(pt, radius, ind, dist, maxNearestNeighbors);
-				//pcl::PointCloud<pcl::PointXYZ> inliers;
-				for(unsigned int i=0; i<ind.size(); ++i)
-				{
-					if(ind[i] >=0)
-					{
-						Transform tmp = _optimizedPoses.find(ids[ind[i]])->second;
-						//inliers.push_back(pcl::PointXYZ(tmp.x(), tmp.y(), tmp.z()));
-						UDEBUG("Inlier %d: %s", ids[ind[i]], tmp.prettyPrint().c_str());
-						poses.insert(std::make_pair(ids[ind[i]], tmp));
-					}
-				}
-
-				//if(inliers.size())
-				//{
-				//	pcl::io::savePCDFile("radiusInliers.pcd", inliers);
-				//}
-				//if(nearestId >0)
-				//{
-				//	pcl::PointCloud<pcl::PointXYZ> c;
-				//	Transform ct = _optimizedPoses.find(nearestId)->second;
-				//	c.push_back(pcl::PointXYZ(ct.x(), ct.y(), ct.z()));
-				//	pcl::io::savePCDFile("radiusNearestPt.pcd", c);
-				//}
+			Transform local = fromTInv * iter->second;
+			if(local.x() >= -1.0f && local.x() <= radius &&
+			   local.y() >= -radius && local.y() <= radius)
+			{
+				UDEBUG("Inlier %d: %s", ids[i], iter->second.prettyPrint().c_str());
+				poses.insert(*iter);
 			}
 		}
 	}
@@ -2281,8 +2332,30 @@ void Rtabmap::optimizeCurrentMap(
 		std::map<int, Transform> & optimizedPoses,
 		std::multimap<int, Link> * constraints) const
 {
-	//Optimize the map
 	optimizedPoses.clear();
+	FlatGraph graph;
+	std::vector<Transform> poses = this->optimizeCurrentMap(id, lookInDatabase, graph);
+	if(constraints && _memory && id > 0)
+	{
+		*constraints = graph.linksMap();
+	}
+	for(unsigned int i=0; i<poses.size(); ++i)
+	{
+		if(!poses[i].isNull())
+		{
+			optimizedPoses.insert(optimizedPoses.end(), std::make_pair(graph.id(i), poses[i]));
+		}
+	}
+}
+
+std::vector<Transform> Rtabmap::optimizeCurrentMap(
+		int id,
+		bool lookInDatabase,
+		FlatGraph & graph) const
+{
+	//Optimize the map
+	std::vector<Transform> optimizedPoses;
+	graph.clear();
 	UDEBUG("Optimize map: around location %d", id);
 	if(_memory && id > 0)
 	{
@@ -2295,34 +2368,30 @@ void Rtabmap::optimizeCurrentMap(
 		}
 		UINFO("get ids time %f s", timer.ticks());
 
-		std::map<int, Transform> poses;
-		std::multimap<int, Link> edgeConstraints;
-		_memory->getMetricConstraints(uKeys(ids), poses, edgeConstraints, lookInDatabase);
-		UINFO("get constraints (%d poses, %d edges) time %f s", (int)poses.size(), (int)edgeConstraints.size(), timer.ticks());
-
-		if(constraints)
-		{
-			*constraints = edgeConstraints;
-		}
+		_memory->getMetricConstraints(uKeys(ids), graph, lookInDatabase);
+		UINFO("get constraints (%d poses, %d edges) time %f s", graph.size(), graph.linksSize(), timer.ticks());
 
 		UASSERT(_graphOptimizer!=0);
-		if(_graphOptimizer->iterations() == 0)
+		graph::Optimizer * optimizer = lookInDatabase && _globalGraphOptimizer?_globalGraphOptimizer:_graphOptimizer;
+		if(optimizer->iterations() == 0)
 		{
 			// Optimization desactivated! Return not optimized poses.
-			optimizedPoses = poses;
+			optimizedPoses = graph.poses();
 		}
 		else
 		{
-			optimizedPoses = _graphOptimizer->optimize(id, poses, edgeConstraints);
+			optimizedPoses = optimizer->optimize(id, graph);
 		}
 		UINFO("optimize time %f s", timer.ticks());
 
-		if(_memory->getSignature(id) && uContains(optimizedPoses, id))
+		int index = graph.index(id);
+		if(_memory->getSignature(id) && index >= 0 && optimizedPoses.size() && !optimizedPoses[index].isNull())
 		{
-			Transform t = optimizedPoses.at(id) * _memory->getSignature(id)->getPose().inverse();
+			Transform t = optimizedPoses[index] * _memory->getSignature(id)->getPose().inverse();
 			UINFO("Correction (from node %d) %s", id, t.prettyPrint().c_str());
 		}
 	}
+	return optimizedPoses;
 }
 
 void Rtabmap::adjustLikelihood(std::map<int, float> & likelihood) const
@@ -2442,70 +2511,207 @@ void Rtabmap::get3DMap(std::map<int, Signature> & signatures,
 	UDEBUG("");
 	if(_memory && _memory->getLastWorkingSignature())
 	{
-		if(_rgbdSlamMode)
+		this->getMapGraph(poses, constraints, optimized, global);
+		this->getNodesInfo(uKeysSet(poses), mapIds, stamps, labels, userDatas);
+		this->getMapData(signatures, global);
+	}
+	else if(_memory && (_memory->getStMem().size() || _memory->getWorkingMem().size() > 1))
+	{
+		UERROR("Last working signature is null!?");
+	}
+	else if(_memory == 0)
+	{
+		UWARN("Memory not initialized...");
+	}
+}
+
+int Rtabmap::get3DMapDelta(int revision,
+		std::map<int, Signature> & signatures,
+		std::map<int, Transform> & poses,
+		std::multimap<int, Link> & constraints,
+		std::map<int, int> & mapIds,
+		std::map<int, double> & stamps,
+		std::map<int, std::string> & labels,
+		std::map<int, std::vector<unsigned char> > & userDatas,
+		std::set<int> & linkedIds,
+		std::set<int> & removedIds,
+		bool & snapshot,
+		bool optimized,
+		bool global)
+{
+	UDEBUG("revision=%d", revision);
+	snapshot = true;
+	if(!_memory || !_memory->getLastWorkingSignature())
+	{
+		this->get3DMap(signatures, poses, constraints, mapIds, stamps, labels, userDatas, optimized, global);
+		return _memory?_memory->getRevision():0;
+	}
+
+	std::map<int, Transform> mapPoses;
+	std::multimap<int, Link> mapConstraints;
+	this->getMapGraph(mapPoses, mapConstraints, optimized, global);
+
+	// Update the poses of the last published map
+	MapDeltaCache & cache = _mapDeltaCaches[(optimized?2:0) + (global?1:0)];
+	if(cache.created < _memory->getRevisionReset())
+	{
+		cache = MapDeltaCache();
+		cache.created = _memory->newRevision();
+		cache.revision = cache.created;
+	}
+	// Moves are tagged with the current revision if the memory changed since the
+	// last update (no client can have it yet), otherwise with a new revision.
+	int moveRevision = _memory->getRevision() > cache.revision?_memory->getRevision():0;
+	std::list<int> moved;
+	for(std::map<int, Transform>::iterator iter=mapPoses.begin(); iter!=mapPoses.end(); ++iter)
+	{
+		std::map<int, std::pair<Transform, int> >::iterator jter = cache.poses.find(iter->first);
+		if(jter == cache.poses.end())
+		{
+			cache.poses.insert(std::make_pair(iter->first, std::make_pair(iter->second, 0)));
+			moved.push_back(iter->first);
+		}
+		else if(jter->second.first != iter->second)
+		{
+			jter->second.first = iter->second;
+			moved.push_back(iter->first);
+		}
+	}
+	std::list<int> left;
+	for(std::map<int, std::pair<Transform, int> >::iterator iter=cache.poses.begin(); iter!=cache.poses.end();)
+	{
+		if(mapPoses.find(iter->first) == mapPoses.end())
+		{
+			left.push_back(iter->first);
+			cache.added.erase(iter->first);
+			cache.poses.erase(iter++);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+	if((moved.size() || left.size()) && moveRevision == 0)
+	{
+		moveRevision = _memory->newRevision();
+	}
+	for(std::list<int>::iterator iter=moved.begin(); iter!=moved.end(); ++iter)
+	{
+		cache.poses.at(*iter).second = moveRevision;
+		if(cache.added.find(*iter) == cache.added.end())
+		{
+			cache.added.insert(std::make_pair(*iter, moveRevision));
+			cache.removed.erase(*iter);
+		}
+	}
+	for(std::list<int>::iterator iter=left.begin(); iter!=left.end(); ++iter)
+	{
+		cache.removed[*iter] = moveRevision;
+	}
+	if(cache.removed.size() > cache.poses.size())
+	{
+		// Forget the oldest half of the removed nodes: clients older
+		// than that get a snapshot, not bigger than the removed nodes
+		std::vector<int> revisions;
+		revisions.reserve(cache.removed.size());
+		for(std::map<int, int>::iterator iter=cache.removed.begin(); iter!=cache.removed.end(); ++iter)
 		{
-			if(optimized)
+			revisions.push_back(iter->second);
+		}
+		std::nth_element(revisions.begin(), revisions.begin()+revisions.size()/2, revisions.end());
+		cache.created = revisions[revisions.size()/2];
+		for(std::map<int, int>::iterator iter=cache.removed.begin(); iter!=cache.removed.end();)
+		{
+			if(iter->second < cache.created)
 			{
-				this->optimizeCurrentMap(_memory->getLastWorkingSignature()->id(), global, poses, &constraints);
+				cache.removed.erase(iter++);
 			}
 			else
 			{
-				std::map<int, int> ids = _memory->getNeighborsId(_memory->getLastWorkingSignature()->id(), 0, global?-1:0, true);
-				_memory->getMetricConstraints(uKeys(ids), poses, constraints, global);
+				++iter;
 			}
 		}
-		else
+	}
+	cache.revision = _memory->getRevision();
+
+	snapshot = revision <= 0 ||
+			revision < _memory->getRevisionReset() ||
+			revision < cache.created ||
+			revision > cache.revision;
+	if(snapshot)
+	{
+		UDEBUG("Snapshot (revision=%d, reset=%d, created=%d, current=%d)",
+				revision, _memory->getRevisionReset(), cache.created, cache.revision);
+		poses = mapPoses;
+		constraints = mapConstraints;
+		this->getNodesInfo(uKeysSet(poses), mapIds, stamps, labels, userDatas);
+		this->getMapData(signatures, global);
+		return cache.revision;
+	}
+
+	// Nodes added or modified after "revision"
+	std::set<int> dataChanged;
+	std::set<int> linksChanged;
+	_memory->getChangedNodes(revision, dataChanged, linksChanged);
+	std::set<int> newIds;
+	for(std::map<int, std::pair<Transform, int> >::iterator iter=cache.poses.begin(); iter!=cache.poses.end(); ++iter)
+	{
+		if(iter->second.second > revision)
 		{
-			// no optimization on appearance-only mode
-			std::map<int, int> ids = _memory->getNeighborsId(_memory->getLastWorkingSignature()->id(), 0, global?-1:0, true);
-			_memory->getMetricConstraints(uKeys(ids), poses, constraints, global);
+			poses.insert(std::make_pair(iter->first, iter->second.first));
 		}
-
-		for(std::map<int, Transform>::iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+		std::map<int, int>::iterator jter = cache.added.find(iter->first);
+		if(jter != cache.added.end() && jter->second > revision)
 		{
-			Transform odomPose;
-			int weight = -1;
-			int mapId = -1;
-			std::string label;
-			double stamp = 0;
-			std::vector<unsigned char> userData;
-			_memory->getNodeInfo(iter->first, odomPose, mapId, weight, label, stamp, userData, true);
-			mapIds.insert(std::make_pair(iter->first, mapId));
-			stamps.insert(std::make_pair(iter->first, stamp));
-			labels.insert(std::make_pair(iter->first, label));
-			userDatas.insert(std::make_pair(iter->first, userData));
+			newIds.insert(iter->first);
 		}
-
-
-		// Get data
-		std::set<int> ids = uKeysSet(_memory->getWorkingMem()); // WM
-
-		//remove virtual signature
-		ids.erase(Memory::kIdVirtual);
-
-		ids.insert(_memory->getStMem().begin(), _memory->getStMem().end()); // STM + WM
-		if(global)
+	}
+	std::set<int> dataIds = newIds;
+	linkedIds = newIds;
+	for(std::set<int>::iterator iter=dataChanged.begin(); iter!=dataChanged.end(); ++iter)
+	{
+		if(cache.poses.find(*iter) != cache.poses.end())
 		{
-			ids = _memory->getAllSignatureIds(); // STM + WM + LTM
+			dataIds.insert(*iter);
 		}
+	}
+	for(std::set<int>::iterator iter=linksChanged.begin(); iter!=linksChanged.end(); ++iter)
+	{
+		if(cache.poses.find(*iter) != cache.poses.end())
+		{
+			linkedIds.insert(*iter);
+		}
+	}
 
-		for(std::set<int>::iterator iter = ids.begin(); iter!=ids.end(); ++iter)
+	this->getNodesInfo(dataIds, mapIds, stamps, labels, userDatas);
+	for(std::set<int>::iterator iter = dataIds.begin(); iter!=dataIds.end(); ++iter)
+	{
+		Signature data = _memory->getSignatureData(*iter);
+		if(data.id() != Memory::kIdInvalid)
 		{
-			Signature data = _memory->getSignatureData(*iter);
-			if(data.id() != Memory::kIdInvalid)
-			{
-				signatures.insert(std::make_pair(*iter, Signature())).first->second = data;
-			}
+			signatures.insert(std::make_pair(*iter, Signature())).first->second = data;
 		}
 	}
-	else if(_memory && (_memory->getStMem().size() || _memory->getWorkingMem().size() > 1))
+	for(std::multimap<int, Link>::iterator iter=mapConstraints.begin(); iter!=mapConstraints.end(); ++iter)
 	{
-		UERROR("Last working signature is null!?");
+		if(linkedIds.find(iter->second.from()) != linkedIds.end() ||
+		   linkedIds.find(iter->second.to()) != linkedIds.end())
+		{
+			constraints.insert(*iter);
+		}
 	}
-	else if(_memory == 0)
+	for(std::map<int, int>::iterator iter=cache.removed.begin(); iter!=cache.removed.end(); ++iter)
 	{
-		UWARN("Memory not initialized...");
+		if(iter->second > revision)
+		{
+			removedIds.insert(iter->first);
+		}
 	}
+
+	UDEBUG("Delta %d->%d: signatures=%d poses=%d/%d links=%d linked=%d removed=%d",
+			revision, cache.revision, (int)signatures.size(), (int)poses.size(), (int)mapPoses.size(),
+			(int)constraints.size(), (int)linkedIds.size(), (int)removedIds.size());
+	return cache.revision;
 }
 
 void Rtabmap::getGraph(
@@ -2520,38 +2726,101 @@ void Rtabmap::getGraph(
 {
 	if(_memory && _memory->getLastWorkingSignature())
 	{
-		if(_rgbdSlamMode)
+		this->getMapGraph(poses, constraints, optimized, global);
+		this->getNodesInfo(uKeysSet(poses), mapIds, stamps, labels, userDatas);
+	}
+	else if(_memory && (_memory->getStMem().size() || _memory->getWorkingMem().size()))
+	{
+		UERROR("Last working signature is null!?");
+	}
+	else if(_memory == 0)
+	{
+		UWARN("Memory not initialized...");
+	}
+}
+
+void Rtabmap::getMapGraph(
+		std::map<int, Transform> & poses,
+		std::multimap<int, Link> & constraints,
+		bool optimized,
+		bool global) const
+{
+	UASSERT(_memory && _memory->getLastWorkingSignature());
+	if(_rgbdSlamMode && optimized)
+	{
+		this->optimizeCurrentMap(_memory->getLastWorkingSignature()->id(), global, poses, &constraints);
+	}
+	else
+	{
+		// no optimization on appearance-only mode
+		std::map<int, int> ids = _memory->getNeighborsId(_memory->getLastWorkingSignature()->id(), 0, global?-1:0, true);
+		_memory->getMetricConstraints(uKeys(ids), poses, constraints, global);
+	}
+}
+
+void Rtabmap::getMapData(std::map<int, Signature> & signatures, bool global) const
+{
+	std::set<int> ids = uKeysSet(_memory->getWorkingMem()); // WM
+
+	//remove virtual signature
+	ids.erase(Memory::kIdVirtual);
+
+	ids.insert(_memory->getStMem().begin(), _memory->getStMem().end()); // STM + WM
+	if(global)
+	{
+		ids = _memory->getAllSignatureIds(); // STM + WM + LTM
+	}
+
+	for(std::set<int>::iterator iter = ids.begin(); iter!=ids.end(); ++iter)
+	{
+		Signature data = _memory->getSignatureData(*iter);
+		if(data.id() != Memory::kIdInvalid)
 		{
-			if(optimized)
-			{
-				this->optimizeCurrentMap(_memory->getLastWorkingSignature()->id(), global, poses, &constraints);
-			}
-			else
-			{
-				std::map<int, int> ids = _memory->getNeighborsId(_memory->getLastWorkingSignature()->id(), 0, global?-1:0, true);
-				_memory->getMetricConstraints(uKeys(ids), poses, constraints, global);
-			}
+			signatures.insert(std::make_pair(*iter, Signature())).first->second = data;
+		}
+	}
+}
+
+void Rtabmap::getNodesInfo(
+		const std::set<int> & ids,
+		std::map<int, int> & mapIds,
+		std::map<int, double> & stamps,
+		std::map<int, std::string> & labels,
+		std::map<int, std::vector<unsigned char> > & userDatas) const
+{
+	for(std::set<int>::const_iterator iter=ids.begin(); iter!=ids.end(); ++iter)
+	{
+		Transform odomPose;
+		int weight = -1;
+		int mapId = -1;
+		std::string label;
+		double stamp = 0;
+		std::vector<unsigned char> userData;
+		_memory->getNodeInfo(*iter, odomPose, mapId, weight, label, stamp, userData, true);
+		mapIds.insert(std::make_pair(*iter, mapId));
+		stamps.insert(std::make_pair(*iter, stamp));
+		labels.insert(std::make_pair(*iter, label));
+		userDatas.insert(std::make_pair(*iter, userData));
+	}
+}
+
+void Rtabmap::getGraph(FlatGraph & graph, bool optimized, bool global) const
+{
+	graph.clear();
+	if(_memory && _memory->getLastWorkingSignature())
+	{
+		if(_rgbdSlamMode && optimized)
+		{
+			std::vector<Transform> poses = this->optimizeCurrentMap(_memory->getLastWorkingSignature()->id(), global, graph);
+			poses.resize(graph.size()); // all nodes are removed if the optimization failed
+			graph.setPoses(poses);
+			graph.removeNullPoses();
 		}
 		else
 		{
 			// no optimization on appearance-only mode
 			std::map<int, int> ids = _memory->getNeighborsId(_memory->getLastWorkingSignature()->id(), 0, global?-1:0, true);
-			_memory->getMetricConstraints(uKeys(ids), poses, constraints, global);
-		}
-
-		for(std::map<int, Transform>::iterator iter=poses.begin(); iter!=poses.end(); ++iter)
-		{
-			Transform odomPose;
-			int weight = -1;
-			int mapId = -1;
-			std::string label;
-			double stamp = 0;
-			std::vector<unsigned char> userData;
-			_memory->getNodeInfo(iter->first, odomPose, mapId, weight, label, stamp, userData, true);
-			mapIds.insert(std::make_pair(iter->first, mapId));
-			stamps.insert(std::make_pair(iter->first, stamp));
-			labels.insert(std::make_pair(iter->first, label));
-			userDatas.insert(std::make_pair(iter->first, userData));
+			_memory->getMetricConstraints(uKeys(ids), graph, global);
 		}
 	}
 	else if(_memory && (_memory->getStMem().size() || _memory->getWorkingMem().size()))
@@ -2578,8 +2847,7 @@ void Rtabmap::clearPath()
 
 bool Rtabmap::computePath(
 		int targetNode,
-		const std::map<int, Transform> & nodes,
-		const std::multimap<int, rtabmap::Link> & constraints)
+		const FlatGraph & graph)
 {
 	if(_memory)
 	{
@@ -2590,44 +2858,57 @@ bool Rtabmap::computePath(
 		}
 		int currentNode = _memory->getLastWorkingSignature()->id();
 
-		if(!uContains(nodes, currentNode))
+		if(!graph.contains(currentNode))
 		{
 			UWARN("Last signature %d not found in the graph! Cannot compute a path", currentNode);
 			return false;
 		}
 
-		if(!uContains(nodes, targetNode))
+		if(!graph.contains(targetNode))
 		{
 			UWARN("Goal %d not found in the graph! Cannot compute a path", targetNode);
 			return false;
 		}
 
-		std::multimap<int, int> links;
-		for(std::multimap<int, rtabmap::Link>::const_iterator iter=constraints.begin(); iter!=constraints.end(); ++iter)
+		FlatGraph links;
+		links.reserve(graph.size(), graph.linksSize()*2);
+		for(int i=0; i<graph.size(); ++i)
+		{
+			links.addNode(graph.id(i), graph.pose(i));
+		}
+		for(int k=0; k<graph.linksSize(); ++k)
 		{
-			links.insert(std::make_pair(iter->first, iter->second.to()));
-			links.insert(std::make_pair(iter->second.to(), iter->first)); // <->
+			Link link = graph.link(k);
+			links.addLink(link);
+			link.setFrom(graph.link(k).to());
+			link.setTo(graph.link(k).from());
+			links.addLink(link); // <->
 		}
+		links.finalize();
 		// Add links between neighbor nodes in the goal radius.
 		if(_planVirtualLinks)
 		{
-			std::multimap<int, int> clusters = rtabmap::graph::radiusPosesClustering(nodes, _goalReachedRadius, CV_PI);
+			std::multimap<int, int> clusters = rtabmap::graph::radiusPosesClustering(graph.posesMap(), _goalReachedRadius, CV_PI);
+			Link link;
 			for(std::multimap<int, int>::iterator iter=clusters.begin(); iter!=clusters.end(); ++iter)
 			{
-				if(graph::findLink(links, iter->first, iter->second) != links.end())
+				if(links.findLink(iter->first, iter->second) >= 0)
 				{
 					if(_planVirtualLinksMaxDiffID <= 0 ||
 					   abs(iter->first - iter->second) < _planVirtualLinksMaxDiffID)
 					{
-						links.insert(*iter);
+						link.setFrom(iter->first);
+						link.setTo(iter->second);
+						links.addLink(link);
 					}
 				}
 			}
+			links.finalize();
 		}
 
 		UINFO("Computing path from location %d to %d", currentNode, targetNode);
 		UTimer timer;
-		_path = uListToVector(rtabmap::graph::computePath(nodes, links, currentNode, targetNode));
+		_path = uListToVector(rtabmap::graph::computePath(links, currentNode, targetNode));
 		UINFO("A* time = %fs", timer.ticks());
 
 		if(_path.size() == 0)
@@ -2676,16 +2957,11 @@ bool Rtabmap::computePath(int targetNode, bool global)
 	}
 
 	UTimer timer;
-	std::map<int, Transform> nodes;
-	std::multimap<int, Link> constraints;
-	std::map<int, int> mapIds;
-	std::map<int, double> stamps;
-	std::map<int, std::string> labels;
-	std::map<int, std::vector<unsigned char> > userDatas;
-	this->getGraph(nodes, constraints, mapIds, stamps, labels, userDatas, true, global);
+	FlatGraph graph;
+	this->getGraph(graph, true, global);
 	UINFO("Time creating graph (global=%s) = %fs", global?"true":"false", timer.ticks());
 
-	if(computePath(targetNode, nodes, constraints))
+	if(computePath(targetNode, graph))
 	{
 		updateGoalIndex();
 	}
@@ -2707,31 +2983,27 @@ bool Rtabmap::computePath(const Transform & targetPose, bool global)
 
 	//Find the nearest node
 	UTimer timer;
-	std::map<int, Transform> nodes;
-	std::multimap<int, Link> constraints;
-	std::map<int, int> mapIds;
-	std::map<int, double> stamps;
-	std::map<int, std::string> labels;
-	std::map<int, std::vector<unsigned char> > userDatas;
-	this->getGraph(nodes, constraints, mapIds, stamps, labels, userDatas, true, global);
+	FlatGraph graph;
+	this->getGraph(graph, true, global);
 	UINFO("Time creating graph (global=%s) = %fs", global?"true":"false", timer.ticks());
 
-	int nearestId = rtabmap::graph::findNearestNode(nodes, targetPose);
+	int nearestId = rtabmap::graph::findNearestNode(graph.posesMap(), targetPose);
 	UINFO("Nearest node found=%d ,%fs", nearestId, timer.ticks());
 	if(nearestId > 0)
 	{
-		if(_localRadius != 0.0f && targetPose.getDistance(nodes.at(nearestId)) > _localRadius)
+		const Transform & nearestPose = graph.pose(graph.index(nearestId));
+		if(_localRadius != 0.0f && targetPose.getDistance(nearestPose) > _localRadius)
 		{
 			UWARN("Cannot plan farther than %f m from the graph! (distance=%f m from node %d)",
-					_localRadius, targetPose.getDistance(nodes.at(nearestId)), nearestId);
+					_localRadius, targetPose.getDistance(nearestPose), nearestId);
 		}
 		else
 		{
-			if(computePath(nearestId, nodes, constraints))
+			if(computePath(nearestId, graph))
 			{
 				UASSERT(_path.size() > 0);
-				UASSERT(uContains(nodes, _path.back().first));
-				_pathTransformToGoal = nodes.at(_path.back().first).inverse() * targetPose;
+				UASSERT(graph.contains(_path.back().first));
+				_pathTransformToGoal = graph.pose(graph.index(_path.back().first)).inverse() * targetPose;
 
 				updateGoalIndex();
 			}
@@ -2740,7 +3012,7 @@ bool Rtabmap::computePath(const Transform & targetPose, bool global)
 	}
 	else
 	{
-		UWARN("Nearest node not found in graph (size=%d) for pose %s", (int)nodes.size(), targetPose.prettyPrint().c_str());
+		UWARN("Nearest node not found in graph (size=%d) for pose %s", graph.size(), targetPose.prettyPrint().c_str());
 	}
 
 	return _path.size()>0;
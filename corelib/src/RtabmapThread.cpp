@@ -43,8 +43,26 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace rtabmap {
 
+// Extract the features of the next data while the previous one is processed
+class FeatureExtractionStage : public UThread
+{
+public:
+	FeatureExtractionStage(RtabmapThread * rtabmapThread) : _rtabmapThread(rtabmapThread) {}
+	virtual ~FeatureExtractionStage() {this->join(true);}
+private:
+	virtual void mainLoop() {_rtabmapThread->extractData(this);}
+	virtual void mainLoopKill()
+	{
+		_rtabmapThread->_inputAdded.release();
+		_rtabmapThread->_readyTaken.release();
+	}
+	RtabmapThread * _rtabmapThread;
+};
+
 RtabmapThread::RtabmapThread(Rtabmap * rtabmap) :
 		_dataBufferMaxSize(Parameters::defaultRtabmapImageBufferSize()),
+		_pipelineDepth(Parameters::defaultRtabmapPipelineDepth()),
+		_extractionStage(0),
 		_rate(Parameters::defaultRtabmapDetectionRate()),
 		_frameRateTimer(new UTimer()),
 		_rtabmap(rtabmap),
@@ -63,6 +81,7 @@ RtabmapThread::~RtabmapThread()
 
 	// Stop the thread first
 	join(true);
+	stopExtractionStage();
 
 	delete _frameRateTimer;
 	delete _rtabmap;
@@ -84,15 +103,25 @@ void RtabmapThread::pushNewState(State newState, const ParametersMap & parameter
 
 void RtabmapThread::clearBufferedData()
 {
+	bool staged = false;
 	_dataMutex.lock();
 	{
 		_dataBuffer.clear();
+		_readyBuffer.clear();
+		staged = _extractionStage != 0;
 		lastPose_.setIdentity();
 		_rotVariance = 0;
 		_transVariance = 0;
 	}
 	_dataMutex.unlock();
 
+	if(staged)
+	{
+		// wake up the extraction stage if it is waiting for a free place, it re-checks the buffers
+		_readyTaken.release();
+		_inputAdded.release();
+	}
+
 	_userDataMutex.lock();
 	{
 		_userData = cv::Mat();
@@ -112,6 +141,12 @@ void RtabmapThread::setBufferSize(int bufferSize)
 	_dataBufferMaxSize = bufferSize;
 }
 
+void RtabmapThread::setPipelineDepth(int depth)
+{
+	UASSERT(depth >= 0);
+	_pipelineDepth = depth; // the extraction stage is started/stopped on next process()
+}
+
 void RtabmapThread::publishMap(bool optimized, bool full) const
 {
 	std::map<int, Signature> signatures;
@@ -141,6 +176,46 @@ void RtabmapThread::publishMap(bool optimized, bool full) const
 			userDatas));
 }
 
+void RtabmapThread::publishMapDelta(bool optimized, bool full, int revision) const
+{
+	std::map<int, Signature> signatures;
+	std::map<int, Transform> poses;
+	std::multimap<int, Link> constraints;
+	std::map<int, int> mapIds;
+	std::map<int, double> stamps;
+	std::map<int, std::string> labels;
+	std::map<int, std::vector<unsigned char> > userDatas;
+	std::set<int> linkedIds;
+	std::set<int> removedIds;
+	bool snapshot = true;
+
+	int newRevision = _rtabmap->get3DMapDelta(revision,
+			signatures,
+			poses,
+			constraints,
+			mapIds,
+			stamps,
+			labels,
+			userDatas,
+			linkedIds,
+			removedIds,
+			snapshot,
+			optimized,
+			full);
+
+	this->post(new RtabmapEvent3DMap(signatures,
+			poses,
+			constraints,
+			mapIds,
+			stamps,
+			labels,
+			userDatas,
+			newRevision,
+			snapshot?0:revision,
+			linkedIds,
+			removedIds));
+}
+
 void RtabmapThread::publishTOROGraph(bool optimized, bool full) const
 {
 	std::map<int, Signature> signatures;
@@ -206,28 +281,50 @@ void RtabmapThread::mainLoop()
 		UASSERT(!parameters.at("RtabmapThread/DatabasePath").empty());
 		Parameters::parse(parameters, Parameters::kRtabmapImageBufferSize(), _dataBufferMaxSize);
 		Parameters::parse(parameters, Parameters::kRtabmapDetectionRate(), _rate);
+		Parameters::parse(parameters, Parameters::kRtabmapPipelineDepth(), _pipelineDepth);
 		UASSERT(_dataBufferMaxSize >= 0);
 		UASSERT(_rate >= 0.0f);
-		_rtabmap->init(parameters, parameters.at("RtabmapThread/DatabasePath"));
+		UASSERT(_pipelineDepth >= 0);
+		_extractionMutex.lock();
+		{
+			_rtabmap->init(parameters, parameters.at("RtabmapThread/DatabasePath"));
+			this->resetExtractedData();
+		}
+		_extractionMutex.unlock();
 		break;
 	case kStateChangingParameters:
 		Parameters::parse(parameters, Parameters::kRtabmapImageBufferSize(), _dataBufferMaxSize);
 		Parameters::parse(parameters, Parameters::kRtabmapDetectionRate(), _rate);
+		Parameters::parse(parameters, Parameters::kRtabmapPipelineDepth(), _pipelineDepth);
 		UASSERT(_dataBufferMaxSize >= 0);
 		UASSERT(_rate >= 0.0f);
-		_rtabmap->parseParameters(parameters);
+		UASSERT(_pipelineDepth >= 0);
+		_extractionMutex.lock();
+		{
+			_rtabmap->parseParameters(parameters);
+			this->resetExtractedData();
+		}
+		_extractionMutex.unlock();
 		break;
 	case kStateReseting:
-		_rtabmap->resetMemory();
-		this->clearBufferedData();
+		_extractionMutex.lock();
+		{
+			_rtabmap->resetMemory();
+			this->clearBufferedData();
+		}
+		_extractionMutex.unlock();
 		break;
 	case kStateClose:
-		if(_dataBuffer.size())
+		_extractionMutex.lock();
 		{
-			UWARN("Closing... %d data still buffered! They will be cleared.", (int)_dataBuffer.size());
-			this->clearBufferedData();
+			if(_dataBuffer.size() || _readyBuffer.size())
+			{
+				UWARN("Closing... %d data still buffered! They will be cleared.", (int)(_dataBuffer.size() + _readyBuffer.size()));
+				this->clearBufferedData();
+			}
+			_rtabmap->close();
 		}
-		_rtabmap->close();
+		_extractionMutex.unlock();
 		break;
 	case kStateDumpingMemory:
 		_rtabmap->dumpData();
@@ -262,6 +359,11 @@ void RtabmapThread::mainLoop()
 	case kStatePublishingTOROGraphGlobal:
 		this->publishTOROGraph(atoi(parameters.at("optimized").c_str())!=0, true);
 		break;
+	case kStatePublishingMapDelta:
+		this->publishMapDelta(atoi(parameters.at("optimized").c_str())!=0,
+				atoi(parameters.at("global").c_str())!=0,
+				atoi(parameters.at("revision").c_str()));
+		break;
 	case kStateTriggeringMap:
 		_rtabmap->triggerNewMap();
 		break;
@@ -452,6 +554,15 @@ void RtabmapThread::handleEvent(UEvent* event)
 			param.insert(ParametersPair("optimized", uNumber2Str(rtabmapEvent->getInt())));
 			pushNewState(kStatePublishingTOROGraphGlobal, param);
 		}
+		else if(cmd == RtabmapEventCmd::kCmdPublish3DMapDelta)
+		{
+			ULOGGER_DEBUG("CMD_PUBLISH_MAP_DELTA");
+			ParametersMap param;
+			param.insert(ParametersPair("revision", uNumber2Str(rtabmapEvent->getInt())));
+			param.insert(ParametersPair("optimized", uValue(rtabmapEvent->getParameters(), std::string("optimized"), std::string("0"))));
+			param.insert(ParametersPair("global", uValue(rtabmapEvent->getParameters(), std::string("global"), std::string("0"))));
+			pushNewState(kStatePublishingMapDelta, param);
+		}
 		else if(cmd == RtabmapEventCmd::kCmdTriggerNewMap)
 		{
 			ULOGGER_DEBUG("CMD_TRIGGER_NEW_MAP");
@@ -487,16 +598,61 @@ void RtabmapThread::handleEvent(UEvent* event)
 //============================================================
 void RtabmapThread::process()
 {
-	SensorData data;
-	getData(data);
-	if(data.isValid() && _state.empty())
+	if(_pipelineDepth > 0 && _extractionStage == 0)
+	{
+		this->startExtractionStage();
+	}
+	else if(_pipelineDepth == 0 && _extractionStage != 0)
+	{
+		this->stopExtractionStage();
+	}
+
+	StagedData staged;
+	getData(staged);
+	if(staged.data.isValid() && _state.empty())
 	{
 		if(_rtabmap->getMemory())
 		{
-			if(_rtabmap->process(data))
+			UTimer timer;
+			// Features not extracted by the stage (cleared by resetExtractedData() or
+			// stage not running) are extracted by the memory: the detectors are not
+			// all thread-safe, so don't share them with the stage extracting the next data.
+			bool extractionLocked = !staged.data.featuresExtracted();
+			if(extractionLocked)
+			{
+				_extractionMutex.lock();
+			}
+			bool added = _rtabmap->process(staged.data);
+			if(extractionLocked)
+			{
+				_extractionMutex.unlock();
+			}
+			if(added)
 			{
 				Statistics stats = _rtabmap->getStatistics();
-				stats.addStatistic(Statistics::kMemoryImages_buffered(), (float)_dataBuffer.size());
+				stats.addStatistic(Statistics::kPipelineMap_update(), timer.ticks()*1000.0f);
+				_dataMutex.lock();
+				{
+					stats.addStatistic(Statistics::kMemoryImages_buffered(), (float)_dataBuffer.size());
+					stats.addStatistic(Statistics::kPipelineInput_buffered(), (float)_dataBuffer.size());
+					stats.addStatistic(Statistics::kPipelineReady_buffered(), (float)_readyBuffer.size());
+				}
+				_dataMutex.unlock();
+				if(staged.readyStamp > 0.0)
+				{
+					// went through the extraction stage
+					for(std::map<std::string, float>::const_iterator iter=staged.stats.data().begin(); iter!=staged.stats.data().end(); ++iter)
+					{
+						stats.addStatistic(iter->first, iter->second);
+					}
+					stats.addStatistic(Statistics::kPipelineInput_latency(), float(staged.readyStamp - staged.addedStamp)*1000.0f - staged.extractionTime);
+					stats.addStatistic(Statistics::kPipelineExtraction(), staged.extractionTime);
+					stats.addStatistic(Statistics::kPipelineReady_latency(), float(staged.takenStamp - staged.readyStamp)*1000.0f);
+				}
+				else
+				{
+					stats.addStatistic(Statistics::kPipelineInput_latency(), float(staged.takenStamp - staged.addedStamp)*1000.0f);
+				}
 				ULOGGER_DEBUG("posting statistics_ event...");
 				this->post(new RtabmapEvent(stats));
 			}
@@ -546,9 +702,13 @@ void RtabmapThread::addData(const SensorData & sensorData)
 		_frameRateTimer->start();
 
 		bool notify = true;
+		bool pipelined = false;
 		_dataMutex.lock();
 		{
-			_dataBuffer.push_back(sensorData);
+			_dataBuffer.push_back(StagedData());
+			_dataBuffer.back().data = sensorData;
+			_dataBuffer.back().addedStamp = UTimer::now();
+			pipelined = _extractionStage != 0;
 			if(_rotVariance <= 0)
 			{
 				_rotVariance = 1.0f;
@@ -557,7 +717,7 @@ void RtabmapThread::addData(const SensorData & sensorData)
 			{
 				_transVariance = 1.0f;
 			}
-			_dataBuffer.back().setPose(_dataBuffer.back().pose(), _rotVariance, _transVariance);
+			_dataBuffer.back().data.setPose(_dataBuffer.back().data.pose(), _rotVariance, _transVariance);
 			_rotVariance = 0;
 			_transVariance = 0;
 			while(_dataBufferMaxSize > 0 && _dataBuffer.size() > (unsigned int)_dataBufferMaxSize)
@@ -571,12 +731,19 @@ void RtabmapThread::addData(const SensorData & sensorData)
 
 		if(notify)
 		{
-			_dataAdded.release();
+			if(pipelined)
+			{
+				_inputAdded.release();
+			}
+			else
+			{
+				_dataAdded.release();
+			}
 		}
 	}
 }
 
-void RtabmapThread::getData(SensorData & image)
+void RtabmapThread::getData(StagedData & data)
 {
 	ULOGGER_DEBUG("");
 
@@ -584,15 +751,152 @@ void RtabmapThread::getData(SensorData & image)
 	_dataAdded.acquire();
 	ULOGGER_INFO("wake-up");
 
+	bool taken = false;
+	_dataMutex.lock();
+	{
+		// Data already in the ready buffer are older than the input buffer
+		if(!_readyBuffer.empty())
+		{
+			data = _readyBuffer.front();
+			_readyBuffer.pop_front();
+			taken = true;
+		}
+		else if(_extractionStage == 0 && !_dataBuffer.empty())
+		{
+			data = _dataBuffer.front();
+			_dataBuffer.pop_front();
+		}
+		data.takenStamp = UTimer::now();
+	}
+	_dataMutex.unlock();
+
+	if(taken)
+	{
+		_readyTaken.release();
+	}
+}
+
+void RtabmapThread::extractData(const FeatureExtractionStage * stage)
+{
+	StagedData staged;
 	_dataMutex.lock();
 	{
-		if(!_dataBuffer.empty())
+		// wait for a free place in the ready buffer, then for data
+		while(!stage->isKilled() && (_readyBuffer.size() >= (unsigned int)_pipelineDepth || _dataBuffer.empty()))
+		{
+			bool full = _readyBuffer.size() >= (unsigned int)_pipelineDepth;
+			_dataMutex.unlock();
+			if(full)
+			{
+				_readyTaken.acquire();
+			}
+			else
+			{
+				_inputAdded.acquire();
+			}
+			_dataMutex.lock();
+		}
+		if(!stage->isKilled())
 		{
-			image = _dataBuffer.front();
+			staged = _dataBuffer.front();
 			_dataBuffer.pop_front();
 		}
 	}
 	_dataMutex.unlock();
+
+	if(!staged.data.isValid())
+	{
+		return;
+	}
+
+	UTimer timer;
+	_extractionMutex.lock();
+	{
+		// Quantization of the descriptors depends on the dictionary, it stays in the map update
+		if(_rtabmap->getMemory() && !staged.data.featuresExtracted())
+		{
+			_rtabmap->getMemory()->extractFeatures(staged.data, &staged.stats);
+			staged.extracted = true;
+		}
+		staged.extractionTime = timer.ticks()*1000.0f;
+
+		// added while the memory cannot change, see resetExtractedData()
+		_dataMutex.lock();
+		{
+			staged.readyStamp = UTimer::now();
+			_readyBuffer.push_back(staged);
+		}
+		_dataMutex.unlock();
+	}
+	_extractionMutex.unlock();
+
+	_dataAdded.release();
+}
+
+void RtabmapThread::startExtractionStage()
+{
+	UASSERT(_extractionStage == 0);
+	UDEBUG("Starting the extraction stage (depth=%d)", _pipelineDepth);
+	FeatureExtractionStage * stage = new FeatureExtractionStage(this);
+	int buffered = 0;
+	_dataMutex.lock();
+	{
+		_extractionStage = stage;
+		buffered = (int)_dataBuffer.size();
+	}
+	_dataMutex.unlock();
+	for(int i=0; i<buffered; ++i)
+	{
+		_inputAdded.release();
+	}
+	stage->start();
+}
+
+void RtabmapThread::stopExtractionStage()
+{
+	FeatureExtractionStage * stage = 0;
+	_dataMutex.lock();
+	{
+		stage = _extractionStage;
+		_extractionStage = 0;
+	}
+	_dataMutex.unlock();
+
+	if(stage)
+	{
+		UDEBUG("Stopping the extraction stage");
+		delete stage; // the data being extracted is added to the ready buffer
+
+		// data in the input buffer will be taken directly by the map update
+		int buffered = 0;
+		_dataMutex.lock();
+		{
+			buffered = (int)_dataBuffer.size();
+		}
+		_dataMutex.unlock();
+		for(int i=0; i<buffered; ++i)
+		{
+			_dataAdded.release();
+		}
+	}
+}
+
+void RtabmapThread::resetExtractedData()
+{
+	// Features extracted with previous parameters would not match the dictionary
+	_dataMutex.lock();
+	{
+		for(std::list<StagedData>::iterator iter=_readyBuffer.begin(); iter!=_readyBuffer.end(); ++iter)
+		{
+			if(iter->extracted)
+			{
+				iter->data.clearFeatures();
+				iter->extracted = false;
+				iter->stats = Statistics();
+			}
+		}
+	}
+	_dataMutex.unlock();
 }
 
 void RtabmapThread::setDataBufferSize(int size)
@@ -45,7 +45,8 @@ SensorData::SensorData() :
 	_cy(0.0f),
 	_localTransform(Transform::getIdentity()),
 	_poseRotVariance(1.0f),
-	_poseTransVariance(1.0f)
+	_poseTransVariance(1.0f),
+	_metadata(0)
 {
 }
 
@@ -63,8 +64,12 @@ SensorData::SensorData(const cv::Mat & image,
 	_localTransform(Transform::getIdentity()),
 	_poseRotVariance(1.0f),
 	_poseTransVariance(1.0f),
-	_userData(userData)
+	_metadata(0)
 {
+	if(userData.size())
+	{
+		this->metadata()->userData = userData;
+	}
 	UASSERT(image.type() == CV_8UC1 || // Mono
 			image.type() == CV_8UC3);  // RGB
 }
@@ -95,8 +100,12 @@ SensorData::SensorData(const cv::Mat & image,
 	_localTransform(localTransform),
 	_poseRotVariance(poseRotVariance),
 	_poseTransVariance(poseTransVariance),
-	_userData(userData)
+	_metadata(0)
 {
+	if(userData.size())
+	{
+		this->metadata()->userData = userData;
+	}
 	UASSERT(image.type() == CV_8UC1 || // Mono
 			image.type() == CV_8UC3);  // RGB
 	UASSERT(depthOrRightImage.empty() ||
@@ -135,8 +144,12 @@ SensorData::SensorData(const cv::Mat & laserScan,
 	_localTransform(localTransform),
 	_poseRotVariance(poseRotVariance),
 	_poseTransVariance(poseTransVariance),
-	_userData(userData)
+	_metadata(0)
 {
+	if(userData.size())
+	{
+		this->metadata()->userData = userData;
+	}
 	UASSERT(_laserScan.empty() || _laserScan.type() == CV_32FC2);
 	UASSERT(image.type() == CV_8UC1 || // Mono
 			image.type() == CV_8UC3);  // RGB
@@ -148,10 +161,150 @@ SensorData::SensorData(const cv::Mat & laserScan,
 	UASSERT_MSG(uIsFinite(_poseRotVariance) && _poseRotVariance>0 && uIsFinite(_poseTransVariance) && _poseTransVariance>0, "Rotational and transitional variances should not be null! (set to 1 if unknown)");
 }
 
+SensorData::SensorData(const SensorData & data) :
+	_image(data._image),
+	_id(data._id),
+	_stamp(data._stamp),
+	_depthOrRightImage(data._depthOrRightImage),
+	_laserScan(data._laserScan),
+	_fx(data._fx),
+	_fyOrBaseline(data._fyOrBaseline),
+	_cx(data._cx),
+	_cy(data._cy),
+	_pose(data._pose),
+	_localTransform(data._localTransform),
+	_poseRotVariance(data._poseRotVariance),
+	_poseTransVariance(data._poseTransVariance),
+	_descriptors(data._descriptors),
+	_metadata(data._metadata)
+{
+	if(_metadata)
+	{
+		CV_XADD(&_metadata->refs, 1);
+	}
+}
+
+SensorData & SensorData::operator=(const SensorData & data)
+{
+	Metadata * metadata = data._metadata;
+	if(metadata)
+	{
+		CV_XADD(&metadata->refs, 1);
+	}
+	this->releaseMetadata();
+	_metadata = metadata;
+
+	_image = data._image;
+	_id = data._id;
+	_stamp = data._stamp;
+	_depthOrRightImage = data._depthOrRightImage;
+	_laserScan = data._laserScan;
+	_fx = data._fx;
+	_fyOrBaseline = data._fyOrBaseline;
+	_cx = data._cx;
+	_cy = data._cy;
+	_pose = data._pose;
+	_localTransform = data._localTransform;
+	_poseRotVariance = data._poseRotVariance;
+	_poseTransVariance = data._poseTransVariance;
+	_descriptors = data._descriptors;
+	return *this;
+}
+
+SensorData::~SensorData()
+{
+	this->releaseMetadata();
+}
+
 bool SensorData::empty() const
 {
 	return _image.empty();
 }
 
+// returned when there is no metadata
+static const std::vector<cv::KeyPoint> kNoKeypoints;
+static const std::vector<unsigned char> kNoUserData;
+
+void SensorData::setFeatures(const std::vector<cv::KeyPoint> & keypoints, const cv::Mat & descriptors)
+{
+	Metadata * metadata = this->metadata();
+	metadata->keypoints = keypoints;
+	metadata->featuresExtracted = true;
+	_descriptors = descriptors;
+}
+
+void SensorData::clearFeatures()
+{
+	if(_metadata && (_metadata->featuresExtracted || _metadata->keypoints.size()))
+	{
+		Metadata * metadata = this->metadata();
+		metadata->keypoints.clear();
+		metadata->featuresExtracted = false;
+	}
+	_descriptors = cv::Mat();
+}
+
+bool SensorData::featuresExtracted() const
+{
+	return _metadata && (_metadata->featuresExtracted || _metadata->keypoints.size());
+}
+
+const std::vector<cv::KeyPoint> & SensorData::keypoints() const
+{
+	return _metadata?_metadata->keypoints:kNoKeypoints;
+}
+
+void SensorData::setUserData(const std::vector<unsigned char> & data)
+{
+	if(data.size() || (_metadata && _metadata->userData.size()))
+	{
+		this->metadata()->userData = data;
+	}
+}
+
+const std::vector<unsigned char> & SensorData::userData() const
+{
+	return _metadata?_metadata->userData:kNoUserData;
+}
+
+void SensorData::setCameraID(std::string cameraID)
+{
+	if(cameraID.size() || (_metadata && _metadata->cameraID.size()))
+	{
+		this->metadata()->cameraID = cameraID;
+	}
+}
+
+std::string SensorData::getCameraID() const
+{
+	return _metadata?_metadata->cameraID:std::string();
+}
+
+SensorData::Metadata * SensorData::metadata()
+{
+	if(_metadata == 0)
+	{
+		_metadata = new Metadata();
+	}
+	else if(_metadata->refs > 1)
+	{
+		// shared, copy it
+		Metadata * metadata = new Metadata(*_metadata);
+		metadata->refs = 1;
+		this->releaseMetadata();
+		_metadata = metadata;
+	}
+	return _metadata;
+}
+
+void SensorData::releaseMetadata()
+{
+	if(_metadata && CV_XADD(&_metadata->refs, -1) == 1)
+	{
+		delete _metadata;
+	}
+	_metadata = 0;
+}
+
 } // namespace rtabmap
 
@@ -28,7 +28,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/Signature.h"
 #include "rtabmap/core/EpipolarGeometry.h"
 #include "rtabmap/core/Memory.h"
-#include "rtabmap/core/Compression.h"
+#include "rtabmap/core/DecompressionService.h"
 #include <opencv2/highgui/highgui.hpp>
 
 #include <rtabmap/utilite/UtiLite.h>
@@ -58,8 +58,8 @@ Signature::Signature(
 		int weight,
 		double stamp,
 		const std::string & label,
-		const std::multimap<int, cv::KeyPoint> & words,
-		const std::multimap<int, pcl::PointXYZ> & words3, // in base_link frame (localTransform applied)
+		const FlatWords<cv::KeyPoint> & words,
+		const FlatWords<pcl::PointXYZ> & words3, // in base_link frame (localTransform applied)
 		const Transform & pose,
 		const std::vector<unsigned char> & userData,
 		const cv::Mat & laserScanCompressed, // in base_link frame
@@ -187,36 +187,43 @@ void Signature::removeVirtualLinks()
 float Signature::compareTo(const Signature & s) const
 {
 	float similarity = 0.0f;
-	const std::multimap<int, cv::KeyPoint> & words = s.getWords();
+	const FlatWords<cv::KeyPoint> & words = s.getWords();
 	if(words.size() != 0 && _words.size() != 0)
 	{
-		std::list<std::pair<int, std::pair<cv::KeyPoint, cv::KeyPoint> > > pairs;
+		// same count than EpipolarGeometry::findPairs()
 		unsigned int totalWords = _words.size()>words.size()?_words.size():words.size();
-		EpipolarGeometry::findPairs(words, _words, pairs);
-
-		similarity = float(pairs.size()) / float(totalWords);
+		similarity = float(words.pairs(_words)) / float(totalWords);
 	}
 	return similarity;
 }
 
 void Signature::changeWordsRef(int oldWordId, int activeWordId)
 {
-	std::list<cv::KeyPoint> kps = uValues(_words, oldWordId);
-	if(kps.size())
+	std::map<int, int> refsToChange;
+	refsToChange.insert(std::make_pair(oldWordId, activeWordId));
+	this->changeWordsRef(refsToChange);
+}
+
+void Signature::changeWordsRef(const std::map<int, int> & refsToChange)
+{
+	// words found in the signature
+	std::vector<int> ids = _words.uniqueIds();
+	std::map<int, int>::const_iterator jter = refsToChange.begin();
+	for(unsigned int i=0; i<ids.size() && jter!=refsToChange.end(); ++i)
 	{
-		std::list<pcl::PointXYZ> pts = uValues(_words3, oldWordId);
-		_words.erase(oldWordId);
-		_words3.erase(oldWordId);
-		_wordsChanged.insert(std::make_pair(oldWordId, activeWordId));
-		for(std::list<cv::KeyPoint>::const_iterator iter=kps.begin(); iter!=kps.end(); ++iter)
+		while(jter!=refsToChange.end() && jter->first < ids[i])
 		{
-			_words.insert(std::pair<int, cv::KeyPoint>(activeWordId, (*iter)));
+			++jter;
 		}
-		for(std::list<pcl::PointXYZ>::const_iterator iter=pts.begin(); iter!=pts.end(); ++iter)
+		if(jter!=refsToChange.end() && jter->first == ids[i])
 		{
-			_words3.insert(std::pair<int, pcl::PointXYZ>(activeWordId, (*iter)));
+			_wordsChanged.insert(*jter);
 		}
 	}
+	if(_words.changeIds(refsToChange))
+	{
+		_words3.changeIds(refsToChange);
+	}
 }
 
 bool Signature::isBadSignature() const
@@ -328,35 +335,23 @@ void Signature::uncompressDataConst(cv::Mat * imageRaw, cv::Mat * depthRaw, cv::
 		(depthRaw && depthRaw->empty()) ||
 		(laserScanRaw && laserScanRaw->empty()))
 	{
-		rtabmap::CompressionThread ctImage(_imageCompressed, true);
-		rtabmap::CompressionThread ctDepth(_depthCompressed, true);
-		rtabmap::CompressionThread ctLaserScan(_laserScanCompressed, false);
-		if(imageRaw && imageRaw->empty())
-		{
-			ctImage.start();
-		}
-		if(depthRaw && depthRaw->empty())
-		{
-			ctDepth.start();
-		}
-		if(laserScanRaw && laserScanRaw->empty())
-		{
-			ctLaserScan.start();
-		}
-		ctImage.join();
-		ctDepth.join();
-		ctLaserScan.join();
+		// the parts are decoded concurrently
+		DecompressionFuture future = DecompressionService::instance().decompress(
+				imageRaw && imageRaw->empty()?_imageCompressed:cv::Mat(),
+				depthRaw && depthRaw->empty()?_depthCompressed:cv::Mat(),
+				laserScanRaw && laserScanRaw->empty()?_laserScanCompressed:cv::Mat(),
+				this->id());
 		if(imageRaw && imageRaw->empty())
 		{
-			*imageRaw = ctImage.getUncompressedData();
+			*imageRaw = future.image();
 		}
 		if(depthRaw && depthRaw->empty())
 		{
-			*depthRaw = ctDepth.getUncompressedData();
+			*depthRaw = future.depth();
 		}
 		if(laserScanRaw && laserScanRaw->empty())
 		{
-			*laserScanRaw = ctLaserScan.getUncompressedData();
+			*laserScanRaw = future.laserScan();
 		}
 	}
 }
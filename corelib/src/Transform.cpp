@@ -32,10 +32,20 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <rtabmap/utilite/UConversion.h>
 #include <rtabmap/utilite/UMath.h>
 #include <iomanip>
+#include <limits>
+#include <string.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define RTABMAP_TRANSFORM_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RTABMAP_TRANSFORM_NEON
+#endif
 
 namespace rtabmap {
 
-Transform::Transform() : data_(12)
+Transform::Transform()
 {
 	data_[0] = 0.0f;
 	data_[1] = 0.0f;
@@ -54,8 +64,7 @@ Transform::Transform() : data_(12)
 // rotation matrix r## and origin o##
 Transform::Transform(float r11, float r12, float r13, float o14,
 				     float r21, float r22, float r23, float o24,
-				     float r31, float r32, float r33, float o34) :
-	data_(12)
+				     float r31, float r32, float r33, float o34)
 {
 	data_[0] = r11;
 	data_[1] = r12;
@@ -140,7 +149,35 @@ float Transform::theta() const
 
 Transform Transform::inverse() const
 {
-	return fromEigen4f(toEigen4f().inverse());
+	// inverse of the 3x3 part from its cofactors (not only a transpose, the
+	// transform may not be rigid), then t' = -R^-1 * t
+	const float * m = data_;
+	float c00 = m[5]*m[10] - m[6]*m[9];
+	float c01 = m[6]*m[8] - m[4]*m[10];
+	float c02 = m[4]*m[9] - m[5]*m[8];
+	float det = m[0]*c00 + m[1]*c01 + m[2]*c02;
+	if(det == 0.0f)
+	{
+		// not invertible (e.g. a null transform), the result is null (NaN)
+		float nan = std::numeric_limits<float>::quiet_NaN();
+		return Transform(nan, nan, nan, nan, nan, nan, nan, nan, nan, nan, nan, nan);
+	}
+	float s = 1.0f/det;
+	Transform r;
+	float * o = r.data_;
+	o[0] = c00*s;
+	o[1] = (m[2]*m[9] - m[1]*m[10])*s;
+	o[2] = (m[1]*m[6] - m[2]*m[5])*s;
+	o[4] = c01*s;
+	o[5] = (m[0]*m[10] - m[2]*m[8])*s;
+	o[6] = (m[2]*m[4] - m[0]*m[6])*s;
+	o[8] = c02*s;
+	o[9] = (m[1]*m[8] - m[0]*m[9])*s;
+	o[10] = (m[0]*m[5] - m[1]*m[4])*s;
+	o[3] = -(o[0]*m[3] + o[1]*m[7] + o[2]*m[11]);
+	o[7] = -(o[4]*m[3] + o[5]*m[7] + o[6]*m[11]);
+	o[11] = -(o[8]*m[3] + o[9]*m[7] + o[10]*m[11]);
+	return r;
 }
 
 Transform Transform::rotation() const
@@ -204,7 +241,47 @@ std::string Transform::prettyPrint() const
 
 Transform Transform::operator*(const Transform & t) const
 {
-	return fromEigen4f(toEigen4f()*t.toEigen4f());
+	// Each row of the result is a linear combination of the rows of t, plus
+	// the translation of this transform on the last column.
+	Transform r;
+#if defined(RTABMAP_TRANSFORM_SSE)
+	__m128 b0 = _mm_loadu_ps(t.data_);
+	__m128 b1 = _mm_loadu_ps(t.data_+4);
+	__m128 b2 = _mm_loadu_ps(t.data_+8);
+	for(int i=0; i<12; i+=4)
+	{
+		const float * a = data_+i;
+		__m128 row = _mm_mul_ps(_mm_set1_ps(a[0]), b0);
+		row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[1]), b1));
+		row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a[2]), b2));
+		row = _mm_add_ps(row, _mm_set_ps(a[3], 0.0f, 0.0f, 0.0f));
+		_mm_storeu_ps(r.data_+i, row);
+	}
+#elif defined(RTABMAP_TRANSFORM_NEON)
+	float32x4_t b0 = vld1q_f32(t.data_);
+	float32x4_t b1 = vld1q_f32(t.data_+4);
+	float32x4_t b2 = vld1q_f32(t.data_+8);
+	for(int i=0; i<12; i+=4)
+	{
+		const float * a = data_+i;
+		float32x4_t row = vmulq_n_f32(b0, a[0]);
+		row = vmlaq_n_f32(row, b1, a[1]);
+		row = vmlaq_n_f32(row, b2, a[2]);
+		row = vaddq_f32(row, vsetq_lane_f32(a[3], vdupq_n_f32(0.0f), 3));
+		vst1q_f32(r.data_+i, row);
+	}
+#else
+	const float * b = t.data_;
+	for(int i=0; i<12; i+=4)
+	{
+		const float * a = data_+i;
+		r.data_[i] = a[0]*b[0] + a[1]*b[4] + a[2]*b[8];
+		r.data_[i+1] = a[0]*b[1] + a[1]*b[5] + a[2]*b[9];
+		r.data_[i+2] = a[0]*b[2] + a[1]*b[6] + a[2]*b[10];
+		r.data_[i+3] = a[0]*b[3] + a[1]*b[7] + a[2]*b[11] + a[3];
+	}
+#endif
+	return r;
 }
 
 Transform & Transform::operator*=(const Transform & t)
@@ -215,7 +292,7 @@ Transform & Transform::operator*=(const Transform & t)
 
 bool Transform::operator==(const Transform & t) const
 {
-	return memcmp(data_.data(), t.data_.data(), data_.size() * sizeof(float)) == 0;
+	return memcmp(data_, t.data_, sizeof(data_)) == 0;
 }
 
 bool Transform::operator!=(const Transform & t) const
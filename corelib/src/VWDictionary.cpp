@@ -27,6 +27,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "rtabmap/core/VWDictionary.h"
 #include "VisualWord.h"
+#include "HammingMatcher.h"
+#include "DescriptorSlab.h"
+#include "InvertedIndex.h"
 
 #include "rtabmap/core/Signature.h"
 #include "rtabmap/core/DBDriver.h"
@@ -38,6 +41,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <fstream>
 #include <string>
+#include <algorithm>
 
 namespace rtabmap
 {
@@ -45,15 +49,187 @@ namespace rtabmap
 const int VWDictionary::ID_START = 1;
 const int VWDictionary::ID_INVALID = 0;
 
+// Part of the dictionary indexed at once. Rows are sorted by word id. Words
+// removed from the dictionary are kept in the index but ignored on search
+// until the segment is rebuilt.
+class VWIndexSegment
+{
+public:
+	VWIndexSegment(const cv::Mat & data, const std::vector<int> & ids, VWDictionary::NNStrategy strategy) :
+		_data(data),
+		_ids(ids),
+		_strategy(strategy),
+		_flannIndex(0),
+		_hammingMatcher(0)
+	{
+		UASSERT(data.rows == (int)ids.size());
+		int type = data.type();
+		switch(_strategy)
+		{
+		case VWDictionary::kNNFlannNaive:
+			_flannIndex = new cv::flann::Index(_data, cv::flann::LinearIndexParams(), type == CV_32F?cvflann::FLANN_DIST_L2:cvflann::FLANN_DIST_HAMMING);
+			break;
+		case VWDictionary::kNNFlannKdTree:
+			UASSERT_MSG(type == CV_32F, "To use KdTree dictionary, float descriptors are required!");
+			_flannIndex = new cv::flann::Index(_data, cv::flann::KDTreeIndexParams(), cvflann::FLANN_DIST_L2);
+			break;
+		case VWDictionary::kNNFlannLSH:
+			UASSERT_MSG(type == CV_8U, "To use LSH dictionary, binary descriptors are required!");
+			_flannIndex = new cv::flann::Index(_data, cv::flann::LshIndexParams(12, 20, 2), cvflann::FLANN_DIST_HAMMING);
+			break;
+		case VWDictionary::kNNBruteForceHamming:
+			UASSERT_MSG(type == CV_8U, "To use Hamming brute force dictionary, binary descriptors are required!");
+			_hammingMatcher = new HammingMatcher();
+			_hammingMatcher->setData(data);
+			_data = _hammingMatcher->data(); // no copy kept outside the aligned block
+			break;
+		default:
+			// brute force on the segment's data
+			break;
+		}
+	}
+	~VWIndexSegment()
+	{
+		_data = cv::Mat();
+		delete _flannIndex;
+		delete _hammingMatcher;
+	}
+
+	int rows() const {return _data.rows;}
+	int aliveRows() const {return _data.rows - (int)_removed.size();}
+	const cv::Mat & data() const {return _data;}
+	const std::vector<int> & ids() const {return _ids;}
+	const std::set<int> & removed() const {return _removed;}
+
+	bool remove(int wordId)
+	{
+		if(std::binary_search(_ids.begin(), _ids.end(), wordId))
+		{
+			_removed.insert(wordId);
+			return true;
+		}
+		return false;
+	}
+
+	void knnSearch(const cv::Mat & query, unsigned int k, std::vector<std::multimap<float, int> > & results) const
+	{
+		UASSERT((int)results.size() == query.rows);
+		// Ask more neighbors when some rows are removed, to still have k valid results most of the time
+		int kSegment = std::min((int)(_removed.size()?2*k:k), _data.rows);
+		if(kSegment <= 0)
+		{
+			return;
+		}
+		if(_flannIndex)
+		{
+			cv::Mat indices;
+			cv::Mat dists;
+			_flannIndex->knnSearch(query, indices, dists, kSegment);
+			// In case of binary descriptors
+			if(dists.type() == CV_32S)
+			{
+				cv::Mat temp;
+				dists.convertTo(temp, CV_32F);
+				dists = temp;
+			}
+			for(int i=0; i<indices.rows; ++i)
+			{
+				for(int j=0; j<indices.cols; ++j)
+				{
+					int index = indices.at<int>(i,j);
+					if(index >= 0 && index < (int)_ids.size() && _removed.find(_ids[index]) == _removed.end())
+					{
+						results[i].insert(std::pair<float, int>(dists.at<float>(i,j), _ids[index]));
+					}
+				}
+			}
+		}
+		else
+		{
+			std::vector<std::vector<cv::DMatch> > matches;
+			if(_hammingMatcher)
+			{
+				_hammingMatcher->knnMatch(query, matches, kSegment);
+			}
+			else
+			{
+				cv::BFMatcher matcher(_data.type()==CV_8U?cv::NORM_HAMMING:cv::NORM_L2SQR);
+				matcher.knnMatch(query, _data, matches, kSegment);
+			}
+			for(unsigned int i=0; i<matches.size(); ++i)
+			{
+				for(unsigned int j=0; j<matches[i].size(); ++j)
+				{
+					int index = matches[i][j].trainIdx;
+					if(index >= 0 && index < (int)_ids.size() && _removed.find(_ids[index]) == _removed.end())
+					{
+						results[i].insert(std::pair<float, int>(matches[i][j].distance, _ids[index]));
+					}
+				}
+			}
+		}
+	}
+
+	// Create a new segment with alive rows of "a" and "b" (b can be null)
+	static VWIndexSegment * merge(const VWIndexSegment * a, const VWIndexSegment * b, VWDictionary::NNStrategy strategy)
+	{
+		UASSERT(a != 0);
+		int total = a->aliveRows() + (b?b->aliveRows():0);
+		if(total == 0)
+		{
+			return 0;
+		}
+		cv::Mat data(total, a->data().cols, a->data().type());
+		std::vector<int> ids(total);
+		int ia = 0, ib = 0, row = 0;
+		int rowsB = b?b->rows():0;
+		while(ia < a->rows() || ib < rowsB)
+		{
+			const VWIndexSegment * from;
+			int index;
+			if(ib >= rowsB || (ia < a->rows() && a->ids()[ia] < b->ids()[ib]))
+			{
+				from = a;
+				index = ia++;
+			}
+			else
+			{
+				from = b;
+				index = ib++;
+			}
+			if(from->removed().find(from->ids()[index]) == from->removed().end())
+			{
+				from->data().row(index).copyTo(data.row(row));
+				ids[row] = from->ids()[index];
+				++row;
+			}
+		}
+		UASSERT(row == total);
+		return new VWIndexSegment(data, ids, strategy);
+	}
+
+private:
+	cv::Mat _data;
+	std::vector<int> _ids;
+	VWDictionary::NNStrategy _strategy;
+	cv::flann::Index * _flannIndex;
+	HammingMatcher * _hammingMatcher;
+	std::set<int> _removed;
+};
+
 VWDictionary::VWDictionary(const ParametersMap & parameters) :
-	_totalActiveReferences(0),
 	_incrementalDictionary(Parameters::defaultKpIncrementalDictionary()),
 	_nndrRatio(Parameters::defaultKpNndrRatio()),
 	_dictionaryPath(Parameters::defaultKpDictionaryPath()),
 	_newWordsComparedTogether(Parameters::defaultKpNewWordsComparedTogether()),
 	_lastWordId(0),
 	_flannIndex(new cv::flann::Index()),
-	_strategy(kNNBruteForce)
+	_hammingMatcher(new HammingMatcher()),
+	_slab(new DescriptorSlab()),
+	_invertedIndex(new InvertedIndex()),
+	_strategy(kNNBruteForce),
+	_incrementalFlann(Parameters::defaultKpIncrementalFlann()),
+	_flannRebalancingFactor(Parameters::defaultKpFlannRebalancingFactor())
 {
 	this->setNNStrategy((NNStrategy)Parameters::defaultKpNNStrategy());
 	this->parseParameters(parameters);
@@ -63,6 +239,9 @@ VWDictionary::~VWDictionary()
 {
 	this->clear();
 	delete _flannIndex;
+	delete _hammingMatcher;
+	delete _slab;
+	delete _invertedIndex;
 }
 
 void VWDictionary::parseParameters(const ParametersMap & parameters)
@@ -70,8 +249,10 @@ void VWDictionary::parseParameters(const ParametersMap & parameters)
 	ParametersMap::const_iterator iter;
 	Parameters::parse(parameters, Parameters::kKpNndrRatio(), _nndrRatio);
 	Parameters::parse(parameters, Parameters::kKpNewWordsComparedTogether(), _newWordsComparedTogether);
+	Parameters::parse(parameters, Parameters::kKpFlannRebalancingFactor(), _flannRebalancingFactor);
 
 	UASSERT_MSG(_nndrRatio > 0.0f, uFormat("String=%s value=%f", uContains(parameters, Parameters::kKpNndrRatio())?parameters.at(Parameters::kKpNndrRatio()).c_str():"", _nndrRatio).c_str());
+	UASSERT_MSG(_flannRebalancingFactor > 1.0f, uFormat("value=%f", _flannRebalancingFactor).c_str());
 
 	std::string dictionaryPath = _dictionaryPath;
 	bool incrementalDictionary = _incrementalDictionary;
@@ -91,6 +272,11 @@ void VWDictionary::parseParameters(const ParametersMap & parameters)
 		this->setNNStrategy(nnStrategy);
 	}
 
+	if((iter=parameters.find(Parameters::kKpIncrementalFlann())) != parameters.end())
+	{
+		this->setIncrementalFlann(uStr2Bool((*iter).second.c_str()));
+	}
+
 	if(incrementalDictionary)
 	{
 		this->setIncrementalDictionary();
@@ -174,7 +360,8 @@ void VWDictionary::setFixedDictionary(const std::string & dictionaryPath)
 								UERROR("");
 							}
 
-							VisualWord * vw = new VisualWord(id, descriptor, 0);
+							VisualWord * vw = new VisualWord(id, descriptor);
+							_slab->add(vw);
 							_visualWords.insert(_visualWords.end(), std::pair<int, VisualWord*>(id, vw));
 							_notIndexedWords.insert(_notIndexedWords.end(), id);
 						}
@@ -228,29 +415,72 @@ void VWDictionary::setNNStrategy(NNStrategy strategy)
 				  "with OpenCV nonfree module (KdTree only used for SURF/SIFT features). "
 				  "NN strategy is not modified (current=%d).", (int)kNNFlannKdTree, (int)_strategy);
 		}
-		else
+		else if(_strategy != strategy)
 		{
+			// Indexed words will be indexed again with the new strategy on next update()
+			this->releaseIndex();
 			_strategy = strategy;
 		}
 	}
 }
 
+void VWDictionary::setIncrementalFlann(bool enabled)
+{
+	if(_incrementalFlann != enabled)
+	{
+		// Indexed words will be indexed again with the new approach on next update()
+		this->releaseIndex();
+		_incrementalFlann = enabled;
+	}
+}
+
+void VWDictionary::releaseIndex()
+{
+	_mapIndexId.clear();
+	_dataTree = cv::Mat();
+	_flannIndex->release();
+	_hammingMatcher->release();
+	for(unsigned int i=0; i<_segments.size(); ++i)
+	{
+		delete _segments[i];
+	}
+	_segments.clear();
+}
+
 int VWDictionary::getLastIndexedWordId() const
 {
-	if(_mapIndexId.size())
+	if(_incrementalFlann)
 	{
-		return _mapIndexId.rbegin()->second;
+		int lastId = 0;
+		for(unsigned int i=0; i<_segments.size(); ++i)
+		{
+			if(_segments[i]->ids().size() && _segments[i]->ids().back() > lastId)
+			{
+				lastId = _segments[i]->ids().back();
+			}
+		}
+		return lastId;
 	}
 	else
 	{
-		return 0;
+		// rows are not sorted by id when the index is built on the slab
+		int lastId = 0;
+		for(std::map<int, int>::const_iterator iter=_mapIndexId.begin(); iter!=_mapIndexId.end(); ++iter)
+		{
+			if(iter->second > lastId)
+			{
+				lastId = iter->second;
+			}
+		}
+		return lastId;
 	}
 }
 
 void VWDictionary::update()
 {
 	ULOGGER_DEBUG("");
-	if(!_incrementalDictionary && !_notIndexedWords.size())
+	bool indexReset = _visualWords.size() && _dataTree.empty() && _segments.empty();
+	if(!_incrementalDictionary && !_notIndexedWords.size() && !indexReset)
 	{
 		// No need to update the search index if we
 		// use a fixed dictionary and the index is
@@ -258,12 +488,24 @@ void VWDictionary::update()
 		return;
 	}
 
-	if(_notIndexedWords.size() || _visualWords.size() == 0 || _removedIndexedWords.size())
+	if(_strategy == kNNBruteForceHamming &&
+	   _visualWords.size() &&
+	   _visualWords.begin()->second->getDescriptor().type() != CV_8U)
+	{
+		UWARN("Nearest neighbor strategy \"kNNBruteForceHamming\" chosen but descriptors are not binary! Doing \"kNNBruteForce\" instead.");
+		this->releaseIndex();
+		_strategy = kNNBruteForce;
+	}
+
+	if(_incrementalFlann && _strategy != kNNBruteForceGPU)
+	{
+		this->updateSegments();
+	}
+	else if(_notIndexedWords.size() || _visualWords.size() == 0 || _removedIndexedWords.size() || indexReset)
 	{
-		_mapIndexId.clear();
 		int oldSize = _dataTree.rows;
-		_dataTree = cv::Mat();
-		_flannIndex->release();
+		this->releaseIndex();
+		_slab->compact(); // nothing is indexed on the slab anymore
 
 		if(_visualWords.size())
 		{
@@ -276,16 +518,45 @@ void VWDictionary::update()
 			UASSERT(type == CV_32F || type == CV_8U);
 			UASSERT(dim > 0);
 
-			// Create the data matrix
-			_dataTree = cv::Mat(_visualWords.size(), dim, type); // SURF descriptors are CV_32F
-			std::map<int, VisualWord*>::const_iterator iter = _visualWords.begin();
-			for(unsigned int i=0; i < _visualWords.size(); ++i, ++iter)
+			if(_slab->size() == (int)_visualWords.size() && _slab->isDense())
+			{
+				// All descriptors are already in one matrix
+				UASSERT(_slab->dim() == dim && _slab->type() == type);
+				if(_strategy == kNNBruteForceHamming)
+				{
+					_hammingMatcher->setData(_slab->data());
+					_dataTree = _hammingMatcher->data();
+				}
+				else
+				{
+					_dataTree = _slab->data();
+				}
+				for(int i=0; i < _slab->rows(); ++i)
+				{
+					_mapIndexId.insert(_mapIndexId.end(), std::pair<int, int>(i, _slab->word(i)->id()));
+				}
+			}
+			else
 			{
-				UASSERT(iter->second->getDescriptor().cols == dim);
-				UASSERT(iter->second->getDescriptor().type() == type);
+				// Create the data matrix
+				if(_strategy == kNNBruteForceHamming)
+				{
+					// contiguous and aligned block for SIMD matching
+					_dataTree = _hammingMatcher->create(_visualWords.size(), dim);
+				}
+				else
+				{
+					_dataTree = cv::Mat(_visualWords.size(), dim, type); // SURF descriptors are CV_32F
+				}
+				std::map<int, VisualWord*>::const_iterator iter = _visualWords.begin();
+				for(unsigned int i=0; i < _visualWords.size(); ++i, ++iter)
+				{
+					UASSERT(iter->second->getDescriptor().cols == dim);
+					UASSERT(iter->second->getDescriptor().type() == type);
 
-				iter->second->getDescriptor().copyTo(_dataTree.row(i));
-				_mapIndexId.insert(_mapIndexId.end(), std::pair<int, int>(i, iter->second->id()));
+					iter->second->getDescriptor().copyTo(_dataTree.row(i));
+					_mapIndexId.insert(_mapIndexId.end(), std::pair<int, int>(i, iter->second->id()));
+				}
 			}
 
 			ULOGGER_DEBUG("_mapIndexId.size() = %d, words.size()=%d, _dim=%d",_mapIndexId.size(), _visualWords.size(), dim);
@@ -321,6 +592,100 @@ void VWDictionary::update()
 	_removedIndexedWords.clear();
 }
 
+void VWDictionary::updateSegments()
+{
+	UTimer timer;
+	int oldSegments = (int)_segments.size();
+
+	// Segments have their own copy of the descriptors, the rows of removed words can be reused
+	_slab->compact();
+
+	// Create a segment with the new words. If there are
+	// no segments yet, all words of the dictionary are indexed.
+	std::vector<int> ids;
+	if(_segments.empty())
+	{
+		ids = uKeys(_visualWords);
+	}
+	else
+	{
+		ids = std::vector<int>(_notIndexedWords.begin(), _notIndexedWords.end());
+	}
+	if(ids.size())
+	{
+		int type = _visualWords.at(ids.front())->getDescriptor().type();
+		int dim = _visualWords.at(ids.front())->getDescriptor().cols;
+		UASSERT(type == CV_32F || type == CV_8U);
+		UASSERT(dim > 0);
+		cv::Mat data(ids.size(), dim, type);
+		for(unsigned int i=0; i<ids.size(); ++i)
+		{
+			const cv::Mat & descriptor = _visualWords.at(ids[i])->getDescriptor();
+			UASSERT(descriptor.cols == dim && descriptor.type() == type);
+			descriptor.copyTo(data.row(i));
+		}
+		_segments.push_back(new VWIndexSegment(data, ids, _strategy));
+	}
+	double timeNew = timer.ticks();
+
+	// Compact segments having too many removed words
+	int compacted = 0;
+	for(unsigned int i=0; i<_segments.size();)
+	{
+		if(_segments[i]->removed().size() && float(_segments[i]->removed().size()) * _flannRebalancingFactor > float(_segments[i]->rows()))
+		{
+			VWIndexSegment * segment = VWIndexSegment::merge(_segments[i], 0, _strategy);
+			delete _segments[i];
+			++compacted;
+			if(segment)
+			{
+				_segments[i++] = segment;
+			}
+			else
+			{
+				_segments.erase(_segments.begin()+i);
+			}
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	// Merge the newest segments while the older is not bigger enough than the newer,
+	// keeping a logarithmic number of segments with sizes growing with their age
+	int merged = 0;
+	while(_segments.size() >= 2 &&
+		  float(_segments[_segments.size()-2]->aliveRows()) < _flannRebalancingFactor * float(_segments.back()->aliveRows()))
+	{
+		VWIndexSegment * older = _segments[_segments.size()-2];
+		VWIndexSegment * newer = _segments.back();
+		VWIndexSegment * segment = VWIndexSegment::merge(older, newer, _strategy);
+		delete older;
+		delete newer;
+		_segments.pop_back();
+		_segments.pop_back();
+		if(segment)
+		{
+			_segments.push_back(segment);
+		}
+		++merged;
+	}
+
+	UDEBUG("Dictionary index updated! (segments=%d->%d, indexed=%d, added=%d, removed=%d, compacted=%d, merged=%d, time new=%fs merge=%fs)",
+			oldSegments, (int)_segments.size(), (int)ids.size(), (int)_notIndexedWords.size(), (int)_removedIndexedWords.size(),
+			compacted, merged, timeNew, timer.ticks());
+}
+
+void VWDictionary::searchSegments(const cv::Mat & query, unsigned int k, std::vector<std::multimap<float, int> > & results) const
+{
+	results = std::vector<std::multimap<float, int> >(query.rows);
+	for(unsigned int i=0; i<_segments.size(); ++i)
+	{
+		_segments[i]->knnSearch(query, k, results);
+	}
+}
+
 void VWDictionary::clear()
 {
 	ULOGGER_DEBUG("");
@@ -337,14 +702,14 @@ void VWDictionary::clear()
 		delete (*i).second;
 	}
 	_visualWords.clear();
+	_slab->clear();
 	_notIndexedWords.clear();
 	_removedIndexedWords.clear();
-	_totalActiveReferences = 0;
+	_invertedIndex->clear();
 	_lastWordId = 0;
 	_dataTree = cv::Mat();
-	_mapIndexId.clear();
 	_unusedWords.clear();
-	_flannIndex->release();
+	this->releaseIndex();
 }
 
 int VWDictionary::getNextId()
@@ -360,8 +725,7 @@ void VWDictionary::addWordRef(int wordId, int signatureId)
 		vw = uValue(_visualWords, wordId, vw);
 		if(vw)
 		{
-			vw->addRef(signatureId);
-			_totalActiveReferences += 1;
+			_invertedIndex->add(vw->id(), signatureId);
 
 			_unusedWords.erase(vw->id());
 		}
@@ -372,20 +736,57 @@ void VWDictionary::addWordRef(int wordId, int signatureId)
 	}
 }
 
-void VWDictionary::removeAllWordRef(int wordId, int signatureId)
+void VWDictionary::addWordsRef(const std::vector<int> & wordIds, int signatureId)
 {
-	VisualWord * vw = 0;
-	vw = uValue(_visualWords, wordId, vw);
-	if(vw)
+	if(signatureId > 0 && wordIds.size())
+	{
+		std::vector<int> sortedIds = wordIds;
+		std::sort(sortedIds.begin(), sortedIds.end());
+		// add the occurrences of a word at once
+		for(unsigned int i=0; i<sortedIds.size();)
+		{
+			unsigned int j = i+1;
+			while(j<sortedIds.size() && sortedIds[j] == sortedIds[i])
+			{
+				++j;
+			}
+			if(sortedIds[i] > 0)
+			{
+				std::map<int, VisualWord *>::iterator iter = _visualWords.find(sortedIds[i]);
+				if(iter != _visualWords.end())
+				{
+					_invertedIndex->add(sortedIds[i], signatureId, j-i);
+					_unusedWords.erase(sortedIds[i]);
+				}
+				else
+				{
+					UERROR("Not found word %d", sortedIds[i]);
+				}
+			}
+			i = j;
+		}
+	}
+}
+
+void VWDictionary::removeAllWordsRef(int signatureId)
+{
+	std::vector<int> unusedWords;
+	_invertedIndex->removeSignature(signatureId, &unusedWords);
+	for(unsigned int i=0; i<unusedWords.size(); ++i)
 	{
-		_totalActiveReferences -= vw->removeAllRef(signatureId);
-		if(vw->getReferences().size() == 0)
+		std::map<int, VisualWord *>::iterator iter = _visualWords.find(unusedWords[i]);
+		if(iter != _visualWords.end())
 		{
-			_unusedWords.insert(std::pair<int, VisualWord*>(vw->id(), vw));
+			_unusedWords.insert(*iter);
 		}
 	}
 }
 
+int VWDictionary::getTotalActiveReferences() const
+{
+	return _invertedIndex->totalReferences();
+}
+
 std::list<int> VWDictionary::addNewWords(const cv::Mat & descriptors,
 							   int signatureId)
 {
@@ -444,7 +845,13 @@ std::list<int> VWDictionary::addNewWords(const cv::Mat & descriptors,
 	UTimer timerLocal;
 	timerLocal.start();
 
-	if(!_dataTree.empty() && _dataTree.rows >= (int)k)
+	std::vector<std::multimap<float, int> > segmentsResults;
+	if(_segments.size())
+	{
+		this->searchSegments(descriptors, k, segmentsResults);
+		UDEBUG("Time to find nn in %d segments = %f s", (int)_segments.size(), timerLocal.ticks());
+	}
+	else if(!_dataTree.empty() && _dataTree.rows >= (int)k)
 	{
 		//Find nearest neighbors
 		UDEBUG("newPts.total()=%d ", descriptors.rows);
@@ -459,6 +866,11 @@ std::list<int> VWDictionary::addNewWords(const cv::Mat & descriptors,
 			cv::BFMatcher matcher(type==CV_8U?cv::NORM_HAMMING:cv::NORM_L2SQR);
 			matcher.knnMatch(descriptors, _dataTree, matches, k);
 		}
+		else if(_strategy == kNNBruteForceHamming)
+		{
+			bruteForce = true;
+			_hammingMatcher->knnMatch(descriptors, matches, k);
+		}
 		else if(_strategy == kNNBruteForceGPU)
 		{
 			bruteForce = true;
@@ -495,7 +907,11 @@ std::list<int> VWDictionary::addNewWords(const cv::Mat & descriptors,
 	for(int i = 0; i < descriptors.rows; ++i)
 	{
 		std::multimap<float, int> fullResults; // Contains results from the kd-tree search and the naive search in new words
-		if(!bruteForce && dists.cols)
+		if(segmentsResults.size())
+		{
+			fullResults = segmentsResults[i];
+		}
+		else if(!bruteForce && dists.cols)
 		{
 			for(int j=0; j<dists.cols; ++j)
 			{
@@ -571,7 +987,9 @@ std::list<int> VWDictionary::addNewWords(const cv::Mat & descriptors,
 
 			if(badDist)
 			{
-				VisualWord * vw = new VisualWord(getNextId(), descriptors.row(i), signatureId);
+				VisualWord * vw = new VisualWord(getNextId(), descriptors.row(i));
+				_slab->add(vw);
+				_invertedIndex->add(vw->id(), signatureId);
 				_visualWords.insert(_visualWords.end(), std::pair<int, VisualWord *>(vw->id(), vw));
 				_notIndexedWords.insert(_notIndexedWords.end(), vw->id());
 				newWords.push_back(vw->getDescriptor());
@@ -611,7 +1029,6 @@ std::list<int> VWDictionary::addNewWords(const cv::Mat & descriptors,
 			dupWordsCountFromDict+dupWordsCountFromLast, dupWordsCountFromLast);
 	UDEBUG("total time %fs", timer.ticks());
 
-	_totalActiveReferences += _notIndexedWords.size();
 	return wordIds;
 }
 
@@ -659,7 +1076,12 @@ std::vector<int> VWDictionary::findNN(const std::list<VisualWord *> & vws) const
 		}
 		ULOGGER_DEBUG("Preparation time = %fs", timer.ticks());
 
-		if(!_dataTree.empty() && _dataTree.rows >= (int)k)
+		std::vector<std::multimap<float, int> > segmentsResults;
+		if(_segments.size())
+		{
+			this->searchSegments(query, k, segmentsResults);
+		}
+		else if(!_dataTree.empty() && _dataTree.rows >= (int)k)
 		{
 			//Find nearest neighbors
 			UDEBUG("newPts.total()=%d ", query.total());
@@ -674,6 +1096,11 @@ std::vector<int> VWDictionary::findNN(const std::list<VisualWord *> & vws) const
 				cv::BFMatcher matcher(type==CV_8U?cv::NORM_HAMMING:cv::NORM_L2SQR);
 				matcher.knnMatch(query, _dataTree, matches, k);
 			}
+			else if(_strategy == kNNBruteForceHamming)
+			{
+				bruteForce = true;
+				_hammingMatcher->knnMatch(query, matches, k);
+			}
 			else if(_strategy == kNNBruteForceGPU)
 			{
 				bruteForce = true;
@@ -739,7 +1166,11 @@ std::vector<int> VWDictionary::findNN(const std::list<VisualWord *> & vws) const
 		for(unsigned int i=0; i<vws.size(); ++i)
 		{
 			std::multimap<float, int> fullResults; // Contains results from the kd-tree search [and the naive search in new words]
-			if(!bruteForce && dists.cols)
+			if(segmentsResults.size())
+			{
+				fullResults = segmentsResults[i];
+			}
+			else if(!bruteForce && dists.cols)
 			{
 				for(int j=0; j<dists.cols; ++j)
 				{
@@ -815,13 +1246,10 @@ void VWDictionary::addWord(VisualWord * vw)
 {
 	if(vw)
 	{
+		_slab->add(vw);
 		_visualWords.insert(std::pair<int, VisualWord *>(vw->id(), vw));
 		_notIndexedWords.insert(vw->id());
-		if(vw->getReferences().size())
-		{
-			_totalActiveReferences += uSum(uValues(vw->getReferences()));
-		}
-		else
+		if(_invertedIndex->signatures(vw->id()) == 0)
 		{
 			_unusedWords.insert(std::pair<int, VisualWord *>(vw->id(), vw));
 		}
@@ -862,11 +1290,19 @@ void VWDictionary::removeWords(const std::vector<VisualWord*> & words)
 {
 	for(unsigned int i=0; i<words.size(); ++i)
 	{
+		_slab->remove(words[i]); // the word keeps its descriptor to be saved
 		_visualWords.erase(words[i]->id());
 		_unusedWords.erase(words[i]->id());
 		if(_notIndexedWords.erase(words[i]->id()) == 0)
 		{
 			_removedIndexedWords.insert(words[i]->id());
+			for(unsigned int j=0; j<_segments.size(); ++j)
+			{
+				if(_segments[j]->remove(words[i]->id()))
+				{
+					break;
+				}
+			}
 		}
 	}
 }
@@ -915,12 +1351,11 @@ void VWDictionary::exportDictionary(const char * fileNameReferences, const char
     	if(foutRef)
     	{
 			fprintf(foutRef, "%d ", (*iter).first);
-			const std::map<int, int> ref = (*iter).second->getReferences();
-			for(std::map<int, int>::const_iterator jter=ref.begin(); jter!=ref.end(); ++jter)
+			for(InvertedIndex::Reader jter=_invertedIndex->postings((*iter).first); jter.next();)
 			{
-				for(int i=0; i<(*jter).second; ++i)
+				for(int i=0; i<jter.count(); ++i)
 				{
-					fprintf(foutRef, "%d ", (*jter).first);
+					fprintf(foutRef, "%d ", jter.signatureId());
 				}
 			}
 			fprintf(foutRef, "\n");
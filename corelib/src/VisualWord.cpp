@@ -26,47 +26,36 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "VisualWord.h"
+#include "DescriptorSlab.h"
 #include "rtabmap/utilite/ULogger.h"
-#include "rtabmap/utilite/UStl.h"
 
 namespace rtabmap
 {
 
-VisualWord::VisualWord(int id, const cv::Mat & descriptor, int signatureId) :
+VisualWord::VisualWord(int id, const cv::Mat & descriptor) :
 	_id(id),
 	_descriptor(descriptor),
-	_saved(false),
-	_totalReferences(0)
+	_slab(0),
+	_row(-1),
+	_saved(false)
 {
-	if(signatureId)
-	{
-		addRef(signatureId);
-	}
 }
 
 VisualWord::~VisualWord()
 {
-}
-
-void VisualWord::addRef(int signatureId)
-{
-	std::map<int, int>::iterator iter = _references.find(signatureId);
-	if(iter != _references.end())
+	if(_slab)
 	{
-		(*iter).second += 1;
+		_slab->remove(this, false);
 	}
-	else
-	{
-		_references.insert(std::pair<int, int>(signatureId, 1));
-	}
-	++_totalReferences;
 }
 
-int VisualWord::removeAllRef(int signatureId)
+cv::Mat VisualWord::getDescriptor() const
 {
-	int removed = uTake(_references, signatureId, 0);
-	_totalReferences -= removed;
-	return removed;
+	if(_slab)
+	{
+		return _slab->row(_row);
+	}
+	return _descriptor;
 }
 
 } // namespace rtabmap
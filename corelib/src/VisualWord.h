@@ -34,31 +34,31 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 namespace rtabmap
 {
 
+class DescriptorSlab;
+
 class RTABMAP_EXP VisualWord
 {
 public:
-	VisualWord(int id, const cv::Mat & descriptor, int signatureId = 0);
+	VisualWord(int id, const cv::Mat & descriptor);
 	~VisualWord();
 
-	void addRef(int signatureId);
-	int removeAllRef(int signatureId);
-
-	int getTotalReferences() const {return _totalReferences;}
 	int id() const {return _id;}
-	const cv::Mat & getDescriptor() const {return _descriptor;}
-	const std::map<int, int> & getReferences() const {return _references;} // (signature id , occurrence in the signature)
+	cv::Mat getDescriptor() const; // not copied, row of the dictionary's slab if the word is in a dictionary
 
 	bool isSaved() const {return _saved;}
 	void setSaved(bool saved) {_saved = saved;}
 
 private:
+	VisualWord(const VisualWord &);
+	VisualWord & operator=(const VisualWord &);
+
+private:
+	friend class DescriptorSlab;
 	int _id;
-	cv::Mat _descriptor;
+	cv::Mat _descriptor; // empty when the descriptor is in a slab
+	DescriptorSlab * _slab;
+	int _row;
 	bool _saved; // If it's saved to db
-
-	int _totalReferences;
-	std::map<int, int> _references; // (signature id , occurrence in the signature)
-	std::map<int, int> _oldReferences; // (signature id , occurrence in the signature)
 };
 
 } // namespace rtabmap
@@ -0,0 +1,449 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/VoxelAccumulator.h"
+
+#include <rtabmap/utilite/ULogger.h>
+#include <rtabmap/utilite/UFile.h>
+#include <rtabmap/utilite/UTimer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+namespace rtabmap {
+namespace util3d {
+
+// Blocks of 16x16x16 voxels
+static const int kBlockBits = 4;
+static const int kBlockMask = (1<<kBlockBits)-1;
+static const int kBlockVoxels = 1<<(3*kBlockBits);
+
+// approximation of a map node
+static const long kMapNodeBytes = 4*sizeof(void*) + 4*sizeof(int);
+
+static bool seekSpillFile(FILE * file, long long offset)
+{
+#ifdef _WIN32
+	return _fseeki64(file, offset, SEEK_SET) == 0;
+#else
+	return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+struct VoxelAccumulator::Voxel
+{
+	Voxel(int index = 0) : index((unsigned short)index), count(0), x(0.0f), y(0.0f), z(0.0f), r(0), g(0), b(0) {}
+	unsigned short index; // in the block
+	int count;
+	float x, y, z; // average
+	unsigned int r, g, b; // sums
+};
+
+struct VoxelAccumulator::Block
+{
+	Block() : indices(kBlockVoxels, 0), lastUpdate(0) {}
+
+	long memory() const
+	{
+		return sizeof(Block) + kMapNodeBytes + indices.capacity()*sizeof(unsigned short) + voxels.capacity()*sizeof(Voxel);
+	}
+
+	Voxel & voxel(int index, long & memory)
+	{
+		unsigned short & i = indices[index];
+		if(i == 0)
+		{
+			size_t capacity = voxels.capacity();
+			voxels.push_back(Voxel(index));
+			memory += (long)((voxels.capacity() - capacity)*sizeof(Voxel));
+			i = (unsigned short)voxels.size();
+		}
+		return voxels[i-1];
+	}
+
+	void merge(const Voxel & v)
+	{
+		long memory = 0;
+		Voxel & voxel = this->voxel(v.index, memory);
+		int count = voxel.count + v.count;
+		float wa = float(voxel.count)/float(count);
+		float wb = float(v.count)/float(count);
+		voxel.x = voxel.x*wa + v.x*wb;
+		voxel.y = voxel.y*wa + v.y*wb;
+		voxel.z = voxel.z*wa + v.z*wb;
+		voxel.r += v.r;
+		voxel.g += v.g;
+		voxel.b += v.b;
+		voxel.count = count;
+	}
+
+	void reset()
+	{
+		std::fill(indices.begin(), indices.end(), 0);
+		voxels.clear();
+	}
+
+	std::vector<unsigned short> indices; // voxel position+1 in "voxels", 0=empty
+	std::vector<Voxel> voxels;
+	int lastUpdate; // integrate() count
+};
+
+VoxelAccumulator::VoxelAccumulator(float voxelSize, long maxMemory, const std::string & spillPath) :
+	_voxelSize(voxelSize),
+	_voxelSizeInv(1.0f/voxelSize),
+	_maxMemory(maxMemory),
+	_spillPath(spillPath),
+	_spillFile(0),
+	_spillSize(0),
+	_memoryUsed(0),
+	_points(0),
+	_integrations(0)
+{
+	UASSERT(voxelSize > 0.0f && maxMemory >= 0);
+}
+
+VoxelAccumulator::~VoxelAccumulator()
+{
+	this->clear();
+}
+
+void VoxelAccumulator::integrate(const pcl::PointCloud<pcl::PointXYZRGB> & cloud, const Transform & transform)
+{
+	++_integrations;
+	bool transformed = !transform.isNull() && !transform.isIdentity();
+	BlockKey key;
+	Block * block = 0;
+	for(unsigned int i=0; i<cloud.size(); ++i)
+	{
+		const pcl::PointXYZRGB & pt = cloud.points[i];
+		if(!pcl::isFinite(pt))
+		{
+			continue;
+		}
+		float x = pt.x;
+		float y = pt.y;
+		float z = pt.z;
+		if(transformed)
+		{
+			transform.transformPoint(x, y, z);
+		}
+		int ix = (int)std::floor(x*_voxelSizeInv);
+		int iy = (int)std::floor(y*_voxelSizeInv);
+		int iz = (int)std::floor(z*_voxelSizeInv);
+
+		// consecutive points are generally in the same block
+		BlockKey k(ix >> kBlockBits, iy >> kBlockBits, iz >> kBlockBits);
+		if(block == 0 || !(k == key))
+		{
+			key = k;
+			block = this->getBlock(key);
+		}
+
+		Voxel & voxel = block->voxel(
+				((ix & kBlockMask) << (2*kBlockBits)) | ((iy & kBlockMask) << kBlockBits) | (iz & kBlockMask),
+				_memoryUsed);
+		++voxel.count;
+		float inv = 1.0f/float(voxel.count);
+		voxel.x += (x - voxel.x)*inv;
+		voxel.y += (y - voxel.y)*inv;
+		voxel.z += (z - voxel.z)*inv;
+		voxel.r += pt.r;
+		voxel.g += pt.g;
+		voxel.b += pt.b;
+		++_points;
+	}
+
+	if(_maxMemory > 0 && _memoryUsed > _maxMemory)
+	{
+		this->spill();
+	}
+}
+
+pcl::PointCloud<pcl::PointXYZRGB>::Ptr VoxelAccumulator::cloud(std::vector<int> * counts) const
+{
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr output(new pcl::PointCloud<pcl::PointXYZRGB>);
+	if(counts)
+	{
+		counts->clear();
+	}
+	Block buffer;
+	std::vector<BlockKey> keys = this->keys();
+	for(unsigned int i=0; i<keys.size(); ++i)
+	{
+		const std::vector<Voxel> & voxels = this->voxels(keys[i], buffer);
+		for(unsigned int j=0; j<voxels.size(); ++j)
+		{
+			const Voxel & v = voxels[j];
+			pcl::PointXYZRGB pt;
+			pt.x = v.x;
+			pt.y = v.y;
+			pt.z = v.z;
+			pt.r = (unsigned char)((v.r + v.count/2) / v.count);
+			pt.g = (unsigned char)((v.g + v.count/2) / v.count);
+			pt.b = (unsigned char)((v.b + v.count/2) / v.count);
+			output->push_back(pt);
+			if(counts)
+			{
+				counts->push_back(v.count);
+			}
+		}
+	}
+	return output;
+}
+
+int VoxelAccumulator::savePLY(const std::string & path, bool binary, bool withCounts) const
+{
+	UTimer timer;
+	FILE * file = fopen(path.c_str(), "wb");
+	if(!file)
+	{
+		UERROR("Cannot open \"%s\"", path.c_str());
+		return -1;
+	}
+
+	int one = 1;
+	bool littleEndian = *(char*)&one == 1;
+	fprintf(file, "ply\nformat %s 1.0\nelement vertex ",
+			binary?(littleEndian?"binary_little_endian":"binary_big_endian"):"ascii");
+	// the number of voxels is known at the end, it is written over this field
+	long countPosition = ftell(file);
+	fprintf(file, "%010d\n"
+			"property float x\n"
+			"property float y\n"
+			"property float z\n"
+			"property uchar red\n"
+			"property uchar green\n"
+			"property uchar blue\n"
+			"%s"
+			"end_header\n",
+			0,
+			withCounts?"property int count\n":"");
+
+	int written = 0;
+	Block buffer;
+	std::vector<BlockKey> keys = this->keys();
+	for(unsigned int i=0; i<keys.size(); ++i)
+	{
+		const std::vector<Voxel> & voxels = this->voxels(keys[i], buffer);
+		for(unsigned int j=0; j<voxels.size(); ++j)
+		{
+			const Voxel & v = voxels[j];
+			unsigned char r = (unsigned char)((v.r + v.count/2) / v.count);
+			unsigned char g = (unsigned char)((v.g + v.count/2) / v.count);
+			unsigned char b = (unsigned char)((v.b + v.count/2) / v.count);
+			if(binary)
+			{
+				char record[19];
+				memcpy(record, &v.x, 4);
+				memcpy(record+4, &v.y, 4);
+				memcpy(record+8, &v.z, 4);
+				record[12] = (char)r;
+				record[13] = (char)g;
+				record[14] = (char)b;
+				memcpy(record+15, &v.count, 4);
+				fwrite(record, withCounts?19:15, 1, file);
+			}
+			else if(withCounts)
+			{
+				fprintf(file, "%f %f %f %d %d %d %d\n", v.x, v.y, v.z, r, g, b, v.count);
+			}
+			else
+			{
+				fprintf(file, "%f %f %f %d %d %d\n", v.x, v.y, v.z, r, g, b);
+			}
+			++written;
+		}
+	}
+
+	fseek(file, countPosition, SEEK_SET);
+	fprintf(file, "%010d", written);
+	bool error = ferror(file) != 0;
+	if(fclose(file) != 0 || error)
+	{
+		UERROR("Failed to write \"%s\"", path.c_str());
+		return -1;
+	}
+	UDEBUG("Saved %d voxels in \"%s\" (%fs)", written, path.c_str(), timer.ticks());
+	return written;
+}
+
+void VoxelAccumulator::clear()
+{
+	for(std::map<BlockKey, Block *>::iterator iter=_blocks.begin(); iter!=_blocks.end(); ++iter)
+	{
+		delete iter->second;
+	}
+	_blocks.clear();
+	_spilled.clear();
+	if(_spillFile)
+	{
+		fclose(_spillFile);
+		_spillFile = 0;
+		if(!_spillPath.empty())
+		{
+			UFile::erase(_spillPath);
+		}
+	}
+	_spillSize = 0;
+	_memoryUsed = 0;
+	_points = 0;
+	_integrations = 0;
+}
+
+VoxelAccumulator::Block * VoxelAccumulator::getBlock(const BlockKey & key)
+{
+	std::map<BlockKey, Block *>::iterator iter = _blocks.find(key);
+	if(iter == _blocks.end())
+	{
+		iter = _blocks.insert(std::make_pair(key, new Block())).first;
+		_memoryUsed += iter->second->memory();
+	}
+	iter->second->lastUpdate = _integrations;
+	return iter->second;
+}
+
+void VoxelAccumulator::spill()
+{
+	UTimer timer;
+	if(_spillFile == 0)
+	{
+		_spillFile = _spillPath.empty()?tmpfile():fopen(_spillPath.c_str(), "w+b");
+		if(_spillFile == 0)
+		{
+			UERROR("Cannot open the spill file \"%s\", the memory is not limited anymore", _spillPath.c_str());
+			_maxMemory = 0;
+			return;
+		}
+	}
+	if(!seekSpillFile(_spillFile, _spillSize))
+	{
+		UERROR("Cannot seek in the spill file");
+		return;
+	}
+
+	// blocks not updated for the longest time first, down to 3/4 of the maximum
+	std::vector<std::pair<int, BlockKey> > order;
+	order.reserve(_blocks.size());
+	for(std::map<BlockKey, Block *>::iterator iter=_blocks.begin(); iter!=_blocks.end(); ++iter)
+	{
+		order.push_back(std::make_pair(iter->second->lastUpdate, iter->first));
+	}
+	std::sort(order.begin(), order.end());
+
+	long target = _maxMemory - _maxMemory/4;
+	int spilled = 0;
+	for(unsigned int i=0; i<order.size() && _memoryUsed > target; ++i)
+	{
+		std::map<BlockKey, Block *>::iterator iter = _blocks.find(order[i].second);
+		Block * block = iter->second;
+		Segment segment;
+		segment.offset = _spillSize;
+		segment.voxels = (int)block->voxels.size();
+		if(fwrite(&block->voxels[0], sizeof(Voxel), block->voxels.size(), _spillFile) != block->voxels.size())
+		{
+			UERROR("Failed to write in the spill file");
+			break;
+		}
+		_spillSize += (long long)segment.voxels*sizeof(Voxel);
+		_spilled[iter->first].push_back(segment);
+		_memoryUsed -= block->memory();
+		delete block;
+		_blocks.erase(iter);
+		++spilled;
+	}
+	UDEBUG("Spilled %d blocks (resident=%d, memory=%ld, spill file=%lld bytes) (%fs)",
+			spilled, (int)_blocks.size(), _memoryUsed, _spillSize, timer.ticks());
+}
+
+std::vector<VoxelAccumulator::BlockKey> VoxelAccumulator::keys() const
+{
+	// union of the resident and spilled blocks, both sorted
+	std::vector<BlockKey> keys;
+	keys.reserve(_blocks.size() + _spilled.size());
+	std::map<BlockKey, Block *>::const_iterator iter = _blocks.begin();
+	std::map<BlockKey, std::vector<Segment> >::const_iterator jter = _spilled.begin();
+	while(iter != _blocks.end() || jter != _spilled.end())
+	{
+		if(jter == _spilled.end() || (iter != _blocks.end() && iter->first < jter->first))
+		{
+			keys.push_back(iter++->first);
+		}
+		else if(iter == _blocks.end() || jter->first < iter->first)
+		{
+			keys.push_back(jter++->first);
+		}
+		else
+		{
+			keys.push_back(iter->first);
+			++iter;
+			++jter;
+		}
+	}
+	return keys;
+}
+
+const std::vector<VoxelAccumulator::Voxel> & VoxelAccumulator::voxels(const BlockKey & key, Block & buffer) const
+{
+	std::map<BlockKey, Block *>::const_iterator iter = _blocks.find(key);
+	std::map<BlockKey, std::vector<Segment> >::const_iterator jter = _spilled.find(key);
+	if(jter == _spilled.end())
+	{
+		UASSERT(iter != _blocks.end());
+		return iter->second->voxels;
+	}
+
+	// merge the parts of the block
+	buffer.reset();
+	std::vector<Voxel> part;
+	for(unsigned int i=0; i<jter->second.size(); ++i)
+	{
+		const Segment & segment = jter->second[i];
+		part.resize(segment.voxels);
+		if(!seekSpillFile(_spillFile, segment.offset) ||
+			fread(&part[0], sizeof(Voxel), part.size(), _spillFile) != part.size())
+		{
+			UERROR("Failed to read the spill file (offset=%lld, voxels=%d)", segment.offset, segment.voxels);
+			continue;
+		}
+		for(unsigned int j=0; j<part.size(); ++j)
+		{
+			buffer.merge(part[j]);
+		}
+	}
+	if(iter != _blocks.end())
+	{
+		for(unsigned int j=0; j<iter->second->voxels.size(); ++j)
+		{
+			buffer.merge(iter->second->voxels[j]);
+		}
+	}
+	return buffer.voxels;
+}
+
+} // namespace util3d
+} // namespace rtabmap
@@ -26,6 +26,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include <rtabmap/core/EpipolarGeometry.h>
+#include <rtabmap/core/OccupancyGrid.h>
 #include <rtabmap/utilite/UMath.h>
 #include <rtabmap/utilite/UStl.h>
 #include <rtabmap/utilite/ULogger.h>
@@ -51,6 +52,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/utilite/UTimer.h"
 #include "rtabmap/core/util3d.h"
 #include "rtabmap/core/Signature.h"
+#include "DepthKernels.h"
 
 #include <pcl/filters/random_sample.h>
 
@@ -294,7 +296,7 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr generateKeypoints3DDepth(
 
 			if(!transform.isNull() && !transform.isIdentity())
 			{
-				pt = pcl::transformPoint(pt, transform.toEigen3f());
+				transform.transformPoint(pt.x, pt.y, pt.z);
 			}
 			keypoints3d->at(i) = pt;
 		}
@@ -326,7 +328,7 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr generateKeypoints3DDisparity(
 
 		if(pcl::isFinite(pt) && !transform.isNull() && !transform.isIdentity())
 		{
-			pt = pcl::transformPoint(pt, transform.toEigen3f());
+			transform.transformPoint(pt.x, pt.y, pt.z);
 		}
 		keypoints3d->at(i) = pt;
 	}
@@ -393,7 +395,7 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr generateKeypoints3DStereo(
 					pt = tmpPt;
 					if(!transform.isNull() && !transform.isIdentity())
 					{
-						pt = pcl::transformPoint(pt, transform.toEigen3f());
+						transform.transformPoint(pt.x, pt.y, pt.z);
 					}
 				}
 			}
@@ -408,9 +410,11 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr generateKeypoints3DStereo(
 // return 3D points in ref referential
 // If cameraTransform is not null, it will be used for triangulation instead of the camera transform computed by epipolar geometry
 // when refGuess3D is passed and cameraTransform is null, scale will be estimated, returning scaled cloud and camera transform
-std::multimap<int, pcl::PointXYZ> generateWords3DMono(
-		const std::multimap<int, cv::KeyPoint> & refWords,
-		const std::multimap<int, cv::KeyPoint> & nextWords,
+// Words are std::multimap or FlatWords
+template<typename Words, typename Words3>
+static std::multimap<int, pcl::PointXYZ> generateWords3DMonoImpl(
+		const Words & refWords,
+		const Words & nextWords,
 		float fx,
 		float fy,
 		float cx,
@@ -422,7 +426,7 @@ std::multimap<int, pcl::PointXYZ> generateWords3DMono(
 		int pnpFlags,
 		float ransacParam1,
 		float ransacParam2,
-		const std::multimap<int, pcl::PointXYZ> & refGuess3D,
+		const Words3 & refGuess3D,
 		double * varianceOut)
 {
 	std::multimap<int, pcl::PointXYZ> words3D;
@@ -684,6 +688,69 @@ std::multimap<int, pcl::PointXYZ> generateWords3DMono(
 	return words3D;
 }
 
+std::multimap<int, pcl::PointXYZ> generateWords3DMono(
+		const std::multimap<int, cv::KeyPoint> & refWords,
+		const std::multimap<int, cv::KeyPoint> & nextWords,
+		float fx,
+		float fy,
+		float cx,
+		float cy,
+		const Transform & localTransform,
+		Transform & cameraTransform,
+		int pnpIterations,
+		float pnpReprojError,
+		int pnpFlags,
+		float ransacParam1,
+		float ransacParam2,
+		const std::multimap<int, pcl::PointXYZ> & refGuess3D,
+		double * varianceOut)
+{
+	return generateWords3DMonoImpl(refWords, nextWords, fx, fy, cx, cy, localTransform, cameraTransform,
+			pnpIterations, pnpReprojError, pnpFlags, ransacParam1, ransacParam2, refGuess3D, varianceOut);
+}
+
+std::multimap<int, pcl::PointXYZ> generateWords3DMono(
+		const FlatWords<cv::KeyPoint> & refWords,
+		const FlatWords<cv::KeyPoint> & nextWords,
+		float fx,
+		float fy,
+		float cx,
+		float cy,
+		const Transform & localTransform,
+		Transform & cameraTransform,
+		int pnpIterations,
+		float pnpReprojError,
+		int pnpFlags,
+		float ransacParam1,
+		float ransacParam2,
+		const std::multimap<int, pcl::PointXYZ> & refGuess3D,
+		double * varianceOut)
+{
+	return generateWords3DMonoImpl(refWords, nextWords, fx, fy, cx, cy, localTransform, cameraTransform,
+			pnpIterations, pnpReprojError, pnpFlags, ransacParam1, ransacParam2, refGuess3D, varianceOut);
+}
+
+std::multimap<int, pcl::PointXYZ> generateWords3DMono(
+		const FlatWords<cv::KeyPoint> & refWords,
+		const FlatWords<cv::KeyPoint> & nextWords,
+		float fx,
+		float fy,
+		float cx,
+		float cy,
+		const Transform & localTransform,
+		Transform & cameraTransform,
+		int pnpIterations,
+		float pnpReprojError,
+		int pnpFlags,
+		float ransacParam1,
+		float ransacParam2,
+		const FlatWords<pcl::PointXYZ> & refGuess3D,
+		double * varianceOut)
+{
+	return generateWords3DMonoImpl(refWords, nextWords, fx, fy, cx, cy, localTransform, cameraTransform,
+			pnpIterations, pnpReprojError, pnpFlags, ransacParam1, ransacParam2, refGuess3D, varianceOut);
+}
+
 std::multimap<int, cv::KeyPoint> aggregate(
 		const std::list<int> & wordIds,
 		const std::vector<cv::KeyPoint> & keypoints)
@@ -732,37 +799,46 @@ std::list<std::pair<cv::Point2f, cv::Point2f> > findCorrespondences(
 	return correspondences;
 }
 
-void findCorrespondences(
-		const std::multimap<int, pcl::PointXYZ> & words1,
-		const std::multimap<int, pcl::PointXYZ> & words2,
+// Words are std::multimap or FlatWords, both sorted by id
+template<typename Words1, typename Words2>
+static void findCorrespondencesImpl(
+		const Words1 & words1,
+		const Words2 & words2,
 		pcl::PointCloud<pcl::PointXYZ> & inliers1,
 		pcl::PointCloud<pcl::PointXYZ> & inliers2,
 		float maxDepth,
 		std::set<int> * uniqueCorrespondences)
 {
-	std::list<int> ids = uUniqueKeys(words1);
 	// Find pairs
-	inliers1.resize(ids.size());
-	inliers2.resize(ids.size());
+	inliers1.resize(words1.size());
+	inliers2.resize(words1.size());
 
 	int oi=0;
-	for(std::list<int>::iterator iter=ids.begin(); iter!=ids.end(); ++iter)
+	typename Words1::const_iterator iter=words1.begin();
+	while(iter!=words1.end())
 	{
-		if(words1.count(*iter) == 1 && words2.count(*iter) == 1)
+		int id = iter->first;
+		inliers1[oi] = iter->second;
+		int count1 = 0;
+		for(; iter!=words1.end() && iter->first == id; ++iter)
 		{
-			inliers1[oi] = words1.find(*iter)->second;
-			inliers2[oi] = words2.find(*iter)->second;
+			++count1;
+		}
+		typename Words2::const_iterator jter = words2.find(id);
+		if(count1 == 1 && jter != words2.end() && words2.count(id) == 1)
+		{
+			inliers2[oi] = jter->second;
 			if(pcl::isFinite(inliers1[oi]) &&
 			   pcl::isFinite(inliers2[oi]) &&
 			   (inliers1[oi].x != 0 || inliers1[oi].y != 0 || inliers1[oi].z != 0) &&
 			   (inliers2[oi].x != 0 || inliers2[oi].y != 0 || inliers2[oi].z != 0) &&
 			   (maxDepth <= 0 || (inliers1[oi].x > 0 && inliers1[oi].x <= maxDepth && inliers2[oi].x>0 &&inliers2[oi].x<=maxDepth)))
 			{
-				++oi;
 				if(uniqueCorrespondences)
 				{
-					uniqueCorrespondences->insert(*iter);
+					uniqueCorrespondences->insert(id);
 				}
+				++oi;
 			}
 		}
 	}
@@ -770,6 +846,39 @@ void findCorrespondences(
 	inliers2.resize(oi);
 }
 
+void findCorrespondences(
+		const std::multimap<int, pcl::PointXYZ> & words1,
+		const std::multimap<int, pcl::PointXYZ> & words2,
+		pcl::PointCloud<pcl::PointXYZ> & inliers1,
+		pcl::PointCloud<pcl::PointXYZ> & inliers2,
+		float maxDepth,
+		std::set<int> * uniqueCorrespondences)
+{
+	findCorrespondencesImpl(words1, words2, inliers1, inliers2, maxDepth, uniqueCorrespondences);
+}
+
+void findCorrespondences(
+		const std::multimap<int, pcl::PointXYZ> & words1,
+		const FlatWords<pcl::PointXYZ> & words2,
+		pcl::PointCloud<pcl::PointXYZ> & inliers1,
+		pcl::PointCloud<pcl::PointXYZ> & inliers2,
+		float maxDepth,
+		std::set<int> * uniqueCorrespondences)
+{
+	findCorrespondencesImpl(words1, words2, inliers1, inliers2, maxDepth, uniqueCorrespondences);
+}
+
+void findCorrespondences(
+		const FlatWords<pcl::PointXYZ> & words1,
+		const FlatWords<pcl::PointXYZ> & words2,
+		pcl::PointCloud<pcl::PointXYZ> & inliers1,
+		pcl::PointCloud<pcl::PointXYZ> & inliers2,
+		float maxDepth,
+		std::set<int> * uniqueCorrespondences)
+{
+	findCorrespondencesImpl(words1, words2, inliers1, inliers2, maxDepth, uniqueCorrespondences);
+}
+
 pcl::PointXYZ projectDepthTo3D(
 		const cv::Mat & depthImage,
 		float x, float y,
@@ -862,11 +971,132 @@ pcl::PointXYZ projectDepthTo3D(
 	return pt;
 }
 
+// Project the rows in x, y and z arrays
+class XYZRowsKernel : public RowsKernel
+{
+public:
+	XYZRowsKernel(const DepthProjector & projector, float * x, float * y, float * z) :
+		_projector(projector),
+		_x(x),
+		_y(y),
+		_z(z)
+	{}
+	virtual int process(int first, int end) const
+	{
+		int count = 0;
+		for(int row=first; row<end; ++row)
+		{
+			int offset = row*_projector.cols();
+			count += _projector.project(row, _x+offset, _y+offset, _z+offset);
+		}
+		return count;
+	}
+private:
+	const DepthProjector & _projector;
+	float * _x;
+	float * _y;
+	float * _z;
+};
+
+static inline void copyRowColors(const cv::Mat &, int, int, pcl::PointXYZ *, int)
+{
+}
+
+static inline void copyRowColors(const cv::Mat & imageRgb, int v, int decimation, pcl::PointXYZRGB * points, int cols)
+{
+	const unsigned char * p = imageRgb.ptr<unsigned char>(v);
+	if(imageRgb.channels() == 3) // BGR
+	{
+		for(int i=0; i<cols; ++i, p+=3*decimation)
+		{
+			points[i].b = p[0];
+			points[i].g = p[1];
+			points[i].r = p[2];
+		}
+	}
+	else // Mono
+	{
+		for(int i=0; i<cols; ++i, p+=decimation)
+		{
+			points[i].b = points[i].g = points[i].r = *p;
+		}
+	}
+}
+
+// Project the rows in an organized cloud, with the colors of imageRgb if PointT has colors
+template<typename PointT>
+class CloudRowsKernel : public RowsKernel
+{
+public:
+	CloudRowsKernel(const DepthProjector & projector, const cv::Mat & imageRgb, int decimation, pcl::PointCloud<PointT> & cloud) :
+		_projector(projector),
+		_imageRgb(imageRgb),
+		_decimation(decimation),
+		_cloud(cloud)
+	{}
+	virtual int process(int first, int end) const
+	{
+		int cols = _projector.cols();
+		std::vector<float> xyz(cols*3);
+		float * x = &xyz[0];
+		float * y = x + cols;
+		float * z = y + cols;
+		int count = 0;
+		for(int row=first; row<end; ++row)
+		{
+			count += _projector.project(row, x, y, z);
+			PointT * points = &_cloud.points[row*cols];
+			for(int i=0; i<cols; ++i)
+			{
+				points[i].x = x[i];
+				points[i].y = y[i];
+				points[i].z = z[i];
+			}
+			copyRowColors(_imageRgb, row*_decimation, _decimation, points, cols);
+		}
+		return count;
+	}
+private:
+	const DepthProjector & _projector;
+	const cv::Mat & _imageRgb;
+	int _decimation;
+	pcl::PointCloud<PointT> & _cloud;
+};
+
+int depthToXYZ(
+		const cv::Mat & imageDepth,
+		float cx, float cy,
+		float fx, float fy,
+		int decimation,
+		float maxDepth,
+		float * x, float * y, float * z,
+		int threads)
+{
+	UASSERT(x && y && z);
+	DepthProjector projector = DepthProjector::fromDepth(imageDepth, cx, cy, fx, fy, decimation, maxDepth);
+	return processRows(XYZRowsKernel(projector, x, y, z), projector.rows(), projector.cols(), threads);
+}
+
+int disparityToXYZ(
+		const cv::Mat & imageDisparity,
+		float cx, float cy,
+		float fx, float baseline,
+		int decimation,
+		float maxDepth,
+		float * x, float * y, float * z,
+		int threads)
+{
+	UASSERT(x && y && z);
+	DepthProjector projector = DepthProjector::fromDisparity(imageDisparity, cx, cy, fx, baseline, decimation, maxDepth);
+	return processRows(XYZRowsKernel(projector, x, y, z), projector.rows(), projector.cols(), threads);
+}
+
 pcl::PointCloud<pcl::PointXYZ>::Ptr cloudFromDepth(
 		const cv::Mat & imageDepth,
 		float cx, float cy,
 		float fx, float fy,
-		int decimation)
+		int decimation,
+		float maxDepth)
 {
 	UASSERT(!imageDepth.empty() && (imageDepth.type() == CV_16UC1 || imageDepth.type() == CV_32FC1));
 	UASSERT(imageDepth.rows % decimation == 0);
@@ -885,21 +1115,8 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr cloudFromDepth(
 
 	cloud->resize(cloud->height * cloud->width);
 
-	int count = 0 ;
-
-	for(int h = 0; h < imageDepth.rows; h+=decimation)
-	{
-		for(int w = 0; w < imageDepth.cols; w+=decimation)
-		{
-			pcl::PointXYZ & pt = cloud->at((h/decimation)*cloud->width + (w/decimation));
-
-			pcl::PointXYZ ptXYZ = projectDepthTo3D(imageDepth, w, h, cx, cy, fx, fy, false);
-			pt.x = ptXYZ.x;
-			pt.y = ptXYZ.y;
-			pt.z = ptXYZ.z;
-			++count;
-		}
-	}
+	DepthProjector projector = DepthProjector::fromDepth(imageDepth, cx, cy, fx, fy, decimation, maxDepth);
+	processRows(CloudRowsKernel<pcl::PointXYZ>(projector, cv::Mat(), decimation, *cloud), projector.rows(), projector.cols());
 
 	return cloud;
 }
@@ -909,7 +1126,8 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudFromDepthRGB(
 		const cv::Mat & imageDepth,
 		float cx, float cy,
 		float fx, float fy,
-		int decimation)
+		int decimation,
+		float maxDepth)
 {
 	UASSERT(imageRgb.rows == imageDepth.rows && imageRgb.cols == imageDepth.cols);
 	UASSERT(!imageDepth.empty() && (imageDepth.type() == CV_16UC1 || imageDepth.type() == CV_32FC1));
@@ -922,16 +1140,8 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudFromDepthRGB(
 		return cloud;
 	}
 
-	bool mono;
-	if(imageRgb.channels() == 3) // BGR
-	{
-		mono = false;
-	}
-	else if(imageRgb.channels() == 1) // Mono
-	{
-		mono = true;
-	}
-	else
+	// BGR or Mono
+	if(imageRgb.depth() != CV_8U || (imageRgb.channels() != 3 && imageRgb.channels() != 1))
 	{
 		return cloud;
 	}
@@ -942,31 +1152,9 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudFromDepthRGB(
 	cloud->is_dense = false;
 	cloud->resize(cloud->height * cloud->width);
 
-	for(int h = 0; h < imageDepth.rows && h/decimation < (int)cloud->height; h+=decimation)
-	{
-		for(int w = 0; w < imageDepth.cols && w/decimation < (int)cloud->width; w+=decimation)
-		{
-			pcl::PointXYZRGB & pt = cloud->at((h/decimation)*cloud->width + (w/decimation));
-			if(!mono)
-			{
-				pt.b = imageRgb.at<cv::Vec3b>(h,w)[0];
-				pt.g = imageRgb.at<cv::Vec3b>(h,w)[1];
-				pt.r = imageRgb.at<cv::Vec3b>(h,w)[2];
-			}
-			else
-			{
-				unsigned char v = imageRgb.at<unsigned char>(h,w);
-				pt.b = v;
-				pt.g = v;
-				pt.r = v;
-			}
+	DepthProjector projector = DepthProjector::fromDepth(imageDepth, cx, cy, fx, fy, decimation, maxDepth);
+	processRows(CloudRowsKernel<pcl::PointXYZRGB>(projector, imageRgb, decimation, *cloud), projector.rows(), projector.cols());
 
-			pcl::PointXYZ ptXYZ = projectDepthTo3D(imageDepth, w, h, cx, cy, fx, fy, false);
-			pt.x = ptXYZ.x;
-			pt.y = ptXYZ.y;
-			pt.z = ptXYZ.z;
-		}
-	}
 	return cloud;
 }
 
@@ -974,14 +1162,15 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr cloudFromDisparity(
 		const cv::Mat & imageDisparity,
 		float cx, float cy,
 		float fx, float baseline,
-		int decimation)
+		int decimation,
+		float maxDepth)
 {
 	UASSERT(imageDisparity.type() == CV_32FC1 || imageDisparity.type()==CV_16SC1);
 	UASSERT(imageDisparity.rows % decimation == 0);
 	UASSERT(imageDisparity.cols % decimation == 0);
 
 	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
-	if(decimation < 1)
+	if(decimation < 1 || imageDisparity.empty())
 	{
 		return cloud;
 	}
@@ -992,28 +1181,9 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr cloudFromDisparity(
 	cloud->is_dense = false;
 	cloud->resize(cloud->height * cloud->width);
 
-	if(imageDisparity.type()==CV_16SC1)
-	{
-		for(int h = 0; h < imageDisparity.rows && h/decimation < (int)cloud->height; h+=decimation)
-		{
-			for(int w = 0; w < imageDisparity.cols && w/decimation < (int)cloud->width; w+=decimation)
-			{
-				float disp = float(imageDisparity.at<short>(h,w))/16.0f;
-				cloud->at((h/decimation)*cloud->width + (w/decimation)) = projectDisparityTo3D(cv::Point2f(w, h), disp, cx, cy, fx, baseline);
-			}
-		}
-	}
-	else
-	{
-		for(int h = 0; h < imageDisparity.rows && h/decimation < (int)cloud->height; h+=decimation)
-		{
-			for(int w = 0; w < imageDisparity.cols && w/decimation < (int)cloud->width; w+=decimation)
-			{
-				float disp = imageDisparity.at<float>(h,w);
-				cloud->at((h/decimation)*cloud->width + (w/decimation)) = projectDisparityTo3D(cv::Point2f(w, h), disp, cx, cy, fx, baseline);
-			}
-		}
-	}
+	DepthProjector projector = DepthProjector::fromDisparity(imageDisparity, cx, cy, fx, baseline, decimation, maxDepth);
+	processRows(CloudRowsKernel<pcl::PointXYZ>(projector, cv::Mat(), decimation, *cloud), projector.rows(), projector.cols());
+
 	return cloud;
 }
 
@@ -1022,7 +1192,8 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudFromDisparityRGB(
 		const cv::Mat & imageDisparity,
 		float cx, float cy,
 		float fx, float baseline,
-		int decimation)
+		int decimation,
+		float maxDepth)
 {
 	UASSERT(imageRgb.rows == imageDisparity.rows &&
 			imageRgb.cols == imageDisparity.cols &&
@@ -1030,21 +1201,13 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudFromDisparityRGB(
 	UASSERT(imageDisparity.rows % decimation == 0);
 	UASSERT(imageDisparity.cols % decimation == 0);
 	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
-	if(decimation < 1)
+	if(decimation < 1 || imageDisparity.empty())
 	{
 		return cloud;
 	}
 
-	bool mono;
-	if(imageRgb.channels() == 3) // BGR
-	{
-		mono = false;
-	}
-	else if(imageRgb.channels() == 1) // Mono
-	{
-		mono = true;
-	}
-	else
+	// BGR or Mono
+	if(imageRgb.depth() != CV_8U || (imageRgb.channels() != 3 && imageRgb.channels() != 1))
 	{
 		return cloud;
 	}
@@ -1055,32 +1218,9 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudFromDisparityRGB(
 	cloud->is_dense = false;
 	cloud->resize(cloud->height * cloud->width);
 
-	for(int h = 0; h < imageRgb.rows && h/decimation < (int)cloud->height; h+=decimation)
-	{
-		for(int w = 0; w < imageRgb.cols && w/decimation < (int)cloud->width; w+=decimation)
-		{
-			pcl::PointXYZRGB & pt = cloud->at((h/decimation)*cloud->width + (w/decimation));
-			if(!mono)
-			{
-				pt.b = imageRgb.at<cv::Vec3b>(h,w)[0];
-				pt.g = imageRgb.at<cv::Vec3b>(h,w)[1];
-				pt.r = imageRgb.at<cv::Vec3b>(h,w)[2];
-			}
-			else
-			{
-				unsigned char v = imageRgb.at<unsigned char>(h,w);
-				pt.b = v;
-				pt.g = v;
-				pt.r = v;
-			}
+	DepthProjector projector = DepthProjector::fromDisparity(imageDisparity, cx, cy, fx, baseline, decimation, maxDepth);
+	processRows(CloudRowsKernel<pcl::PointXYZRGB>(projector, imageRgb, decimation, *cloud), projector.rows(), projector.cols());
 
-			float disp = imageDisparity.type()==CV_16SC1?float(imageDisparity.at<short>(h,w))/16.0f:imageDisparity.at<float>(h,w);
-			pcl::PointXYZ ptXYZ = projectDisparityTo3D(cv::Point2f(w, h), disp, cx, cy, fx, baseline);
-			pt.x = ptXYZ.x;
-			pt.y = ptXYZ.y;
-			pt.z = ptXYZ.z;
-		}
-	}
 	return cloud;
 }
 
@@ -1089,7 +1229,8 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudFromStereoImages(
 		const cv::Mat & imageRight,
 		float cx, float cy,
 		float fx, float baseline,
-		int decimation)
+		int decimation,
+		float maxDepth)
 {
 	UASSERT(imageRight.type() == CV_8UC1);
 
@@ -1107,7 +1248,8 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudFromStereoImages(
 			util3d::disparityFromStereoImages(leftMono, imageRight),
 			cx, cy,
 			fx, baseline,
-			decimation);
+			decimation,
+			maxDepth);
 }
 
 cv::Mat disparityFromStereoImages(
@@ -2362,13 +2504,15 @@ pcl::PointCloud<pcl::PointXYZ>::Ptr getICPReadyCloud(
 			cy,
 			fx,
 			fy,
-			decimation);
+			decimation,
+			maxDepth);
 
 	if(cloud->size())
 	{
 		if(maxDepth>0.0)
 		{
-			cloud = passThrough<pcl::PointXYZ>(cloud, "z", 0, maxDepth);
+			// the points farther than maxDepth are already NaN
+			cloud = removeNaNFromPointCloud<pcl::PointXYZ>(cloud);
 		}
 
 		if(cloud->size())
@@ -2554,6 +2698,7 @@ void occupancy2DFromLaserScan(
  * @param yMin
  * @param minMapSize minimum width (m)
  * @param erode
+ * See OccupancyGrid to keep the map between updates.
  */
 cv::Mat create2DMapFromOccupancyLocalMaps(
 		const std::map<int, Transform> & poses,
@@ -2564,236 +2709,10 @@ cv::Mat create2DMapFromOccupancyLocalMaps(
 		float minMapSize,
 		bool erode)
 {
-	UASSERT(minMapSize >= 0.0f);
 	UDEBUG("cellSize=%f m, minMapSize=%f m, erode=%d", cellSize, minMapSize, erode?1:0);
-	UTimer timer;
-
-	std::map<int, cv::Mat> emptyLocalMaps;
-	std::map<int, cv::Mat> occupiedLocalMaps;
-
-	float minX=-minMapSize/2.0, minY=-minMapSize/2.0, maxX=minMapSize/2.0, maxY=minMapSize/2.0;
-	bool undefinedSize = minMapSize == 0.0f;
-	float x=0.0f,y=0.0f,z=0.0f,roll=0.0f,pitch=0.0f,yaw=0.0f,cosT=0.0f,sinT=0.0f;
-	cv::Mat affineTransform(2,3,CV_32FC1);
-	for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter)
-	{
-		if(uContains(occupancy, iter->first))
-		{
-			UASSERT(!iter->second.isNull());
-			const std::pair<cv::Mat, cv::Mat> & pair = occupancy.at(iter->first);
-
-			iter->second.getTranslationAndEulerAngles(x,y,z,roll,pitch,yaw);
-			cosT = cos(yaw);
-			sinT = sin(yaw);
-			affineTransform.at<float>(0,0) = cosT;
-			affineTransform.at<float>(0,1) = -sinT;
-			affineTransform.at<float>(1,0) = sinT;
-			affineTransform.at<float>(1,1) = cosT;
-			affineTransform.at<float>(0,2) = x;
-			affineTransform.at<float>(1,2) = y;
-
-			if(undefinedSize)
-			{
-				minX = maxX = x;
-				minY = maxY = y;
-				undefinedSize = false;
-			}
-			else
-			{
-				if(minX > x)
-					minX = x;
-				else if(maxX < x)
-					maxX = x;
-
-				if(minY > y)
-					minY = y;
-				else if(maxY < y)
-					maxY = y;
-			}
-
-			//ground
-			if(pair.first.rows)
-			{
-				UASSERT(pair.first.type() == CV_32FC2);
-				cv::Mat ground(pair.first.rows, pair.first.cols, pair.first.type());
-				cv::transform(pair.first, ground, affineTransform);
-				for(int i=0; i<ground.rows; ++i)
-				{
-					if(minX > ground.at<float>(i,0))
-						minX = ground.at<float>(i,0);
-					else if(maxX < ground.at<float>(i,0))
-						maxX = ground.at<float>(i,0);
-
-					if(minY > ground.at<float>(i,1))
-						minY = ground.at<float>(i,1);
-					else if(maxY < ground.at<float>(i,1))
-						maxY = ground.at<float>(i,1);
-				}
-				emptyLocalMaps.insert(std::make_pair(iter->first, ground));
-			}
-
-			//obstacles
-			if(pair.second.rows)
-			{
-				UASSERT(pair.second.type() == CV_32FC2);
-				cv::Mat obstacles(pair.second.rows, pair.second.cols, pair.second.type());
-				cv::transform(pair.second, obstacles, affineTransform);
-				for(int i=0; i<obstacles.rows; ++i)
-				{
-					if(minX > obstacles.at<float>(i,0))
-						minX = obstacles.at<float>(i,0);
-					else if(maxX < obstacles.at<float>(i,0))
-						maxX = obstacles.at<float>(i,0);
-
-					if(minY > obstacles.at<float>(i,1))
-						minY = obstacles.at<float>(i,1);
-					else if(maxY < obstacles.at<float>(i,1))
-						maxY = obstacles.at<float>(i,1);
-				}
-				occupiedLocalMaps.insert(std::make_pair(iter->first, obstacles));
-			}
-		}
-	}
-	UDEBUG("timer=%fs", timer.ticks());
-
-	cv::Mat map;
-	if(minX != maxX && minY != maxY)
-	{
-		//Get map size
-		float margin = cellSize*10.0f;
-		xMin = minX-margin;
-		yMin = minY-margin;
-		float xMax = maxX+margin;
-		float yMax = maxY+margin;
-		if(fabs((yMax - yMin) / cellSize) > 99999 ||
-		   fabs((xMax - xMin) / cellSize) > 99999)
-		{
-			UERROR("Large map size!! map min=(%f, %f) max=(%f,%f). "
-					"There's maybe an error with the poses provided! The map will not be created!",
-					xMin, yMin, xMax, yMax);
-		}
-		else
-		{
-			UDEBUG("map min=(%f, %f) max=(%f,%f)", xMin, yMin, xMax, yMax);
-
-
-			map = cv::Mat::ones((yMax - yMin) / cellSize + 0.5f, (xMax - xMin) / cellSize + 0.5f, CV_8S)*-1;
-			for(std::map<int, Transform>::const_iterator kter = poses.begin(); kter!=poses.end(); ++kter)
-			{
-				std::map<int, cv::Mat >::iterator iter = emptyLocalMaps.find(kter->first);
-				std::map<int, cv::Mat >::iterator jter = occupiedLocalMaps.find(kter->first);
-				if(iter!=emptyLocalMaps.end())
-				{
-					for(int i=0; i<iter->second.rows; ++i)
-					{
-						cv::Point2i pt((iter->second.at<float>(i,0)-xMin)/cellSize + 0.5f, (iter->second.at<float>(i,1)-yMin)/cellSize + 0.5f);
-						map.at<char>(pt.y, pt.x) = 0; // free space
-					}
-				}
-				if(jter!=occupiedLocalMaps.end())
-				{
-					for(int i=0; i<jter->second.rows; ++i)
-					{
-						cv::Point2i pt((jter->second.at<float>(i,0)-xMin)/cellSize + 0.5f, (jter->second.at<float>(i,1)-yMin)/cellSize + 0.5f);
-						map.at<char>(pt.y, pt.x) = 100; // obstacles
-					}
-				}
-
-				//UDEBUG("empty=%d occupied=%d", empty, occupied);
-			}
-
-			// fill holes and remove empty from obstacle borders
-			cv::Mat updatedMap = map.clone();
-			std::list<std::pair<int, int> > obstacleIndices;
-			for(int i=2; i<map.rows-2; ++i)
-			{
-				for(int j=2; j<map.cols-2; ++j)
-				{
-					if(map.at<char>(i, j) == -1 &&
-						map.at<char>(i+1, j) != -1 &&
-						map.at<char>(i-1, j) != -1 &&
-						map.at<char>(i, j+1) != -1 &&
-						map.at<char>(i, j-1) != -1)
-					{
-						updatedMap.at<char>(i, j) = 0;
-					}
-					else if(map.at<char>(i, j) == 100)
-					{
-						// obstacle/empty/unknown -> remove empty
-						// unknown/empty/obstacle -> remove empty
-						if(map.at<char>(i-1, j) == 0 &&
-							map.at<char>(i-2, j) == -1)
-						{
-							updatedMap.at<char>(i-1, j) = -1;
-						}
-						else if(map.at<char>(i+1, j) == 0 &&
-								map.at<char>(i+2, j) == -1)
-						{
-							updatedMap.at<char>(i+1, j) = -1;
-						}
-						if(map.at<char>(i, j-1) == 0 &&
-							map.at<char>(i, j-2) == -1)
-						{
-							updatedMap.at<char>(i, j-1) = -1;
-						}
-						else if(map.at<char>(i, j+1) == 0 &&
-								map.at<char>(i, j+2) == -1)
-						{
-							updatedMap.at<char>(i, j+1) = -1;
-						}
-
-						if(erode)
-						{
-							obstacleIndices.push_back(std::make_pair(i, j));
-						}
-					}
-					else if(map.at<char>(i, j) == 0)
-					{
-						// obstacle/empty/obstacle -> remove empty
-						if(map.at<char>(i-1, j) == 100 &&
-							map.at<char>(i+1, j) == 100)
-						{
-							updatedMap.at<char>(i, j) = -1;
-						}
-						else if(map.at<char>(i, j-1) == 100 &&
-							map.at<char>(i, j+1) == 100)
-						{
-							updatedMap.at<char>(i, j) = -1;
-						}
-					}
-
-				}
-			}
-			map = updatedMap;
-
-			if(erode)
-			{
-				// remove obstacles which touch to empty cells but not unknown cells
-				cv::Mat erodedMap = map.clone();
-				for(std::list<std::pair<int,int> >::iterator iter = obstacleIndices.begin();
-					iter!= obstacleIndices.end();
-					++iter)
-				{
-					int i = iter->first;
-					int j = iter->second;
-					bool touchEmpty = map.at<char>(i+1, j) == 0 ||
-						map.at<char>(i-1, j) == 0 ||
-						map.at<char>(i, j+1) == 0 ||
-						map.at<char>(i, j-1) == 0;
-					if(touchEmpty && map.at<char>(i+1, j) != -1 &&
-						map.at<char>(i-1, j) != -1 &&
-						map.at<char>(i, j+1) != -1 &&
-						map.at<char>(i, j-1) != -1)
-					{
-						erodedMap.at<char>(i, j) = 0; // empty
-					}
-				}
-				map = erodedMap;
-			}
-		}
-	}
-	UDEBUG("timer=%fs", timer.ticks());
-	return map;
+	OccupancyGrid grid(cellSize, 0.0f, 0.0f);
+	grid.update(poses, occupancy);
+	return grid.getMap(xMin, yMin, minMapSize, erode);
 }
 
 /**
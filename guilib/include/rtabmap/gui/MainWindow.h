@@ -36,6 +36,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/RtabmapEvent.h"
 #include "rtabmap/core/SensorData.h"
 #include "rtabmap/core/OdometryInfo.h"
+#include "rtabmap/core/OccupancyGrid.h"
 #include "rtabmap/gui/PreferencesDialog.h"
 
 #include <pcl/point_cloud.h>
@@ -67,6 +68,7 @@ class TwistGridWidget;
 class ExportCloudsDialog;
 class PostProcessingDialog;
 class DataRecorder;
+class MapAssemblerProgress;
 
 class RTABMAPGUI_EXP MainWindow : public QMainWindow, public UEventsHandler
 {
@@ -245,6 +247,9 @@ private:
 			int regenerateDecimation,
 			float regenerateVoxelSize,
 			float regenerateMaxDepth) const;
+	std::map<int, const Signature *> getCachedSignatures(
+			const std::map<int, Transform> & poses,
+			MapAssemblerProgress & progress) const;
 
 	bool getExportedScans(std::map<int, pcl::PointCloud<pcl::PointXYZ>::Ptr > & scans);
 	bool getExportedClouds(std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr> & clouds, std::map<int, pcl::PolygonMesh::Ptr> & meshes, bool toSave);
@@ -286,10 +291,19 @@ private:
 	std::map<int, Transform> _currentPosesMap; // <nodeId, pose>
 	std::multimap<int, Link> _currentLinksMap; // <nodeFromId, link>
 	std::map<int, int> _currentMapIds;   // <nodeId, mapId>
+	// Last map downloaded, updated with the map deltas
+	int _downloadedMapRevision; // 0 if the next download is the whole map
+	int _downloadedMapType; // optimized*2+global
+	int _downloadedMapRequestedType;
+	std::map<int, Transform> _downloadedMapPoses;
+	std::multimap<int, Link> _downloadedMapLinks;
+	std::map<int, int> _downloadedMapIds;
 	std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr > _createdClouds;
 	std::map<int, pcl::PointCloud<pcl::PointXYZ>::Ptr > _createdScans;
 	std::map<int, std::pair<cv::Mat, cv::Mat> > _projectionLocalMaps; // <ground, obstacles>
 	std::map<int, std::pair<cv::Mat, cv::Mat> > _gridLocalMaps; // <ground, obstacles>
+	rtabmap::OccupancyGrid _occupancyGrid; // from _projectionLocalMaps or _gridLocalMaps
+	bool _occupancyGridFrom3DCloud;
 	Transform _odometryCorrection;
 	Transform _lastOdomPose;
 	bool _processingOdometry;
@@ -52,6 +52,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/Signature.h"
 #include "rtabmap/core/Features2d.h"
 #include "rtabmap/core/Compression.h"
+#include "rtabmap/core/DecompressionService.h"
 #include "rtabmap/core/Graph.h"
 #include "rtabmap/gui/DataRecorder.h"
 #include "rtabmap/core/SensorData.h"
@@ -749,15 +750,27 @@ void DatabaseViewer::extractImages()
 	QString path = QFileDialog::getExistingDirectory(this, tr("Select directory where to save images..."), QDir::homePath());
 	if(!path.isNull())
 	{
-		for(int i=0; i<ids_.size(); i+=1)
+		// images decoded in advance while the previous ones are saved
+		DecompressionService & decompression = DecompressionService::instance();
+		std::list<DecompressionFuture> images;
+		int i=0;
+		while(i<ids_.size() || images.size())
 		{
-			int id = ids_.at(i);
-			cv::Mat compressedRgb = memory_->getImageCompressed(id);
-			if(!compressedRgb.empty())
+			while(i<ids_.size() && (int)images.size() < decompression.threads()*2)
 			{
-				cv::Mat imageMat = rtabmap::uncompressImage(compressedRgb);
-				cv::imwrite(QString("%1/%2.png").arg(path).arg(id).toStdString(), imageMat);
+				int id = ids_.at(i++);
+				cv::Mat compressedRgb = memory_->getImageCompressed(id);
+				if(!compressedRgb.empty())
+				{
+					images.push_back(decompression.decompress(compressedRgb, cv::Mat(), cv::Mat(), id));
+				}
+			}
+			if(images.size())
+			{
+				int id = images.front().id();
+				cv::imwrite(QString("%1/%2.png").arg(path).arg(id).toStdString(), images.front().image());
 				UINFO(QString("Saved %1/%2.png").arg(path).arg(id).toStdString().c_str());
+				images.pop_front();
 			}
 		}
 	}
@@ -1419,7 +1432,7 @@ void DatabaseViewer::update(int value,
 
 				if(data.getWords().size())
 				{
-					view->setFeatures(data.getWords());
+					view->setFeatures(data.getWords().toMultimap());
 				}
 
 				Transform odomPose;
@@ -2021,14 +2034,14 @@ void DatabaseViewer::updateConstraintView(
 					cloudFrom->resize(sFrom->getWords3().size());
 					cloudTo->resize(sTo->getWords3().size());
 					int i=0;
-					for(std::multimap<int, pcl::PointXYZ>::const_iterator iter=sFrom->getWords3().begin();
+					for(FlatWords<pcl::PointXYZ>::const_iterator iter=sFrom->getWords3().begin();
 						iter!=sFrom->getWords3().end();
 						++iter)
 					{
 						cloudFrom->at(i++) = iter->second;
 					}
 					i=0;
-					for(std::multimap<int, pcl::PointXYZ>::const_iterator iter=sTo->getWords3().begin();
+					for(FlatWords<pcl::PointXYZ>::const_iterator iter=sTo->getWords3().begin();
 						iter!=sTo->getWords3().end();
 						++iter)
 					{
@@ -2490,8 +2503,10 @@ void DatabaseViewer::refineConstraint(int from, int to, bool updateGraph)
 	if(ui_->checkBox_icp_2d->isChecked())
 	{
 		//2D
-		cv::Mat oldLaserScan = rtabmap::uncompressData(dataFrom.getLaserScanCompressed());
-		cv::Mat newLaserScan = rtabmap::uncompressData(dataTo.getLaserScanCompressed());
+		DecompressionFuture scanFrom = DecompressionService::instance().decompress(cv::Mat(), cv::Mat(), dataFrom.getLaserScanCompressed());
+		DecompressionFuture scanTo = DecompressionService::instance().decompress(cv::Mat(), cv::Mat(), dataTo.getLaserScanCompressed());
+		cv::Mat oldLaserScan = scanFrom.laserScan();
+		cv::Mat newLaserScan = scanTo.laserScan();
 
 		if(!oldLaserScan.empty() && !newLaserScan.empty())
 		{
@@ -2521,8 +2536,10 @@ void DatabaseViewer::refineConstraint(int from, int to, bool updateGraph)
 	else
 	{
 		//3D
-		cv::Mat depthA = rtabmap::uncompressImage(dataFrom.getDepthCompressed());
-		cv::Mat depthB = rtabmap::uncompressImage(dataTo.getDepthCompressed());
+		DecompressionFuture depthFrom = DecompressionService::instance().decompress(cv::Mat(), dataFrom.getDepthCompressed());
+		DecompressionFuture depthTo = DecompressionService::instance().decompress(cv::Mat(), dataTo.getDepthCompressed());
+		cv::Mat depthA = depthFrom.depth();
+		cv::Mat depthB = depthTo.depth();
 
 		if(depthA.type() == CV_8UC1)
 		{
@@ -2830,8 +2847,8 @@ bool DatabaseViewer::addConstraint(int from, int to, bool silent, bool updateGra
 
 			if(!silent)
 			{
-				ui_->graphicsView_A->setFeatures(tmpMemory.getSignature(from)->getWords());
-				ui_->graphicsView_B->setFeatures(tmpMemory.getSignature(to)->getWords());
+				ui_->graphicsView_A->setFeatures(tmpMemory.getSignature(from)->getWords().toMultimap());
+				ui_->graphicsView_B->setFeatures(tmpMemory.getSignature(to)->getWords().toMultimap());
 				updateWordsMatching();
 			}
 		}
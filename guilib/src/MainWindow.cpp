@@ -85,6 +85,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "rtabmap/core/OdometryEvent.h"
 #include "rtabmap/core/util3d.h"
 #include "rtabmap/core/Graph.h"
+#include "rtabmap/core/MapAssembler.h"
 #include <pcl/visualization/cloud_viewer.h>
 #include <pcl/common/transforms.h>
 #include <pcl/common/common.h>
@@ -106,6 +107,46 @@ inline static void initGuiResource() { Q_INIT_RESOURCE(GuiLib); }
 
 namespace rtabmap {
 
+// Map assembly showing the progress of each node in the progress dialog
+class MapAssemblerProgress : public MapAssembler
+{
+public:
+	MapAssemblerProgress(DetailedProgressDialog * dialog, int total) :
+		MapAssembler(std::max(1, QThread::idealThreadCount())),
+		_dialog(dialog),
+		_index(0),
+		_total(total)
+	{}
+	void nodeGenerated(int id)
+	{
+		_dialog->appendText(QObject::tr("Generated cloud %1 (%2/%3).").arg(id).arg(++_index).arg(_total));
+		_dialog->incrementStep();
+		QApplication::processEvents();
+	}
+	void nodeIgnored(int id)
+	{
+		_dialog->appendText(QObject::tr("Ignored cloud %1 (%2/%3).").arg(id).arg(++_index).arg(_total));
+		_dialog->incrementStep();
+		QApplication::processEvents();
+	}
+protected:
+	virtual void nodeProcessed(int id, const pcl::PointCloud<pcl::PointXYZRGB> & cloud, int, int)
+	{
+		if(cloud.size())
+		{
+			this->nodeGenerated(id);
+		}
+		else
+		{
+			this->nodeIgnored(id);
+		}
+	}
+private:
+	DetailedProgressDialog * _dialog;
+	int _index;
+	int _total;
+};
+
 MainWindow::MainWindow(PreferencesDialog * prefDialog, QWidget * parent) :
 	QMainWindow(parent),
 	_ui(0),
@@ -127,6 +168,10 @@ MainWindow::MainWindow(PreferencesDialog * prefDialog, QWidget * parent) :
 	_databaseUpdated(false),
 	_odomImageShow(true),
 	_odomImageDepthShow(false),
+	_downloadedMapRevision(0),
+	_downloadedMapType(-1),
+	_downloadedMapRequestedType(-1),
+	_occupancyGridFrom3DCloud(false),
 	_odometryCorrection(Transform::getIdentity()),
 	_processingOdometry(false),
 	_lastOdomInfoUpdateTime(0),
@@ -1105,7 +1150,7 @@ void MainWindow::processStats(const rtabmap::Statistics & stat)
 		UDEBUG("time= %d ms", time.restart());
 
 		// do it after scaling
-		this->drawKeypoints(signature.getWords(), loopSignature.getWords());
+		this->drawKeypoints(signature.getWords().toMultimap(), loopSignature.getWords().toMultimap());
 
 		UDEBUG("time= %d ms", time.restart());
 
@@ -1476,25 +1521,21 @@ void MainWindow::updateMapCloud(
 		float xMin, yMin;
 		float resolution = _preferencesDialog->getGridMapResolution();
 		cv::Mat map8S;
+		if(_occupancyGridFrom3DCloud != _preferencesDialog->isGridMapFrom3DCloud())
+		{
+			_occupancyGrid.clear();
+			_occupancyGridFrom3DCloud = _preferencesDialog->isGridMapFrom3DCloud();
+		}
+		_occupancyGrid.setCellSize(resolution);
 		if(_preferencesDialog->isGridMapFrom3DCloud())
 		{
-			map8S = util3d::create2DMapFromOccupancyLocalMaps(
-					poses,
-					_projectionLocalMaps,
-					resolution,
-					xMin, yMin,
-					0,
-					_preferencesDialog->isGridMapEroded());
+			_occupancyGrid.update(poses, _projectionLocalMaps);
+			map8S = _occupancyGrid.getMap(xMin, yMin, 0, _preferencesDialog->isGridMapEroded());
 		}
 		else if(_gridLocalMaps.size())
 		{
-			map8S = util3d::create2DMapFromOccupancyLocalMaps(
-					poses,
-					_gridLocalMaps,
-					resolution,
-					xMin, yMin,
-					0,
-					_preferencesDialog->isGridMapEroded());
+			_occupancyGrid.update(poses, _gridLocalMaps);
+			map8S = _occupancyGrid.getMap(xMin, yMin, 0, _preferencesDialog->isGridMapEroded());
 		}
 		if(!map8S.empty())
 		{
@@ -1681,7 +1722,7 @@ void MainWindow::createAndAddCloudToMap(int nodeId, const Transform & pose, int
 		pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
 		cloud->resize(iter->getWords3().size());
 		int oi=0;
-		for(std::multimap<int, pcl::PointXYZ>::const_iterator jter=iter->getWords3().begin(); jter!=iter->getWords3().end(); ++jter)
+		for(FlatWords<pcl::PointXYZ>::const_iterator jter=iter->getWords3().begin(); jter!=iter->getWords3().end(); ++jter)
 		{
 			(*cloud)[oi].x = jter->second.x;
 			(*cloud)[oi].y = jter->second.y;
@@ -1924,6 +1965,9 @@ void MainWindow::processRtabmapEvent3DMap(const rtabmap::RtabmapEvent3DMap & eve
 		UINFO(" poses = %d", event.getPoses().size());
 		UINFO(" constraints = %d", event.getConstraints().size());
 
+		UINFO(" revision = %d (base=%d, linked=%d, removed=%d)",
+				event.getRevision(), event.getBaseRevision(), (int)event.getLinkedIds().size(), (int)event.getRemovedIds().size());
+
 		_initProgressDialog->setMaximumSteps(int(event.getSignatures().size()+event.getPoses().size()+1));
 		_initProgressDialog->appendText(QString("Inserting data in the cache (%1 signatures downloaded)...").arg(event.getSignatures().size()));
 		QApplication::processEvents();
@@ -1938,6 +1982,10 @@ void MainWindow::processRtabmapEvent3DMap(const rtabmap::RtabmapEvent3DMap & eve
 				_cachedSignatures.insert(iter->first, iter->second);
 				++addedSignatures;
 			}
+			else if(event.isDelta())
+			{
+				_cachedSignatures.insert(iter->first, iter->second); // data modified
+			}
 			_initProgressDialog->incrementStep();
 			QApplication::processEvents();
 		}
@@ -1947,7 +1995,65 @@ void MainWindow::processRtabmapEvent3DMap(const rtabmap::RtabmapEvent3DMap & eve
 
 		_initProgressDialog->appendText("Inserting data in the cache... done.");
 
-		if(event.getPoses().size())
+		if(event.isDelta() && event.getBaseRevision() == _downloadedMapRevision && _downloadedMapType == _downloadedMapRequestedType)
+		{
+			// Apply the changes on the last map downloaded
+			for(std::set<int>::const_iterator iter=event.getRemovedIds().begin(); iter!=event.getRemovedIds().end(); ++iter)
+			{
+				_downloadedMapPoses.erase(*iter);
+				_downloadedMapIds.erase(*iter);
+			}
+			for(std::multimap<int, Link>::iterator iter=_downloadedMapLinks.begin(); iter!=_downloadedMapLinks.end();)
+			{
+				if(event.getLinkedIds().find(iter->second.from()) != event.getLinkedIds().end() ||
+				   event.getLinkedIds().find(iter->second.to()) != event.getLinkedIds().end() ||
+				   event.getRemovedIds().find(iter->second.from()) != event.getRemovedIds().end() ||
+				   event.getRemovedIds().find(iter->second.to()) != event.getRemovedIds().end())
+				{
+					_downloadedMapLinks.erase(iter++);
+				}
+				else
+				{
+					++iter;
+				}
+			}
+			_downloadedMapLinks.insert(event.getConstraints().begin(), event.getConstraints().end());
+			for(std::map<int, Transform>::const_iterator iter=event.getPoses().begin(); iter!=event.getPoses().end(); ++iter)
+			{
+				_downloadedMapPoses[iter->first] = iter->second;
+			}
+			for(std::map<int, int>::const_iterator iter=event.getMapIds().begin(); iter!=event.getMapIds().end(); ++iter)
+			{
+				_downloadedMapIds[iter->first] = iter->second;
+			}
+			_downloadedMapRevision = event.getRevision();
+			_initProgressDialog->appendText(tr("Map updated from revision %1 to %2 (%3 nodes moved, %4 removed).")
+					.arg(event.getBaseRevision()).arg(event.getRevision()).arg(event.getPoses().size()).arg(event.getRemovedIds().size()));
+		}
+		else if(event.isDelta())
+		{
+			UWARN("Map delta from revision %d received but the last map downloaded is at revision %d, the whole map will be downloaded next time.",
+					event.getBaseRevision(), _downloadedMapRevision);
+			_downloadedMapRevision = 0;
+		}
+		else
+		{
+			_downloadedMapPoses = event.getPoses();
+			_downloadedMapLinks = event.getConstraints();
+			_downloadedMapIds = event.getMapIds();
+			_downloadedMapRevision = event.getRevision();
+			_downloadedMapType = _downloadedMapRevision>0?_downloadedMapRequestedType:-1;
+		}
+
+		if(event.isDelta() && _downloadedMapRevision)
+		{
+			_initProgressDialog->appendText("Updating the 3D map cloud...");
+			_initProgressDialog->incrementStep();
+			QApplication::processEvents();
+			this->updateMapCloud(_downloadedMapPoses, Transform(), _downloadedMapLinks, _downloadedMapIds, true);
+			_initProgressDialog->appendText("Updating the 3D map cloud... done.");
+		}
+		else if(!event.isDelta() && event.getPoses().size())
 		{
 			_initProgressDialog->appendText("Updating the 3D map cloud...");
 			_initProgressDialog->incrementStep();
@@ -2720,6 +2826,10 @@ void MainWindow::startDetection()
 				{
 					odom = new OdometryMono(parameters);
 				}
+				else if(_preferencesDialog->getOdomStrategy() == 3)
+				{
+					odom = new OdometryF2M(parameters);
+				}
 				else
 				{
 					odom = new OdometryBOW(parameters);
@@ -2757,6 +2867,10 @@ void MainWindow::startDetection()
 			{
 				odom = new OdometryMono(parameters);
 			}
+			else if(_preferencesDialog->getOdomStrategy() == 3)
+			{
+				odom = new OdometryF2M(parameters);
+			}
 			else
 			{
 				odom = new OdometryBOW(parameters);
@@ -3731,14 +3845,22 @@ void MainWindow::downloadAllClouds()
 		_initProgressDialog->show();
 		_initProgressDialog->appendText(tr("Downloading the map (global=%1 ,optimized=%2)...")
 				.arg(global?"true":"false").arg(optimized?"true":"false"));
-		if(global)
-		{
-			this->post(new RtabmapEventCmd(RtabmapEventCmd::kCmdPublish3DMapGlobal, "", optimized?1:0));
-		}
-		else
+
+		// Only the changes since the last download are needed if the
+		// same map was downloaded and its data are still in the cache
+		_downloadedMapRequestedType = (optimized?2:0) + (global?1:0);
+		int revision = 0;
+		if(_downloadedMapRevision > 0 &&
+		   _downloadedMapType == _downloadedMapRequestedType &&
+		   _preferencesDialog->isImagesKept())
 		{
-			this->post(new RtabmapEventCmd(RtabmapEventCmd::kCmdPublish3DMapLocal, "", optimized?1:0));
+			revision = _downloadedMapRevision;
+			_initProgressDialog->appendText(tr("Downloading changes since revision %1...").arg(revision));
 		}
+		ParametersMap parameters;
+		parameters.insert(ParametersPair("optimized", uNumber2Str(optimized?1:0)));
+		parameters.insert(ParametersPair("global", uNumber2Str(global?1:0)));
+		this->post(new RtabmapEventCmd(RtabmapEventCmd::kCmdPublish3DMapDelta, "", revision, parameters));
 	}
 }
 
@@ -3801,6 +3923,7 @@ void MainWindow::clearTheCache()
 	_createdScans.clear();
 	_gridLocalMaps.clear();
 	_projectionLocalMaps.clear();
+	_occupancyGrid.clear();
 	_ui->widget_cloudViewer->removeAllClouds();
 	_ui->widget_cloudViewer->removeAllGraphs();
 	_ui->widget_cloudViewer->setBackgroundColor(_ui->widget_cloudViewer->getDefaultBackgroundColor());
@@ -3809,6 +3932,11 @@ void MainWindow::clearTheCache()
 	_currentPosesMap.clear();
 	_currentLinksMap.clear();
 	_currentMapIds.clear();
+	_downloadedMapRevision = 0;
+	_downloadedMapType = -1;
+	_downloadedMapPoses.clear();
+	_downloadedMapLinks.clear();
+	_downloadedMapIds.clear();
 	_odometryCorrection = Transform::getIdentity();
 	_lastOdomPose.setNull();
 	//disable save cloud action
@@ -4853,7 +4981,8 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr MainWindow::createCloud(
 				depth,
 				cx, cy,
 				fx, fy,
-				decimation);
+				decimation,
+				maxDepth);
 	}
 	else
 	{
@@ -4862,25 +4991,17 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr MainWindow::createCloud(
 				depth,
 				cx, cy,
 				fx, fy,
-				decimation);
+				decimation,
+				maxDepth);
 	}
 
 	if(cloud->size())
 	{
-		bool filtered = false;
-		if(cloud->size() && maxDepth)
-		{
-			cloud = util3d::passThrough<pcl::PointXYZRGB>(cloud, "z", 0, maxDepth);
-			filtered = true;
-		}
-
-		if(cloud->size() && voxelSize)
+		if(voxelSize)
 		{
 			cloud = util3d::voxelize<pcl::PointXYZRGB>(cloud, voxelSize);
-			filtered = true;
 		}
-
-		if(cloud->size() && !filtered)
+		else
 		{
 			cloud = util3d::removeNaNFromPointCloud<pcl::PointXYZRGB>(cloud);
 		}
@@ -4902,102 +5023,27 @@ pcl::PointCloud<pcl::PointXYZRGB>::Ptr MainWindow::getAssembledCloud(
 		float regenerateVoxelSize,
 		float regenerateMaxDepth) const
 {
-	pcl::PointCloud<pcl::PointXYZRGB>::Ptr assembledCloud(new pcl::PointCloud<pcl::PointXYZRGB>);
-	int i=0;
-	int count = 0;
-	for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter)
+	MapAssemblerProgress assembler(_initProgressDialog, (int)poses.size());
+	assembler.setAssembledVoxelSize(assembledVoxelSize);
+	if(regenerateClouds)
 	{
-		bool inserted = false;
-		if(!iter->second.isNull())
-		{
-			pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
-			if(regenerateClouds)
-			{
-				if(_cachedSignatures.contains(iter->first))
-				{
-					const Signature & s = _cachedSignatures.find(iter->first).value();
-					cv::Mat image, depth;
-					s.uncompressDataConst(&image, &depth, 0);
-
-					if(!image.empty() && !depth.empty())
-					{
-						cloud = createCloud(iter->first,
-								image,
-								depth,
-								s.getFx(),
-								s.getFy(),
-								s.getCx(),
-								s.getCy(),
-								s.getLocalTransform(),
-								iter->second,
-								regenerateVoxelSize,
-								regenerateDecimation,
-								regenerateMaxDepth);
-					}
-					else if(s.getWords3().size())
-					{
-						cloud->resize(s.getWords3().size());
-						int oi=0;
-						for(std::multimap<int, pcl::PointXYZ>::const_iterator jter=s.getWords3().begin(); jter!=s.getWords3().end(); ++jter)
-						{
-							(*cloud)[oi].x = jter->second.x;
-							(*cloud)[oi].y = jter->second.y;
-							(*cloud)[oi].z = jter->second.z;
-							(*cloud)[oi].r = 255;
-							(*cloud)[oi].g = 255;
-							(*cloud)[oi++].b = 255;
-						}
-					}
-				}
-				else
-				{
-					UWARN("Cloud %d not found in cache!", iter->first);
-				}
-			}
-			else if(uContains(_createdClouds, iter->first))
-			{
-				cloud = util3d::transformPointCloud<pcl::PointXYZRGB>(_createdClouds.at(iter->first), iter->second);
-			}
-
-			if(cloud->size())
-			{
-				*assembledCloud += *cloud;
-
-				inserted = true;
-				++count;
-			}
-		}
-		else
-		{
-			UERROR("transform is null!?");
-		}
+		assembler.setNodeFilters(regenerateDecimation, regenerateVoxelSize, regenerateMaxDepth);
+		return assembler.assemble(poses, this->getCachedSignatures(poses, assembler));
+	}
 
-		if(inserted)
+	std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr> clouds;
+	for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter)
+	{
+		if(!iter->second.isNull() && uContains(_createdClouds, iter->first))
 		{
-			_initProgressDialog->appendText(tr("Generated cloud %1 (%2/%3).").arg(iter->first).arg(++i).arg(poses.size()));
-
-			if(count % 100 == 0)
-			{
-				if(assembledCloud->size() && assembledVoxelSize)
-				{
-					assembledCloud = util3d::voxelize<pcl::PointXYZRGB>(assembledCloud, assembledVoxelSize);
-				}
-			}
+			clouds.insert(*_createdClouds.find(iter->first));
 		}
 		else
 		{
-			_initProgressDialog->appendText(tr("Ignored cloud %1 (%2/%3).").arg(iter->first).arg(++i).arg(poses.size()));
+			assembler.nodeIgnored(iter->first);
 		}
-		_initProgressDialog->incrementStep();
-		QApplication::processEvents();
 	}
-
-	if(assembledCloud->size() && assembledVoxelSize)
-	{
-		assembledCloud = util3d::voxelize<pcl::PointXYZRGB>(assembledCloud, assembledVoxelSize);
-	}
-
-	return assembledCloud;
+	return assembler.assemble(poses, clouds);
 }
 
 std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr > MainWindow::getClouds(
@@ -5007,85 +5053,52 @@ std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr > MainWindow::getClouds(
 		float regenerateVoxelSize,
 		float regenerateMaxDepth) const
 {
+	MapAssemblerProgress assembler(_initProgressDialog, (int)poses.size());
+	if(regenerateClouds)
+	{
+		assembler.setNodeFilters(regenerateDecimation, regenerateVoxelSize, regenerateMaxDepth);
+		return assembler.createClouds(poses, this->getCachedSignatures(poses, assembler), false);
+	}
+
 	std::map<int, pcl::PointCloud<pcl::PointXYZRGB>::Ptr> clouds;
-	int i=0;
 	for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter)
 	{
-		bool inserted = false;
-		if(!iter->second.isNull())
+		if(!iter->second.isNull() && uContains(_createdClouds, iter->first) && _createdClouds.at(iter->first)->size())
 		{
-			pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
-			if(regenerateClouds)
-			{
-				if(_cachedSignatures.contains(iter->first))
-				{
-					const Signature & s = _cachedSignatures.find(iter->first).value();
-					cv::Mat image, depth;
-					s.uncompressDataConst(&image, &depth, 0);
-					if(!image.empty() && !depth.empty())
-					{
-						cloud =	 createCloud(iter->first,
-							image,
-							depth,
-							s.getFx(),
-							s.getFy(),
-							s.getCx(),
-							s.getCy(),
-							s.getLocalTransform(),
-							Transform::getIdentity(),
-							regenerateVoxelSize,
-							regenerateDecimation,
-							regenerateMaxDepth);
-					}
-					else if(s.getWords3().size())
-					{
-						cloud->resize(s.getWords3().size());
-						int oi=0;
-						for(std::multimap<int, pcl::PointXYZ>::const_iterator jter=s.getWords3().begin(); jter!=s.getWords3().end(); ++jter)
-						{
-							(*cloud)[oi].x = jter->second.x;
-							(*cloud)[oi].y = jter->second.y;
-							(*cloud)[oi].z = jter->second.z;
-							(*cloud)[oi].r = 255;
-							(*cloud)[oi].g = 255;
-							(*cloud)[oi++].b = 255;
-						}
-					}
-				}
-				else
-				{
-					UERROR("Cloud %d not found in cache!", iter->first);
-				}
-			}
-			else if(uContains(_createdClouds, iter->first))
-			{
-				cloud = _createdClouds.at(iter->first);
-			}
-
-			if(cloud->size())
-			{
-				clouds.insert(std::make_pair(iter->first, cloud));
-				inserted = true;
-			}
+			clouds.insert(*_createdClouds.find(iter->first));
+			assembler.nodeGenerated(iter->first);
 		}
 		else
 		{
-			UERROR("transform is null!?");
+			assembler.nodeIgnored(iter->first);
 		}
+	}
+	return clouds;
+}
 
-		if(inserted)
+std::map<int, const Signature *> MainWindow::getCachedSignatures(
+		const std::map<int, Transform> & poses,
+		MapAssemblerProgress & progress) const
+{
+	std::map<int, const Signature *> signatures;
+	for(std::map<int, Transform>::const_iterator iter = poses.begin(); iter!=poses.end(); ++iter)
+	{
+		if(iter->second.isNull())
+		{
+			UERROR("transform is null!?");
+			progress.nodeIgnored(iter->first);
+		}
+		else if(_cachedSignatures.contains(iter->first))
 		{
-			_initProgressDialog->appendText(tr("Generated cloud %1 (%2/%3).").arg(iter->first).arg(++i).arg(poses.size()));
+			signatures.insert(std::make_pair(iter->first, &_cachedSignatures.find(iter->first).value()));
 		}
 		else
 		{
-			_initProgressDialog->appendText(tr("Ignored cloud %1 (%2/%3).").arg(iter->first).arg(++i).arg(poses.size()));
+			UWARN("Cloud %d not found in cache!", iter->first);
+			progress.nodeIgnored(iter->first);
 		}
-		_initProgressDialog->incrementStep();
-		QApplication::processEvents();
 	}
-
-	return clouds;
+	return signatures;
 }
 
 // STATES
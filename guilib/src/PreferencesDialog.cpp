@@ -109,10 +109,10 @@ PreferencesDialog::PreferencesDialog(QWidget * parent) :
 		_ui->checkBox_ORBGpu->setEnabled(false);
 		_ui->label_orbGpu->setEnabled(false);
 
-		// remove BruteForceGPU option
-		_ui->comboBox_dictionary_strategy->removeItem(4);
-		_ui->odom_bin_nn->removeItem(4);
-		_ui->reextract_nn->removeItem(4);
+		// disable BruteForceGPU option (not removed to keep following indexes matching the strategy values)
+		_ui->comboBox_dictionary_strategy->setItemData(4, 0, Qt::UserRole - 1);
+		_ui->odom_bin_nn->setItemData(4, 0, Qt::UserRole - 1);
+		_ui->reextract_nn->setItemData(4, 0, Qt::UserRole - 1);
 	}
 
 #if PCL_VERSION_COMPARE(<, 1, 7, 2)
@@ -1612,11 +1612,11 @@ bool PreferencesDialog::validateForm()
 
 	//verify binary features and nearest neighbor
 	// BOW dictionary type
-	if(_ui->comboBox_dictionary_strategy->currentIndex() == VWDictionary::kNNFlannLSH && _ui->comboBox_detector_strategy->currentIndex() <= 1)
+	if((_ui->comboBox_dictionary_strategy->currentIndex() == VWDictionary::kNNFlannLSH || _ui->comboBox_dictionary_strategy->currentIndex() == VWDictionary::kNNBruteForceHamming) && _ui->comboBox_detector_strategy->currentIndex() <= 1)
 	{
 		QMessageBox::warning(this, tr("Parameter warning"),
 				tr("With the selected feature type (SURF or SIFT), parameter \"Visual word->Nearest Neighbor\" "
-				   "cannot be LSH (used for binary descriptor). KD-tree is set instead for the bag-of-words dictionary."));
+				   "cannot be LSH or Brute Force Hamming (used for binary descriptor). KD-tree is set instead for the bag-of-words dictionary."));
 		_ui->comboBox_dictionary_strategy->setCurrentIndex(VWDictionary::kNNFlannKdTree);
 	}
 	else if(_ui->comboBox_dictionary_strategy->currentIndex() == VWDictionary::kNNFlannKdTree && _ui->comboBox_detector_strategy->currentIndex() >1)
@@ -1628,11 +1628,11 @@ bool PreferencesDialog::validateForm()
 	}
 
 	// BOW Reextract features type
-	if(_ui->reextract_nn->currentIndex() == VWDictionary::kNNFlannLSH && _ui->reextract_type->currentIndex() <= 1)
+	if((_ui->reextract_nn->currentIndex() == VWDictionary::kNNFlannLSH || _ui->reextract_nn->currentIndex() == VWDictionary::kNNBruteForceHamming) && _ui->reextract_type->currentIndex() <= 1)
 	{
 		QMessageBox::warning(this, tr("Parameter warning"),
 				tr("With the selected feature type (SURF or SIFT), parameter \"Visual word->Nearest Neighbor\" "
-				   "cannot be LSH (used for binary descriptor). KD-tree is set instead for the re-extraction "
+				   "cannot be LSH or Brute Force Hamming (used for binary descriptor). KD-tree is set instead for the re-extraction "
 					   "of features on loop closure."));
 		_ui->reextract_nn->setCurrentIndex(VWDictionary::kNNFlannKdTree);
 	}
@@ -1646,11 +1646,11 @@ bool PreferencesDialog::validateForm()
 	}
 
 	// odom type
-	if(_ui->odom_bin_nn->currentIndex() == VWDictionary::kNNFlannLSH && _ui->odom_type->currentIndex() <= 1)
+	if((_ui->odom_bin_nn->currentIndex() == VWDictionary::kNNFlannLSH || _ui->odom_bin_nn->currentIndex() == VWDictionary::kNNBruteForceHamming) && _ui->odom_type->currentIndex() <= 1)
 	{
 		QMessageBox::warning(this, tr("Parameter warning"),
 				tr("With the selected feature type (SURF or SIFT), parameter \"Odometry->Nearest Neighbor\" "
-				   "cannot be LSH (used for binary descriptor). KD-tree is set instead for odometry."));
+				   "cannot be LSH or Brute Force Hamming (used for binary descriptor). KD-tree is set instead for odometry."));
 		_ui->odom_bin_nn->setCurrentIndex(VWDictionary::kNNFlannKdTree);
 	}
 	else if(_ui->odom_bin_nn->currentIndex() == VWDictionary::kNNFlannKdTree && _ui->odom_type->currentIndex() >1)
@@ -3335,6 +3335,10 @@ void PreferencesDialog::testOdometry(int type)
 	{
 		odometry = new OdometryMono(parameters);
 	}
+	else if(this->getOdomStrategy() == 3)
+	{
+		odometry = new OdometryF2M(parameters);
+	}
 	else
 	{
 		odometry = new OdometryBOW(parameters);
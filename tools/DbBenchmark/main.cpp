@@ -0,0 +1,173 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include "DBDriverSqlite3.h"
+#include "VisualWord.h"
+#include "rtabmap/core/Signature.h"
+#include "rtabmap/utilite/ULogger.h"
+#include "rtabmap/utilite/UTimer.h"
+#include "rtabmap/utilite/UFile.h"
+#include "rtabmap/utilite/UConversion.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace rtabmap;
+
+void showUsage()
+{
+	printf("Usage:\n"
+			"dbBenchmark [options] [database.db]\n"
+			"  Save N signatures of M words in a new database, then load them back.\n"
+			"  The database (default \"dbBenchmark.db\") is overwritten.\n"
+			"  Options:\n"
+			"    -n #       Signatures (default 500)\n"
+			"    -m #       Words per signature (default 400)\n"
+			"    -d #       Descriptor size in bytes (default 32)\n"
+			"    -mem       Database in memory (saved on disconnection)\n"
+			"    -debug     Show debug log\n\n");
+	exit(1);
+}
+
+int main(int argc, char * argv[])
+{
+	ULogger::setType(ULogger::kTypeConsole);
+	ULogger::setLevel(ULogger::kWarning);
+
+	int n = 500;
+	int m = 400;
+	int descriptorSize = 32;
+	bool inMemory = false;
+	std::string path = "dbBenchmark.db";
+	for(int i=1; i<argc; ++i)
+	{
+		if(strcmp(argv[i], "-n") == 0 && i+1<argc)
+		{
+			n = std::atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-m") == 0 && i+1<argc)
+		{
+			m = std::atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-d") == 0 && i+1<argc)
+		{
+			descriptorSize = std::atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-mem") == 0)
+		{
+			inMemory = true;
+		}
+		else if(strcmp(argv[i], "-debug") == 0)
+		{
+			ULogger::setLevel(ULogger::kDebug);
+		}
+		else if(i == argc-1 && argv[i][0] != '-')
+		{
+			path = argv[i];
+		}
+		else
+		{
+			printf("Not recognized option: \"%s\"\n", argv[i]);
+			showUsage();
+		}
+	}
+	if(n <= 0 || m <= 0 || descriptorSize <= 0)
+	{
+		showUsage();
+	}
+	printf("Signatures=%d, words/signature=%d, descriptor=%d bytes, database=\"%s\"%s\n",
+			n, m, descriptorSize, path.c_str(), inMemory?" (in memory)":"");
+
+	ParametersMap parameters;
+	parameters.insert(ParametersPair(Parameters::kDbSqlite3InMemory(), uBool2Str(inMemory)));
+	DBDriverSqlite3 driver(parameters);
+	if(!driver.openConnection(path, true))
+	{
+		printf("Cannot open database \"%s\"\n", path.c_str());
+		return 1;
+	}
+
+	// Half of the words of a signature are shared with the previous one
+	UTimer timer;
+	std::list<int> ids;
+	std::set<int> wordIds;
+	int nextWordId = 1;
+	for(int i=1; i<=n; ++i)
+	{
+		std::multimap<int, cv::KeyPoint> words;
+		int firstWordId = nextWordId - (i>1?m/2:0);
+		for(int j=0; j<m; ++j)
+		{
+			int wordId = firstWordId + j;
+			if(wordId == nextWordId)
+			{
+				cv::Mat descriptor(1, descriptorSize, CV_8U);
+				cv::randu(descriptor, cv::Scalar(0), cv::Scalar(255));
+				driver.asyncSave(new VisualWord(wordId, descriptor));
+				wordIds.insert(wordId);
+				++nextWordId;
+			}
+			words.insert(std::make_pair(wordId, cv::KeyPoint(float(j%640), float(j/640), 7.0f, float(j%360), 0.01f)));
+		}
+		driver.asyncSave(new Signature(i, 0, 0, double(i), "", words, std::multimap<int, pcl::PointXYZ>()));
+		ids.push_back(i);
+	}
+	double createTime = timer.ticks();
+
+	driver.emptyTrashes();
+	double saveTime = timer.ticks();
+
+	std::list<Signature *> signatures;
+	driver.loadSignatures(ids, signatures);
+	double loadSignaturesTime = timer.ticks();
+
+	std::list<VisualWord *> visualWords;
+	driver.loadWords(wordIds, visualWords);
+	double loadWordsTime = timer.ticks();
+
+	int keypoints = 0;
+	for(std::list<Signature *>::iterator iter=signatures.begin(); iter!=signatures.end(); ++iter)
+	{
+		keypoints += (int)(*iter)->getWords().size();
+		delete *iter;
+	}
+	for(std::list<VisualWord *>::iterator iter=visualWords.begin(); iter!=visualWords.end(); ++iter)
+	{
+		delete *iter;
+	}
+	driver.closeConnection();
+	double closeTime = timer.ticks();
+
+	printf("Created %d signatures and %d words in %f s\n", n, (int)wordIds.size(), createTime);
+	printf("Saved in %f s (%f ms/signature)\n", saveTime, saveTime*1000.0/n);
+	printf("Loaded %d signatures (%d keypoints) in %f s (%f ms/signature)\n", (int)signatures.size(), keypoints, loadSignaturesTime, loadSignaturesTime*1000.0/n);
+	printf("Loaded %d words in %f s\n", (int)visualWords.size(), loadWordsTime);
+	printf("Closed in %f s, database size = %ld KB\n", closeTime, UFile::length(path)/1024);
+
+	return 0;
+}
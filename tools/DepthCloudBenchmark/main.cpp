@@ -0,0 +1,322 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/util3d.h"
+#include "rtabmap/utilite/ULogger.h"
+#include "rtabmap/utilite/UTimer.h"
+#include <pcl/filters/passthrough.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+using namespace rtabmap;
+
+void showUsage()
+{
+	printf("Usage:\n"
+			"depthCloudBenchmark [options]\n"
+			"  Time the creation of clouds from depth and disparity images (VGA and 1080p),\n"
+			"  compared to projecting the pixels one by one with util3d::projectDepthTo3D()\n"
+			"  and util3d::projectDisparityTo3D() (the previous implementation).\n"
+			"  Options:\n"
+			"    -r #       Repetitions (default 20)\n"
+			"    -t #       Threads (default 0: chosen from the image size)\n\n");
+	exit(1);
+}
+
+// Previous implementation of util3d::cloudFromDepth()
+pcl::PointCloud<pcl::PointXYZ>::Ptr cloudFromDepthPerPixel(
+		const cv::Mat & imageDepth,
+		float cx, float cy,
+		float fx, float fy,
+		int decimation)
+{
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+	cloud->height = imageDepth.rows/decimation;
+	cloud->width  = imageDepth.cols/decimation;
+	cloud->is_dense = false;
+	cloud->resize(cloud->height * cloud->width);
+	for(int h = 0; h < imageDepth.rows; h+=decimation)
+	{
+		for(int w = 0; w < imageDepth.cols; w+=decimation)
+		{
+			pcl::PointXYZ & pt = cloud->at((h/decimation)*cloud->width + (w/decimation));
+			pcl::PointXYZ ptXYZ = util3d::projectDepthTo3D(imageDepth, w, h, cx, cy, fx, fy, false);
+			pt.x = ptXYZ.x;
+			pt.y = ptXYZ.y;
+			pt.z = ptXYZ.z;
+		}
+	}
+	return cloud;
+}
+
+// Previous implementation of util3d::cloudFromDepthRGB()
+pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloudFromDepthRGBPerPixel(
+		const cv::Mat & imageRgb,
+		const cv::Mat & imageDepth,
+		float cx, float cy,
+		float fx, float fy,
+		int decimation)
+{
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZRGB>);
+	cloud->height = imageDepth.rows/decimation;
+	cloud->width  = imageDepth.cols/decimation;
+	cloud->is_dense = false;
+	cloud->resize(cloud->height * cloud->width);
+	for(int h = 0; h < imageDepth.rows && h/decimation < (int)cloud->height; h+=decimation)
+	{
+		for(int w = 0; w < imageDepth.cols && w/decimation < (int)cloud->width; w+=decimation)
+		{
+			pcl::PointXYZRGB & pt = cloud->at((h/decimation)*cloud->width + (w/decimation));
+			pt.b = imageRgb.at<cv::Vec3b>(h,w)[0];
+			pt.g = imageRgb.at<cv::Vec3b>(h,w)[1];
+			pt.r = imageRgb.at<cv::Vec3b>(h,w)[2];
+			pcl::PointXYZ ptXYZ = util3d::projectDepthTo3D(imageDepth, w, h, cx, cy, fx, fy, false);
+			pt.x = ptXYZ.x;
+			pt.y = ptXYZ.y;
+			pt.z = ptXYZ.z;
+		}
+	}
+	return cloud;
+}
+
+// Previous implementation of util3d::cloudFromDisparity()
+pcl::PointCloud<pcl::PointXYZ>::Ptr cloudFromDisparityPerPixel(
+		const cv::Mat & imageDisparity,
+		float cx, float cy,
+		float fx, float baseline,
+		int decimation)
+{
+	pcl::PointCloud<pcl::PointXYZ>::Ptr cloud(new pcl::PointCloud<pcl::PointXYZ>);
+	cloud->height = imageDisparity.rows/decimation;
+	cloud->width  = imageDisparity.cols/decimation;
+	cloud->is_dense = false;
+	cloud->resize(cloud->height * cloud->width);
+	for(int h = 0; h < imageDisparity.rows && h/decimation < (int)cloud->height; h+=decimation)
+	{
+		for(int w = 0; w < imageDisparity.cols && w/decimation < (int)cloud->width; w+=decimation)
+		{
+			float disp = float(imageDisparity.at<short>(h,w))/16.0f;
+			cloud->at((h/decimation)*cloud->width + (w/decimation)) = util3d::projectDisparityTo3D(cv::Point2f(w, h), disp, cx, cy, fx, baseline);
+		}
+	}
+	return cloud;
+}
+
+int countValid(const pcl::PointCloud<pcl::PointXYZ> & cloud)
+{
+	int count = 0;
+	for(unsigned int i=0; i<cloud.size(); ++i)
+	{
+		if(pcl::isFinite(cloud.points[i]))
+		{
+			++count;
+		}
+	}
+	return count;
+}
+
+void printResult(const char * name, double before, double after, int repetitions)
+{
+	printf("  %-28s %9.3f ms %9.3f ms %7.1fx\n", name, before*1000.0/repetitions, after*1000.0/repetitions, after>0.0?before/after:0.0);
+}
+
+int main(int argc, char * argv[])
+{
+	ULogger::setType(ULogger::kTypeConsole);
+	ULogger::setLevel(ULogger::kWarning);
+
+	int repetitions = 20;
+	int threads = 0;
+	for(int i=1; i<argc; ++i)
+	{
+		if(strcmp(argv[i], "-r") == 0 && i+1<argc)
+		{
+			repetitions = std::atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-t") == 0 && i+1<argc)
+		{
+			threads = std::atoi(argv[++i]);
+		}
+		else
+		{
+			printf("Not recognized option: \"%s\"\n", argv[i]);
+			showUsage();
+		}
+	}
+	if(repetitions <= 0)
+	{
+		showUsage();
+	}
+	printf("Repetitions=%d, threads=%d\n", repetitions, threads);
+
+	const int sizes[2][2] = {{640, 480}, {1920, 1080}};
+	const int decimations[3] = {1, 2, 4};
+	const float maxDepth = 4.0f;
+	for(int s=0; s<2; ++s)
+	{
+		int cols = sizes[s][0];
+		int rows = sizes[s][1];
+		float fx = cols==640?525.0f:1050.0f;
+		float cx = float(cols)/2.0f - 0.5f;
+		float cy = float(rows)/2.0f - 0.5f;
+		float baseline = 0.075f;
+
+		// Random depth (mm) with 10% of holes, and the equivalent disparity
+		srand(0);
+		cv::Mat depth(rows, cols, CV_16UC1);
+		cv::Mat disparity(rows, cols, CV_16SC1);
+		cv::Mat rgb(rows, cols, CV_8UC3);
+		for(int v=0; v<rows; ++v)
+		{
+			for(int u=0; u<cols; ++u)
+			{
+				unsigned short d = rand()%10==0?0:500+rand()%7500;
+				depth.at<unsigned short>(v,u) = d;
+				disparity.at<short>(v,u) = d?short(16.0f*fx*baseline/(float(d)*0.001f)):0;
+				rgb.at<cv::Vec3b>(v,u) = cv::Vec3b(rand()%256, rand()%256, rand()%256);
+			}
+		}
+		cv::Mat depth32F = util3d::cvtDepthToFloat(depth);
+
+		for(int d=0; d<3; ++d)
+		{
+			int decimation = decimations[d];
+			printf("%dx%d, decimation=%d                  previous       new\n", cols, rows, decimation);
+			UTimer timer;
+			double before, after;
+			int validBefore = 0, validAfter = 0;
+
+			// depth 16 bits
+			timer.start();
+			for(int r=0; r<repetitions; ++r)
+			{
+				validBefore = countValid(*cloudFromDepthPerPixel(depth, cx, cy, fx, fx, decimation));
+			}
+			before = timer.ticks();
+			for(int r=0; r<repetitions; ++r)
+			{
+				validAfter = countValid(*util3d::cloudFromDepth(depth, cx, cy, fx, fx, decimation));
+			}
+			after = timer.ticks();
+			printResult("cloudFromDepth (16U)", before, after, repetitions);
+			if(validBefore != validAfter)
+			{
+				printf("  Error: %d valid points instead of %d!\n", validAfter, validBefore);
+			}
+
+			// depth float
+			timer.start();
+			for(int r=0; r<repetitions; ++r)
+			{
+				cloudFromDepthPerPixel(depth32F, cx, cy, fx, fx, decimation);
+			}
+			before = timer.ticks();
+			for(int r=0; r<repetitions; ++r)
+			{
+				util3d::cloudFromDepth(depth32F, cx, cy, fx, fx, decimation);
+			}
+			after = timer.ticks();
+			printResult("cloudFromDepth (32F)", before, after, repetitions);
+
+			// depth with colors
+			timer.start();
+			for(int r=0; r<repetitions; ++r)
+			{
+				cloudFromDepthRGBPerPixel(rgb, depth, cx, cy, fx, fx, decimation);
+			}
+			before = timer.ticks();
+			for(int r=0; r<repetitions; ++r)
+			{
+				util3d::cloudFromDepthRGB(rgb, depth, cx, cy, fx, fx, decimation);
+			}
+			after = timer.ticks();
+			printResult("cloudFromDepthRGB", before, after, repetitions);
+
+			// disparity
+			timer.start();
+			for(int r=0; r<repetitions; ++r)
+			{
+				validBefore = countValid(*cloudFromDisparityPerPixel(disparity, cx, cy, fx, baseline, decimation));
+			}
+			before = timer.ticks();
+			for(int r=0; r<repetitions; ++r)
+			{
+				validAfter = countValid(*util3d::cloudFromDisparity(disparity, cx, cy, fx, baseline, decimation));
+			}
+			after = timer.ticks();
+			printResult("cloudFromDisparity (16S)", before, after, repetitions);
+			if(validBefore != validAfter)
+			{
+				printf("  Error: %d valid points instead of %d!\n", validAfter, validBefore);
+			}
+
+			// max depth: pass through filter vs filter done with the projection
+			pcl::PassThrough<pcl::PointXYZ> filter;
+			filter.setFilterFieldName("z");
+			filter.setFilterLimits(0, maxDepth);
+			timer.start();
+			for(int r=0; r<repetitions; ++r)
+			{
+				pcl::PointCloud<pcl::PointXYZ>::Ptr output(new pcl::PointCloud<pcl::PointXYZ>);
+				filter.setInputCloud(cloudFromDepthPerPixel(depth, cx, cy, fx, fx, decimation));
+				filter.filter(*output);
+				validBefore = (int)output->size();
+			}
+			before = timer.ticks();
+			for(int r=0; r<repetitions; ++r)
+			{
+				validAfter = countValid(*util3d::cloudFromDepth(depth, cx, cy, fx, fx, decimation, maxDepth));
+			}
+			after = timer.ticks();
+			printResult("cloudFromDepth + max depth", before, after, repetitions);
+			if(validBefore != validAfter)
+			{
+				printf("  Error: %d valid points instead of %d!\n", validAfter, validBefore);
+			}
+
+			// structure of arrays, without cloud
+			int points = (rows/decimation)*(cols/decimation);
+			std::vector<float> x(points), y(points), z(points);
+			timer.start();
+			for(int r=0; r<repetitions; ++r)
+			{
+				util3d::depthToXYZ(depth, cx, cy, fx, fx, decimation, 0.0f, &x[0], &y[0], &z[0], 1);
+			}
+			before = timer.ticks();
+			for(int r=0; r<repetitions; ++r)
+			{
+				util3d::depthToXYZ(depth, cx, cy, fx, fx, decimation, 0.0f, &x[0], &y[0], &z[0], threads);
+			}
+			after = timer.ticks();
+			printResult("depthToXYZ (1 vs -t threads)", before, after, repetitions);
+		}
+	}
+
+	return 0;
+}
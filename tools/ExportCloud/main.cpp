@@ -0,0 +1,225 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/Rtabmap.h"
+#include "rtabmap/core/MapAssembler.h"
+#include "rtabmap/core/VoxelAccumulator.h"
+#include "rtabmap/core/Signature.h"
+#include "rtabmap/utilite/ULogger.h"
+#include "rtabmap/utilite/UTimer.h"
+#include "rtabmap/utilite/UFile.h"
+#include "rtabmap/utilite/UConversion.h"
+#include <pcl/io/pcd_io.h>
+#include <pcl/io/ply_io.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace rtabmap;
+
+void showUsage()
+{
+	printf("Usage:\n"
+			"exportCloud [options] database.db [output.ply]\n"
+			"  Assemble the clouds of the nodes of a database (optimized graph)\n"
+			"  in one cloud, saved in PLY or PCD (default \"cloud.ply\").\n"
+			"  Options:\n"
+			"    -t #       Threads (default 4)\n"
+			"    -d #       Depth decimation (default 4)\n"
+			"    -v #       Voxel size of the node clouds (m, default 0: none)\n"
+			"    -m #       Maximum depth (m, default 4)\n"
+			"    -a #       Voxel size of the assembled cloud (m, default 0.01, 0: none)\n"
+			"    -mem #     Maximum memory of the assembled voxels (MB, default 0: no\n"
+			"               limit), older voxels are spilled in a temporary file\n"
+			"    -counts    Add the number of points of each voxel in the PLY file\n"
+			"    -odom      Use odometry poses instead of the optimized graph\n"
+			"    -ascii     Save in ASCII instead of binary\n\n");
+	exit(1);
+}
+
+// Show the progress each 100 nodes
+class MapAssemblerLog : public MapAssembler
+{
+public:
+	MapAssemblerLog(int threads) : MapAssembler(threads) {}
+protected:
+	virtual void nodeProcessed(int id, const pcl::PointCloud<pcl::PointXYZRGB> & cloud, int index, int total)
+	{
+		if((index+1) % 100 == 0 || index+1 == total)
+		{
+			printf("Processed %d/%d nodes (last=%d, %d points)\n", index+1, total, id, (int)cloud.size());
+		}
+	}
+};
+
+int main(int argc, char * argv[])
+{
+	ULogger::setType(ULogger::kTypeConsole);
+	ULogger::setLevel(ULogger::kWarning);
+
+	if(argc < 2)
+	{
+		showUsage();
+	}
+
+	int threads = 4;
+	int decimation = 4;
+	float voxelSize = 0.0f;
+	float maxDepth = 4.0f;
+	float assembledVoxelSize = 0.01f;
+	int maxMemory = 0;
+	bool counts = false;
+	bool optimized = true;
+	bool binary = true;
+	std::string databasePath;
+	std::string outputPath = "cloud.ply";
+	for(int i=1; i<argc; ++i)
+	{
+		if(strcmp(argv[i], "-t") == 0 && i+1<argc)
+		{
+			threads = std::atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-d") == 0 && i+1<argc)
+		{
+			decimation = std::atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-v") == 0 && i+1<argc)
+		{
+			voxelSize = uStr2Float(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-m") == 0 && i+1<argc)
+		{
+			maxDepth = uStr2Float(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-a") == 0 && i+1<argc)
+		{
+			assembledVoxelSize = uStr2Float(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-mem") == 0 && i+1<argc)
+		{
+			maxMemory = std::atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-counts") == 0)
+		{
+			counts = true;
+		}
+		else if(strcmp(argv[i], "-odom") == 0)
+		{
+			optimized = false;
+		}
+		else if(strcmp(argv[i], "-ascii") == 0)
+		{
+			binary = false;
+		}
+		else if(argv[i][0] == '-')
+		{
+			printf("Not recognized option: \"%s\"\n", argv[i]);
+			showUsage();
+		}
+		else if(databasePath.empty())
+		{
+			databasePath = argv[i];
+		}
+		else
+		{
+			outputPath = argv[i];
+		}
+	}
+	if(databasePath.empty() || threads < 1 || decimation < 1 || voxelSize < 0.0f || maxDepth < 0.0f || assembledVoxelSize < 0.0f || maxMemory < 0)
+	{
+		showUsage();
+	}
+	if(!UFile::exists(databasePath))
+	{
+		printf("Database \"%s\" doesn't exist!\n", databasePath.c_str());
+		return 1;
+	}
+
+	UTimer timer;
+	ParametersMap parameters;
+	parameters.insert(ParametersPair(Parameters::kMemIncrementalMemory(), "false")); // don't modify the database
+	parameters.insert(ParametersPair(Parameters::kMemInitWMWithAllNodes(), "true"));
+	Rtabmap rtabmap;
+	rtabmap.init(parameters, databasePath);
+
+	std::map<int, Signature> signatures;
+	std::map<int, Transform> poses;
+	std::multimap<int, Link> links;
+	std::map<int, int> mapIds;
+	std::map<int, double> stamps;
+	std::map<int, std::string> labels;
+	std::map<int, std::vector<unsigned char> > userDatas;
+	rtabmap.get3DMap(signatures, poses, links, mapIds, stamps, labels, userDatas, optimized, true);
+	printf("Loaded %d nodes (%d poses) in %fs\n", (int)signatures.size(), (int)poses.size(), timer.ticks());
+
+	std::map<int, const Signature *> signaturesRef;
+	for(std::map<int, Signature>::const_iterator iter=signatures.begin(); iter!=signatures.end(); ++iter)
+	{
+		signaturesRef.insert(std::make_pair(iter->first, &iter->second));
+	}
+
+	MapAssemblerLog assembler(threads);
+	assembler.setNodeFilters(decimation, voxelSize, maxDepth);
+	assembler.setAssembledVoxelSize(assembledVoxelSize);
+	bool isPCD = UFile::getExtension(outputPath).compare("pcd") == 0;
+	if(assembledVoxelSize > 0.0f && !isPCD)
+	{
+		// the voxels are streamed in the PLY file
+		util3d::VoxelAccumulator accumulator(assembledVoxelSize, long(maxMemory)*1024*1024);
+		assembler.assemble(poses, signaturesRef, accumulator);
+		printf("Assembled %ld points with %d threads in %fs (%d blocks spilled, %lld bytes)\n",
+				accumulator.points(), threads, timer.ticks(), accumulator.spilledBlocks(), accumulator.spilledBytes());
+		int voxels = accumulator.savePLY(outputPath, binary, counts);
+		if(voxels < 0)
+		{
+			rtabmap.close();
+			return 1;
+		}
+		printf("Saved %d voxels in \"%s\" in %fs\n", voxels, outputPath.c_str(), timer.ticks());
+		rtabmap.close();
+		return 0;
+	}
+
+	pcl::PointCloud<pcl::PointXYZRGB>::Ptr cloud = assembler.assemble(poses, signaturesRef);
+	printf("Assembled %d points with %d threads in %fs\n", (int)cloud->size(), threads, timer.ticks());
+
+	if(cloud->size())
+	{
+		if(isPCD)
+		{
+			pcl::io::savePCDFile(outputPath, *cloud, binary);
+		}
+		else
+		{
+			pcl::io::savePLYFile(outputPath, *cloud, binary);
+		}
+		printf("Saved \"%s\" in %fs\n", outputPath.c_str(), timer.ticks());
+	}
+	rtabmap.close();
+
+	return 0;
+}
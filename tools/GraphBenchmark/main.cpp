@@ -0,0 +1,266 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/Graph.h"
+#include "rtabmap/utilite/ULogger.h"
+#include "rtabmap/utilite/UTimer.h"
+#include "rtabmap/utilite/UConversion.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+
+using namespace rtabmap;
+
+void showUsage()
+{
+	printf("Usage:\n"
+			"graphBenchmark [options]\n"
+			"  Optimize a synthetic graph (laps on a spiral, noisy odometry, a loop closure\n"
+			"  with the previous lap every 3 nodes), then add nodes with a new loop closure\n"
+			"  one at a time and time the incremental optimization of each one.\n"
+			"  Options:\n"
+			"    -n #       Nodes of the graph (default 1000, 10000 and 100000, can be repeated)\n"
+			"    -c #       Loop closures added and timed (default 20)\n"
+			"    -lap #     Nodes per lap (default 100)\n"
+			"    -i #       Maximum iterations (default 100)\n"
+			"    -t #       Relinearize threshold (default %f)\n"
+			"    -r #       Reference optimizer optimizing the whole graph: -1=none, 0=TORO, 1=g2o (default 0)\n"
+			"    -2d        SLAM 2D\n"
+			"    -debug     Show debug log\n\n", Parameters::defaultRGBDOptimizeRelinearizeThreshold());
+	exit(1);
+}
+
+class GraphGenerator
+{
+public:
+	GraphGenerator(int lap, bool slam2d) :
+		lap_(lap),
+		slam2d_(slam2d)
+	{
+		srand(0);
+	}
+
+	const std::map<int, Transform> & poses() const {return poses_;}
+	const std::multimap<int, Link> & links() const {return links_;}
+
+	void addNode(bool loopClosure)
+	{
+		int id = (int)groundTruth_.size() + 1;
+		groundTruth_.insert(std::make_pair(id, truth(id)));
+		if(id == 1)
+		{
+			poses_.insert(std::make_pair(id, groundTruth_.at(id)));
+			return;
+		}
+		Transform odom = groundTruth_.at(id-1).inverse() * groundTruth_.at(id) * noise(0.02f);
+		poses_.insert(std::make_pair(id, poses_.at(id-1) * odom));
+		links_.insert(std::make_pair(id-1, Link(id-1, id, Link::kNeighbor, odom, 0.001f, 0.0004f)));
+		if(loopClosure && id > lap_)
+		{
+			int to = id - lap_;
+			Transform t = groundTruth_.at(id).inverse() * groundTruth_.at(to) * noise(0.01f);
+			links_.insert(std::make_pair(id, Link(id, to, Link::kGlobalClosure, t, 0.0005f, 0.0002f)));
+		}
+	}
+
+	// max distance between the optimized poses and the ground truth
+	float error(int rootId, const std::map<int, Transform> & optimizedPoses) const
+	{
+		float maxError = 0.0f;
+		if(optimizedPoses.size())
+		{
+			Transform correction = groundTruth_.at(rootId) * optimizedPoses.at(rootId).inverse();
+			for(std::map<int, Transform>::const_iterator iter=optimizedPoses.begin(); iter!=optimizedPoses.end(); ++iter)
+			{
+				maxError = std::max(maxError, (correction * iter->second).getDistance(groundTruth_.at(iter->first)));
+			}
+		}
+		return maxError;
+	}
+
+private:
+	Transform truth(int id) const
+	{
+		float a = 2.0f*M_PI*float(id%lap_)/float(lap_);
+		float r = 10.0f + 0.3f*float(id/lap_);
+		if(slam2d_)
+		{
+			return Transform(r*cos(a), r*sin(a), 0, 0, 0, a+M_PI/2.0f);
+		}
+		return Transform(r*cos(a), r*sin(a), 0.2f*sin(3.0f*a), 0.05f*sin(a), 0.05f*cos(a), a+M_PI/2.0f);
+	}
+	Transform noise(float s) const
+	{
+		if(slam2d_)
+		{
+			return Transform(random(s), random(s), 0, 0, 0, random(s/3.0f));
+		}
+		return Transform(random(s), random(s), random(s), random(s/5.0f), random(s/5.0f), random(s/3.0f));
+	}
+	static float random(float s)
+	{
+		return s*(float(rand())/float(RAND_MAX)*2.0f - 1.0f);
+	}
+
+private:
+	int lap_;
+	bool slam2d_;
+	std::map<int, Transform> groundTruth_;
+	std::map<int, Transform> poses_;
+	std::multimap<int, Link> links_;
+};
+
+int main(int argc, char * argv[])
+{
+	ULogger::setType(ULogger::kTypeConsole);
+	ULogger::setLevel(ULogger::kWarning);
+
+	std::vector<int> sizes;
+	int closures = 20;
+	int lap = 100;
+	int iterations = 100;
+	float threshold = Parameters::defaultRGBDOptimizeRelinearizeThreshold();
+	int reference = graph::Optimizer::kTypeTORO;
+	bool slam2d = false;
+	for(int i=1; i<argc; ++i)
+	{
+		if(strcmp(argv[i], "-n") == 0 && i+1<argc)
+		{
+			sizes.push_back(std::atoi(argv[++i]));
+		}
+		else if(strcmp(argv[i], "-c") == 0 && i+1<argc)
+		{
+			closures = std::atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-lap") == 0 && i+1<argc)
+		{
+			lap = std::atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-i") == 0 && i+1<argc)
+		{
+			iterations = std::atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-t") == 0 && i+1<argc)
+		{
+			threshold = uStr2Float(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-r") == 0 && i+1<argc)
+		{
+			reference = std::atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-2d") == 0)
+		{
+			slam2d = true;
+		}
+		else if(strcmp(argv[i], "-debug") == 0)
+		{
+			ULogger::setLevel(ULogger::kDebug);
+		}
+		else
+		{
+			printf("Not recognized option: \"%s\"\n", argv[i]);
+			showUsage();
+		}
+	}
+	if(sizes.empty())
+	{
+		sizes.push_back(1000);
+		sizes.push_back(10000);
+		sizes.push_back(100000);
+	}
+	if(closures <= 0 || lap < 3 || iterations <= 0 || threshold <= 0.0f)
+	{
+		showUsage();
+	}
+	for(unsigned int i=0; i<sizes.size(); ++i)
+	{
+		if(sizes[i] <= lap)
+		{
+			printf("The graph should have more nodes than a lap (%d)\n", lap);
+			showUsage();
+		}
+	}
+	printf("Loop closures timed=%d, nodes/lap=%d, iterations=%d, threshold=%f, %s\n",
+			closures, lap, iterations, threshold, slam2d?"2D":"3D");
+
+	for(unsigned int s=0; s<sizes.size(); ++s)
+	{
+		int n = sizes[s];
+		GraphGenerator generator(lap, slam2d);
+		for(int i=1; i<=n; ++i)
+		{
+			generator.addNode(i%3 == 0);
+		}
+		int rootId = 1;
+
+		graph::IncrementalOptimizer optimizer(iterations, slam2d, false, threshold);
+		UTimer timer;
+		std::map<int, Transform> optimizedPoses = optimizer.optimize(rootId, generator.poses(), generator.links());
+		double batchTime = timer.ticks();
+		printf("\n%d nodes, %d links\n", n, (int)generator.links().size());
+		printf("  First optimization: %f s (%d iterations), error=%f m\n",
+				batchTime, optimizer.lastIterations(), generator.error(rootId, optimizedPoses));
+
+		double total = 0.0;
+		double maxTime = 0.0;
+		int iterationsDone = 0;
+		int rows = 0;
+		for(int i=0; i<closures; ++i)
+		{
+			generator.addNode(true);
+			timer.start();
+			optimizedPoses = optimizer.optimize(rootId, generator.poses(), generator.links());
+			double time = timer.ticks();
+			total += time;
+			maxTime = std::max(maxTime, time);
+			iterationsDone += optimizer.lastIterations();
+			rows += optimizer.lastUpdatedRows();
+		}
+		printf("  New loop closure: %f ms (max %f ms), %.1f iterations and %.1f rows updated on average, error=%f m\n",
+				total*1000.0/closures, maxTime*1000.0, float(iterationsDone)/closures, float(rows)/closures,
+				generator.error(rootId, optimizedPoses));
+
+		if(reference >= 0)
+		{
+			graph::Optimizer::Type type = (graph::Optimizer::Type)reference;
+			ParametersMap parameters;
+			parameters.insert(ParametersPair(Parameters::kRGBDOptimizeIterations(), uNumber2Str(iterations)));
+			parameters.insert(ParametersPair(Parameters::kRGBDOptimizeSlam2D(), uBool2Str(slam2d)));
+			graph::Optimizer * referenceOptimizer = graph::Optimizer::create(type, parameters);
+			timer.start();
+			optimizedPoses = referenceOptimizer->optimize(rootId, generator.poses(), generator.links());
+			double time = timer.ticks();
+			printf("  Reference optimizer (%s, whole graph): %f ms, error=%f m\n",
+					type==graph::Optimizer::kTypeG2O?"g2o":type==graph::Optimizer::kTypeTORO?"TORO":"incremental",
+					time*1000.0, generator.error(rootId, optimizedPoses));
+			delete referenceOptimizer;
+		}
+	}
+
+	return 0;
+}
@@ -47,11 +47,12 @@ void showUsage()
 			"Options:\n"
 			"  -driver #                 Driver number to use: 0=OpenNI-PCL, 1=OpenNI2, 2=Freenect, 3=OpenNI-CV, 4=OpenNI-CV-ASUS, 5=Freenect2, 6=dc1394, 7=FlyCapture2\n"
 			"  -o #                      Odometry type (default 6): 0=SURF, 1=SIFT, 2=ORB, 3=FAST/FREAK, 4=FAST/BRIEF, 5=GFTT/FREAK, 6=GFTT/BRIEF, 7=BRISK\n"
-			"  -nn #                     Nearest neighbor strategy (default 3): kNNFlannNaive=0, kNNFlannKdTree=1, kNNFlannLSH=2, kNNBruteForce=3, kNNBruteForceGPU=4\n"
+			"  -nn #                     Nearest neighbor strategy (default 3): kNNFlannNaive=0, kNNFlannKdTree=1, kNNFlannLSH=2, kNNBruteForce=3, kNNBruteForceGPU=4, kNNBruteForceHamming=5\n"
 			"  -nndr #                   Nearest neighbor distance ratio (default 0.7)\n"
 			"  -flow                     Use optical flow odometry.\n"
 			"  -icp                      Use ICP odometry\n"
 			"  -mono                     Use Mono odometry\n"
+			"  -f2m                      Use Frame-to-Map odometry (local history is the local map size)\n"
 			"\n"
 			"  -hz #.#                   Camera rate (default 0, 0 means as fast as the camera can)\n"
 			"  -db \"input.db\"          Use database instead of camera (recorded with rtabmap-dataRecorder)\n"
@@ -103,6 +104,7 @@ int main (int argc, char * argv[])
 	bool icp = false;
 	bool flow = false;
 	bool mono = false;
+	bool f2m = false;
 	int nnType = rtabmap::Parameters::defaultOdomBowNNType();
 	float nndr = rtabmap::Parameters::defaultOdomBowNNDR();
 	float distance = rtabmap::Parameters::defaultOdomInlierDistance();
@@ -165,7 +167,7 @@ int main (int argc, char * argv[])
 			if(i < argc)
 			{
 				nnType = std::atoi(argv[i]);
-				if(nnType < 0 || nnType > 4)
+				if(nnType < 0 || nnType > 5)
 				{
 					showUsage();
 				}
@@ -503,6 +505,11 @@ int main (int argc, char * argv[])
 			mono = true;
 			continue;
 		}
+		if(strcmp(argv[i], "-f2m") == 0)
+		{
+			f2m = true;
+			continue;
+		}
 		if(strcmp(argv[i], "-p2p") == 0)
 		{
 			p2p = true;
@@ -525,9 +532,9 @@ int main (int argc, char * argv[])
 		UERROR("You set \"-o %d\" (binary descriptor), you must use \"-nn 2\" (any \"-nn\" other than kNNFlannKdTree)", odomType);
 		showUsage();
 	}
-	else if(odomType <= 1 && nnType == rtabmap::VWDictionary::kNNFlannLSH)
+	else if(odomType <= 1 && (nnType == rtabmap::VWDictionary::kNNFlannLSH || nnType == rtabmap::VWDictionary::kNNBruteForceHamming))
 	{
-		UERROR("You set \"-o %d\" (float descriptor), you must use \"-nn 1\" (any \"-nn\" other than kNNFlannLSH)", odomType);
+		UERROR("You set \"-o %d\" (float descriptor), you must use \"-nn 1\" (any \"-nn\" other than kNNFlannLSH or kNNBruteForceHamming)", odomType);
 		showUsage();
 	}
 
@@ -605,6 +612,10 @@ int main (int argc, char * argv[])
 	{
 		nnName= "kNNBruteForceGPU";
 	}
+	else if(nnType == 5)
+	{
+		nnName= "kNNBruteForceHamming";
+	}
 
 	UINFO("Odometry used =           %s", odomName.c_str());
 	UINFO("Camera rate =             %f Hz", rate);
@@ -676,6 +687,12 @@ int main (int argc, char * argv[])
 				parameters.insert(rtabmap::ParametersPair(rtabmap::Parameters::kOdomIterations(), "100"));
 				odom = new rtabmap::OdometryMono(parameters);
 			}
+			else if(f2m)
+			{
+				parameters.insert(rtabmap::ParametersPair(rtabmap::Parameters::kOdomF2MNNDR(), uNumber2Str(nndr)));
+				parameters.insert(rtabmap::ParametersPair(rtabmap::Parameters::kOdomF2MMaxSize(), uNumber2Str(localHistory)));
+				odom = new rtabmap::OdometryF2M(parameters);
+			}
 			else
 			{
 				odom = new rtabmap::OdometryBOW(parameters);
@@ -0,0 +1,225 @@
+/*
+Copyright (c) 2010-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "rtabmap/core/Transform.h"
+#include "rtabmap/utilite/ULogger.h"
+#include "rtabmap/utilite/UTimer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <map>
+
+using namespace rtabmap;
+
+void showUsage()
+{
+	printf("Usage:\n"
+			"transformBenchmark [options]\n"
+			"  Time the Transform operations, compared to the same operations done with\n"
+			"  Eigen 4x4 matrices and a heap allocated storage (the previous implementation).\n"
+			"  Options:\n"
+			"    -n #       Poses (default 100000)\n"
+			"    -r #       Repetitions (default 10)\n\n");
+	exit(1);
+}
+
+// Previous storage of Transform: 12 floats allocated on the heap
+struct HeapTransform
+{
+	HeapTransform() : data(12, 0.0f) {}
+	HeapTransform(const Transform & t) : data(t.data(), t.data()+12) {}
+	Transform toTransform() const
+	{
+		return Transform(data[0], data[1], data[2], data[3],
+						 data[4], data[5], data[6], data[7],
+						 data[8], data[9], data[10], data[11]);
+	}
+	std::vector<float> data;
+};
+
+Transform composeEigen(const Transform & a, const Transform & b)
+{
+	return Transform::fromEigen4f(a.toEigen4f()*b.toEigen4f());
+}
+
+Transform inverseEigen(const Transform & a)
+{
+	return Transform::fromEigen4f(a.toEigen4f().inverse());
+}
+
+void printResult(const char * name, double before, double after, int operations)
+{
+	printf("%-22s %10.2f ns %10.2f ns %8.1fx\n", name, before*1e9/operations, after*1e9/operations, after>0.0?before/after:0.0);
+}
+
+int main(int argc, char * argv[])
+{
+	ULogger::setType(ULogger::kTypeConsole);
+	ULogger::setLevel(ULogger::kWarning);
+
+	int n = 100000;
+	int repetitions = 10;
+	for(int i=1; i<argc; ++i)
+	{
+		if(strcmp(argv[i], "-n") == 0 && i+1<argc)
+		{
+			n = std::atoi(argv[++i]);
+		}
+		else if(strcmp(argv[i], "-r") == 0 && i+1<argc)
+		{
+			repetitions = std::atoi(argv[++i]);
+		}
+		else
+		{
+			printf("Not recognized option: \"%s\"\n", argv[i]);
+			showUsage();
+		}
+	}
+	if(n <= 0 || repetitions <= 0)
+	{
+		showUsage();
+	}
+	printf("Poses=%d, repetitions=%d\n", n, repetitions);
+
+	srand(0);
+	std::map<int, Transform> poses;
+	std::map<int, HeapTransform> heapPoses;
+	for(int i=0; i<n; ++i)
+	{
+		Transform t(float(rand()%1000)/100.0f, float(rand()%1000)/100.0f, float(rand()%1000)/100.0f,
+				float(rand()%628)/100.0f, float(rand()%628)/100.0f, float(rand()%628)/100.0f);
+		poses.insert(std::make_pair(i, t));
+		heapPoses.insert(std::make_pair(i, HeapTransform(t)));
+	}
+	Transform correction(1.0f, 2.0f, 0.5f, 0.1f, 0.2f, 0.3f);
+	int operations = n*repetitions;
+	float checksum = 0.0f; // so that the operations are not optimized away
+
+	printf("%-22s %13s %13s %9s\n", "Operation (per pose)", "Before", "After", "Speedup");
+
+	// Copy of a map of poses (e.g. optimized poses copied in the statistics)
+	UTimer timer;
+	for(int r=0; r<repetitions; ++r)
+	{
+		std::map<int, HeapTransform> copy = heapPoses;
+		checksum += copy.begin()->second.data[3];
+	}
+	double before = timer.ticks();
+	for(int r=0; r<repetitions; ++r)
+	{
+		std::map<int, Transform> copy = poses;
+		checksum += copy.begin()->second.x();
+	}
+	double after = timer.ticks();
+	printResult("map copy", before, after, operations);
+
+	// Composition (e.g. map correction applied on all poses)
+	Transform sum = Transform::getIdentity();
+	timer.start();
+	for(int r=0; r<repetitions; ++r)
+	{
+		for(std::map<int, HeapTransform>::iterator iter=heapPoses.begin(); iter!=heapPoses.end(); ++iter)
+		{
+			HeapTransform t = HeapTransform(composeEigen(correction, iter->second.toTransform()));
+			checksum += t.data[3];
+		}
+	}
+	before = timer.ticks();
+	for(int r=0; r<repetitions; ++r)
+	{
+		for(std::map<int, Transform>::iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+		{
+			Transform t = correction * iter->second;
+			checksum += t.x();
+		}
+	}
+	after = timer.ticks();
+	printResult("composition", before, after, operations);
+
+	// Inverse
+	for(int r=0; r<repetitions; ++r)
+	{
+		for(std::map<int, HeapTransform>::iterator iter=heapPoses.begin(); iter!=heapPoses.end(); ++iter)
+		{
+			HeapTransform t = HeapTransform(inverseEigen(iter->second.toTransform()));
+			checksum += t.data[3];
+		}
+	}
+	before = timer.ticks();
+	for(int r=0; r<repetitions; ++r)
+	{
+		for(std::map<int, Transform>::iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+		{
+			Transform t = iter->second.inverse();
+			checksum += t.x();
+		}
+	}
+	after = timer.ticks();
+	printResult("inverse", before, after, operations);
+
+	// Point transformation
+	float x=0.0f, y=0.0f, z=0.0f;
+	for(int r=0; r<repetitions; ++r)
+	{
+		for(std::map<int, HeapTransform>::iterator iter=heapPoses.begin(); iter!=heapPoses.end(); ++iter)
+		{
+			Eigen::Vector3f p = iter->second.toTransform().toEigen3f() * Eigen::Vector3f(1.0f, 2.0f, 3.0f);
+			x += p[0]; y += p[1]; z += p[2];
+		}
+	}
+	before = timer.ticks();
+	for(int r=0; r<repetitions; ++r)
+	{
+		for(std::map<int, Transform>::iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+		{
+			float px = 1.0f, py = 2.0f, pz = 3.0f;
+			iter->second.transformPoint(px, py, pz);
+			x += px; y += py; z += pz;
+		}
+	}
+	after = timer.ticks();
+	printResult("point transformation", before, after, operations);
+	checksum += x+y+z;
+
+	// Same results
+	float maxError = 0.0f;
+	for(std::map<int, Transform>::iterator iter=poses.begin(); iter!=poses.end(); ++iter)
+	{
+		Transform a = correction * iter->second.inverse();
+		Transform b = composeEigen(correction, inverseEigen(iter->second));
+		for(int i=0; i<12; ++i)
+		{
+			maxError = std::max(maxError, std::fabs(a[i]-b[i]));
+		}
+	}
+	printf("Max difference with Eigen: %g (checksum %f)\n", maxError, checksum);
+
+	return 0;
+}
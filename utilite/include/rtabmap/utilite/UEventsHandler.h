@@ -35,7 +35,8 @@ class UEvent;
  * Note that it is not safe to automatically add the handler to UEventsManager in the handler's constructor.
  *
  * Note for multi-threading: the handleEvent() method is called
- * inside the UEventsManager thread. If the inherited class also inherits
+ * inside a thread of the UEventsManager dedicated to this handler (or in the
+ * sender thread for synchronous posts). If the inherited class also inherits
  * from UThreadNode, handleEvent() is done as well outside the thread's main loop, so
  * be careful to protect private data of the thread used in its main loop.
  *
@@ -138,6 +139,7 @@ protected:
      * to the handleEvent() method.
      */
     friend class UEventsManager;
+    friend class UEventDispatcher;
 
     /**
      * Method called by the UEventsManager
@@ -146,8 +148,9 @@ protected:
      * the dispatching loop is done; the faster the 
      * events are received. If a handling function 
      * takes too much time, the events list can grow 
-     * faster than it is emptied. The event can be
-     * modified but must not be deleted.
+     * faster than it is emptied. The event is shared
+     * with the other handlers receiving it at the same
+     * time, so it must not be modified or deleted.
      *
      */
     virtual void handleEvent(UEvent * event) = 0;
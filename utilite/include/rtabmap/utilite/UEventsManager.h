@@ -30,23 +30,96 @@
 #include <list>
 #include <map>
 
-// TODO Not implemented... for multithreading event handling
+/**
+ * Counters of the events queue of a handler.
+ * @see UEventsManager::getQueueStatistics()
+ */
+class UTILITE_EXP UEventsQueueStatistics
+{
+public:
+	UEventsQueueStatistics() :
+		queued(0),
+		maxQueued(0),
+		handled(0),
+		latencyMean(0.0),
+		latencyMax(0.0),
+		handlingMean(0.0),
+		handlingMax(0.0)
+	{}
+	int queued;          /* Events waiting to be handled. */
+	int maxQueued;       /* Maximum events waiting since the handler was added. */
+	unsigned long handled; /* Events handled. */
+	double latencyMean;  /* Mean time (s) between the post and the handling of an event. */
+	double latencyMax;   /* Maximum time (s) between the post and the handling of an event. */
+	double handlingMean; /* Mean time (s) of handleEvent(). */
+	double handlingMax;  /* Maximum time (s) of handleEvent(). */
+};
+
+/*
+ * Thread delivering the asynchronous events to one handler, in the
+ * order they are posted. Events are posted in a lock-free queue
+ * (multiple producers, one consumer: this thread). Only the
+ * UEventsManager can create a dispatcher.
+ */
 class UEventDispatcher : public UThread
 {
 public:
 	virtual ~UEventDispatcher();
+
 protected:
 	friend class UEventsManager;
-	UEventDispatcher();
 
-	virtual void mainLoop();
+	/*
+	 * An event shared by all the handlers receiving it, deleted
+	 * by the last handler that handled it.
+	 */
+	struct SharedEvent
+	{
+		UEvent * event;
+		double stamp; // time of the post
+		volatile long refs; // handlers not done with the event
+	};
+
+	UEventDispatcher(UEventsHandler * handler);
+
+	/*
+	 * Can be called by many threads at the same time.
+	 */
+	void post(SharedEvent * event);
+
+	/*
+	 * handleEvent() will not be called anymore on the handler after
+	 * this call (except for an event being already handled).
+	 */
+	void disable();
+
+	UEventsHandler * handler() const {return handler_;}
+	UEventsQueueStatistics statistics() const;
+
+	static void release(SharedEvent * event);
 
 private:
-	virtual void killCleanup();
+	virtual void mainLoop();
+	virtual void mainLoopKill();
+	SharedEvent * pop();
 
 private:
-	UEvent * _event;
-	std::vector<UEventsHandler*> _handlers;
+	struct Node
+	{
+		Node * volatile next;
+		SharedEvent * event;
+	};
+
+	UEventsHandler * handler_;
+	bool enabled_;
+	UMutex enabledMutex_;
+	Node * volatile head_; // last node pushed, producers side
+	Node * tail_;          // stub node, consumer side
+	volatile long queued_;
+	volatile long maxQueued_;
+	USemaphore postedSem_;
+	UEventsQueueStatistics stats_; // updated by the consumer only, except maxQueued
+	mutable UMutex statsMutex_;
 };
 
 /**
@@ -56,6 +129,12 @@ private:
  * like the design pattern Mediator. It is also a Singleton, so 
  * it can be used anywhere in the application. 
  *
+ * Each handler receives its asynchronous events in its own thread, so
+ * a slow handler doesn't delay the others. The FIFO order is kept
+ * for each handler, not between handlers. An event is not copied: all
+ * its receivers share the same event, which is deleted after the last
+ * one handled it.
+ *
  * To send an event, use UEventsManager::post().
  * Events are automatically deleted after they are posted.
  *
@@ -122,6 +201,11 @@ public:
     static void removeAllPipes(const UEventsSender * sender);
     static void removeNullPipes(const UEventsSender * sender);
 
+    /**
+     * Queue counters of each handler currently added.
+     */
+    static std::map<const UEventsHandler*, UEventsQueueStatistics> getQueueStatistics();
+
 protected:
 
     /*
@@ -155,7 +239,8 @@ protected:
     friend class UDestroyer<UEventsManager>;
 
     /**
-	 * The UEventsManager's main loop.
+	 * The UEventsManager's main loop: the threads of the
+	 * removed handlers are joined and deleted.
 	 */
     virtual void mainLoop();
 
@@ -167,13 +252,7 @@ private:
     virtual void mainLoopKill();
 
     /*
-     * This method dispatches asynchronized events to all handlers.
-     * FIFO (first in first out) dispatching is used.
-     */
-    virtual void dispatchEvents();
-
-    /*
-	 * This method dispatches an event to all handlers.
+	 * This method dispatches an event to all handlers (synchronous post).
 	 */
     virtual void dispatchEvent(UEvent * event, const UEventsSender * sender);
 
@@ -224,6 +303,8 @@ private:
     void _removeAllPipes(const UEventsSender * sender);
     void _removeNullPipes(const UEventsSender * sender);
 
+    std::map<const UEventsHandler*, UEventsQueueStatistics> _getQueueStatistics() const;
+
 private:
     
     class Pipe
@@ -241,11 +322,11 @@ private:
 
     static UEventsManager* instance_;            /* The EventsManager instance pointer. */
     static UDestroyer<UEventsManager> destroyer_; /* The EventsManager's destroyer. */
-    std::list<std::pair<UEvent*, const UEventsSender * > > events_; /* The events list. */
     std::list<UEventsHandler*> handlers_;      /* The handlers list. */
-    UMutex eventsMutex_;                         /* The mutex of the events list, */
-    UMutex handlersMutex_;                       /* The mutex of the handlers list. */
-    USemaphore postEventSem_;                    /* Semaphore used to signal when an events is posted. */
+    std::map<UEventsHandler*, UEventDispatcher*> dispatchers_; /* The thread of each handler. */
+    std::list<UEventDispatcher*> removedDispatchers_; /* Threads of the removed handlers, to be deleted. */
+    mutable UMutex handlersMutex_;               /* The mutex of the handlers list and dispatchers. */
+    USemaphore removedSem_;                      /* Semaphore used to signal when a handler is removed. */
     std::list<Pipe> pipes_;
     UMutex pipesMutex_;
 };
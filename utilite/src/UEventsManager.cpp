@@ -19,9 +19,188 @@
 
 #include "rtabmap/utilite/UEventsManager.h"
 #include "rtabmap/utilite/UEvent.h"
+#include "rtabmap/utilite/UTimer.h"
 #include <list>
 #include "rtabmap/utilite/UStl.h"
 
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Atomic operations used by the events queues
+#ifdef _WIN32
+inline void * uAtomicExchangePtr(void * volatile * ptr, void * value) {return InterlockedExchangePointer(ptr, value);}
+inline long uAtomicAdd(volatile long * value, long increment) {return InterlockedExchangeAdd(value, increment) + increment;}
+inline long uAtomicCompareExchange(volatile long * value, long expected, long desired) {return InterlockedCompareExchange(value, desired, expected);}
+inline void * uAtomicLoadPtr(void * volatile * ptr) {void * value = *ptr; MemoryBarrier(); return value;}
+inline void uAtomicStorePtr(void * volatile * ptr, void * value) {MemoryBarrier(); *ptr = value;}
+#elif defined(__ATOMIC_ACQ_REL)
+inline void * uAtomicExchangePtr(void * volatile * ptr, void * value) {return __atomic_exchange_n(ptr, value, __ATOMIC_ACQ_REL);}
+inline long uAtomicAdd(volatile long * value, long increment) {return __atomic_add_fetch(value, increment, __ATOMIC_ACQ_REL);}
+inline long uAtomicCompareExchange(volatile long * value, long expected, long desired) {__atomic_compare_exchange_n(value, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE); return expected;}
+inline void * uAtomicLoadPtr(void * volatile * ptr) {return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);}
+inline void uAtomicStorePtr(void * volatile * ptr, void * value) {__atomic_store_n(ptr, value, __ATOMIC_RELEASE);}
+#else
+inline void * uAtomicExchangePtr(void * volatile * ptr, void * value) {__sync_synchronize(); return __sync_lock_test_and_set(ptr, value);}
+inline long uAtomicAdd(volatile long * value, long increment) {return __sync_add_and_fetch(value, increment);}
+inline long uAtomicCompareExchange(volatile long * value, long expected, long desired) {return __sync_val_compare_and_swap(value, expected, desired);}
+inline void * uAtomicLoadPtr(void * volatile * ptr) {void * value = *ptr; __sync_synchronize(); return value;}
+inline void uAtomicStorePtr(void * volatile * ptr, void * value) {__sync_synchronize(); *ptr = value;}
+#endif
+
+////////////////////////////
+// UEventDispatcher
+////////////////////////////
+UEventDispatcher::UEventDispatcher(UEventsHandler * handler) :
+	handler_(handler),
+	enabled_(true),
+	queued_(0),
+	maxQueued_(0)
+{
+	UASSERT(handler_ != 0);
+	tail_ = new Node();
+	tail_->next = 0;
+	tail_->event = 0;
+	head_ = tail_;
+}
+
+UEventDispatcher::~UEventDispatcher()
+{
+	join(true);
+
+	// Release events not handled
+	SharedEvent * event;
+	while((event = pop()) != 0)
+	{
+		uAtomicAdd(&queued_, -1);
+		release(event);
+	}
+	delete tail_;
+}
+
+void UEventDispatcher::post(SharedEvent * event)
+{
+	// Vyukov's MPSC queue: the producers only exchange the head
+	Node * node = new Node();
+	node->next = 0;
+	node->event = event;
+	Node * previous = (Node *)uAtomicExchangePtr((void * volatile *)&head_, node);
+	uAtomicStorePtr((void * volatile *)&previous->next, node);
+
+	long queued = uAtomicAdd(&queued_, 1);
+	long maxQueued = maxQueued_;
+	while(queued > maxQueued)
+	{
+		long previous = uAtomicCompareExchange(&maxQueued_, maxQueued, queued);
+		if(previous == maxQueued)
+		{
+			break;
+		}
+		maxQueued = previous;
+	}
+
+	postedSem_.release();
+}
+
+UEventDispatcher::SharedEvent * UEventDispatcher::pop()
+{
+	Node * next = (Node *)uAtomicLoadPtr((void * volatile *)&tail_->next);
+	while(next == 0)
+	{
+		// a producer exchanged the head but has not linked its node yet
+		if(head_ == tail_)
+		{
+			return 0;
+		}
+		uSleep(0);
+		next = (Node *)uAtomicLoadPtr((void * volatile *)&tail_->next);
+	}
+	SharedEvent * event = next->event;
+	next->event = 0;
+	delete tail_;
+	tail_ = next; // becomes the stub
+	return event;
+}
+
+void UEventDispatcher::disable()
+{
+	enabledMutex_.lock();
+	enabled_ = false;
+	enabledMutex_.unlock();
+}
+
+UEventsQueueStatistics UEventDispatcher::statistics() const
+{
+	statsMutex_.lock();
+	UEventsQueueStatistics stats = stats_;
+	statsMutex_.unlock();
+	stats.queued = (int)uAtomicAdd(const_cast<volatile long *>(&queued_), 0);
+	stats.maxQueued = (int)uAtomicAdd(const_cast<volatile long *>(&maxQueued_), 0);
+	return stats;
+}
+
+void UEventDispatcher::release(SharedEvent * event)
+{
+	if(uAtomicAdd(&event->refs, -1) == 0)
+	{
+		delete event->event;
+		delete event;
+	}
+}
+
+void UEventDispatcher::mainLoop()
+{
+	postedSem_.acquire();
+	if(this->isKilled())
+	{
+		return;
+	}
+
+	SharedEvent * event = pop();
+	if(event == 0)
+	{
+		return;
+	}
+	uAtomicAdd(&queued_, -1);
+
+	enabledMutex_.lock();
+	bool enabled = enabled_;
+	enabledMutex_.unlock();
+
+	if(enabled)
+	{
+		double start = UTimer::now();
+		handler_->handleEvent(event->event);
+		double end = UTimer::now();
+
+		double latency = start - event->stamp;
+		double handling = end - start;
+		statsMutex_.lock();
+		++stats_.handled;
+		stats_.latencyMean += (latency - stats_.latencyMean) / double(stats_.handled);
+		stats_.handlingMean += (handling - stats_.handlingMean) / double(stats_.handled);
+		if(latency > stats_.latencyMax)
+		{
+			stats_.latencyMax = latency;
+		}
+		if(handling > stats_.handlingMax)
+		{
+			stats_.handlingMax = handling;
+		}
+		statsMutex_.unlock();
+	}
+	release(event);
+}
+
+void UEventDispatcher::mainLoopKill()
+{
+	postedSem_.release();
+}
+
+////////////////////////////
+// UEventsManager
+////////////////////////////
+
 UEventsManager* UEventsManager::instance_ = 0;
 UDestroyer<UEventsManager> UEventsManager::destroyer_;
 
@@ -122,6 +301,11 @@ void UEventsManager::removeNullPipes(const UEventsSender * sender)
 	}
 }
 
+std::map<const UEventsHandler*, UEventsQueueStatistics> UEventsManager::getQueueStatistics()
+{
+	return UEventsManager::getInstance()->_getQueueStatistics();
+}
+
 UEventsManager* UEventsManager::getInstance()
 {
     if(!instance_)
@@ -141,12 +325,20 @@ UEventsManager::~UEventsManager()
 {
    	join(true);
 
-    // Free memory
-    for(std::list<std::pair<UEvent*, const UEventsSender*> >::iterator it=events_.begin(); it!=events_.end(); ++it)
+    // Stop the handler threads, events not handled are deleted
+    handlersMutex_.lock();
+    for(std::map<UEventsHandler*, UEventDispatcher*>::iterator iter=dispatchers_.begin(); iter!=dispatchers_.end(); ++iter)
     {
-        delete it->first;
+    	removedDispatchers_.push_back(iter->second);
+    }
+    dispatchers_.clear();
+    std::list<UEventDispatcher*> dispatchers = removedDispatchers_;
+    removedDispatchers_.clear();
+    handlersMutex_.unlock();
+    for(std::list<UEventDispatcher*>::iterator iter=dispatchers.begin(); iter!=dispatchers.end(); ++iter)
+    {
+    	delete *iter;
     }
-    events_.clear();
 
     handlers_.clear();
 
@@ -155,45 +347,26 @@ UEventsManager::~UEventsManager()
 
 void UEventsManager::mainLoop()
 {
-    postEventSem_.acquire();
+    removedSem_.acquire();
     if(!this->isKilled())
     {
-		dispatchEvents();
+    	std::list<UEventDispatcher*> dispatchers;
+    	handlersMutex_.lock();
+    	dispatchers = removedDispatchers_;
+    	removedDispatchers_.clear();
+    	handlersMutex_.unlock();
+
+    	// Wait the events being handled, then delete the threads
+    	for(std::list<UEventDispatcher*>::iterator iter=dispatchers.begin(); iter!=dispatchers.end(); ++iter)
+    	{
+    		delete *iter;
+    	}
     }
 }
 
 void UEventsManager::mainLoopKill()
 {
-    postEventSem_.release();
-}
-
-void UEventsManager::dispatchEvents()
-{
-    if(events_.size() == 0)
-    {
-        return;
-    }
-
-    std::list<std::pair<UEvent*, const UEventsSender*> >::iterator it;
-    std::list<std::pair<UEvent*, const UEventsSender*> > eventsBuf;
-
-    // Copy events in a buffer :
-    // Other threads can post events 
-    // while events are handled.
-    eventsMutex_.lock();
-    {
-        eventsBuf = events_;
-        events_.clear();
-    }
-    eventsMutex_.unlock();
-
-	// Past events to handlers
-	for(it=eventsBuf.begin(); it!=eventsBuf.end(); ++it)
-	{
-		dispatchEvent(it->first, it->second);
-		delete it->first;
-	}
-    eventsBuf.clear();
+    removedSem_.release();
 }
 
 void UEventsManager::dispatchEvent(UEvent * event, const UEventsSender * sender)
@@ -255,6 +428,9 @@ void UEventsManager::_addHandler(UEventsHandler* handler)
         	if(!handlerFound)
         	{
         		handlers_.push_back(handler);
+        		UEventDispatcher * dispatcher = new UEventDispatcher(handler);
+        		dispatchers_.insert(std::make_pair(handler, dispatcher));
+        		dispatcher->start();
         	}
         }
         handlersMutex_.unlock();
@@ -275,6 +451,17 @@ void UEventsManager::_removeHandler(UEventsHandler* handler)
                     break;
                 }
             }
+            std::map<UEventsHandler*, UEventDispatcher*>::iterator iter = dispatchers_.find(handler);
+            if(iter != dispatchers_.end())
+            {
+            	// The thread may be the caller (handler removed in its handleEvent()),
+            	// it is joined later by the UEventsManager's thread.
+            	iter->second->disable();
+            	iter->second->kill();
+            	removedDispatchers_.push_back(iter->second);
+            	dispatchers_.erase(iter);
+            	removedSem_.release();
+            }
         }
         handlersMutex_.unlock();
 
@@ -298,14 +485,38 @@ void UEventsManager::_postEvent(UEvent * event, bool async, const UEventsSender
     {
     	if(async)
     	{
-			eventsMutex_.lock();
+    		std::list<UEventsHandler*> handlers;
+
+			// Verify if there are pipes with the sender for his type of event
+			if(sender)
+			{
+				handlers = getPipes(sender, event->getClassName());
+			}
+
+			UEventDispatcher::SharedEvent * sharedEvent = new UEventDispatcher::SharedEvent();
+			sharedEvent->event = event;
+			sharedEvent->stamp = UTimer::now();
+			sharedEvent->refs = 1; // released after the event is posted to all handlers
+
+			handlersMutex_.lock();
+			if(handlers.size() == 0)
 			{
-				events_.push_back(std::make_pair(event, sender));
+				//No pipes, send to all handlers
+				handlers = handlers_;
 			}
-			eventsMutex_.unlock();
+			for(std::list<UEventsHandler*>::iterator it=handlers.begin(); it!=handlers.end(); ++it)
+			{
+				// Don't send the event to the sender
+				std::map<UEventsHandler*, UEventDispatcher*>::iterator iter = dispatchers_.find(*it);
+				if(*it != sender && iter != dispatchers_.end())
+				{
+					uAtomicAdd(&sharedEvent->refs, 1);
+					iter->second->post(sharedEvent);
+				}
+			}
+			handlersMutex_.unlock();
 
-			// Signal the EventsManager that an Event is added
-			postEventSem_.release();
+			UEventDispatcher::release(sharedEvent);
     	}
     	else
     	{
@@ -319,6 +530,18 @@ void UEventsManager::_postEvent(UEvent * event, bool async, const UEventsSender
     }
 }
 
+std::map<const UEventsHandler*, UEventsQueueStatistics> UEventsManager::_getQueueStatistics() const
+{
+	std::map<const UEventsHandler*, UEventsQueueStatistics> statistics;
+	handlersMutex_.lock();
+	for(std::map<UEventsHandler*, UEventDispatcher*>::const_iterator iter=dispatchers_.begin(); iter!=dispatchers_.end(); ++iter)
+	{
+		statistics.insert(std::make_pair(iter->first, iter->second->statistics()));
+	}
+	handlersMutex_.unlock();
+	return statistics;
+}
+
 std::list<UEventsHandler*> UEventsManager::getPipes(
 		const UEventsSender * sender,
 		const std::string & eventName)